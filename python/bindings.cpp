@@ -8,14 +8,14 @@ namespace py = pybind11;
 
 class PyMatch {
 public:
-    int m_start;
-    int m_end;
+    int64_t m_start;
+    int64_t m_end;
     
-    PyMatch(int start, int end) : m_start(start), m_end(end) {}
+    PyMatch(int64_t start, int64_t end) : m_start(start), m_end(end) {}
     
-    int start() const { return m_start; }
-    int end() const { return m_end; }
-    std::pair<int, int> span() const { return {m_start, m_end}; }
+    int64_t start() const { return m_start; }
+    int64_t end() const { return m_end; }
+    std::pair<int64_t, int64_t> span() const { return {m_start, m_end}; }
     
     // Support truthiness check
     bool __bool__() const { return true; }
@@ -25,77 +25,113 @@ public:
     }
 };
 
-// JIT function signature: int match(const char* input, int* start_out, int* end_out)
-typedef int (*JitFunc)(const char*, int*, int*);
+// Raised (as _regjit.BudgetExceeded, a TimeoutError) when a pattern compiled
+// with a step budget gives up on an input.
+struct BudgetExceeded : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
 
 class PyRegex {
 public:
     std::string pattern;
-    uintptr_t func_ptr;  // Cached JIT function pointer
+    regjit_handle* handle;  // Pins the compiled pattern for the object's lifetime
     
-    PyRegex(const std::string &pat) : pattern(pat), func_ptr(0) {
+    // engine: "backtrack" (JIT, default), "dfa" (lazy DFA, linear time),
+    // "pike" (Pike VM, linear time), "bitstate" (memoized backtracking),
+    // "auto" (JIT unless the pattern is risky) or "tiered" (BitState, then
+    // the JIT once the pattern is hot)
+    // step_budget: backtracking steps allowed per match call (0 = unlimited)
+    PyRegex(const std::string &pat, const std::string &engine = "backtrack", uint64_t step_budget = 0)
+        : pattern(pat), handle(nullptr) {
+        regjit_options opts;
+        regjit_options_init(&opts);
+        opts.step_budget = step_budget;
+        if (engine == "dfa") {
+            opts.engine = REGJIT_ENGINE_LAZY_DFA;
+        } else if (engine == "pike") {
+            opts.engine = REGJIT_ENGINE_PIKE_VM;
+        } else if (engine == "bitstate") {
+            opts.engine = REGJIT_ENGINE_BITSTATE;
+        } else if (engine == "auto") {
+            opts.engine = REGJIT_ENGINE_AUTO;
+        } else if (engine == "tiered") {
+            opts.engine = REGJIT_ENGINE_TIERED;
+        } else if (engine != "backtrack") {
+            throw std::invalid_argument("unknown engine: " + engine);
+        }
         char* err = nullptr;
-        if (!regjit_acquire(pat.c_str(), &err)) {
+        handle = regjit_open_ex(pat.c_str(), &opts, &err);
+        if (!handle) {
             std::string emsg = err ? std::string(err) : "acquire/compile failed";
             if (err) free(err);
             throw std::runtime_error(emsg);
         }
-        // Cache the JIT function pointer for fast matching
-        func_ptr = regjit_get_func_ptr(pat.c_str());
+    }
+    
+    PyRegex(const PyRegex&) = delete;
+    PyRegex& operator=(const PyRegex&) = delete;
+    PyRegex(PyRegex &&o) noexcept : pattern(std::move(o.pattern)), handle(o.handle) {
+        o.handle = nullptr;
     }
     
     ~PyRegex() {
-        regjit_release(pattern.c_str());
+        regjit_close(handle);
     }
     
-    // Fast match using cached function pointer - no acquire/release overhead
-    py::object match_str_fast(const std::string &s) {
-        if (func_ptr == 0) {
-            throw std::runtime_error("JIT function not available");
-        }
-        
-        // Ensure null termination
-        const char* cstr = s.c_str();
-        
-        JitFunc func = (JitFunc)func_ptr;
-        int start = -1, end = -1;
-        int matched = func(cstr, &start, &end);
-        
-        if (matched == 1) {
-            return py::cast(PyMatch(start, end));
-        }
-        return py::none();
+    // Close the handle and unload the compiled code if nothing else uses it
+    void unload() {
+        regjit_close(handle);
+        handle = nullptr;
+        regjit_unload(pattern.c_str());
     }
     
-    // Fast search using cached function pointer
-    py::object search_str_fast(const std::string &s) {
-        if (func_ptr == 0) {
+    // Match through the pinned handle - no cache lookup or refcounting.
+    // The buffer is passed with its length, so it is matched in place.
+    py::object exec_fast(const char* data, size_t len) {
+        if (!handle) {
             throw std::runtime_error("JIT function not available");
         }
         
-        const char* cstr = s.c_str();
-        
-        JitFunc func = (JitFunc)func_ptr;
-        int start = -1, end = -1;
-        int matched = func(cstr, &start, &end);
-        
-        if (matched == 1) {
-            return py::cast(PyMatch(start, end));
+        regjit_match_result r = regjit_exec(handle, data, len);
+        if (r.matched == 1) {
+            return py::cast(PyMatch(r.start, r.end));
+        }
+        if (r.matched == REGJIT_BUDGET_EXCEEDED) {
+            throw BudgetExceeded("step budget exhausted matching " + pattern);
         }
         return py::none();
     }
     
-    py::object match_bytes(py::bytes b) {
-        std::string s = static_cast<std::string>(b);
-        return match_str_fast(s);
+    // Borrow the UTF-8 buffer of a str without copying it into a std::string
+    py::object exec_str(const py::str &s) {
+        Py_ssize_t len = 0;
+        const char* data = PyUnicode_AsUTF8AndSize(s.ptr(), &len);
+        if (!data) throw py::error_already_set();
+        return exec_fast(data, (size_t)len);
+    }
+    
+    // Borrow the internal buffer of a bytes object (may contain NUL bytes)
+    py::object exec_bytes(const py::bytes &b) {
+        char* data = nullptr;
+        Py_ssize_t len = 0;
+        if (PyBytes_AsStringAndSize(b.ptr(), &data, &len) != 0) throw py::error_already_set();
+        return exec_fast(data, (size_t)len);
     }
     
-    py::object match_str(const std::string &s) {
-        return match_str_fast(s);
+    py::object match_bytes(const py::bytes &b) {
+        return exec_bytes(b);
     }
     
-    py::object search_str(const std::string &s) {
-        return search_str_fast(s);
+    py::object search_bytes(const py::bytes &b) {
+        return exec_bytes(b);
+    }
+    
+    py::object match_str(const py::str &s) {
+        return exec_str(s);
+    }
+    
+    py::object search_str(const py::str &s) {
+        return exec_str(s);
     }
 };
 
@@ -109,14 +145,20 @@ public:
             ;
 
         py::class_<PyRegex>(m, "Regex")
-            .def(py::init<const std::string&>())
+            .def(py::init<const std::string&, const std::string&, uint64_t>(), py::arg("pattern"),
+                 py::arg("engine") = "backtrack", py::arg("step_budget") = 0)
             .def("match_bytes", &PyRegex::match_bytes)
-            .def("match", (py::object (PyRegex::*)(const std::string&)) &PyRegex::match_str)
-            .def("search", (py::object (PyRegex::*)(const std::string&)) &PyRegex::search_str)
-            .def("unload", [](PyRegex &r){ regjit_unload(r.pattern.c_str()); })
+            .def("search_bytes", &PyRegex::search_bytes)
+            .def("match", &PyRegex::match_str)
+            .def("search", &PyRegex::search_str)
+            .def("unload", &PyRegex::unload)
             ;
 
-    m.def("compile", [](const std::string &pat){ return PyRegex(pat); });
+    py::register_exception<BudgetExceeded>(m, "BudgetExceeded", PyExc_TimeoutError);
+
+    m.def("compile", [](const std::string &pat, const std::string &engine, uint64_t step_budget){
+              return PyRegex(pat, engine, step_budget); },
+          py::arg("pattern"), py::arg("engine") = "backtrack", py::arg("step_budget") = 0);
     m.def("cache_size", [](){ return regjit_cache_size(); });
     m.def("set_cache_maxsize", [](size_t n){ regjit_set_cache_maxsize(n); });
     m.def("acquire", [](const std::string &pat){ char* err = nullptr; if (!regjit_acquire(pat.c_str(), &err)) { std::string emsg = err ? std::string(err) : "acquire failed"; if (err) free(err); throw std::runtime_error(emsg); } });
@@ -0,0 +1,135 @@
+#include "regjit.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compile latency vs. match speed of each optimization level
+// (regjit_opt_level) on the patterns of src/benchmark.cpp. Runs once with
+// the default codegen, where most of these become direct-coded DFAs, and
+// once with the DFA codegen off, so every pattern gets the backtracking
+// code.
+//
+//   make RELEASE=1 bench_opt && ./bench_opt
+
+struct Case {
+    std::string name;
+    std::string pattern;
+    std::string input;
+};
+
+constexpr int COMPILES = 15;      // compile time is the median of these
+constexpr int ITERATIONS = 10000; // searches timed per pattern
+constexpr int WARMUP = 100;
+
+static const regjit_opt_level LEVELS[] = {REGJIT_OPT_O0, REGJIT_OPT_O1, REGJIT_OPT_O2, REGJIT_OPT_O3,
+                                          REGJIT_OPT_REGEX};
+static const char* const LEVEL_NAMES[] = {"O0", "O1", "O2", "O3", "regex"};
+constexpr int NLEVELS = 5;
+
+struct Timing {
+    double compile_us;
+    double search_ns;
+};
+
+static Timing measure(const Case& c, regjit_opt_level level) {
+    using clock = std::chrono::steady_clock;
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.opt_level = level;
+
+    // The cache holds nothing once a handle closes, so each open compiles
+    std::vector<double> compiles;
+    for (int i = 0; i < COMPILES; ++i) {
+        char* err = nullptr;
+        auto t0 = clock::now();
+        regjit_handle* h = regjit_open_ex(c.pattern.c_str(), &opts, &err);
+        auto t1 = clock::now();
+        if (!h) {
+            std::cerr << "Failed to compile " << c.pattern << ": " << (err ? err : "") << std::endl;
+            free(err);
+            return {0, 0};
+        }
+        compiles.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        regjit_close(h);
+    }
+    std::sort(compiles.begin(), compiles.end());
+
+    regjit_handle* h = regjit_open_ex(c.pattern.c_str(), &opts, nullptr);
+    for (int i = 0; i < WARMUP; ++i) regjit_exec(h, c.input.data(), c.input.size());
+    auto t0 = clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) regjit_exec(h, c.input.data(), c.input.size());
+    auto t1 = clock::now();
+    regjit_close(h);
+    return {compiles[COMPILES / 2], std::chrono::duration<double, std::nano>(t1 - t0).count() / ITERATIONS};
+}
+
+static void run(const std::vector<Case>& cases, const char* title) {
+    std::cout << "\n" << title << "\n";
+    std::cout << std::left << std::setw(24) << "Pattern";
+    for (const char* l : LEVEL_NAMES) std::cout << std::right << std::setw(16) << l;
+    std::cout << "\n" << std::setw(24) << "" << std::right;
+    for (int l = 0; l < NLEVELS; ++l) std::cout << std::setw(16) << "compile us/ns";
+    std::cout << "\n" << std::string(24 + 16 * NLEVELS, '-') << "\n";
+
+    double compile_total[NLEVELS] = {}, search_total[NLEVELS] = {};
+    for (const auto& c : cases) {
+        std::cout << std::left << std::setw(24) << c.name << std::right;
+        for (int l = 0; l < NLEVELS; ++l) {
+            Timing t = measure(c, LEVELS[l]);
+            compile_total[l] += t.compile_us;
+            search_total[l] += t.search_ns;
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(0) << t.compile_us << "/" << std::setprecision(1) << t.search_ns;
+            std::cout << std::setw(16) << cell.str();
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::string(24 + 16 * NLEVELS, '-') << "\n" << std::left << std::setw(24) << "Total" << std::right;
+    for (int l = 0; l < NLEVELS; ++l) {
+        std::ostringstream cell;
+        cell << std::fixed << std::setprecision(0) << compile_total[l] << "/" << std::setprecision(1)
+             << search_total[l];
+        std::cout << std::setw(16) << cell.str();
+    }
+    std::cout << "\n";
+}
+
+int main() {
+    std::string long_a(1000, 'a');
+    std::string alphanum = "abc123XYZ789def456GHI";
+    std::string long_text = std::string(10000, 'x') + "needle";
+    const std::vector<Case> cases = {
+        {"Simple literal", "hello", "hello world"},
+        {"Long literal", "abcdefghij", "xxxxxxxxxxabcdefghijyyyyyyyyyy"},
+        {"Exact repeat {1000}", "a{1000}", long_a},
+        {"Plus quantifier a+", "a+", long_a},
+        {"Star quantifier a*", "a*", long_a},
+        {"Char class [a-z]+", "[a-z]+", alphanum},
+        {"Char class [a-zA-Z0-9]+", "[a-zA-Z0-9]+", alphanum},
+        {"Negated class [^0-9]+", "[^0-9]+", alphanum},
+        {"Digit \\d+", "\\d+", "1234567890"},
+        {"Word \\w+", "\\w+", "hello_world_123"},
+        {"Whitespace \\s+", "\\s+", "  \t\n  text  \r\n  "},
+        {"Simple alternation", "cat|dog|bird", "I have a dog"},
+        {"Complex alternation", "hello|world|foo|bar|baz", "the world is beautiful"},
+        {"Start anchor ^hello", "^hello", "hello world"},
+        {"End anchor world$", "world$", "hello world"},
+        {"Both anchors ^...$", "^hello world$", "hello world"},
+        {"Email-like pattern", "[a-z]+@[a-z]+\\.[a-z]+", "contact user@example.com for info"},
+        {"IP-like pattern", "\\d+\\.\\d+\\.\\d+\\.\\d+", "Server IP is 192.168.1.100"},
+        {"Nested groups", "(a(b(c)+)+)+", "abcbcabcbcbc"},
+        {"Long input search", "needle", long_text},
+    };
+
+    regjit_set_cache_maxsize(0);
+    std::cout << "Compile time (median of " << COMPILES << ", us) / search time (mean of " << ITERATIONS
+              << ", ns) per optimization level\n";
+    run(cases, "Default codegen");
+    regjit_set_dfa_codegen_limit(0);
+    run(cases, "Backtracking codegen (regjit_set_dfa_codegen_limit(0))");
+    return 0;
+}
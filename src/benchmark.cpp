@@ -81,17 +81,18 @@ uint64_t benchmark_jit(const std::string& pattern, const std::string& input) {
     // Use the FunctionName set by CompileRegex
     std::string lookupName = FunctionName.empty() ? "match" : FunctionName;
     auto MatchSym = ExitOnErr(JIT->lookup(lookupName));
-    auto MatchFunc = (int (*)(const char*))MatchSym.getValue();
+    auto MatchFunc = (int (*)(const char*, size_t, int64_t*, int64_t*))MatchSym.getValue();
+    int64_t mstart = -1, mend = -1;
     
     // Warmup
     for (int i = 0; i < WARMUP; ++i) {
-        MatchFunc(input.c_str());
+        MatchFunc(input.data(), input.size(), &mstart, &mend);
     }
     
     // Benchmark
     auto start = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < ITERATIONS; ++i) {
-        MatchFunc(input.c_str());
+        MatchFunc(input.data(), input.size(), &mstart, &mend);
     }
     auto end = std::chrono::high_resolution_clock::now();
     
@@ -2,18 +2,23 @@
 #include <iostream>
 #include <stdexcept>
 #include "regjit_capi.h"
+#include "regjit_dfa.h"
+#include "regjit_bitstate.h"
+#include "regjit_tiered.h"
+#include "regjit_pool.h"
+#include "regjit_aho.h"
+#include "regjit_teddy.h"
+#include "regjit_inner.h"
+#include "regjit_objcache.h"
 #include <future>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <bitset>
 #include "llvm/IR/Verifier.h"
-
-// ARM NEON SIMD support
-#if defined(__ARM_NEON) || defined(__aarch64__)
-#include <arm_neon.h>
-#define HAS_NEON 1
-#else
-#define HAS_NEON 0
-#endif
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 
 // Debug printing macro: enable by defining REGJIT_DEBUG (e.g. -DREGJIT_DEBUG)
 #ifdef REGJIT_DEBUG
@@ -23,32 +28,22 @@
 #endif
 
   ExitOnError ExitOnErr;
-  // Global fallback context/builder used when not compiling. Per-compile code
-  // will create its own LLVMContext and IRBuilder and temporarily point
-  // ContextPtr/BuilderPtr at them.
-  LLVMContext GlobalContext;
-  IRBuilder<> GlobalBuilder(GlobalContext);
-  // Pointers used by CodeGen; default to global instances.
-  LLVMContext* ContextPtr = &GlobalContext;
-  IRBuilder<>* BuilderPtr = &GlobalBuilder;
-
-  // Convenience macros so existing CodeGen code can use `Context` and
-  // `Builder` names without changing every reference.
+  // CodeGen reaches the per-compile LLVMContext and IRBuilder through the
+  // session it is handed, so each compile has its own and several patterns
+  // can be generated on different threads at once.
   #undef Context
-  #define Context (*ContextPtr)
+  #define Context (*S.Ctx)
   #undef Builder
-  #define Builder (*BuilderPtr)
-  std::unique_ptr<Module>ThisModule = nullptr;
+  #define Builder (*S.B)
   std::unique_ptr<llvm::orc::LLJIT> JIT;
+  std::mutex JITInitMutex;
+  // Tracker of the module added by the last CompileRegex() call (legacy
+  // Execute()/CleanUp() API). Cached patterns keep their own in CompiledEntry.
   llvm::orc::ResourceTrackerSP RT;
-  // Per-compile owned context/builder (kept alive during compilation).
-  std::unique_ptr<LLVMContext> OwnedCompileContext;
-  std::unique_ptr<IRBuilder<>> OwnedCompileBuilder;
-  Function *MatchF;
-    // Default to empty to indicate "no explicit name chosen".
-    // Previously this was the literal "match" which made the check for
-    // whether to generate a unique name brittle. Use empty() semantics
-    // and treat any non-empty value as an explicit name.
+  std::shared_ptr<const AhoCorasick> RTKeywords; // kept alive with RT's code
+    // Name of the function generated by the last CompileRegex() call.
+    // Empty means "nothing compiled yet"; Execute() then falls back to the
+    // legacy name "match".
     std::string FunctionName("");
    // Compilation cache and helpers
     std::unordered_map<std::string, CompiledEntry> CompileCache;
@@ -57,177 +52,64 @@
     std::unordered_map<std::string, InflightCompile> CompileInflight;
    std::atomic<uint64_t> GlobalFnId{0};
    size_t CacheMaxSize = 64; // default max entries
+   // Largest minimized DFA emitted as direct-coded IR (0 = never), see
+   // regjit_set_dfa_codegen_limit().
+   std::atomic<size_t> DirectDFAMaxStates{256};
    std::list<std::string> CacheLRUList;
   const std::string FunArgName("Arg0");
   const std::string TrueBlockName("TrueBlock");
   const std::string FalseBlockName("FalseBlock");
-  Value *Index;
-  Value *Arg0;
-  Value *StrLenAlloca = nullptr;
-  // Match position tracking for Python re compatibility
-  Value *MatchStartAlloca = nullptr;  // Stores the start position of current match attempt
-  Value *StartOutArg = nullptr;       // Output parameter for match start
-  Value *EndOutArg = nullptr;         // Output parameter for match end
   
 
+// Defined with the runtime helpers, below.
+static void defineRuntimeSymbols();
+
 void Initialize() {
+   std::lock_guard<std::mutex> lk(JITInitMutex);
    if (!JIT) {
      InitializeNativeTarget();
      InitializeNativeTargetAsmPrinter();
-     JIT = ExitOnErr(LLJITBuilder().create());
+     // Compile threads let modules added from several threads be lowered to
+     // machine code in parallel (and select LLVM's thread-safe IR compiler).
+     unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+     JIT = ExitOnErr(LLJITBuilder().setNumCompileThreads(threads).create());
+     // Allow the JIT to resolve symbols from the host process (e.g. libc's memchr)
+     JIT->getMainJITDylib().addGenerator(
+         cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+             JIT->getDataLayout().getGlobalPrefix())));
+     defineRuntimeSymbols();
    }
-  // Allow the JIT to resolve symbols from the host process (e.g. libc's strlen)
-  JIT->getMainJITDylib().addGenerator(
-      cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
-          JIT->getDataLayout().getGlobalPrefix())));
 
   // We compute string length inline inside Func::CodeGen to avoid depending
   // on host libc symbol resolution (e.g. renamed variants like "strlen.1").
   // Keep DynamicLibrarySearchGenerator in case other external symbols are
   // required by generated code.
   
-  // Do not create a global ThisModule here. Modules must be created per-compile
-  // in the compile path so they are backed by the correct LLVMContext.
+  // Do not create a module here. Each compile creates its module in its own
+  // CodeGenSession so it is backed by that session's LLVMContext.
 
 }
 
-// Runtime trace helper called from generated code. Keep C linkage so the
-// JIT can resolve the symbol via DynamicLibrarySearchGenerator.
-extern "C" void regjit_trace(const char* tag, int idx, int cnt) {
-    RJDBG(fprintf(stderr, "regjit_trace: %s idx=%d cnt=%d\n", tag, idx, cnt));
+// Functions generated code calls, by name. The variants runtimeHelpers()
+// picked get names of their own, so calls skip the dispatch. Calling
+// through symbols rather than embedded addresses keeps the code free of
+// this process's addresses, which the object cache relies on, and does not
+// need the host binary to export them.
+static void defineRuntimeSymbol(SymbolMap &Syms, MangleAndInterner &Mangle, const char* name,
+                                const void* addr) {
+    Syms[Mangle(name)] = ExecutorSymbolDef(ExecutorAddr::fromPtr(addr),
+                                           JITSymbolFlags::Exported | JITSymbolFlags::Callable);
 }
 
-// Boyer-Moore-Horspool string search implementation with memchr optimization.
-// Returns pointer to first occurrence of needle in haystack, or nullptr if not found.
-// This combines BMH bad-character shifts with memchr SIMD acceleration.
-extern "C" const char* regjit_bmh_search(const char* haystack, size_t haystackLen,
-                                          const char* needle, size_t needleLen) {
-    if (needleLen == 0) return haystack;
-    if (needleLen > haystackLen) return nullptr;
-    
-    // For single character, just use memchr (SIMD optimized)
-    if (needleLen == 1) {
-        return (const char*)memchr(haystack, needle[0], haystackLen);
-    }
-    
-    // For short needles (2-3 chars), use memchr + verify approach
-    // This is typically faster than building the shift table
-    if (needleLen <= 3) {
-        const char* p = haystack;
-        const char* end = haystack + haystackLen - needleLen + 1;
-        const char firstChar = needle[0];
-        
-        while (p < end) {
-            p = (const char*)memchr(p, firstChar, end - p);
-            if (!p) return nullptr;
-            if (memcmp(p, needle, needleLen) == 0) return p;
-            p++;
-        }
-        return nullptr;
-    }
-    
-    // For longer needles, use full BMH with memchr for initial search
-    const char firstChar = needle[0];
-    const char lastChar = needle[needleLen - 1];
-    const size_t lastIdx = needleLen - 1;
-    
-    // Build the bad character shift table (only for chars in needle)
-    // Using a simple array is faster than unordered_map
-    size_t shift[256];
-    for (int i = 0; i < 256; i++) {
-        shift[i] = needleLen;
-    }
-    for (size_t i = 0; i < needleLen - 1; i++) {
-        shift[(unsigned char)needle[i]] = needleLen - 1 - i;
-    }
-    
-    // Use memchr to find first char, then verify with BMH-style shifts
-    const char* p = haystack;
-    const char* end = haystack + haystackLen;
-    
-    while (p <= end - needleLen) {
-        // Use memchr to find first character (SIMD accelerated)
-        p = (const char*)memchr(p, firstChar, end - p - lastIdx);
-        if (!p) return nullptr;
-        
-        // Check last char quickly
-        if (p[lastIdx] == lastChar) {
-            // Full comparison (skip first and last which we already checked)
-            if (needleLen == 2 || memcmp(p + 1, needle + 1, needleLen - 2) == 0) {
-                return p;  // Found!
-            }
-        }
-        
-        // Move forward - use BMH shift if beneficial, otherwise just +1
-        size_t bmhShift = shift[(unsigned char)p[lastIdx]];
-        p += (bmhShift > 1) ? bmhShift : 1;
-    }
-    
-    return nullptr;  // Not found
-}
-
-// Count consecutive occurrences of a character starting from pos.
-// Uses SIMD when available for faster scanning.
-// Returns the count of consecutive matching characters.
-extern "C" size_t regjit_count_char(const char* str, size_t len, char target) {
-    if (len == 0) return 0;
-    
-#if HAS_NEON
-    // ARM NEON optimized path (Apple Silicon, ARM64)
-    size_t count = 0;
-    uint8x16_t vtarget = vdupq_n_u8((uint8_t)target);
-    
-    // Process 16 bytes at a time with NEON
-    while (count + 16 <= len) {
-        uint8x16_t vdata = vld1q_u8((const uint8_t*)(str + count));
-        uint8x16_t vcmp = vceqq_u8(vdata, vtarget);
-        
-        // Check if all 16 bytes match using 64-bit lane comparison
-        uint64x2_t vcmp64 = vreinterpretq_u64_u8(vcmp);
-        uint64_t low = vgetq_lane_u64(vcmp64, 0);
-        uint64_t high = vgetq_lane_u64(vcmp64, 1);
-        
-        if (low == 0xFFFFFFFFFFFFFFFFULL && high == 0xFFFFFFFFFFFFFFFFULL) {
-            count += 16;
-        } else {
-            // Some bytes don't match - find the first non-match
-            for (int i = 0; i < 16 && count + i < len; i++) {
-                if (str[count + i] != target) return count + i;
-            }
-            count += 16;
-        }
-    }
-    
-    // Handle remaining bytes
-    while (count < len && str[count] == target) {
-        count++;
-    }
-    return count;
-    
-#else
-    // Generic optimized path - unroll loop for better pipelining
-    size_t count = 0;
-    
-    // Process 8 bytes at a time
-    while (count + 8 <= len) {
-        if (str[count] != target) return count;
-        if (str[count + 1] != target) return count + 1;
-        if (str[count + 2] != target) return count + 2;
-        if (str[count + 3] != target) return count + 3;
-        if (str[count + 4] != target) return count + 4;
-        if (str[count + 5] != target) return count + 5;
-        if (str[count + 6] != target) return count + 6;
-        if (str[count + 7] != target) return count + 7;
-        count += 8;
-    }
-    
-    // Handle remaining bytes
-    while (count < len && str[count] == target) {
-        count++;
-    }
-    
-    return count;
-#endif
+static void defineRuntimeSymbols() {
+    MangleAndInterner Mangle(JIT->getExecutionSession(), JIT->getDataLayout());
+    SymbolMap Syms;
+    defineRuntimeSymbol(Syms, Mangle, "regjit_rt_bmh_search", reinterpret_cast<const void*>(runtimeHelpers().bmhSearch));
+    defineRuntimeSymbol(Syms, Mangle, "regjit_rt_count_char", reinterpret_cast<const void*>(runtimeHelpers().countChar));
+    defineRuntimeSymbol(Syms, Mangle, "regjit_teddy_find", reinterpret_cast<const void*>(&regjit_teddy_find));
+    defineRuntimeSymbol(Syms, Mangle, "regjit_ac_search", reinterpret_cast<const void*>(&regjit_ac_search));
+    defineRuntimeSymbol(Syms, Mangle, "regjit_trace", reinterpret_cast<const void*>(&regjit_trace));
+    ExitOnErr(JIT->getMainJITDylib().define(absoluteSymbols(std::move(Syms))));
 }
 
 // NOTE: previous attempts to defensively create new blocks when the current
@@ -237,9 +119,7 @@ extern "C" size_t regjit_count_char(const char* str, size_t len, char target) {
 // emit follow-on instructions when the current block has no terminator.
 
 void ensureJITInitialized() {
-  if (!JIT) {
-    Initialize();
-  }
+  Initialize();
 }
 
 // Ensure the given basic block has a terminator. If it doesn't, insert an
@@ -254,27 +134,148 @@ static void ensureBlockHasTerminator(BasicBlock* B, BasicBlock* target) {
     }
 }
 
-// Reset compile-time state after a failed compile.
-static void resetCompileState() {
-    ThisModule.reset();
-    OwnedCompileBuilder.reset();
-    OwnedCompileContext.reset();
-    ContextPtr = &GlobalContext;
-    BuilderPtr = &GlobalBuilder;
-    FunctionName.clear();
+// Defined after the parser, below.
+// `dfaMaxStates` is the direct-coded DFA limit the code is built with.
+static CompiledEntry compilePattern(const std::string &pattern, uint64_t stepBudget = 0,
+                                    regjit_opt_level optLevel = REGJIT_OPT_REGEX,
+                                    size_t dfaMaxStates = DirectDFAMaxStates.load(std::memory_order_relaxed));
+
+static regjit_options defaultOptions() {
+  regjit_options opts;
+  regjit_options_init(&opts);
+  return opts;
+}
+
+std::string cacheKey(const std::string &pattern, const regjit_options &opts) {
+  bool usesBudget = opts.engine == REGJIT_ENGINE_BACKTRACK || opts.engine == REGJIT_ENGINE_AUTO ||
+                    opts.engine == REGJIT_ENGINE_TIERED;
+  if (opts.engine == REGJIT_ENGINE_BACKTRACK && opts.step_budget == 0 && opts.opt_level == REGJIT_OPT_REGEX)
+    return pattern;
+  // Patterns are C strings and never contain NUL, so a suffix after one
+  // cannot collide with another pattern's key.
+  std::string key = pattern;
+  key += '\0';
+  switch (opts.engine) {
+    case REGJIT_ENGINE_BACKTRACK: key += "jit"; break;
+    case REGJIT_ENGINE_LAZY_DFA: key += "dfa:" + std::to_string(opts.dfa_cache_bytes); break;
+    case REGJIT_ENGINE_PIKE_VM: key += "pike"; break;
+    case REGJIT_ENGINE_BITSTATE: key += "bitstate"; break;
+    case REGJIT_ENGINE_TIERED:
+      key += "tiered:" + std::to_string(opts.tier_up_calls) + "," + std::to_string(opts.tier_up_bytes);
+      break;
+    default: key += "auto"; break;
+  }
+  if (usesBudget && opts.step_budget) key += ":budget=" + std::to_string(opts.step_budget);
+  if (usesBudget && opts.opt_level != REGJIT_OPT_REGEX) key += ":opt=" + std::to_string(opts.opt_level);
+  return key;
+}
+
+// Defined with the DFA codegen, below.
+static bool buildDirectDFA(const Root &body, size_t limit, DenseDFA &fwd, DenseDFA &rev);
+
+// REGJIT_ENGINE_AUTO: a pattern is risky for the JIT when it has nested
+// quantifiers and is too large (or uses lazy quantifiers) for the
+// direct-coded DFA, i.e. it would get the backtracking codegen.
+static bool preferBitState(const Root &ast, size_t dfaMaxStates) {
+  if (!hasNestedQuantifier(ast)) return false;
+  DenseDFA fwd, rev;
+  return !buildDirectDFA(ast, dfaMaxStates, fwd, rev);
+}
+
+// REGJIT_ENGINE_TIERED: the JIT may take over from the interpreter only
+// when its code reports the same match: a direct-coded DFA or a plain
+// literal search. The backtracking codegen never re-enters an alternative
+// or repeat it has moved past, so (a|ab)c+? would stop matching "abcd".
+// The deferred compile must use the same `dfaMaxStates`.
+static bool jitMatchesExactly(const Root &ast, size_t dfaMaxStates) {
+  if (ast.isPureLiteral() && !ast.getLiteralPrefix().empty()) return true;
+  DenseDFA fwd, rev;
+  return buildDirectDFA(ast, dfaMaxStates, fwd, rev);
 }
 
-// compile-or-get with cache. This uses CompileRegex which generates IR into
-// the global ThisModule and calls Compile() to add it to the JIT. We hold
-// CompileCacheMutex during compilation to avoid races and RT being overwritten.
+// Build the cache entry for `pattern` with the engine selected in `opts`.
+static CompiledEntry buildEntry(const std::string &pattern, const regjit_options &opts) {
+  if (opts.engine == REGJIT_ENGINE_LAZY_DFA) {
+    CompiledEntry e;
+    e.Matcher = std::make_shared<LazyDFA>(*parseRegex(pattern), opts.dfa_cache_bytes);
+    return e;
+  }
+  if (opts.engine == REGJIT_ENGINE_PIKE_VM) {
+    CompiledEntry e;
+    e.Matcher = std::make_shared<PikeVM>(*parseRegex(pattern));
+    return e;
+  }
+  if (opts.engine == REGJIT_ENGINE_BITSTATE) {
+    CompiledEntry e;
+    e.Matcher = std::make_shared<BitState>(*parseRegex(pattern));
+    return e;
+  }
+  if (opts.engine == REGJIT_ENGINE_TIERED) {
+    // BitState answers from the first call; patterns the JIT would answer
+    // differently never tier up
+    auto ast = parseRegex(pattern);
+    std::unique_ptr<ProgMatcher> interpreter;
+    try {
+      interpreter = std::make_unique<BitState>(*ast);
+    } catch (const std::runtime_error&) {
+      // Not expressible as a Prog: the JIT is the only option
+    }
+    if (interpreter) {
+      size_t dfaLimit = DirectDFAMaxStates.load(std::memory_order_relaxed);
+      bool exact = jitMatchesExactly(*ast, dfaLimit);
+      uint64_t budget = opts.step_budget;
+      regjit_opt_level level = opts.opt_level;
+      CompiledEntry e;
+      e.Matcher = std::make_shared<TieredMatcher>(
+          std::move(interpreter),
+          [pattern, budget, level, dfaLimit] { return compilePattern(pattern, budget, level, dfaLimit); },
+          exact ? opts.tier_up_calls : 0, exact ? opts.tier_up_bytes : 0);
+      return e;
+    }
+    return compilePattern(pattern, opts.step_budget, opts.opt_level);
+  }
+  if (opts.engine == REGJIT_ENGINE_AUTO) {
+    auto ast = parseRegex(pattern);
+    if (preferBitState(*ast, DirectDFAMaxStates.load(std::memory_order_relaxed))) {
+      try {
+        CompiledEntry e;
+        e.Matcher = std::make_shared<BitState>(*ast);
+        return e;
+      } catch (const std::runtime_error&) {
+        // Not expressible as a Prog: the JIT is the only option
+      }
+    }
+  }
+  return compilePattern(pattern, opts.step_budget, opts.opt_level);
+}
+
+// Take a reference on a cache entry and move it to the front of the LRU.
+// Caller must hold CompileCacheMutex.
+static CompiledEntry& pinEntryLocked(std::unordered_map<std::string, CompiledEntry>::iterator it) {
+  it->second.refCount++;
+  CacheLRUList.splice(CacheLRUList.begin(), CacheLRUList, it->second.lruIt);
+  return it->second;
+}
+
+// compile-or-get with cache. The compile itself runs outside
+// CompileCacheMutex in its own CodeGenSession, so different patterns compile
+// concurrently; threads asking for the same pattern wait on its in-flight
+// entry instead of compiling it twice.
+// The returned entry has been pinned (refCount incremented) on behalf of the
+// caller, who must drop it with releasePattern().
 CompiledEntry getOrCompile(const std::string &pattern) {
+  return getOrCompile(pattern, defaultOptions());
+}
+
+CompiledEntry getOrCompile(const std::string &pattern, const regjit_options &opts) {
+  const std::string key = cacheKey(pattern, opts);
   // Fast-path: return if already cached
   {
     std::lock_guard<std::mutex> lk(CompileCacheMutex);
-    auto it = CompileCache.find(pattern);
+    auto it = CompileCache.find(key);
     if (it != CompileCache.end()) {
-      fprintf(stderr, "getOrCompile: cache HIT for pattern='%s' fn='%s'\n", pattern.c_str(), it->second.FnName.c_str());
-      return it->second;
+      RJDBG(fprintf(stderr, "getOrCompile: cache HIT for pattern='%s' fn='%s'\n", pattern.c_str(), it->second.FnName.c_str()));
+      return pinEntryLocked(it);
     }
   }
 
@@ -282,10 +283,10 @@ CompiledEntry getOrCompile(const std::string &pattern) {
   // If another thread is compiling the same pattern, wait for it.
   {
     std::unique_lock<std::mutex> lk(CompileCacheMutex);
-    auto it = CompileCache.find(pattern);
-    if (it != CompileCache.end()) return it->second;
+    auto it = CompileCache.find(key);
+    if (it != CompileCache.end()) return pinEntryLocked(it);
 
-    auto inflIt = CompileInflight.find(pattern);
+    auto inflIt = CompileInflight.find(key);
     if (inflIt != CompileInflight.end()) {
       auto fut = inflIt->second.fut;
       // unlock while waiting
@@ -295,114 +296,89 @@ CompiledEntry getOrCompile(const std::string &pattern) {
       if (!ok) throw std::runtime_error("concurrent compile failed");
       std::lock_guard<std::mutex> lk2(CompileCacheMutex);
       fprintf(stderr, "getOrCompile: inflight compile finished for pattern='%s'\n", pattern.c_str());
-      return CompileCache.at(pattern);
+      auto done = CompileCache.find(key);
+      if (done == CompileCache.end()) throw std::runtime_error("compiled pattern was evicted");
+      return pinEntryLocked(done);
     }
 
     // No inflight compile: become the compiler
     auto prom = std::make_shared<std::promise<bool>>();
     auto sf = std::make_shared<std::shared_future<bool>>(prom->get_future().share());
-    CompileInflight.emplace(pattern, InflightCompile{prom, sf});
+    CompileInflight.emplace(key, InflightCompile{prom, sf});
     // release lock while compiling
     lk.unlock();
 
-    // Now perform compilation (same logic as before)
+    // Now perform compilation
     try {
-      ensureJITInitialized();
-
-      uint64_t id = GlobalFnId.fetch_add(1);
-      std::hash<std::string> hasher;
-      auto h = hasher(pattern);
-      FunctionName = "regjit_match_" + std::to_string(h) + "_" + std::to_string(id);
-      RJDBG(fprintf(stderr, "getOrCompile: compiling pattern='%s' -> FunctionName='%s'\n", pattern.c_str(), FunctionName.c_str()));
-
-      // create fresh per-compile LLVMContext and IRBuilder, and set pointers so
-      // CodeGen uses them via the Context/Builder macros
-      OwnedCompileContext = std::make_unique<LLVMContext>();
-      OwnedCompileBuilder = std::make_unique<IRBuilder<>>(*OwnedCompileContext);
-      // point the Context/Builder macros at the per-compile instances
-      ContextPtr = OwnedCompileContext.get();
-      BuilderPtr = OwnedCompileBuilder.get();
-
-      // create fresh module for this compile within the per-compile context
-      ThisModule = std::make_unique<Module>("module_" + std::to_string(id), Context);
-      ThisModule->setDataLayout(JIT->getDataLayout());
-
-      // Call existing CompileRegex which will fill ThisModule and call Compile()
-      if (!CompileRegex(pattern)) {
-        resetCompileState();
-        // signal failure and clean inflight
-        prom->set_value(false);
-        std::lock_guard<std::mutex> lk2(CompileCacheMutex);
-        CompileInflight.erase(pattern);
-        throw std::runtime_error("compile failed");
-      }
-
-      // After Compile(), RT holds the ResourceTracker used for this module
-      auto Sym = ExitOnErr(JIT->lookup(FunctionName));
-      uint64_t addr = Sym.getValue();
-
-      CompiledEntry e;
-      e.Addr = addr;
-      e.RT = RT; // RT set by Compile()
-      e.FnName = FunctionName;
+      CompiledEntry e = buildEntry(pattern, opts);
       e.refCount = 1;
 
-      // insert into LRU front
+      // insert into LRU front and evict if needed
       {
         std::lock_guard<std::mutex> lk3(CompileCacheMutex);
-        CacheLRUList.push_front(pattern);
+        CacheLRUList.push_front(key);
         e.lruIt = CacheLRUList.begin();
-        CompileCache.emplace(pattern, std::move(e));
+        CompileCache.emplace(key, std::move(e));
+        evictIfNeeded();
       }
 
-      // Evict if needed
-      evictIfNeeded();
-
       // signal success and remove inflight entry
       prom->set_value(true);
       {
         std::lock_guard<std::mutex> lk4(CompileCacheMutex);
-        CompileInflight.erase(pattern);
-        return CompileCache.at(pattern);
+        CompileInflight.erase(key);
+        return CompileCache.at(key);
       }
     } catch (...) {
       try {
         prom->set_value(false);
       } catch (...) {}
       std::lock_guard<std::mutex> lkErr(CompileCacheMutex);
-      CompileInflight.erase(pattern);
+      CompileInflight.erase(key);
       throw;
     }
   }
 }
 
+std::future<CompiledEntry> getOrCompileAsync(const std::string &pattern) {
+  return getOrCompileAsync(pattern, defaultOptions());
+}
+
+std::future<CompiledEntry> getOrCompileAsync(const std::string &pattern, const regjit_options &opts) {
+  auto prom = std::make_shared<std::promise<CompiledEntry>>();
+  std::future<CompiledEntry> fut = prom->get_future();
+  submitCompileJob([pattern, opts, prom] {
+    try {
+      prom->set_value(getOrCompile(pattern, opts));
+    } catch (...) {
+      prom->set_exception(std::current_exception());
+    }
+  });
+  return fut;
+}
+
+// Pin a pattern (increment its refCount), compiling it if necessary, and
+// return its entry.
+static CompiledEntry acquireEntry(const std::string &pattern, const regjit_options &opts) {
+  {
+    std::lock_guard<std::mutex> lk(CompileCacheMutex);
+    auto it = CompileCache.find(cacheKey(pattern, opts));
+    if (it != CompileCache.end()) {
+      return pinEntryLocked(it);
+    }
+  }
+  // Not found -> compile (outside lock to allow getOrCompile locking)
+  return getOrCompile(pattern, opts);
+}
+
 // Acquire API: increment refCount for pattern, compiling if necessary.
 int regjit_acquire(const char* cpattern, char** err_msg) {
   if (!cpattern) {
     if (err_msg) *err_msg = strdup("null pattern");
     return 0;
   }
-  std::string pattern(cpattern);
   try {
-    std::lock_guard<std::mutex> lk(CompileCacheMutex);
-    auto it = CompileCache.find(pattern);
-    if (it != CompileCache.end()) {
-      it->second.refCount++;
-      // move to front of LRU
-      CacheLRUList.erase(it->second.lruIt);
-      CacheLRUList.push_front(pattern);
-      it->second.lruIt = CacheLRUList.begin();
-      return 1;
-    }
-  } catch (...) {
-    if (err_msg) *err_msg = strdup("internal error");
-    return 0;
-  }
-
-  // Not found -> compile (outside lock to allow getOrCompile locking)
-  try {
-    auto entry = getOrCompile(pattern);
-    (void)entry;
+    acquireEntry(std::string(cpattern), defaultOptions());
     return 1;
   } catch (const std::exception &e) {
     if (err_msg) *err_msg = strdup(e.what());
@@ -415,6 +391,99 @@ void regjit_release(const char* cpattern) {
   releasePattern(std::string(cpattern));
 }
 
+// Handle API: the handle owns one reference on the cache entry, so the JIT
+// code stays loaded and the entry point can be called without touching the
+// cache again until regjit_close().
+struct regjit_handle {
+  std::string key;                      // cache key, used to drop the reference on close
+  RegjitMatchFn fn;                     // pinned JIT entry point, or null when matcher is set
+  std::shared_ptr<ProgMatcher> matcher; // non-JIT engine
+  int prefilterByte;                    // see regjit_prefilter_byte()
+};
+
+void regjit_options_init(regjit_options* opts) {
+  if (!opts) return;
+  opts->engine = REGJIT_ENGINE_BACKTRACK;
+  opts->dfa_cache_bytes = 0;
+  opts->step_budget = 0;
+  opts->tier_up_calls = 1000;
+  opts->tier_up_bytes = uint64_t(1) << 20;
+  opts->opt_level = REGJIT_OPT_REGEX;
+}
+
+static regjit_handle* openHandle(const std::string &pattern, const regjit_options &opts) {
+  CompiledEntry e = acquireEntry(pattern, opts);
+  return new regjit_handle{cacheKey(pattern, opts), (RegjitMatchFn)(uintptr_t)e.Addr, e.Matcher, e.PrefilterByte};
+}
+
+regjit_handle* regjit_open(const char* cpattern, char** err_msg) {
+  return regjit_open_ex(cpattern, nullptr, err_msg);
+}
+
+regjit_handle* regjit_open_ex(const char* cpattern, const regjit_options* opts, char** err_msg) {
+  if (!cpattern) {
+    if (err_msg) *err_msg = strdup("null pattern");
+    return nullptr;
+  }
+  try {
+    return openHandle(std::string(cpattern), opts ? *opts : defaultOptions());
+  } catch (const std::exception &e) {
+    if (err_msg) *err_msg = strdup(e.what());
+    return nullptr;
+  }
+}
+
+int regjit_compile_async(const char* cpattern, regjit_compile_callback callback, void* userdata) {
+  return regjit_compile_async_ex(cpattern, nullptr, callback, userdata);
+}
+
+int regjit_compile_async_ex(const char* cpattern, const regjit_options* opts, regjit_compile_callback callback,
+                            void* userdata) {
+  if (!cpattern || !callback) return 0;
+  submitCompileJob([pattern = std::string(cpattern), o = opts ? *opts : defaultOptions(), callback, userdata] {
+    regjit_handle* h = nullptr;
+    try {
+      h = openHandle(pattern, o);
+    } catch (const std::exception &e) {
+      callback(nullptr, e.what(), userdata);
+      return;
+    }
+    callback(h, nullptr, userdata);
+  });
+  return 1;
+}
+
+void regjit_set_compile_threads(size_t n) {
+  setCompileThreads(n);
+}
+
+regjit_match_result regjit_exec(const regjit_handle* h, const char* buf, size_t len) {
+  regjit_match_result res = {0, -1, -1};
+  if (!h || (!buf && len != 0)) {
+    res.matched = -1;
+    return res;
+  }
+  if (h->matcher) {
+    res.matched = h->matcher->search(buf, len, &res.start, &res.end);
+  } else {
+    res.matched = h->fn(buf, len, &res.start, &res.end);
+  }
+  return res;
+}
+
+int regjit_tier(const regjit_handle* h) {
+  if (!h) return 0;
+  if (!h->matcher) return 1;
+  auto* tiered = dynamic_cast<const TieredMatcher*>(h->matcher.get());
+  return tiered && tiered->jitFunction() ? 1 : 0;
+}
+
+void regjit_close(regjit_handle* h) {
+  if (!h) return;
+  releasePattern(h->key);
+  delete h;
+}
+
 // Cache helpers (C API)
 size_t regjit_cache_size() {
   std::lock_guard<std::mutex> lk(CompileCacheMutex);
@@ -427,6 +496,33 @@ void regjit_set_cache_maxsize(size_t n) {
   evictIfNeeded();
 }
 
+void regjit_set_dfa_codegen_limit(size_t max_states) {
+  DirectDFAMaxStates.store(max_states, std::memory_order_relaxed);
+}
+
+void regjit_train_byte_frequencies(const char* sample, size_t len) {
+  if (!sample && len != 0) return;
+  setByteFrequencies(ByteFrequencies::train(sample, len));
+}
+
+void regjit_reset_byte_frequencies(void) {
+  setByteFrequencies(ByteFrequencies::builtin());
+}
+
+int regjit_prefilter_byte(const regjit_handle* h) {
+  return h ? h->prefilterByte : -1;
+}
+
+int regjit_set_object_cache(const char* dir, uint64_t max_bytes) {
+  return setObjectCacheDir(dir ? dir : "", max_bytes) ? 1 : 0;
+}
+
+void regjit_object_cache_stats(uint64_t* loaded, uint64_t* stored) {
+  ObjectCacheStats st = objectCacheStats();
+  if (loaded) *loaded = st.loaded;
+  if (stored) *stored = st.stored;
+}
+
 // Get raw JIT function pointer for fast matching
 uintptr_t regjit_get_func_ptr(const char* cpattern) {
   if (!cpattern) return 0;
@@ -468,9 +564,9 @@ void evictIfNeeded() {
 }
 
 // release a pattern reference (decrement refCount and possibly evict)
-void releasePattern(const std::string &pattern) {
+void releasePattern(const std::string &key) {
   std::lock_guard<std::mutex> lk(CompileCacheMutex);
-  auto it = CompileCache.find(pattern);
+  auto it = CompileCache.find(key);
   if (it == CompileCache.end()) return;
   if (it->second.refCount > 0) it->second.refCount--;
   // move to front of LRU when used? keep as is
@@ -490,6 +586,9 @@ void unloadPattern(const std::string& pattern) {
   std::lock_guard<std::mutex> lk(CompileCacheMutex);
   auto it = CompileCache.find(pattern);
   if (it == CompileCache.end()) return;
+  // Code still referenced by regjit_acquire or an open handle stays loaded
+  if (it->second.refCount > 0) return;
+  CacheLRUList.erase(it->second.lruIt);
   if (it->second.RT) {
     ExitOnErr(it->second.RT->remove());
   }
@@ -515,17 +614,11 @@ int regjit_compile(const char* pattern, char** err_msg) {
 static regjit_match_result execute_jit_func(const char* pattern, const char* buf, size_t len) {
     regjit_match_result res = {0, -1, -1};
     
-    // Ensure null termination
-    bool need_copy = false;
-    if (len == 0 || buf[len-1] != '\0') need_copy = true;
-    std::string tmp;
-    const char* cstr = nullptr;
-    if (need_copy) {
-        tmp.assign(buf, len);
-        tmp.push_back('\0');
-        cstr = tmp.c_str();
-    } else {
-        cstr = buf;
+    // The JIT function takes (buf, len) directly, so the caller's buffer is
+    // matched in place: no NUL-terminating copy and no strlen pass.
+    if (!buf && len != 0) {
+        res.matched = -1;
+        return res;
     }
     
     if (!pattern) {
@@ -534,38 +627,18 @@ static regjit_match_result execute_jit_func(const char* pattern, const char* buf
     }
 
     // Acquire the compiled pattern to ensure it isn't evicted while executing
-    char* err = nullptr;
-    if (!regjit_acquire(pattern, &err)) {
-        if (err) free(err);
+    std::string key(pattern);
+    RegjitMatchFn fn = nullptr;
+    try {
+        fn = (RegjitMatchFn)(uintptr_t)acquireEntry(key, defaultOptions()).Addr;
+    } catch (const std::exception &) {
         res.matched = -1;
         return res;
     }
-
-    // Find the compiled entry and call its function pointer (Addr)
-    uint64_t addr = 0;
-    {
-        std::lock_guard<std::mutex> lk(CompileCacheMutex);
-        auto it = CompileCache.find(std::string(pattern));
-        if (it != CompileCache.end()) {
-            addr = it->second.Addr;
-        }
-    }
-
-    if (addr != 0) {
-        // JIT function signature: int match(const char* input, int* start_out, int* end_out)
-        auto Func = (int (*)(const char*, int*, int*))(uintptr_t)addr;
-        int start = -1, end = -1;
-        int matched = Func(cstr, &start, &end);
-        
-        res.matched = matched;
-        res.start = start;
-        res.end = end;
-    } else {
-        res.matched = -1;
-    }
+    res.matched = fn(buf, len, &res.start, &res.end);
 
     // Release the acquired ref
-    regjit_release(pattern);
+    releasePattern(key);
 
     return res;
 }
@@ -600,49 +673,109 @@ void regjit_unload(const char* pattern) {
   unloadPattern(std::string(pattern));
 }
 
-// Add optimization passes
-void OptimizeModule(Module& M) {
-    // Create pass managers
-    PassBuilder PB;
-    LoopAnalysisManager LAM;
-    FunctionAnalysisManager FAM;
-    CGSCCAnalysisManager CGAM;
-    ModuleAnalysisManager MAM;
-    
+// The REGEX pipeline. The generated IR is one function that keeps the
+// match position and loop counters in allocas and branches through many
+// small blocks: SROA puts those in registers, after which instcombine,
+// simplifycfg and GVN do nearly everything O2 would. LICM and its loop
+// canonicalization only run for a function that has loops.
+static const char* const kRegexPipeline = "function(sroa,early-cse<memssa>,instcombine,simplifycfg,gvn,simplifycfg)";
+static const char* const kRegexLoopPipeline =
+    "function(sroa,early-cse<memssa>,instcombine,simplifycfg,loop-mssa(loop-rotate,licm),gvn,instcombine,"
+    "simplifycfg)";
+
+// A PassBuilder with every analysis registered costs about as much to set
+// up as optimizing a small matcher does, so each compiling thread keeps
+// one, along with the pipelines built so far. Cached analysis results are
+// dropped after each module; nothing else carries over between them.
+namespace {
+struct OptPipelines {
+  PassBuilder PB;
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+  std::unique_ptr<ModulePassManager> Standard[4]; // by level; O0 stays empty
+  std::unique_ptr<ModulePassManager> Regex, RegexLoops;
+
+  OptPipelines() {
     PB.registerModuleAnalyses(MAM);
     PB.registerCGSCCAnalyses(CGAM);
     PB.registerFunctionAnalyses(FAM);
     PB.registerLoopAnalyses(LAM);
     PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  }
 
-    // Configure optimization level to O2
-    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
-    
-    // Run optimization
-    MPM.run(M, MAM);
-}
+  ModulePassManager& parsed(std::unique_ptr<ModulePassManager>& MPM, const char* text) {
+    if (!MPM) {
+      auto P = std::make_unique<ModulePassManager>();
+      if (Error err = PB.parsePassPipeline(*P, text)) {
+        throw std::runtime_error("bad pass pipeline: " + toString(std::move(err)));
+      }
+      MPM = std::move(P);
+    }
+    return *MPM;
+  }
 
-// Modified Compile function
-void Compile() {
-  // Set data layout for the target
+  ModulePassManager& standard(regjit_opt_level level) {
+    static const OptimizationLevel Levels[] = {OptimizationLevel::O0, OptimizationLevel::O1, OptimizationLevel::O2,
+                                               OptimizationLevel::O3};
+    auto& MPM = Standard[level];
+    if (!MPM) MPM = std::make_unique<ModulePassManager>(PB.buildPerModuleDefaultPipeline(Levels[level]));
+    return *MPM;
+  }
 
-  // Diagnostic IR dump: only print when REGJIT_DEBUG is enabled
-  RJDBG({ outs() << "\nGenerated LLVM IR:\n"; ThisModule->print(outs(), nullptr); });
+  bool hasLoops(Module& M) {
+    for (Function& F : M) {
+      if (!F.isDeclaration() && !FAM.getResult<LoopAnalysis>(F).empty()) return true;
+    }
+    return false;
+  }
 
-  // Diagnostic info (only when debugging)
-  RJDBG({
-    if (!OwnedCompileContext) {
-      errs() << "Compile(): OwnedCompileContext is NULL\n";
-    } else {
-      errs() << "Compile(): OwnedCompileContext addr=" << (void*)OwnedCompileContext.get() << "\n";
+  void run(Module& M, regjit_opt_level level) {
+    switch (level) {
+      case REGJIT_OPT_O0: return;
+      case REGJIT_OPT_O1:
+      case REGJIT_OPT_O2:
+      case REGJIT_OPT_O3: standard(level).run(M, MAM); break;
+      case REGJIT_OPT_REGEX:
+        if (hasLoops(M)) {
+          parsed(RegexLoops, kRegexLoopPipeline).run(M, MAM);
+        } else {
+          parsed(Regex, kRegexPipeline).run(M, MAM);
+        }
+        break;
+      default: throw std::runtime_error("unknown optimization level " + std::to_string(level));
     }
-    errs() << "Compile(): ThisModule context=" << (void*)&ThisModule->getContext() << "\n";
-  });
+  }
+
+  // The results refer to M, which the caller is about to hand to the JIT
+  void clear() {
+    LAM.clear();
+    FAM.clear();
+    CGAM.clear();
+    MAM.clear();
+  }
+};
+} // namespace
+
+void OptimizeModule(Module& M, regjit_opt_level level) {
+  static thread_local OptPipelines P;
+  try {
+    P.run(M, level);
+  } catch (...) {
+    P.clear();
+    throw;
+  }
+  P.clear();
+}
+
+// Verify, optimize and hand the session's module to the JIT. Ownership of
+// the session's LLVMContext and Module moves into the JIT; the returned
+// tracker removes the module again.
+ResourceTrackerSP Compile(CodeGenSession &S) {
+  // Diagnostic IR dump: only print when REGJIT_DEBUG is enabled
+  RJDBG({ outs() << "\nGenerated LLVM IR:\n"; S.M->print(outs(), nullptr); });
 
-  // Run optimization pipeline on the module built in the per-compile
-  // LLVMContext. OptimizeModule expects the Module to be backed by the
-  // same LLVMContext used to generate the IR, so we must call it while
-  // OwnedCompileContext is still alive.
   // Dump the module to a temporary file for debugging so we can
   // inspect IR that triggers optimizer crashes.
   RJDBG({
@@ -651,11 +784,11 @@ void Compile() {
     auto now = std::chrono::steady_clock::now().time_since_epoch().count();
     std::hash<std::thread::id> hasher_tid;
     auto tid_hash = hasher_tid(std::this_thread::get_id());
-    std::string dumpPath = "/tmp/regjit_ir_" + std::to_string(now) + "_" + std::to_string(tid_hash) + "_" + FunctionName + ".ll";
+    std::string dumpPath = "/tmp/regjit_ir_" + std::to_string(now) + "_" + std::to_string(tid_hash) + "_" + S.FunctionName + ".ll";
     std::error_code EC;
     llvm::raw_fd_ostream ofs(dumpPath, EC, llvm::sys::fs::OF_Text);
     if (!EC) {
-      ThisModule->print(ofs, nullptr);
+      S.M->print(ofs, nullptr);
       ofs.close();
     } else {
       errs() << "Failed to open dump file: " << EC.message() << "\n";
@@ -664,139 +797,541 @@ void Compile() {
   // Verify IR before running optimizer to avoid crashes in LLVM when IR is
   // malformed. If verification fails, write the dump and abort compilation
   // so we can fix the generator instead of crashing inside the optimizer.
-  if (llvm::verifyModule(*ThisModule, &errs())) {
+  if (llvm::verifyModule(*S.M, &errs())) {
     errs() << "Module verification failed; aborting Compile() to avoid optimizer crash.\n";
     throw std::runtime_error("Module verification failed");
   }
 
-  OptimizeModule(*ThisModule);
-
-  // Add module to JIT. Move the per-compile LLVMContext (OwnedCompileContext)
-  // into a ThreadSafeContext so the JIT owns it and it remains valid while
-  // the module is active.
-  RT = JIT->getMainJITDylib().createResourceTracker();
-
-  // OwnedCompileBuilder may reference the OwnedCompileContext; drop the
-  // builder before transferring ownership to the JIT.
-  OwnedCompileBuilder.reset();
-
-  // Transfer ownership of the compile-time LLVMContext into ThreadSafeContext
-  RJDBG(fprintf(stderr, "Compile(): OwnedCompileContext=%p ThisModule_ctx=%p\n", (void*)OwnedCompileContext.get(), (void*)&ThisModule->getContext()));
-  ThreadSafeContext SafeCtx(std::move(OwnedCompileContext));
-
-  ExitOnErr(JIT->addIRModule(RT, ThreadSafeModule(std::move(ThisModule), SafeCtx)));
+  // The optimizer runs in the session's own LLVMContext, so sessions on
+  // different threads do not contend here.
+  OptimizeModule(*S.M, S.OptLevel);
+
+  ResourceTrackerSP Tracker = JIT->getMainJITDylib().createResourceTracker();
+
+  if (!S.ObjectCacheKey.empty()) {
+    // Lower to an object here, as the JIT would, so it can be stored too
+    std::unique_ptr<MemoryBuffer> Obj = ExitOnErr(SimpleCompiler(hostTargetMachine())(*S.M));
+    CachedObject entry;
+    entry.FnName = S.FunctionName;
+    entry.PrefilterByte = S.PrefilterByte;
+    entry.Object = Obj->getBuffer().str();
+    storeCachedObject(S.ObjectCacheKey, entry);
+    ExitOnErr(JIT->addObjectFile(Tracker, std::move(Obj)));
+    return Tracker;
+  }
 
-  // restore builder/context pointers to global defaults
-  ContextPtr = &GlobalContext;
-  BuilderPtr = &GlobalBuilder;
+  // The builder references the session's LLVMContext; drop it before
+  // transferring ownership of the context to the JIT.
+  S.B.reset();
+  ThreadSafeContext SafeCtx(std::move(S.Ctx));
+  ExitOnErr(JIT->addIRModule(Tracker, ThreadSafeModule(std::move(S.M), SafeCtx)));
+  return Tracker;
 }
 void CleanUp() {
   if (RT) {
     ExitOnErr(RT->remove());
     RT = nullptr;
   }
+  RTKeywords.reset();
   // Note: We don't delete JIT here as it might be reused
   // JIT resources will be cleaned up when the JIT object is destroyed
 }
 int Execute(const char* input) {
+  return Execute(input, strlen(input));
+}
+int Execute(const char* input, size_t len) {
   // Use the last generated function name if available; fall back to legacy
   // "match" for compatibility with older code paths.
   std::string lookupName = FunctionName.empty() ? "match" : FunctionName;
   RJDBG(fprintf(stderr, "Execute(): FunctionName='%s' lookupName='%s'\n", FunctionName.c_str(), lookupName.c_str()));
   auto MatchSym = ExitOnErr(JIT->lookup(lookupName));
   
-  // Updated signature to match JIT: int match(const char* input, int* start_out, int* end_out)
-  auto Func = (int (*)(const char*, int*, int*))MatchSym.getValue();
+  // Updated signature to match JIT: int match(const char* data, size_t len, int64_t* start_out, int64_t* end_out)
+  auto Func = (RegjitMatchFn)MatchSym.getValue();
 
-  int start = -1, end = -1;
-  int ResultCode = Func(input, &start, &end);
+  int64_t start = -1, end = -1;
+  int ResultCode = Func(input, len, &start, &end);
   outs() << "\nProgram exited with code: " << ResultCode << "\n";
   return ResultCode;
 }
 
+// Allocate a local in the function's entry block, so it is allocated once
+// per call. An alloca emitted where the builder is, inside the search loop,
+// would take more stack on every start position tried.
+static AllocaInst* createEntryAlloca(CodeGenSession &S, Type* ty, const Twine &name = "") {
+  BasicBlock &entry = S.MatchF->getEntryBlock();
+  IRBuilder<> EntryB(&entry, entry.begin());
+  return EntryB.CreateAlloca(ty, nullptr, name);
+}
+
+// Count one backtracking step against the per-call budget, leaving the
+// builder in the block that continues while steps remain. Emits nothing
+// when the pattern has no budget, so the common case pays nothing.
+static void emitBacktrackStep(CodeGenSession &S) {
+    if (!S.StepsLeft) return;
+    Value* left = Builder.CreateSub(Builder.CreateLoad(Builder.getInt64Ty(), S.StepsLeft),
+                                    ConstantInt::get(Builder.getInt64Ty(), 1));
+    Builder.CreateStore(left, S.StepsLeft);
+    BasicBlock* ContinueBB = BasicBlock::Create(Context, "budget_ok", S.MatchF);
+    MDBuilder MDB(Context);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(left, ConstantInt::get(Builder.getInt64Ty(), 0)),
+                         S.BudgetExceededBB, ContinueBB, MDB.createBranchWeights(1, 1 << 20));
+    Builder.SetInsertPoint(ContinueBB);
+}
+
+// Direct-coded DFA
+//
+// Patterns without lazy quantifiers whose minimized DFA is small enough are
+// not compiled to the backtracking block graph but to the DFA itself: every
+// state is a basic block that loads one byte and switches on it, so each
+// input byte costs one load and one branch and no position is ever
+// revisited. As in LazyDFA, a forward DFA finds where the leftmost-first
+// match ends and a reverse DFA run back from there finds where it starts.
+// Being a DFA, it explores every alternative: (a|ab)c matches "abc".
+
+static Value* emitWordCharAt(CodeGenSession &S, Value* pos, Value* valid, const std::string& prefix);
+
+// Build both DFAs for `body`, or return false to use the backtracking
+// codegen (limit disabled or exceeded, lazy quantifiers, pure literals that
+// regjit_bmh_search finds faster, or constructs the Prog does not support).
+static bool buildDirectDFA(const Root &body, size_t limit, DenseDFA &fwd, DenseDFA &rev) {
+    if (limit == 0) return false;
+    if (body.isPureLiteral() && !body.getLiteralPrefix().empty()) return false;
+    if (body.containsLazyRepeat()) return false;
+    try {
+        auto f = compileProg(body, false);
+        auto r = compileProg(body, true);
+        return buildDenseDFA(*f, f->anchoredStart ? f->start : f->startUnanchored, false, limit, fwd) &&
+               buildDenseDFA(*r, r->start, true, limit, rev);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+// Emit one block per state of `D`, scanning forward from `pos` (backward
+// with `reverse`). Positions where a match ends (starts, when reversed) are
+// stored to `found`; the scan branches to `done` when the DFA dies or the
+// input runs out. Returns the block of every state, `done` for the dead one.
+// With `reenter`, a forward scan that comes back to the start state for the
+// byte it just read (nothing started earlier is still alive) branches there
+// instead, so a prefilter can skip ahead.
+static std::vector<BasicBlock*> emitDFAStates(CodeGenSession &S, const DenseDFA &D, bool reverse,
+                                              Value* len, Value* pos, Value* found,
+                                              BasicBlock* done, const std::string& prefix,
+                                              BasicBlock* reenter = nullptr) {
+    Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
+    Type* sizeTy = Builder.getInt64Ty();
+    Value* one = ConstantInt::get(sizeTy, 1);
+    std::vector<BasicBlock*> blocks(D.size(), done);
+    for (size_t k = 1; k < D.size(); ++k) {
+        blocks[k] = BasicBlock::Create(Context, prefix + "_s" + std::to_string(k), S.MatchF);
+    }
+
+    for (size_t k = 1; k < D.size(); ++k) {
+        Builder.SetInsertPoint(blocks[k]);
+        Value* cur = Builder.CreateLoad(sizeTy, pos);
+        if (D.matchOnEntry[k]) {
+            // The byte just consumed follows the match
+            Builder.CreateStore(reverse ? Builder.CreateAdd(cur, one) : Builder.CreateSub(cur, one), found);
+        }
+        if (D.finished[k]) {
+            Builder.CreateBr(done);
+            continue;
+        }
+
+        // Successor of every byte; the most common one becomes the default.
+        // Index D.size() stands for `reenter`.
+        uint32_t target[256];
+        std::vector<int> uses(D.size() + 1, 0);
+        for (int b = 0; b < 256; ++b) {
+            target[b] = D.next[k * D.numClasses + D.byteClass[b]];
+            if (reenter && target[b] != 0 && target[b] == D.start[isWordByte(b) ? 2 : 0]) {
+                target[b] = D.size();
+            }
+            ++uses[target[b]];
+        }
+        uint32_t dflt = std::max_element(uses.begin(), uses.end()) - uses.begin();
+        auto dest = [&](uint32_t t) { return t == D.size() ? reenter : blocks[t]; };
+
+        std::string name = prefix + "_s" + std::to_string(k);
+        BasicBlock* EndBB = BasicBlock::Create(Context, name + "_end", S.MatchF);
+        BasicBlock* ByteBB = BasicBlock::Create(Context, name + "_byte", S.MatchF);
+
+        if (!reverse && !reenter && !D.matchOnEntry[k] && uses[k] == 255) {
+            // The state loops on every byte but one: skip to it with memchr.
+            int exitByte = 0;
+            while (target[exitByte] == k) ++exitByte;
+            FunctionCallee memchrFn = S.M->getOrInsertFunction("memchr",
+                FunctionType::get(i8ptrTy, {i8ptrTy, Builder.getInt32Ty(), sizeTy}, false));
+            Value* from = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {cur});
+            Value* hit = Builder.CreateCall(memchrFn,
+                {from, ConstantInt::get(Builder.getInt32Ty(), exitByte), Builder.CreateSub(len, cur)});
+            BasicBlock* SkipBB = BasicBlock::Create(Context, name + "_skip", S.MatchF);
+            Builder.CreateCondBr(
+                Builder.CreateICmpEQ(hit, ConstantPointerNull::get(cast<PointerType>(i8ptrTy))),
+                EndBB, SkipBB);
+            Builder.SetInsertPoint(SkipBB);
+            Value* hitPos = Builder.CreateSub(Builder.CreatePtrToInt(hit, sizeTy),
+                                              Builder.CreatePtrToInt(S.Arg0, sizeTy));
+            Builder.CreateStore(hitPos, pos);
+            Builder.CreateBr(ByteBB);
+        } else {
+            Value* atEnd = reverse ? Builder.CreateICmpEQ(cur, ConstantInt::get(sizeTy, 0))
+                                   : Builder.CreateICmpEQ(cur, len);
+            Builder.CreateCondBr(atEnd, EndBB, ByteBB);
+        }
+
+        Builder.SetInsertPoint(EndBB);
+        if (D.matchAtEnd[k]) {
+            Builder.CreateStore(reverse ? ConstantInt::get(sizeTy, 0) : len, found);
+        }
+        Builder.CreateBr(done);
+
+        Builder.SetInsertPoint(ByteBB);
+        Value* at = Builder.CreateLoad(sizeTy, pos);
+        Value* idx = reverse ? Builder.CreateSub(at, one) : at;
+        Value* byte = Builder.CreateLoad(Builder.getInt8Ty(), Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {idx}));
+        Builder.CreateStore(reverse ? idx : Builder.CreateAdd(at, one), pos);
+        SwitchInst* sw = Builder.CreateSwitch(byte, dest(dflt), 256 - uses[dflt]);
+        for (int b = 0; b < 256; ++b) {
+            if (target[b] != dflt) sw->addCase(Builder.getInt8(static_cast<uint8_t>(b)), dest(target[b]));
+        }
+    }
+    return blocks;
+}
+
+// Call the BMH searcher for `needle` in [hay, hay + hayLen), with its
+// shift table built now and embedded as a constant. Returns the i8* of the
+// first occurrence or null.
+static Value* emitBmhSearch(CodeGenSession &S, Value* hay, Value* hayLen, const std::string &needle,
+                            const std::string &name) {
+    Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
+    Type* sizeTy = Builder.getInt64Ty();
+    FunctionCallee bmhFn = S.M->getOrInsertFunction("regjit_rt_bmh_search",
+        FunctionType::get(i8ptrTy, {i8ptrTy, sizeTy, i8ptrTy, sizeTy, i8ptrTy}, false));
+    uint8_t shift[256];
+    buildBmhShiftTable(needle.data(), needle.size(), shift);
+    Value* shiftPtr = Builder.CreateGlobalStringPtr(
+        StringRef(reinterpret_cast<const char*>(shift), sizeof(shift)), name + "_shift");
+    return Builder.CreateCall(bmhFn,
+        {hay, hayLen, Builder.CreateGlobalStringPtr(needle, name), ConstantInt::get(sizeTy, needle.size()),
+         shiftPtr});
+}
+
+// Search for the next occurrence of `inner.literal` at or after *from (an
+// i64 alloca) where its prefix can end, moving *from past occurrences where
+// it cannot. Branches to FailBB when there is none; otherwise continues in
+// a new block, left as the insert point, with the occurrence in *hit and
+// the earliest start of the prefix before it in *hitStart. Returns the
+// search block, for callers that loop back to it.
+static BasicBlock* emitInnerLiteralSearch(CodeGenSession &S, const InnerLiteral &inner, Value* from,
+                                          Value* hit, Value* hitStart, BasicBlock* FailBB) {
+    Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
+    Type* sizeTy = Builder.getInt64Ty();
+    BasicBlock* SearchBB = BasicBlock::Create(Context, "inner_search", S.MatchF);
+    BasicBlock* FoundBB = BasicBlock::Create(Context, "inner_found", S.MatchF);
+    BasicBlock* HitBB = BasicBlock::Create(Context, "inner_hit", S.MatchF);
+    Builder.CreateBr(SearchBB);
+
+    Builder.SetInsertPoint(SearchBB);
+    Value* len = Builder.CreateLoad(sizeTy, S.StrLenAlloca);
+    Value* f = Builder.CreateLoad(sizeTy, from);
+    Value* foundPtr = emitBmhSearch(S, Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {f}),
+                                    Builder.CreateSub(len, f), inner.literal, "inner_literal");
+    Builder.CreateCondBr(Builder.CreateICmpEQ(foundPtr, ConstantPointerNull::get(cast<PointerType>(i8ptrTy))),
+                         FailBB, FoundBB);
+
+    Builder.SetInsertPoint(FoundBB);
+    Value* at = Builder.CreateSub(Builder.CreatePtrToInt(foundPtr, sizeTy),
+                                  Builder.CreatePtrToInt(S.Arg0, sizeTy));
+    Builder.CreateStore(at, hit);
+    if (inner.prefixLen == 0) {
+        Builder.CreateStore(at, hitStart);
+        Builder.CreateBr(HitBB);
+        Builder.SetInsertPoint(HitBB);
+        return SearchBB;
+    }
+
+    // Run the prefix's reverse DFA back from the occurrence; it starts
+    // knowing the byte after it, the literal's first
+    IRBuilder<> EntryB(&S.MatchF->getEntryBlock(), S.MatchF->getEntryBlock().begin());
+    Value* pos = EntryB.CreateAlloca(sizeTy, nullptr, "inner_rev_pos");
+    BasicBlock* RevDoneBB = BasicBlock::Create(Context, "inner_rev_done", S.MatchF);
+    auto revBlocks = emitDFAStates(S, inner.prefixRev, true, len, pos, hitStart, RevDoneBB, "inner_rev");
+    Builder.SetInsertPoint(FoundBB);
+    Builder.CreateStore(at, pos);
+    Builder.CreateStore(ConstantInt::get(sizeTy, -1), hitStart);
+    bool wordAfter = isWordByte(static_cast<unsigned char>(inner.literal[0]));
+    Builder.CreateBr(revBlocks[inner.prefixRev.start[wordAfter ? 2 : 0]]);
+
+    // No start: nothing matches up to here, look past this occurrence
+    Builder.SetInsertPoint(RevDoneBB);
+    BasicBlock* NextBB = BasicBlock::Create(Context, "inner_next", S.MatchF);
+    Value* start = Builder.CreateLoad(sizeTy, hitStart);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(start, ConstantInt::get(sizeTy, 0)), NextBB, HitBB);
+    Builder.SetInsertPoint(NextBB);
+    Builder.CreateStore(Builder.CreateAdd(Builder.CreateLoad(sizeTy, hit), ConstantInt::get(sizeTy, 1)), from);
+    Builder.CreateBr(SearchBB);
+
+    Builder.SetInsertPoint(HitBB);
+    return SearchBB;
+}
+
+// What emitDirectDFA may scan for before and during the DFA run.
+struct DFAPrefilter {
+    int requiredByte = -1;          // every match contains this byte
+    std::string requiredLiteral;    // ... or this string (used when not empty)
+    const InnerLiteral* inner = nullptr; // drives the whole scan when set
+};
+
+// Emit the whole matcher body from the current insertion point. Inputs
+// without the prefilter's required byte or literal are rejected by one
+// search before the DFA runs. With an inner literal, the forward scan
+// starts at the first place a match could start and jumps back to the
+// literal search whenever it returns to its start state.
+static void emitDirectDFA(CodeGenSession &S, const DenseDFA &fwd, const DenseDFA &rev,
+                          const DFAPrefilter &pre, BasicBlock* SuccessBB, BasicBlock* FailBB) {
+    Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
+    Type* sizeTy = Builder.getInt64Ty();
+    if (!pre.inner && !pre.requiredLiteral.empty()) {
+        Value* hit = emitBmhSearch(S, S.Arg0, Builder.CreateLoad(sizeTy, S.StrLenAlloca),
+                                   pre.requiredLiteral, "required_literal");
+        BasicBlock* ScanBB = BasicBlock::Create(Context, "dfa_scan", S.MatchF);
+        Builder.CreateCondBr(
+            Builder.CreateICmpEQ(hit, ConstantPointerNull::get(cast<PointerType>(i8ptrTy))),
+            FailBB, ScanBB);
+        Builder.SetInsertPoint(ScanBB);
+    } else if (!pre.inner && pre.requiredByte >= 0) {
+        FunctionCallee memchrFn = S.M->getOrInsertFunction("memchr",
+            FunctionType::get(i8ptrTy, {i8ptrTy, Builder.getInt32Ty(), sizeTy}, false));
+        Value* hit = Builder.CreateCall(memchrFn,
+            {S.Arg0, ConstantInt::get(Builder.getInt32Ty(), pre.requiredByte),
+             Builder.CreateLoad(sizeTy, S.StrLenAlloca)});
+        BasicBlock* ScanBB = BasicBlock::Create(Context, "dfa_scan", S.MatchF);
+        Builder.CreateCondBr(
+            Builder.CreateICmpEQ(hit, ConstantPointerNull::get(cast<PointerType>(i8ptrTy))),
+            FailBB, ScanBB);
+        Builder.SetInsertPoint(ScanBB);
+    }
+    BasicBlock* InitBB = Builder.GetInsertBlock();
+    IRBuilder<> EntryB(&S.MatchF->getEntryBlock(), S.MatchF->getEntryBlock().begin());
+    Value* pos = EntryB.CreateAlloca(sizeTy, nullptr, "dfa_pos");
+    Value* matchEnd = EntryB.CreateAlloca(sizeTy, nullptr, "dfa_match_end");
+
+    BasicBlock* FwdDoneBB = BasicBlock::Create(Context, "dfa_fwd_done", S.MatchF);
+    BasicBlock* RevDoneBB = BasicBlock::Create(Context, "dfa_rev_done", S.MatchF);
+    BasicBlock* ReenterBB = pre.inner ? BasicBlock::Create(Context, "dfa_reenter", S.MatchF) : nullptr;
+    Builder.SetInsertPoint(InitBB);
+    Value* len = Builder.CreateLoad(sizeTy, S.StrLenAlloca);
+    auto fwdBlocks = emitDFAStates(S, fwd, false, len, pos, matchEnd, FwdDoneBB, "dfa_fwd", ReenterBB);
+    auto revBlocks = emitDFAStates(S, rev, true, len, pos, S.MatchStartAlloca, RevDoneBB, "dfa_rev");
+
+    Builder.SetInsertPoint(InitBB);
+    Builder.CreateStore(ConstantInt::get(sizeTy, -1), matchEnd);
+    if (!pre.inner) {
+        // Forward scan from 0 with no byte before it
+        Builder.CreateStore(ConstantInt::get(sizeTy, 0), pos);
+        Builder.CreateBr(fwdBlocks[fwd.start[1]]);
+    } else {
+        // No match starts before `from`. The scan resumes at the later of
+        // `from` and the earliest start for the current occurrence `hit`;
+        // once past that occurrence it searches for the next one.
+        Value* from = EntryB.CreateAlloca(sizeTy, nullptr, "inner_from");
+        Value* hit = EntryB.CreateAlloca(sizeTy, nullptr, "inner_hit_pos");
+        Value* hitStart = EntryB.CreateAlloca(sizeTy, nullptr, "inner_hit_start");
+        BasicBlock* ResumeBB = BasicBlock::Create(Context, "dfa_resume", S.MatchF);
+        BasicBlock* SearchBB = BasicBlock::Create(Context, "dfa_inner_search", S.MatchF);
+        BasicBlock* StartBB = BasicBlock::Create(Context, "dfa_inner_start", S.MatchF);
+        Builder.CreateStore(ConstantInt::get(sizeTy, 0), from);
+        Builder.CreateStore(ConstantInt::get(sizeTy, -1), hit);
+        Builder.CreateBr(ResumeBB);
+
+        // Back in the start state: report a match already found, else
+        // nothing before `pos` can start one
+        Builder.SetInsertPoint(ReenterBB);
+        Builder.CreateStore(Builder.CreateLoad(sizeTy, pos), from);
+        Value* found = Builder.CreateICmpSGE(Builder.CreateLoad(sizeTy, matchEnd), ConstantInt::get(sizeTy, 0));
+        Builder.CreateCondBr(found, FwdDoneBB, ResumeBB);
+
+        Builder.SetInsertPoint(ResumeBB);
+        Value* behind = Builder.CreateICmpSLT(Builder.CreateLoad(sizeTy, hit), Builder.CreateLoad(sizeTy, from));
+        Builder.CreateCondBr(behind, SearchBB, StartBB);
+
+        Builder.SetInsertPoint(SearchBB);
+        emitInnerLiteralSearch(S, *pre.inner, from, hit, hitStart, FailBB);
+        Builder.CreateBr(StartBB);
+
+        // Enter the start state for the byte before the resume position
+        Builder.SetInsertPoint(StartBB);
+        Value* f = Builder.CreateLoad(sizeTy, from);
+        Value* hs = Builder.CreateLoad(sizeTy, hitStart);
+        Value* at = Builder.CreateSelect(Builder.CreateICmpSGT(hs, f), hs, f);
+        Builder.CreateStore(at, pos);
+        BasicBlock* MidBB = BasicBlock::Create(Context, "dfa_inner_mid", S.MatchF);
+        Builder.CreateCondBr(Builder.CreateICmpEQ(at, ConstantInt::get(sizeTy, 0)),
+                             fwdBlocks[fwd.start[1]], MidBB);
+        Builder.SetInsertPoint(MidBB);
+        if (fwd.start[0] == fwd.start[2]) {
+            Builder.CreateBr(fwdBlocks[fwd.start[0]]);
+        } else {
+            Value* prev = Builder.CreateSub(at, ConstantInt::get(sizeTy, 1));
+            Value* word = emitWordCharAt(S, prev, Builder.getTrue(), "dfa_inner_word");
+            Builder.CreateCondBr(word, fwdBlocks[fwd.start[2]], fwdBlocks[fwd.start[0]]);
+        }
+    }
+
+    // Reverse scan from the match end; its start state depends on whether
+    // that end is the end of the text and on the byte that follows it.
+    Builder.SetInsertPoint(FwdDoneBB);
+    Value* end = Builder.CreateLoad(sizeTy, matchEnd);
+    BasicBlock* RevInitBB = BasicBlock::Create(Context, "dfa_rev_init", S.MatchF);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(end, ConstantInt::get(sizeTy, 0)), FailBB, RevInitBB);
+    Builder.SetInsertPoint(RevInitBB);
+    Builder.CreateStore(end, pos);
+    BasicBlock* atTextEnd = revBlocks[rev.start[1]];
+    BasicBlock* beforeWord = revBlocks[rev.start[2]];
+    BasicBlock* beforeOther = revBlocks[rev.start[0]];
+    if (atTextEnd == beforeWord && atTextEnd == beforeOther) {
+        Builder.CreateBr(atTextEnd);
+    } else {
+        BasicBlock* InsideBB = BasicBlock::Create(Context, "dfa_rev_inside", S.MatchF);
+        Builder.CreateCondBr(Builder.CreateICmpEQ(end, len), atTextEnd, InsideBB);
+        Builder.SetInsertPoint(InsideBB);
+        if (beforeWord == beforeOther) {
+            Builder.CreateBr(beforeOther);
+        } else {
+            Value* word = emitWordCharAt(S, end, Builder.CreateICmpULT(end, len), "dfa_rev_word");
+            Builder.CreateCondBr(word, beforeWord, beforeOther);
+        }
+    }
+
+    Builder.SetInsertPoint(RevDoneBB);
+    Builder.CreateStore(Builder.CreateLoad(sizeTy, matchEnd), S.Index);
+    Builder.CreateBr(SuccessBB);
+}
+
 //
 // Anchor/Quantifier Search Mode Note:
 // PCRE, std::regex, and RE2 all require that anchors (e.g. ^, $, \b) with quantifiers (e.g. ^*, $+) are matched by attempting the regex at every possible offset in the input string.
 // This search loop (and the logic below) is essential for correct zero-width anchor + quantifier compatibility. DO NOT REMOVE/REFRACTOR this loop unless you re-run all anchor/quant edge tests against PCRE/RE2.
 //
-Value* Func::CodeGen() {
-    // New function signature: int match(const char* input, int* start_out, int* end_out)
+Value* Func::CodeGen(CodeGenSession &S) {
+    // Function signature: int match(const char* data, size_t len, int64_t* start_out, int64_t* end_out)
     // Returns 1 on match, 0 on no match
+    // The input is length-delimited: it need not be NUL-terminated and may
+    // contain embedded NUL bytes. No byte at or beyond data[len] is read.
     // start_out and end_out are written with match positions (or -1 if no match)
+    // All positions are 64-bit, so inputs larger than 2 GiB are supported and
+    // index arithmetic feeds CreateGEP without sign extension.
     Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
-    Type* i32ptrTy = PointerType::get(Builder.getInt32Ty(), 0);
+    Type* i64ptrTy = PointerType::get(Builder.getInt64Ty(), 0);
+    Type* sizeTy = Builder.getInt64Ty();
     
     FunctionType *matchFuncType = FunctionType::get(
         Builder.getInt32Ty(), 
-        {i8ptrTy, i32ptrTy, i32ptrTy},  // input, start_out, end_out
+        {i8ptrTy, sizeTy, i64ptrTy, i64ptrTy},  // data, len, start_out, end_out
         false
     );
-    MatchF = Function::Create(
-        matchFuncType, Function::ExternalLinkage, FunctionName, ThisModule.get());
-
-    auto argIt = MatchF->arg_begin();
-    Arg0 = argIt++;
-    Arg0->setName(FunArgName);
-    StartOutArg = argIt++;
-    StartOutArg->setName("start_out");
-    EndOutArg = argIt++;
-    EndOutArg->setName("end_out");
+    S.MatchF = Function::Create(
+        matchFuncType, Function::ExternalLinkage, S.FunctionName, S.M.get());
+
+    auto argIt = S.MatchF->arg_begin();
+    S.Arg0 = argIt++;
+    S.Arg0->setName(FunArgName);
+    Value* LenArg = argIt++;
+    LenArg->setName("len");
+    S.StartOutArg = argIt++;
+    S.StartOutArg->setName("start_out");
+    S.EndOutArg = argIt++;
+    S.EndOutArg->setName("end_out");
 
     // Create entry block and index variable
-    BasicBlock *EntryBB = BasicBlock::Create(Context, "entry", MatchF);
+    BasicBlock *EntryBB = BasicBlock::Create(Context, "entry", S.MatchF);
     Builder.SetInsertPoint(EntryBB);
-    Index = Builder.CreateAlloca(Builder.getInt32Ty());
-    Builder.CreateStore(ConstantInt::get(Context, APInt(32, 0)), Index);
+    S.Index = Builder.CreateAlloca(Builder.getInt64Ty());
+    Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), S.Index);
     
     // Alloca to save match start position
-    MatchStartAlloca = Builder.CreateAlloca(Builder.getInt32Ty());
-    Builder.CreateStore(ConstantInt::get(Context, APInt(32, 0)), MatchStartAlloca);
+    S.MatchStartAlloca = Builder.CreateAlloca(Builder.getInt64Ty());
+    Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), S.MatchStartAlloca);
     
-    // Compute string length using libc strlen (with direct function pointer)
-    // This is much faster than the inline loop for long strings
-    StrLenAlloca = Builder.CreateAlloca(Builder.getInt32Ty());
-    
-    Type* sizeTy = Builder.getInt64Ty();
-    
-    // Get strlen function pointer directly
-    FunctionType* strlenFnTy = FunctionType::get(sizeTy, {i8ptrTy}, false);
-    auto strlenAddr = reinterpret_cast<uintptr_t>(&strlen);
-    Value* strlenPtrInt = ConstantInt::get(Builder.getInt64Ty(), strlenAddr);
-    Value* strlenPtr = Builder.CreateIntToPtr(strlenPtrInt, PointerType::get(strlenFnTy, 0));
-    
-    // Call strlen and truncate to i32
-    Value* strlenResult = Builder.CreateCall(strlenFnTy, strlenPtr, {Arg0});
-    Value* strlenVal32 = Builder.CreateTrunc(strlenResult, Builder.getInt32Ty());
-    Builder.CreateStore(strlenVal32, StrLenAlloca);
+    // The caller passes the length explicitly, so there is no strlen pass
+    // over the input and no requirement for a terminating NUL.
+    S.StrLenAlloca = Builder.CreateAlloca(Builder.getInt64Ty());
+    Builder.CreateStore(LenArg, S.StrLenAlloca);
+
+    // Each call starts with the full step budget
+    if (S.StepBudget) {
+        uint64_t budget = std::min<uint64_t>(S.StepBudget, INT64_MAX);
+        S.StepsLeft = Builder.CreateAlloca(Builder.getInt64Ty(), nullptr, "steps_left");
+        Builder.CreateStore(ConstantInt::get(Builder.getInt64Ty(), budget), S.StepsLeft);
+        S.BudgetExceededBB = BasicBlock::Create(Context, "budget_exceeded", S.MatchF);
+    }
     
-    BasicBlock *PostStrlenBB = BasicBlock::Create(Context, "post_strlen", MatchF);
-    Builder.CreateBr(PostStrlenBB);
+    BasicBlock *PostEntryBB = BasicBlock::Create(Context, "post_entry", S.MatchF);
+    Builder.CreateBr(PostEntryBB);
     
     // Create return blocks (reusable)
-    BasicBlock *ReturnFailBB = BasicBlock::Create(Context, "return_fail", MatchF);
-    BasicBlock *ReturnSuccessBB = BasicBlock::Create(Context, "return_success", MatchF);
-
-    // Optimization: if the AST is anchored at start and there are no
-    // zero-width repeats (e.g. '^' not repeated), we can skip the search
-    // loop and attempt the pattern only at index 0. This is safe and
-    // preserves semantics while avoiding unnecessary scanning.
-    if (Body->isAnchoredAtStart() && !Body->containsZeroWidthRepeat()) {
+    BasicBlock *ReturnFailBB = BasicBlock::Create(Context, "return_fail", S.MatchF);
+    BasicBlock *ReturnSuccessBB = BasicBlock::Create(Context, "return_success", S.MatchF);
+
+    DenseDFA fwdDFA, revDFA;
+    if (S.Keywords) {
+        // === AHO-CORASICK PATH ===
+        // Large literal alternation: one pass of the keyword automaton
+        // finds the leftmost-first match and writes start/end itself.
+        RJDBG(std::cerr << "Using Aho-Corasick: " << S.Keywords->numStates() << " states\n");
+        Builder.SetInsertPoint(PostEntryBB);
+        FunctionCallee acFn = S.M->getOrInsertFunction("regjit_ac_search",
+            FunctionType::get(Builder.getInt32Ty(), {i8ptrTy, i8ptrTy, sizeTy, i64ptrTy, i64ptrTy}, false));
+        Value* acPtr = Builder.CreateIntToPtr(
+            ConstantInt::get(Builder.getInt64Ty(), reinterpret_cast<uintptr_t>(S.Keywords.get())), i8ptrTy);
+        Value* rc = Builder.CreateCall(acFn, {acPtr, S.Arg0, LenArg, S.StartOutArg, S.EndOutArg});
+        Builder.CreateRet(rc);
+    } else if (buildDirectDFA(*Body, S.DFAMaxStates, fwdDFA, revDFA)) {
+        // === DIRECT-CODED DFA PATH ===
+        RJDBG(std::cerr << "Using direct-coded DFA: " << fwdDFA.size() << " forward, "
+                        << revDFA.size() << " reverse states\n");
+        Builder.SetInsertPoint(PostEntryBB);
+        // Prefer driving the scan from an inner literal; otherwise reject
+        // inputs missing a required literal (or its rarest required byte)
+        DFAPrefilter pre;
+        InnerLiteral inner;
+        if (findInnerLiteral(*Body, true, S.ByteFreq, inner)) {
+            RJDBG(std::cerr << "Inner literal '" << inner.literal << "' after " << inner.prefixLen
+                            << " prefix items\n");
+            pre.inner = &inner;
+            S.PrefilterByte = inner.literal.size() == 1 ? static_cast<unsigned char>(inner.literal[0]) : -1;
+        } else {
+            pre.requiredLiteral = Body->getRequiredLiteral();
+            if (pre.requiredLiteral.size() < 2) {
+                pre.requiredLiteral.clear();
+                pre.requiredByte = rarestByte(Body->getRequiredChars(), S.ByteFreq);
+            }
+            S.PrefilterByte = pre.requiredByte;
+        }
+        emitDirectDFA(S, fwdDFA, revDFA, pre, ReturnSuccessBB, ReturnFailBB);
+    } else if (Body->isAnchoredAtStart() && !Body->containsZeroWidthRepeat()) {
+        // Optimization: if the AST is anchored at start and there are no
+        // zero-width repeats (e.g. '^' not repeated), we can skip the search
+        // loop and attempt the pattern only at index 0. This is safe and
+        // preserves semantics while avoiding unnecessary scanning.
         // This is the OPTIMIZATION PATH (no search loop)
         
-        // Connect post_strlen directly to this path's entry.
-        Builder.SetInsertPoint(PostStrlenBB);
-        BasicBlock *SingleAttemptBB = BasicBlock::Create(Context, "single_attempt", MatchF);
+        // Connect post_entry directly to this path's entry.
+        Builder.SetInsertPoint(PostEntryBB);
+        BasicBlock *SingleAttemptBB = BasicBlock::Create(Context, "single_attempt", S.MatchF);
         Builder.CreateBr(SingleAttemptBB);
         Builder.SetInsertPoint(SingleAttemptBB);
         
         // Ensure index is 0 and emit a single attempt
-        Builder.CreateStore(ConstantInt::get(Context, APInt(32, 0)), Index);
+        Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), S.Index);
         // Save match start position (always 0 for anchored patterns)
-        Builder.CreateStore(ConstantInt::get(Context, APInt(32, 0)), MatchStartAlloca);
+        Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), S.MatchStartAlloca);
         // Trace attempt at idx=0
         {
           Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
-          FunctionCallee traceFn = ThisModule->getOrInsertFunction("regjit_trace",
+          FunctionCallee traceFn = S.M->getOrInsertFunction("regjit_trace",
             FunctionType::get(Builder.getVoidTy(), {i8ptrTy, Builder.getInt32Ty(), Builder.getInt32Ty()}, false));
           Value* tag = Builder.CreateGlobalStringPtr("attempt");
           Builder.CreateCall(traceFn, {tag, ConstantInt::get(Builder.getInt32Ty(), 0), ConstantInt::get(Builder.getInt32Ty(), 0)});
@@ -805,16 +1340,30 @@ Value* Func::CodeGen() {
 
         Body->SetFailBlock(ReturnFailBB);
         Body->SetSuccessBlock(ReturnSuccessBB);
-        Body->CodeGen();
+        Body->CodeGen(S);
 
-        // The Body->CodeGen() call will have already generated terminators
+        // The Body->CodeGen(S) call will have already generated terminators
         // that branch to either ReturnSuccessBB or ReturnFailBB. We don't need to
         // add more branches here. The blocks are already properly terminated.
 
     } else {
         // This is the SEARCH LOOP PATH
-        Builder.SetInsertPoint(PostStrlenBB);
-        Value* strlenVal = Builder.CreateLoad(Builder.getInt32Ty(), StrLenAlloca);
+        Builder.SetInsertPoint(PostEntryBB);
+        Value* strlenVal = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
+
+        // Inputs shorter than the shortest match fail before any search,
+        // and no start after lastStart leaves room for a match
+        int64_t minLen = Body->getMinLength();
+        int64_t maxLen = Body->getMaxLength();
+        Value* lastStart = strlenVal;
+        if (minLen > 0) {
+            BasicBlock *LongEnoughBB = BasicBlock::Create(Context, "long_enough", S.MatchF);
+            Value* tooShort = Builder.CreateICmpSLT(strlenVal, ConstantInt::get(Builder.getInt64Ty(), minLen));
+            Builder.CreateCondBr(tooShort, ReturnFailBB, LongEnoughBB);
+            Builder.SetInsertPoint(LongEnoughBB);
+            lastStart = Builder.CreateSub(strlenVal, ConstantInt::get(Builder.getInt64Ty(), minLen));
+        }
+        RJDBG(std::cerr << "Match length bounds: [" << minLen << ", " << maxLen << "]\n");
 
         // Check optimization opportunities
         std::string literalPrefix = Body->getLiteralPrefix();
@@ -831,71 +1380,111 @@ Value* Func::CodeGen() {
             
             RJDBG(std::cerr << "Using BMH optimization for literal: " << literalPrefix << "\n");
             
-            // Get the function type for regjit_bmh_search
-            FunctionType* bmhFnTy = FunctionType::get(i8ptrTy, {i8ptrTy, sizeTy, i8ptrTy, sizeTy}, false);
-            
-            // Create function pointer by embedding the address directly
-            // This avoids symbol lookup overhead at runtime
-            auto bmhAddr = reinterpret_cast<uintptr_t>(&regjit_bmh_search);
-            Value* bmhPtrInt = ConstantInt::get(Builder.getInt64Ty(), bmhAddr);
-            Value* bmhPtr = Builder.CreateIntToPtr(bmhPtrInt, PointerType::get(bmhFnTy, 0));
-            
-            // Create a global string constant for the needle
-            Value* needlePtr = Builder.CreateGlobalStringPtr(literalPrefix, "needle");
-            Value* needleLen = ConstantInt::get(sizeTy, literalPrefix.length());
-            
-            // Call regjit_bmh_search(Arg0, strlen, needle, needlelen) via function pointer
-            Value* haystackLen = Builder.CreateZExt(strlenVal, sizeTy);
-            Value* foundPtr = Builder.CreateCall(bmhFnTy, bmhPtr, {Arg0, haystackLen, needlePtr, needleLen});
+            // Call the BMH searcher for this CPU (regjit_rt_bmh_search, no
+            // dispatch) with the needle and its shift table, both built here
+            // and embedded as constants instead of prepared on every call
+            Value* foundPtr = emitBmhSearch(S, S.Arg0, strlenVal, literalPrefix, "needle");
             
             // Check if BMH found anything (returns nullptr if not found)
             Value* isNull = Builder.CreateICmpEQ(foundPtr, ConstantPointerNull::get(cast<PointerType>(i8ptrTy)));
             
             // Create block to handle BMH success - calculate and save match positions
-            BasicBlock *BmhSuccessBB = BasicBlock::Create(Context, "bmh_success", MatchF);
+            BasicBlock *BmhSuccessBB = BasicBlock::Create(Context, "bmh_success", S.MatchF);
             Builder.CreateCondBr(isNull, ReturnFailBB, BmhSuccessBB);
             
             Builder.SetInsertPoint(BmhSuccessBB);
-            // Calculate match start: foundPtr - Arg0
+            // Calculate match start: foundPtr - S.Arg0
             Value* foundPtrInt = Builder.CreatePtrToInt(foundPtr, sizeTy);
-            Value* arg0PtrInt = Builder.CreatePtrToInt(Arg0, sizeTy);
-            Value* matchStartLong = Builder.CreateSub(foundPtrInt, arg0PtrInt);
-            Value* matchStart = Builder.CreateTrunc(matchStartLong, Builder.getInt32Ty());
-            Builder.CreateStore(matchStart, MatchStartAlloca);
+            Value* arg0PtrInt = Builder.CreatePtrToInt(S.Arg0, sizeTy);
+            Value* matchStart = Builder.CreateSub(foundPtrInt, arg0PtrInt);
+            Builder.CreateStore(matchStart, S.MatchStartAlloca);
             // Match end = start + pattern length
-            Value* matchEnd = Builder.CreateAdd(matchStart, ConstantInt::get(Builder.getInt32Ty(), literalPrefix.length()));
-            Builder.CreateStore(matchEnd, Index);
+            Value* matchEnd = Builder.CreateAdd(matchStart, ConstantInt::get(Builder.getInt64Ty(), literalPrefix.length()));
+            Builder.CreateStore(matchEnd, S.Index);
             Builder.CreateBr(ReturnSuccessBB);
             
+        } else if (literalPrefix.length() >= 2 && dynamic_cast<Concat*>(Body.get())) {
+            // === LITERAL PREFIX SEARCH PATH ===
+            // Every match starts with literalPrefix: BMH finds the next
+            // occurrence, and the body runs from there without re-checking
+            // the leading literal elements (anchors among them stay).
+            auto* concat = static_cast<Concat*>(Body.get());
+            size_t verified = 0, verifiedLen = 0;
+            while (verified < concat->BodyVec.size() && !concat->BodyVec[verified]->isZeroWidth() &&
+                   concat->BodyVec[verified]->isPureLiteral()) {
+                verifiedLen += concat->BodyVec[verified]->getLiteralPrefix().size();
+                ++verified;
+            }
+            RJDBG(std::cerr << "Using BMH prefix search for: " << literalPrefix << " (skipping "
+                            << verifiedLen << " bytes)\n");
+
+            BasicBlock *PrefixSearchBB = BasicBlock::Create(Context, "prefix_search", S.MatchF);
+            BasicBlock *PrefixFoundBB = BasicBlock::Create(Context, "prefix_found", S.MatchF);
+            Builder.CreateBr(PrefixSearchBB);
+
+            // Next occurrence that starts at or before lastStart
+            Builder.SetInsertPoint(PrefixSearchBB);
+            Value *curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+            Value *hayLen = Builder.CreateSub(
+                Builder.CreateAdd(lastStart, ConstantInt::get(sizeTy, literalPrefix.length())), curIdx);
+            Value *foundPtr = emitBmhSearch(S, Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {curIdx}),
+                                            hayLen, literalPrefix, "prefix");
+            Value *isNull = Builder.CreateICmpEQ(foundPtr, ConstantPointerNull::get(cast<PointerType>(i8ptrTy)));
+            Builder.CreateCondBr(isNull, ReturnFailBB, PrefixFoundBB);
+
+            // Run the rest of the body right after the verified bytes
+            Builder.SetInsertPoint(PrefixFoundBB);
+            BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+            BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
+            Value *hitIdx = Builder.CreateSub(Builder.CreatePtrToInt(foundPtr, sizeTy),
+                                              Builder.CreatePtrToInt(S.Arg0, sizeTy));
+            Builder.CreateStore(hitIdx, S.MatchStartAlloca);
+            Builder.CreateStore(Builder.CreateAdd(hitIdx, ConstantInt::get(sizeTy, verifiedLen)), S.Index);
+
+            concat->SetFailBlock(TryFail);
+            concat->SetSuccessBlock(TrySuccess);
+            concat->CodeGenFrom(S, verified);
+
+            Builder.SetInsertPoint(TrySuccess);
+            Builder.CreateBr(ReturnSuccessBB);
+
+            // Fail - resume the search one past this occurrence
+            Builder.SetInsertPoint(TryFail);
+            emitBacktrackStep(S);
+            Builder.CreateStore(Builder.CreateAdd(hitIdx, ConstantInt::get(sizeTy, 1)), S.Index);
+            Builder.CreateBr(PrefixSearchBB);
+
         } else if (firstLiteralChar >= 0) {
             // === MEMCHR OPTIMIZATION PATH ===
             // Use memchr to quickly find the next occurrence of the first literal character
             // instead of checking every position sequentially.
             
             RJDBG(std::cerr << "Using memchr optimization for first char: " << (char)firstLiteralChar << "\n");
+            S.PrefilterByte = firstLiteralChar;
             
             // Declare memchr: void* memchr(const void* s, int c, size_t n)
-            FunctionCallee memchrFn = ThisModule->getOrInsertFunction("memchr",
+            FunctionCallee memchrFn = S.M->getOrInsertFunction("memchr",
                 FunctionType::get(i8ptrTy, {i8ptrTy, Builder.getInt32Ty(), sizeTy}, false));
             
             // Create memchr search blocks
-            BasicBlock *MemchrSearchBB = BasicBlock::Create(Context, "memchr_search", MatchF);
-            BasicBlock *MemchrFoundBB = BasicBlock::Create(Context, "memchr_found", MatchF);
-            BasicBlock *LoopBodyBB = BasicBlock::Create(Context, "search_loop_body", MatchF);
+            BasicBlock *MemchrSearchBB = BasicBlock::Create(Context, "memchr_search", S.MatchF);
+            BasicBlock *MemchrFoundBB = BasicBlock::Create(Context, "memchr_found", S.MatchF);
+            BasicBlock *LoopBodyBB = BasicBlock::Create(Context, "search_loop_body", S.MatchF);
             
             Builder.CreateBr(MemchrSearchBB);
             
             // Memchr search: find next occurrence of first char starting from current index
             Builder.SetInsertPoint(MemchrSearchBB);
-            Value *curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-            Value *searchPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, {curIdx});
-            // remaining = strlen - curIdx
-            Value *remaining = Builder.CreateSub(strlenVal, curIdx);
-            Value *remainingSize = Builder.CreateZExt(remaining, sizeTy);
+            Value *curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+            Value *searchPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {curIdx});
+            // remaining = lastStart + 1 - curIdx (the first char is part of
+            // the match, so minLen >= 1 here)
+            Value *remaining = Builder.CreateSub(
+                Builder.CreateAdd(lastStart, ConstantInt::get(Builder.getInt64Ty(), minLen > 0 ? 1 : 0)), curIdx);
             
             // Call memchr(searchPtr, firstChar, remaining)
             Value *firstCharVal = ConstantInt::get(Builder.getInt32Ty(), firstLiteralChar);
-            Value *foundPtr = Builder.CreateCall(memchrFn, {searchPtr, firstCharVal, remainingSize});
+            Value *foundPtr = Builder.CreateCall(memchrFn, {searchPtr, firstCharVal, remaining});
             
             // Check if memchr found anything (returns null if not found)
             Value *isNull = Builder.CreateICmpEQ(foundPtr, ConstantPointerNull::get(cast<PointerType>(i8ptrTy)));
@@ -903,27 +1492,26 @@ Value* Func::CodeGen() {
             
             // Memchr found: calculate the new index
             Builder.SetInsertPoint(MemchrFoundBB);
-            // newIdx = foundPtr - Arg0 (pointer subtraction)
+            // newIdx = foundPtr - S.Arg0 (pointer subtraction)
             Value *foundPtrInt = Builder.CreatePtrToInt(foundPtr, sizeTy);
-            Value *arg0PtrInt = Builder.CreatePtrToInt(Arg0, sizeTy);
-            Value *newIdxLong = Builder.CreateSub(foundPtrInt, arg0PtrInt);
-            Value *newIdx = Builder.CreateTrunc(newIdxLong, Builder.getInt32Ty());
-            Builder.CreateStore(newIdx, Index);
+            Value *arg0PtrInt = Builder.CreatePtrToInt(S.Arg0, sizeTy);
+            Value *newIdx = Builder.CreateSub(foundPtrInt, arg0PtrInt);
+            Builder.CreateStore(newIdx, S.Index);
             Builder.CreateBr(LoopBodyBB);
             
             // Loop body: try to match the full pattern at this position
             Builder.SetInsertPoint(LoopBodyBB);
-            BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", MatchF);
-            BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", MatchF);
+            BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+            BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
             
-            Value *curIdx_search = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-            Builder.CreateStore(curIdx_search, Index);
+            Value *curIdx_search = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+            Builder.CreateStore(curIdx_search, S.Index);
             // Save match start position before attempting match
-            Builder.CreateStore(curIdx_search, MatchStartAlloca);
+            Builder.CreateStore(curIdx_search, S.MatchStartAlloca);
             
             Body->SetFailBlock(TryFail);
             Body->SetSuccessBlock(TrySuccess);
-            Body->CodeGen();
+            Body->CodeGen(S);
             
             // If body succeeds, return success immediately
             Builder.SetInsertPoint(TrySuccess);
@@ -931,9 +1519,10 @@ Value* Func::CodeGen() {
             
             // If body fails, increment index and search again with memchr
             Builder.SetInsertPoint(TryFail);
+            emitBacktrackStep(S);
             // We need to skip past the current position to avoid infinite loop
-            Value* nextIdx = Builder.CreateAdd(curIdx_search, ConstantInt::get(Context, APInt(32, 1)));
-            Builder.CreateStore(nextIdx, Index);
+            Value* nextIdx = Builder.CreateAdd(curIdx_search, ConstantInt::get(Context, APInt(64, 1)));
+            Builder.CreateStore(nextIdx, S.Index);
             Builder.CreateBr(MemchrSearchBB);
             
         } else {
@@ -941,45 +1530,166 @@ Value* Func::CodeGen() {
             
             // Check if pattern has required characters for memchr-accelerated search
             std::set<char> requiredChars = Body->getRequiredChars();
-            
-            if (!requiredChars.empty()) {
+
+            // Check if every match starts with one of a few short strings
+            std::vector<std::string> prefixes;
+            TeddyMasks teddy;
+            if (collectPrefixSet(*Body, prefixes)) teddy = TeddyMasks(prefixes);
+            // A one-byte fingerprint filters little; memchr on a required
+            // char skips more when there is one.
+            bool useTeddy = teddy.len >= 2 || (teddy.len == 1 && requiredChars.empty());
+            // A literal inside the pattern: only the starts its prefix can
+            // reach back to from each occurrence are tried
+            InnerLiteral inner;
+            bool useInner = findInnerLiteral(*Body, false, S.ByteFreq, inner) &&
+                            (!useTeddy || inner.literal.size() > teddy.len);
+
+            if (useInner) {
+                // === INNER LITERAL SEARCH LOOP ===
+                RJDBG(std::cerr << "Using inner literal '" << inner.literal << "' after " << inner.prefixLen
+                                << " prefix items\n");
+                if (inner.literal.size() == 1) S.PrefilterByte = static_cast<unsigned char>(inner.literal[0]);
+                AllocaInst* FromAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "inner_from");
+                AllocaInst* HitAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "inner_hit_pos");
+                AllocaInst* HitStartAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "inner_hit_start");
+                Builder.CreateStore(ConstantInt::get(Builder.getInt64Ty(), 0), FromAlloca);
+                BasicBlock *InnerSearchBB =
+                    emitInnerLiteralSearch(S, inner, FromAlloca, HitAlloca, HitStartAlloca, ReturnFailBB);
+
+                // Try every start from the prefix's earliest one up to the literal
+                BasicBlock *WindowCheckBB = BasicBlock::Create(Context, "inner_window_check", S.MatchF);
+                BasicBlock *WindowBodyBB = BasicBlock::Create(Context, "inner_window_body", S.MatchF);
+                BasicBlock *NextHitBB = BasicBlock::Create(Context, "inner_next_hit", S.MatchF);
+                Value* from = Builder.CreateLoad(Builder.getInt64Ty(), FromAlloca);
+                Value* hitStart = Builder.CreateLoad(Builder.getInt64Ty(), HitStartAlloca);
+                Builder.CreateStore(Builder.CreateSelect(Builder.CreateICmpSGT(hitStart, from), hitStart, from),
+                                    S.Index);
+                Builder.CreateBr(WindowCheckBB);
+
+                Builder.SetInsertPoint(WindowCheckBB);
+                Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+                if (minLen > 0) {
+                    BasicBlock *RoomBB = BasicBlock::Create(Context, "inner_window_room", S.MatchF);
+                    Builder.CreateCondBr(Builder.CreateICmpSGT(curIdx, lastStart), ReturnFailBB, RoomBB);
+                    Builder.SetInsertPoint(RoomBB);
+                }
+                Value* inWindow = Builder.CreateICmpSLE(curIdx, Builder.CreateLoad(Builder.getInt64Ty(), HitAlloca));
+                Builder.CreateCondBr(inWindow, WindowBodyBB, NextHitBB);
+
+                Builder.SetInsertPoint(WindowBodyBB);
+                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
+                Builder.CreateStore(curIdx, S.MatchStartAlloca);
+
+                Body->SetFailBlock(TryFail);
+                Body->SetSuccessBlock(TrySuccess);
+                Body->CodeGen(S);
+
+                Builder.SetInsertPoint(TrySuccess);
+                Builder.CreateBr(ReturnSuccessBB);
+
+                // Fail - next start in the window
+                Builder.SetInsertPoint(TryFail);
+                emitBacktrackStep(S);
+                Value* nextIdx = Builder.CreateAdd(curIdx, ConstantInt::get(Builder.getInt64Ty(), 1));
+                Builder.CreateStore(nextIdx, S.Index);
+                Builder.CreateBr(WindowCheckBB);
+
+                // Window exhausted - look for the next occurrence
+                Builder.SetInsertPoint(NextHitBB);
+                Value* past = Builder.CreateAdd(Builder.CreateLoad(Builder.getInt64Ty(), HitAlloca),
+                                                ConstantInt::get(Builder.getInt64Ty(), 1));
+                Builder.CreateStore(past, FromAlloca);
+                Builder.CreateBr(InnerSearchBB);
+
+            } else if (useTeddy) {
+                // === TEDDY PREFILTER SEARCH LOOP ===
+                // regjit_teddy_find jumps to the next position where some
+                // prefix may start; the full pattern only runs there.
+                RJDBG(std::cerr << "Using Teddy prefilter: " << prefixes.size()
+                                << " prefixes, fingerprint length " << teddy.len << "\n");
+
+                FunctionCallee teddyFn = S.M->getOrInsertFunction("regjit_teddy_find",
+                    FunctionType::get(Builder.getInt64Ty(), {i8ptrTy, sizeTy, i8ptrTy, sizeTy, sizeTy}, false));
+                // The nibble tables travel with the module as a constant
+                Value* masksPtr = Builder.CreateGlobalStringPtr(
+                    StringRef(reinterpret_cast<const char*>(&teddy.table[0][0][0]), sizeof(teddy.table)),
+                    "teddy_masks");
+                Value* fpLen = ConstantInt::get(sizeTy, teddy.len);
+
+                BasicBlock *TeddySearchBB = BasicBlock::Create(Context, "teddy_search", S.MatchF);
+                BasicBlock *LoopBodyBB = BasicBlock::Create(Context, "search_loop_body", S.MatchF);
+                Builder.CreateBr(TeddySearchBB);
+
+                // Next candidate at or after the current index
+                Builder.SetInsertPoint(TeddySearchBB);
+                Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+                Value* cand = Builder.CreateCall(teddyFn, {masksPtr, fpLen, S.Arg0, strlenVal, curIdx});
+                // -1 (none) compares above lastStart too when unsigned
+                Value* none = Builder.CreateICmpUGT(cand, lastStart);
+                Builder.CreateCondBr(none, ReturnFailBB, LoopBodyBB);
+
+                // Try the full pattern at the candidate
+                Builder.SetInsertPoint(LoopBodyBB);
+                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
+                Builder.CreateStore(cand, S.Index);
+                Builder.CreateStore(cand, S.MatchStartAlloca);
+
+                Body->SetFailBlock(TryFail);
+                Body->SetSuccessBlock(TrySuccess);
+                Body->CodeGen(S);
+
+                Builder.SetInsertPoint(TrySuccess);
+                Builder.CreateBr(ReturnSuccessBB);
+
+                // Fail - look for the next candidate after this one
+                Builder.SetInsertPoint(TryFail);
+                emitBacktrackStep(S);
+                Value* nextIdx = Builder.CreateAdd(cand, ConstantInt::get(Builder.getInt64Ty(), 1));
+                Builder.CreateStore(nextIdx, S.Index);
+                Builder.CreateBr(TeddySearchBB);
+
+            } else if (!requiredChars.empty()) {
                 // === MEMCHR-ACCELERATED SEARCH LOOP ===
                 // Use memchr to find positions where required char exists,
-                // then limit search to only those candidate regions
-                char filterChar = *requiredChars.begin();
-                RJDBG(std::cerr << "Using memchr-accelerated search for required char: '" << filterChar << "'\n");
+                // then limit search to only those candidate regions. Of
+                // several required chars the rarest one stops memchr least.
+                char filterChar = static_cast<char>(rarestByte(requiredChars, S.ByteFreq));
+                S.PrefilterByte = static_cast<unsigned char>(filterChar);
+                RJDBG(std::cerr << "Using memchr-accelerated search for required char: '" << filterChar
+                                << "' (rank " << int(S.ByteFreq.rank[S.PrefilterByte]) << ")\n");
                 
                 // Declare memchr
-                FunctionCallee memchrFn = ThisModule->getOrInsertFunction("memchr",
+                FunctionCallee memchrFn = S.M->getOrInsertFunction("memchr",
                     FunctionType::get(i8ptrTy, {i8ptrTy, Builder.getInt32Ty(), sizeTy}, false));
                 Value* filterCharVal = ConstantInt::get(Builder.getInt32Ty(), static_cast<unsigned char>(filterChar));
                 
                 // Create blocks for the accelerated search
-                BasicBlock *MemchrSearchBB = BasicBlock::Create(Context, "memchr_search", MatchF);
-                BasicBlock *MemchrFoundBB = BasicBlock::Create(Context, "memchr_found", MatchF);
-                BasicBlock *RangeLoopCheckBB = BasicBlock::Create(Context, "range_loop_check", MatchF);
-                BasicBlock *RangeLoopBodyBB = BasicBlock::Create(Context, "range_loop_body", MatchF);
-                BasicBlock *NextMemchrBB = BasicBlock::Create(Context, "next_memchr", MatchF);
+                BasicBlock *MemchrSearchBB = BasicBlock::Create(Context, "memchr_search", S.MatchF);
+                BasicBlock *MemchrFoundBB = BasicBlock::Create(Context, "memchr_found", S.MatchF);
+                BasicBlock *RangeLoopCheckBB = BasicBlock::Create(Context, "range_loop_check", S.MatchF);
+                BasicBlock *RangeLoopBodyBB = BasicBlock::Create(Context, "range_loop_body", S.MatchF);
+                BasicBlock *NextMemchrBB = BasicBlock::Create(Context, "next_memchr", S.MatchF);
                 
                 // Store the "range end" - we'll search positions 0..foundPos for each memchr hit
-                AllocaInst* RangeEndAlloca = Builder.CreateAlloca(Builder.getInt32Ty(), nullptr, "range_end");
-                AllocaInst* RangeStartAlloca = Builder.CreateAlloca(Builder.getInt32Ty(), nullptr, "range_start");
-                AllocaInst* MemchrPosAlloca = Builder.CreateAlloca(Builder.getInt32Ty(), nullptr, "memchr_pos");
+                AllocaInst* RangeEndAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "range_end");
+                AllocaInst* RangeStartAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "range_start");
+                AllocaInst* MemchrPosAlloca = createEntryAlloca(S, Builder.getInt64Ty(), "memchr_pos");
                 
                 // Initialize: first memchr search starts at position 0
-                Builder.CreateStore(ConstantInt::get(Builder.getInt32Ty(), 0), RangeStartAlloca);
-                Builder.CreateStore(ConstantInt::get(Builder.getInt32Ty(), 0), MemchrPosAlloca);
+                Builder.CreateStore(ConstantInt::get(Builder.getInt64Ty(), 0), RangeStartAlloca);
+                Builder.CreateStore(ConstantInt::get(Builder.getInt64Ty(), 0), MemchrPosAlloca);
                 Builder.CreateBr(MemchrSearchBB);
                 
                 // === MEMCHR SEARCH BLOCK ===
                 // Find next occurrence of required char
                 Builder.SetInsertPoint(MemchrSearchBB);
-                Value* memchrStartPos = Builder.CreateLoad(Builder.getInt32Ty(), MemchrPosAlloca);
-                Value* searchPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, {memchrStartPos});
+                Value* memchrStartPos = Builder.CreateLoad(Builder.getInt64Ty(), MemchrPosAlloca);
+                Value* searchPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {memchrStartPos});
                 Value* remaining = Builder.CreateSub(strlenVal, memchrStartPos);
-                Value* remainingSize = Builder.CreateZExt(remaining, sizeTy);
                 
-                Value* foundPtr = Builder.CreateCall(memchrFn, {searchPtr, filterCharVal, remainingSize});
+                Value* foundPtr = Builder.CreateCall(memchrFn, {searchPtr, filterCharVal, remaining});
                 Value* isNull = Builder.CreateICmpEQ(foundPtr, ConstantPointerNull::get(cast<PointerType>(i8ptrTy)));
                 Builder.CreateCondBr(isNull, ReturnFailBB, MemchrFoundBB);
                 
@@ -987,36 +1697,49 @@ Value* Func::CodeGen() {
                 // Calculate position of found char
                 Builder.SetInsertPoint(MemchrFoundBB);
                 Value* foundPtrInt = Builder.CreatePtrToInt(foundPtr, sizeTy);
-                Value* arg0PtrInt = Builder.CreatePtrToInt(Arg0, sizeTy);
-                Value* foundPosLong = Builder.CreateSub(foundPtrInt, arg0PtrInt);
-                Value* foundPos = Builder.CreateTrunc(foundPosLong, Builder.getInt32Ty());
+                Value* arg0PtrInt = Builder.CreatePtrToInt(S.Arg0, sizeTy);
+                Value* foundPos = Builder.CreateSub(foundPtrInt, arg0PtrInt);
                 
-                // Set range: try positions from RangeStart to foundPos (inclusive)
-                Value* rangeStart = Builder.CreateLoad(Builder.getInt32Ty(), RangeStartAlloca);
+                // Set range: try positions from RangeStart to foundPos (inclusive).
+                // The range holds no earlier required char, so a match starting
+                // in it reaches foundPos: it starts after foundPos - maxLen.
+                Value* rangeStart = Builder.CreateLoad(Builder.getInt64Ty(), RangeStartAlloca);
+                if (maxLen > 0) {
+                    Value* reach = Builder.CreateSub(foundPos, ConstantInt::get(Builder.getInt64Ty(), maxLen - 1));
+                    rangeStart = Builder.CreateSelect(Builder.CreateICmpSGT(reach, rangeStart), reach, rangeStart);
+                }
                 Builder.CreateStore(foundPos, RangeEndAlloca);
-                Builder.CreateStore(rangeStart, Index);  // Start trying from rangeStart
+                Builder.CreateStore(rangeStart, S.Index);  // Start trying from rangeStart
                 Builder.CreateBr(RangeLoopCheckBB);
                 
                 // === RANGE LOOP CHECK ===
                 // Check if we've tried all positions in the range
                 Builder.SetInsertPoint(RangeLoopCheckBB);
-                Value* curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-                Value* rangeEnd = Builder.CreateLoad(Builder.getInt32Ty(), RangeEndAlloca);
+                Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+                if (minLen > 0) {
+                    // Past lastStart no later hit can fit a match either
+                    BasicBlock *RoomBB = BasicBlock::Create(Context, "range_room", S.MatchF);
+                    Builder.CreateCondBr(Builder.CreateICmpSGT(curIdx, lastStart), ReturnFailBB, RoomBB);
+                    Builder.SetInsertPoint(RoomBB);
+                }
+                Value* rangeEnd = Builder.CreateLoad(Builder.getInt64Ty(), RangeEndAlloca);
                 Value* inRange = Builder.CreateICmpSLE(curIdx, rangeEnd);
                 Builder.CreateCondBr(inRange, RangeLoopBodyBB, NextMemchrBB);
                 
                 // === RANGE LOOP BODY ===
                 // Try to match at current position
                 Builder.SetInsertPoint(RangeLoopBodyBB);
-                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", MatchF);
-                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", MatchF);
+                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
                 
-                Value* tryIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-                Builder.CreateStore(tryIdx, Index);
+                Value* tryIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+                Builder.CreateStore(tryIdx, S.Index);
+                // Save match start position before attempting match
+                Builder.CreateStore(tryIdx, S.MatchStartAlloca);
                 
                 Body->SetFailBlock(TryFail);
                 Body->SetSuccessBlock(TrySuccess);
-                Body->CodeGen();
+                Body->CodeGen(S);
                 
                 // Success - return 1
                 Builder.SetInsertPoint(TrySuccess);
@@ -1024,43 +1747,46 @@ Value* Func::CodeGen() {
                 
                 // Fail - try next position in range
                 Builder.SetInsertPoint(TryFail);
-                Value* nextIdx = Builder.CreateAdd(tryIdx, ConstantInt::get(Builder.getInt32Ty(), 1));
-                Builder.CreateStore(nextIdx, Index);
+                emitBacktrackStep(S);
+                Value* nextIdx = Builder.CreateAdd(tryIdx, ConstantInt::get(Builder.getInt64Ty(), 1));
+                Builder.CreateStore(nextIdx, S.Index);
                 Builder.CreateBr(RangeLoopCheckBB);
                 
                 // === NEXT MEMCHR ===
                 // Move to find next occurrence of required char
                 Builder.SetInsertPoint(NextMemchrBB);
-                Value* nextRangeEnd = Builder.CreateLoad(Builder.getInt32Ty(), RangeEndAlloca);
-                Value* nextMemchrPos = Builder.CreateAdd(nextRangeEnd, ConstantInt::get(Builder.getInt32Ty(), 1));
+                Value* nextRangeEnd = Builder.CreateLoad(Builder.getInt64Ty(), RangeEndAlloca);
+                Value* nextMemchrPos = Builder.CreateAdd(nextRangeEnd, ConstantInt::get(Builder.getInt64Ty(), 1));
                 Builder.CreateStore(nextMemchrPos, MemchrPosAlloca);
                 Builder.CreateStore(nextMemchrPos, RangeStartAlloca);  // Next range starts after this one
                 Builder.CreateBr(MemchrSearchBB);
                 
             } else {
                 // === BASIC SEARCH LOOP (no required chars to accelerate) ===
-                BasicBlock *LoopCheckBB = BasicBlock::Create(Context, "search_loop_check", MatchF);
-                BasicBlock *LoopBodyBB = BasicBlock::Create(Context, "search_loop_body", MatchF);
-                BasicBlock *LoopIncBB = BasicBlock::Create(Context, "search_loop_inc", MatchF);
+                BasicBlock *LoopCheckBB = BasicBlock::Create(Context, "search_loop_check", S.MatchF);
+                BasicBlock *LoopBodyBB = BasicBlock::Create(Context, "search_loop_body", S.MatchF);
+                BasicBlock *LoopIncBB = BasicBlock::Create(Context, "search_loop_inc", S.MatchF);
 
                 Builder.CreateBr(LoopCheckBB);
 
-                // Search loop condition: for(curIdx=0; curIdx<=strlen; ++curIdx)
+                // Search loop condition: for(curIdx=0; curIdx<=lastStart; ++curIdx)
                 Builder.SetInsertPoint(LoopCheckBB);
-                Value *curIdx_search = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-                Value *cond = Builder.CreateICmpSLE(curIdx_search, strlenVal);
+                Value *curIdx_search = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+                Value *cond = Builder.CreateICmpSLE(curIdx_search, lastStart);
                 Builder.CreateCondBr(cond, LoopBodyBB, ReturnFailBB);
 
                 // Each search attempt gets its own AST success/fail blocks
                 Builder.SetInsertPoint(LoopBodyBB);
-                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", MatchF);
-                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", MatchF);
+                BasicBlock *TrySuccess = BasicBlock::Create(Context, "try_success", S.MatchF);
+                BasicBlock *TryFail = BasicBlock::Create(Context, "try_fail", S.MatchF);
                 
-                Builder.CreateStore(curIdx_search, Index);
+                Builder.CreateStore(curIdx_search, S.Index);
+                // Save match start position before attempting match
+                Builder.CreateStore(curIdx_search, S.MatchStartAlloca);
 
                 Body->SetFailBlock(TryFail);
                 Body->SetSuccessBlock(TrySuccess);
-                Body->CodeGen();
+                Body->CodeGen(S);
 
                 // If body succeeds, return success immediately
                 Builder.SetInsertPoint(TrySuccess);
@@ -1072,8 +1798,9 @@ Value* Func::CodeGen() {
 
                 // Search loop increment: curIdx++ and loop back
                 Builder.SetInsertPoint(LoopIncBB);
-                Value* nextIdx_search = Builder.CreateAdd(curIdx_search, ConstantInt::get(Context, APInt(32, 1)));
-                Builder.CreateStore(nextIdx_search, Index);
+                emitBacktrackStep(S);
+                Value* nextIdx_search = Builder.CreateAdd(curIdx_search, ConstantInt::get(Context, APInt(64, 1)));
+                Builder.CreateStore(nextIdx_search, S.Index);
                 Builder.CreateBr(LoopCheckBB);
             }
         }
@@ -1082,31 +1809,41 @@ Value* Func::CodeGen() {
     // Define the actual return blocks
     Builder.SetInsertPoint(ReturnSuccessBB);
     // Write match positions to output parameters
-    Value* matchStart = Builder.CreateLoad(Builder.getInt32Ty(), MatchStartAlloca);
-    Value* matchEnd = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-    Builder.CreateStore(matchStart, StartOutArg);
-    Builder.CreateStore(matchEnd, EndOutArg);
+    Value* matchStart = Builder.CreateLoad(Builder.getInt64Ty(), S.MatchStartAlloca);
+    Value* matchEnd = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+    Builder.CreateStore(matchStart, S.StartOutArg);
+    Builder.CreateStore(matchEnd, S.EndOutArg);
     Builder.CreateRet(ConstantInt::get(Context, APInt(32, 1)));
     
     Builder.SetInsertPoint(ReturnFailBB);
     // Write -1 to indicate no match
-    Builder.CreateStore(ConstantInt::get(Context, APInt(32, -1)), StartOutArg);
-    Builder.CreateStore(ConstantInt::get(Context, APInt(32, -1)), EndOutArg);
+    Builder.CreateStore(ConstantInt::get(Context, APInt(64, -1)), S.StartOutArg);
+    Builder.CreateStore(ConstantInt::get(Context, APInt(64, -1)), S.EndOutArg);
     Builder.CreateRet(ConstantInt::get(Context, APInt(32, 0)));
-    
-    // Reset the global context/builder pointers after all IR generation is done
-    ContextPtr = &GlobalContext;
-    BuilderPtr = &GlobalBuilder;
+
+    if (S.BudgetExceededBB) {
+        // Out of steps: report no match and the distinct status
+        Builder.SetInsertPoint(S.BudgetExceededBB);
+        Builder.CreateStore(ConstantInt::get(Context, APInt(64, -1)), S.StartOutArg);
+        Builder.CreateStore(ConstantInt::get(Context, APInt(64, -1)), S.EndOutArg);
+        Builder.CreateRet(ConstantInt::get(Context, APInt(32, REGJIT_BUDGET_EXCEEDED, true)));
+    }
     
     return nullptr;
 }
 
 // Match::CodeGen - 匹配单个字符
-Value* Match::CodeGen() {
+Value* Match::CodeGen(CodeGenSession &S) {
     // 获取当前索引
-    Value* idx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
+    Value* idx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+    // 边界检查: 输入按长度界定且不保证以 NUL 结尾, 不能读取 data[len]
+    Value* strLen = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
+    Value* inBounds = Builder.CreateICmpSLT(idx, strLen);
+    BasicBlock* loadBlock = BasicBlock::Create(Context, "match_load", S.MatchF);
+    Builder.CreateCondBr(inBounds, loadBlock, GetFailBlock());
+    Builder.SetInsertPoint(loadBlock);
     // 获取字符指针
-    Value* charPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, {idx});
+    Value* charPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {idx});
     // 加载当前字符
     Value* ch = Builder.CreateLoad(Builder.getInt8Ty(), charPtr);
     // 比较字符
@@ -1114,13 +1851,13 @@ Value* Match::CodeGen() {
     Value* cmp = Builder.CreateICmpEQ(ch, expected);
     
     // 创建成功块 - 增加索引并跳转到下一个
-    BasicBlock* matchSuccess = BasicBlock::Create(Context, "match_success", MatchF);
+    BasicBlock* matchSuccess = BasicBlock::Create(Context, "match_success", S.MatchF);
     Builder.CreateCondBr(cmp, matchSuccess, GetFailBlock());
     
     Builder.SetInsertPoint(matchSuccess);
     // 增加索引
-    Value* nextIdx = Builder.CreateAdd(idx, ConstantInt::get(Context, APInt(32, 1)));
-    Builder.CreateStore(nextIdx, Index);
+    Value* nextIdx = Builder.CreateAdd(idx, ConstantInt::get(Context, APInt(64, 1)));
+    Builder.CreateStore(nextIdx, S.Index);
     Builder.CreateBr(GetSuccessBlock());
     
     return nullptr;
@@ -1132,23 +1869,28 @@ void Concat::Append(std::unique_ptr<Root> Body) {
 }
 
 // Concat::CodeGen - 连接多个模式
-Value* Concat::CodeGen() {
-    if (BodyVec.empty()) {
+Value* Concat::CodeGen(CodeGenSession &S) {
+    return CodeGenFrom(S, 0);
+}
+
+// Concat::CodeGenFrom - 只生成从 first 开始的元素 (前面的已由调用者验证)
+Value* Concat::CodeGenFrom(CodeGenSession &S, size_t first) {
+    if (first >= BodyVec.size()) {
         Builder.CreateBr(GetSuccessBlock());
         return nullptr;
     }
     
     // 创建各元素之间的连接块
-    std::vector<BasicBlock*> blocks;
-    for (size_t i = 0; i < BodyVec.size(); ++i) {
-        blocks.push_back(BasicBlock::Create(Context, "concat_" + std::to_string(i), MatchF));
+    std::vector<BasicBlock*> blocks(BodyVec.size(), nullptr);
+    for (size_t i = first; i < BodyVec.size(); ++i) {
+        blocks[i] = BasicBlock::Create(Context, "concat_" + std::to_string(i), S.MatchF);
     }
     
     // 跳转到第一个块
-    Builder.CreateBr(blocks[0]);
+    Builder.CreateBr(blocks[first]);
     
     // 生成每个元素的代码
-    for (size_t i = 0; i < BodyVec.size(); ++i) {
+    for (size_t i = first; i < BodyVec.size(); ++i) {
         Builder.SetInsertPoint(blocks[i]);
         // 设置成功块：下一个元素或最终成功块
         if (i + 1 < BodyVec.size()) {
@@ -1158,7 +1900,7 @@ Value* Concat::CodeGen() {
         }
         // 失败块：整体失败
         BodyVec[i]->SetFailBlock(GetFailBlock());
-        BodyVec[i]->CodeGen();
+        BodyVec[i]->CodeGen(S);
     }
     
     return nullptr;
@@ -1169,8 +1911,127 @@ void Alternative::Append(std::unique_ptr<Root> Body) {
     BodyVec.push_back(std::move(Body));
 }
 
+// Bytes that can start a match of `node` are added to `set`. Returns true
+// when `node` can also match the empty string, in which case the set says
+// nothing about what it consumes. Unknown nodes match anything.
+static bool firstByteSet(const Root &node, std::bitset<256> &set) {
+    if (auto* m = dynamic_cast<const Match*>(&node)) {
+        set.set(static_cast<unsigned char>(m->getChar()));
+        return false;
+    }
+    if (auto* cc = dynamic_cast<const CharClass*>(&node)) {
+        for (int c = 0; c < 256; ++c) {
+            if (cc->matchesByte(static_cast<unsigned char>(c))) set.set(c);
+        }
+        return false;
+    }
+    if (auto* c = dynamic_cast<const Concat*>(&node)) {
+        for (const auto& child : c->BodyVec) {
+            if (!firstByteSet(*child, set)) return false;
+        }
+        return true;
+    }
+    if (auto* alt = dynamic_cast<const Alternative*>(&node)) {
+        bool nullable = false;
+        for (const auto& child : alt->BodyVec) {
+            nullable |= firstByteSet(*child, set);
+        }
+        return nullable;
+    }
+    if (auto* rep = dynamic_cast<const Repeat*>(&node)) {
+        if (rep->maxCount == 0) return true;
+        bool bodyNullable = firstByteSet(*rep->Body, set);
+        return bodyNullable || rep->minCount == 0;
+    }
+    if (dynamic_cast<const Anchor*>(&node)) return true;
+    if (auto* f = dynamic_cast<const Func*>(&node)) return firstByteSet(*f->Body, set);
+    set.set();
+    return true;
+}
+
+// Jump on byte `ch` to targets[ch]; bytes without a target go to `other`.
+// `possible` holds the bytes `ch` can be here: when they all share a target
+// no switch is needed.
+static void emitByteSwitch(CodeGenSession &S, Value* ch, const std::vector<BasicBlock*> &targets,
+                           const std::bitset<256> &possible, BasicBlock* other) {
+    BasicBlock* only = nullptr;
+    bool single = true;
+    unsigned numCases = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (!possible[b]) continue;
+        BasicBlock* t = targets[b] ? targets[b] : other;
+        if (only && t != only) single = false;
+        only = t;
+        if (targets[b]) ++numCases;
+    }
+    if (!only || single) {
+        Builder.CreateBr(only ? only : other);
+        return;
+    }
+    SwitchInst* sw = Builder.CreateSwitch(ch, other, numCases);
+    for (int b = 0; b < 256; ++b) {
+        if (possible[b] && targets[b]) sw->addCase(Builder.getInt8(static_cast<uint8_t>(b)), targets[b]);
+    }
+}
+
+// First-byte dispatch for an alternation none of whose branches can match
+// empty: load the byte at the current position once and jump straight to the
+// first branch that can start with it. When that branch fails, the index is
+// restored and the same byte picks the next candidate, so branches are still
+// tried in pattern order but only the viable ones are tried at all. A branch
+// with no candidate after it restores the index too, so the alternation fails
+// at its start position like the sequential code.
+static void emitAlternativeDispatch(CodeGenSession &S, Alternative &alt,
+                                    const std::vector<std::bitset<256>> &first) {
+    auto &branches = alt.BodyVec;
+    const size_t n = branches.size();
+    std::vector<BasicBlock*> tryBlocks;
+    for (size_t i = 0; i < n; ++i) {
+        tryBlocks.push_back(BasicBlock::Create(Context, "alt_try_" + std::to_string(i), S.MatchF));
+    }
+    // First branch from `from` on that can start with each byte in `bytes`
+    auto nextCandidates = [&](size_t from, const std::bitset<256> &bytes) {
+        std::vector<BasicBlock*> targets(256, nullptr);
+        for (int b = 0; b < 256; ++b) {
+            if (!bytes[b]) continue;
+            for (size_t j = from; j < n; ++j) {
+                if (first[j][b]) { targets[b] = tryBlocks[j]; break; }
+            }
+        }
+        return targets;
+    };
+
+    Value* idx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+    Value* strLen = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
+    BasicBlock* loadBlock = BasicBlock::Create(Context, "alt_dispatch", S.MatchF);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(idx, strLen), loadBlock, alt.GetFailBlock());
+    Builder.SetInsertPoint(loadBlock);
+    Value* ch = Builder.CreateLoad(Builder.getInt8Ty(), Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, idx));
+    std::bitset<256> all;
+    all.set();
+    emitByteSwitch(S, ch, nextCandidates(0, all), all, alt.GetFailBlock());
+
+    for (size_t i = 0; i < n; ++i) {
+        Builder.SetInsertPoint(tryBlocks[i]);
+        std::vector<BasicBlock*> retry = nextCandidates(i + 1, first[i]);
+        bool canRetry = std::any_of(retry.begin(), retry.end(), [](BasicBlock* b) { return b != nullptr; });
+        BasicBlock* restoreBlock = BasicBlock::Create(Context, "alt_restore_" + std::to_string(i), S.MatchF);
+        branches[i]->SetSuccessBlock(alt.GetSuccessBlock());
+        branches[i]->SetFailBlock(restoreBlock);
+        branches[i]->CodeGen(S);
+        Builder.SetInsertPoint(restoreBlock);
+        if (canRetry) emitBacktrackStep(S);
+        Builder.CreateStore(idx, S.Index);
+        if (canRetry) {
+            emitByteSwitch(S, ch, retry, first[i], alt.GetFailBlock());
+        } else {
+            Builder.CreateBr(alt.GetFailBlock());
+        }
+    }
+}
+
 // Alternative::CodeGen - 选择操作 (|)
-Value* Alternative::CodeGen() {
+Value* Alternative::CodeGen(CodeGenSession &S) {
     if (BodyVec.empty()) {
         Builder.CreateBr(GetFailBlock());
         return nullptr;
@@ -1180,14 +2041,27 @@ Value* Alternative::CodeGen() {
     if (BodyVec.size() == 1) {
         BodyVec[0]->SetSuccessBlock(GetSuccessBlock());
         BodyVec[0]->SetFailBlock(GetFailBlock());
-        BodyVec[0]->CodeGen();
+        BodyVec[0]->CodeGen(S);
+        return nullptr;
+    }
+
+    // 首字节分派: 没有分支能匹配空串, 且首字节能排除一部分分支时
+    std::vector<std::bitset<256>> first(BodyVec.size());
+    bool nullable = false;
+    for (size_t i = 0; i < BodyVec.size(); ++i) {
+        nullable |= firstByteSet(*BodyVec[i], first[i]);
+    }
+    bool selective = false;
+    for (const auto& f : first) selective |= !f.all();
+    if (!nullable && selective) {
+        emitAlternativeDispatch(S, *this, first);
         return nullptr;
     }
     
     // 创建每个选项的尝试块和失败后尝试下一个的块
     std::vector<BasicBlock*> tryBlocks;
     for (size_t i = 0; i < BodyVec.size(); ++i) {
-        tryBlocks.push_back(BasicBlock::Create(Context, "alt_try_" + std::to_string(i), MatchF));
+        tryBlocks.push_back(BasicBlock::Create(Context, "alt_try_" + std::to_string(i), S.MatchF));
     }
     
     // 跳转到第一个选项
@@ -1198,12 +2072,12 @@ Value* Alternative::CodeGen() {
         Builder.SetInsertPoint(tryBlocks[i]);
         
         // 保存当前索引以便回溯
-        Value* savedIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
+        Value* savedIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
         
         // 创建回溯块
         BasicBlock* restoreBlock = nullptr;
         if (i + 1 < BodyVec.size()) {
-            restoreBlock = BasicBlock::Create(Context, "alt_restore_" + std::to_string(i), MatchF);
+            restoreBlock = BasicBlock::Create(Context, "alt_restore_" + std::to_string(i), S.MatchF);
         }
         
         // 设置成功块和失败块
@@ -1214,13 +2088,14 @@ Value* Alternative::CodeGen() {
             // 最后一个选项失败就是整体失败
             BodyVec[i]->SetFailBlock(GetFailBlock());
         }
-        BodyVec[i]->CodeGen();
+        BodyVec[i]->CodeGen(S);
         
         // 如果不是最后一个选项，生成回溯块
         if (restoreBlock) {
             Builder.SetInsertPoint(restoreBlock);
+            emitBacktrackStep(S);
             // 恢复索引
-            Builder.CreateStore(savedIdx, Index);
+            Builder.CreateStore(savedIdx, S.Index);
             // 尝试下一个选项
             Builder.CreateBr(tryBlocks[i + 1]);
         }
@@ -1229,13 +2104,140 @@ Value* Alternative::CodeGen() {
     return nullptr;
 }
 
-Value* Repeat::CodeGen() {
-    auto intTy = Builder.getInt32Ty();
+// regjit_count_char as a callee: runtimeHelpers().countChar, through the
+// symbol defineRuntimeSymbols() gives it, like the BMH search.
+static FunctionCallee emitCountCharCallee(CodeGenSession &S) {
+    Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
+    return S.M->getOrInsertFunction("regjit_rt_count_char",
+        FunctionType::get(Builder.getInt64Ty(), {i8ptrTy, Builder.getInt64Ty(), Builder.getInt8Ty()}, false));
+}
+
+// Classes whose bytes (or whose complement's bytes) form at most this many
+// runs get the vectorized span scan; \w is four runs, \s two.
+static constexpr size_t kClassSpanMaxRuns = 8;
+
+// === FAST PATH: greedy class repeat ([a-z]+, \d*, \w{2,8}, [^,]+) ===
+// Counts the run of class bytes 16 at a time with vector range compares
+// (lowered to SSE2/AVX2/NEON for the host), finds the first miss with a
+// bitcast-to-i16 movemask and cttz, and finishes the tail byte by byte.
+// Like the regjit_count_char path it consumes min(run, max) bytes without
+// giving any back. Returns false when `body` is not a suitable class.
+static bool emitClassSpanRepeat(CodeGenSession &S, const Root &body, int minCount, int maxCount,
+                                BasicBlock* success, BasicBlock* fail) {
+    auto* cc = dynamic_cast<const CharClass*>(&body);
+    if (!cc) return false;
+    // Runs [lo, hi] of member bytes, and of non-member bytes
+    std::vector<std::pair<int, int>> runs[2];
+    for (int c = 0; c < 256; ++c) {
+        auto& r = runs[cc->matchesByte(static_cast<unsigned char>(c)) ? 0 : 1];
+        if (!r.empty() && r.back().second == c - 1) r.back().second = c;
+        else r.emplace_back(c, c);
+    }
+    bool invert = runs[1].size() < runs[0].size();
+    const auto& spans = runs[invert ? 1 : 0];
+    if (spans.size() > kClassSpanMaxRuns) return false;
+    RJDBG(std::cerr << "Using vectorized class span: " << spans.size() << " runs"
+                    << (invert ? " (inverted)" : "") << " {" << minCount << "," << maxCount << "}\n");
+
+    // i1 (or <16 x i1>) membership of the byte(s) in `x`
+    auto inClass = [&](Value* x) -> Value* {
+        Type* ty = x->getType();
+        Value* in = nullptr;
+        for (const auto& [lo, hi] : spans) {
+            Value* r = lo == hi
+                ? Builder.CreateICmpEQ(x, ConstantInt::get(ty, lo))
+                : Builder.CreateICmpULE(Builder.CreateSub(x, ConstantInt::get(ty, lo)),
+                                        ConstantInt::get(ty, hi - lo));
+            in = in ? Builder.CreateOr(in, r) : r;
+        }
+        if (!in) in = ConstantInt::getFalse(CmpInst::makeCmpResultType(ty));
+        return invert ? Builder.CreateNot(in) : in;
+    };
+
+    auto intTy = Builder.getInt64Ty();
+    auto vecTy = FixedVectorType::get(Builder.getInt8Ty(), 16);
+    Value* start = Builder.CreateLoad(intTy, S.Index);
+    Value* limit = Builder.CreateSub(Builder.CreateLoad(intTy, S.StrLenAlloca), start);
+    if (maxCount >= 0) {
+        Value* maxVal = ConstantInt::get(intTy, maxCount);
+        limit = Builder.CreateSelect(Builder.CreateICmpSGT(limit, maxVal), maxVal, limit);
+    }
+    Value* base = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {start});
+    Value* count = createEntryAlloca(S, intTy, "span_count");
+    Builder.CreateStore(ConstantInt::get(intTy, 0), count);
+
+    BasicBlock* firstLoad = BasicBlock::Create(Context, "span_first_load", S.MatchF);
+    BasicBlock* firstHit = BasicBlock::Create(Context, "span_first_hit", S.MatchF);
+    BasicBlock* vecCheck = BasicBlock::Create(Context, "span_vec_check", S.MatchF);
+    BasicBlock* vecBody = BasicBlock::Create(Context, "span_vec_body", S.MatchF);
+    BasicBlock* vecMiss = BasicBlock::Create(Context, "span_vec_miss", S.MatchF);
+    BasicBlock* tailCheck = BasicBlock::Create(Context, "span_tail_check", S.MatchF);
+    BasicBlock* tailBody = BasicBlock::Create(Context, "span_tail_body", S.MatchF);
+    BasicBlock* done = BasicBlock::Create(Context, "span_done", S.MatchF);
+
+    // Most search positions fail on the first byte: test it alone before
+    // setting up the vector loop
+    Builder.CreateCondBr(Builder.CreateICmpSGT(limit, ConstantInt::get(intTy, 0)), firstLoad, done);
+    Builder.SetInsertPoint(firstLoad);
+    Value* first = Builder.CreateLoad(Builder.getInt8Ty(), base);
+    Builder.CreateCondBr(inClass(first), firstHit, done);
+    Builder.SetInsertPoint(firstHit);
+    Builder.CreateStore(ConstantInt::get(intTy, 1), count);
+    Builder.CreateBr(vecCheck);
+
+    // 16 bytes at a time while they are all in bounds
+    Builder.SetInsertPoint(vecCheck);
+    Value* n = Builder.CreateLoad(intTy, count);
+    Value* n16 = Builder.CreateAdd(n, ConstantInt::get(intTy, 16));
+    Builder.CreateCondBr(Builder.CreateICmpSLE(n16, limit), vecBody, tailCheck);
+
+    Builder.SetInsertPoint(vecBody);
+    Value* vptr = Builder.CreateBitCast(Builder.CreateGEP(Builder.getInt8Ty(), base, {n}),
+                                        PointerType::get(vecTy, 0));
+    Value* v = Builder.CreateAlignedLoad(vecTy, vptr, MaybeAlign(1));
+    Value* miss = Builder.CreateBitCast(Builder.CreateNot(inClass(v)), Builder.getInt16Ty());
+    Builder.CreateStore(n16, count);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(miss, Builder.getInt16(0)), vecCheck, vecMiss);
+
+    // First byte outside the class within this block
+    Builder.SetInsertPoint(vecMiss);
+    Value* firstMiss = Builder.CreateBinaryIntrinsic(Intrinsic::cttz, miss, Builder.getTrue());
+    Builder.CreateStore(Builder.CreateAdd(n, Builder.CreateZExt(firstMiss, intTy)), count);
+    Builder.CreateBr(done);
+
+    // Fewer than 16 bytes left
+    Builder.SetInsertPoint(tailCheck);
+    Value* m = Builder.CreateLoad(intTy, count);
+    BasicBlock* tailLoad = BasicBlock::Create(Context, "span_tail_load", S.MatchF);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(m, limit), tailLoad, done);
+    Builder.SetInsertPoint(tailLoad);
+    Value* ch = Builder.CreateLoad(Builder.getInt8Ty(), Builder.CreateGEP(Builder.getInt8Ty(), base, {m}));
+    Builder.CreateCondBr(inClass(ch), tailBody, done);
+    Builder.SetInsertPoint(tailBody);
+    Builder.CreateStore(Builder.CreateAdd(m, ConstantInt::get(intTy, 1)), count);
+    Builder.CreateBr(tailCheck);
+
+    Builder.SetInsertPoint(done);
+    Value* run = Builder.CreateLoad(intTy, count);
+    BasicBlock* enough = BasicBlock::Create(Context, "span_enough", S.MatchF);
+    if (minCount > 0) {
+        Builder.CreateCondBr(Builder.CreateICmpSGE(run, ConstantInt::get(intTy, minCount)), enough, fail);
+    } else {
+        Builder.CreateBr(enough);
+    }
+    Builder.SetInsertPoint(enough);
+    Builder.CreateStore(Builder.CreateAdd(start, run), S.Index);
+    Builder.CreateBr(success);
+    return true;
+}
+
+Value* Repeat::CodeGen(CodeGenSession &S) {
+    auto intTy = Builder.getInt64Ty();
     // Star: minCount=0, maxCount=-1
     // Plus: minCount=1, maxCount=-1
     bool isStar = (minCount == 0 && maxCount == -1);
     bool isPlus = (minCount == 1 && maxCount == -1);
-    Value* savedIdx = Builder.CreateAlloca(intTy);
+    Value* savedIdx = createEntryAlloca(S, intTy, "repeat_saved_idx");
     
     if (isStar || isPlus) {
         // For zero-width bodies (anchors, lookarounds), we need special handling
@@ -1247,15 +2249,15 @@ Value* Repeat::CodeGen() {
             // Must match exactly once, then succeed
             Body->SetSuccessBlock(GetSuccessBlock());
             Body->SetFailBlock(GetFailBlock());
-            Body->CodeGen();
+            Body->CodeGen(S);
             return nullptr;
         }
         
         // Special case: zero-width Star - try to match once, always succeed
         if (isStar && bodyIsZeroWidth) {
             // Create blocks for the attempt
-            BasicBlock* tryBlock = BasicBlock::Create(Context, "repeat_zero_try", MatchF);
-            BasicBlock* afterBlock = BasicBlock::Create(Context, "repeat_zero_after", MatchF);
+            BasicBlock* tryBlock = BasicBlock::Create(Context, "repeat_zero_try", S.MatchF);
+            BasicBlock* afterBlock = BasicBlock::Create(Context, "repeat_zero_after", S.MatchF);
             
             Builder.CreateBr(tryBlock);
             Builder.SetInsertPoint(tryBlock);
@@ -1263,7 +2265,7 @@ Value* Repeat::CodeGen() {
             // Try to match once
             Body->SetSuccessBlock(afterBlock);
             Body->SetFailBlock(afterBlock);  // Fail also goes to after (zero times is OK)
-            Body->CodeGen();
+            Body->CodeGen(S);
             
             // After trying, go to success
             Builder.SetInsertPoint(afterBlock);
@@ -1278,61 +2280,61 @@ Value* Repeat::CodeGen() {
             // Fast path for greedy single-char quantifiers
             RJDBG(std::cerr << "Using fast path for single-char repeat: " << (char)singleChar << (isPlus ? "+" : "*") << "\n");
             
-            Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
-            Type* sizeTy = Builder.getInt64Ty();
-            
-            // Declare regjit_count_char: size_t regjit_count_char(const char* str, size_t len, char target)
-            FunctionCallee countFn = ThisModule->getOrInsertFunction("regjit_count_char",
-                FunctionType::get(sizeTy, {i8ptrTy, sizeTy, Builder.getInt8Ty()}, false));
+            // size_t regjit_count_char(const char* str, size_t len, char target),
+            // the variant chosen for this CPU
+            FunctionCallee countFn = emitCountCharCallee(S);
             
             // Get current position and remaining length
-            Value* curIdx = Builder.CreateLoad(intTy, Index);
-            Value* strLen = Builder.CreateLoad(intTy, StrLenAlloca);
+            Value* curIdx = Builder.CreateLoad(intTy, S.Index);
+            Value* strLen = Builder.CreateLoad(intTy, S.StrLenAlloca);
             Value* remaining = Builder.CreateSub(strLen, curIdx);
-            Value* remainingSize = Builder.CreateZExt(remaining, sizeTy);
             
             // Get pointer to current position
-            Value* curPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, {curIdx});
+            Value* curPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {curIdx});
             
             // Call regjit_count_char(curPtr, remaining, targetChar)
             Value* targetChar = ConstantInt::get(Builder.getInt8Ty(), singleChar);
-            Value* count = Builder.CreateCall(countFn, {curPtr, remainingSize, targetChar});
-            Value* count32 = Builder.CreateTrunc(count, intTy);
+            Value* count = Builder.CreateCall(countFn, {curPtr, remaining, targetChar});
             
             if (isPlus) {
                 // Plus: must match at least one
-                Value* isZero = Builder.CreateICmpEQ(count32, ConstantInt::get(intTy, 0));
-                BasicBlock* successBlock = BasicBlock::Create(Context, "repeat_fast_success", MatchF);
+                Value* isZero = Builder.CreateICmpEQ(count, ConstantInt::get(intTy, 0));
+                BasicBlock* successBlock = BasicBlock::Create(Context, "repeat_fast_success", S.MatchF);
                 Builder.CreateCondBr(isZero, GetFailBlock(), successBlock);
                 
                 Builder.SetInsertPoint(successBlock);
-                Value* newIdx = Builder.CreateAdd(curIdx, count32);
-                Builder.CreateStore(newIdx, Index);
+                Value* newIdx = Builder.CreateAdd(curIdx, count);
+                Builder.CreateStore(newIdx, S.Index);
                 Builder.CreateBr(GetSuccessBlock());
             } else {
                 // Star: zero or more is always ok
-                Value* newIdx = Builder.CreateAdd(curIdx, count32);
-                Builder.CreateStore(newIdx, Index);
+                Value* newIdx = Builder.CreateAdd(curIdx, count);
+                Builder.CreateStore(newIdx, S.Index);
                 Builder.CreateBr(GetSuccessBlock());
             }
             return nullptr;
         }
+
+        if (!nonGreedy && emitClassSpanRepeat(S, *Body, minCount, maxCount, GetSuccessBlock(), GetFailBlock())) {
+            return nullptr;
+        }
         
         // Regular (non-zero-width) body handling
-        BasicBlock* checkBlock = BasicBlock::Create(Context, "repeat_check", MatchF);
-        BasicBlock* bodyBlock = BasicBlock::Create(Context, "repeat_body", MatchF);
-        BasicBlock* exitBlock = BasicBlock::Create(Context, "repeat_exit", MatchF);
+        BasicBlock* checkBlock = BasicBlock::Create(Context, "repeat_check", S.MatchF);
+        BasicBlock* bodyBlock = BasicBlock::Create(Context, "repeat_body", S.MatchF);
+        BasicBlock* exitBlock = BasicBlock::Create(Context, "repeat_exit", S.MatchF);
 
         if (!isStar) { // Plus: must match at least once
-            Value* curIdx = Builder.CreateLoad(intTy, Index);
+            Value* curIdx = Builder.CreateLoad(intTy, S.Index);
             Builder.CreateStore(curIdx, savedIdx);
-            BasicBlock* firstFailRestore = BasicBlock::Create(Context, "repeat_first_fail_restore", MatchF);
+            BasicBlock* firstFailRestore = BasicBlock::Create(Context, "repeat_first_fail_restore", S.MatchF);
             Body->SetSuccessBlock(checkBlock);
             Body->SetFailBlock(firstFailRestore);
-            Body->CodeGen();
+            Body->CodeGen(S);
             Builder.SetInsertPoint(firstFailRestore);
+            emitBacktrackStep(S);
             Value* restore = Builder.CreateLoad(intTy, savedIdx);
-            Builder.CreateStore(restore, Index);
+            Builder.CreateStore(restore, S.Index);
             Builder.CreateBr(GetFailBlock());
         } else { // Star: can match zero times
             Builder.CreateBr(checkBlock);
@@ -1340,11 +2342,11 @@ Value* Repeat::CodeGen() {
 
         Builder.SetInsertPoint(checkBlock);
 
-        BasicBlock* failRestore = BasicBlock::Create(Context, "repeat_fail_restore", MatchF);
+        BasicBlock* failRestore = BasicBlock::Create(Context, "repeat_fail_restore", S.MatchF);
         if (nonGreedy) {
             // Non-greedy: first try to exit, then try to match
             // FIX: Set success/fail blocks for Body even if we jump to success first,
-            // because Body->CodeGen() is called below and expects them.
+            // because Body->CodeGen(S) is called below and expects them.
             Body->SetSuccessBlock(checkBlock);
             Body->SetFailBlock(GetFailBlock()); // If match fails in non-greedy, it's a hard fail for this branch
             Builder.CreateCondBr(Builder.getTrue(), GetSuccessBlock(), bodyBlock);
@@ -1356,17 +2358,18 @@ Value* Repeat::CodeGen() {
         }
 
         Builder.SetInsertPoint(bodyBlock);
-        Value* curIdx = Builder.CreateLoad(intTy, Index);
+        Value* curIdx = Builder.CreateLoad(intTy, S.Index);
         Builder.CreateStore(curIdx, savedIdx);
-        Body->CodeGen();
+        Body->CodeGen(S);
         if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
           if (nonGreedy) Builder.CreateBr(checkBlock);
           else Builder.CreateBr(failRestore);
         }
 
         Builder.SetInsertPoint(failRestore);
+        emitBacktrackStep(S);
         Value* restore = Builder.CreateLoad(intTy, savedIdx);
-        Builder.CreateStore(restore, Index);
+        Builder.CreateStore(restore, S.Index);
         Builder.CreateBr(exitBlock);
 
         Builder.SetInsertPoint(exitBlock);
@@ -1384,32 +2387,26 @@ Value* Repeat::CodeGen() {
     if (singleChar >= 0 && !nonGreedy && (isExactRepeat || isRangeRepeat || isMinOnlyRepeat)) {
         RJDBG(std::cerr << "Using fast path for char repeat: " << (char)singleChar << "{" << minCount << "," << maxCount << "}\n");
         
-        Type* i8ptrTy = PointerType::get(Builder.getInt8Ty(), 0);
-        Type* sizeTy = Builder.getInt64Ty();
-        
-        // Declare regjit_count_char
-        FunctionCallee countFn = ThisModule->getOrInsertFunction("regjit_count_char",
-            FunctionType::get(sizeTy, {i8ptrTy, sizeTy, Builder.getInt8Ty()}, false));
+        // regjit_count_char, the variant chosen for this CPU
+        FunctionCallee countFn = emitCountCharCallee(S);
         
         // Get current position and remaining length
-        Value* curIdx = Builder.CreateLoad(intTy, Index);
-        Value* strLen = Builder.CreateLoad(intTy, StrLenAlloca);
+        Value* curIdx = Builder.CreateLoad(intTy, S.Index);
+        Value* strLen = Builder.CreateLoad(intTy, S.StrLenAlloca);
         Value* remaining = Builder.CreateSub(strLen, curIdx);
-        Value* remainingSize = Builder.CreateZExt(remaining, sizeTy);
         
         // Get pointer to current position
-        Value* curPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, {curIdx});
+        Value* curPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, {curIdx});
         
         // Call regjit_count_char
         Value* targetChar = ConstantInt::get(Builder.getInt8Ty(), singleChar);
-        Value* count = Builder.CreateCall(countFn, {curPtr, remainingSize, targetChar});
-        Value* count32 = Builder.CreateTrunc(count, intTy);
+        Value* count = Builder.CreateCall(countFn, {curPtr, remaining, targetChar});
         
         // Check minimum requirement
         Value* minVal = ConstantInt::get(intTy, minCount);
-        Value* hasEnough = Builder.CreateICmpSGE(count32, minVal);
+        Value* hasEnough = Builder.CreateICmpSGE(count, minVal);
         
-        BasicBlock* successBlock = BasicBlock::Create(Context, "repeat_range_success", MatchF);
+        BasicBlock* successBlock = BasicBlock::Create(Context, "repeat_range_success", S.MatchF);
         Builder.CreateCondBr(hasEnough, successBlock, GetFailBlock());
         
         Builder.SetInsertPoint(successBlock);
@@ -1418,48 +2415,53 @@ Value* Repeat::CodeGen() {
         Value* consumed;
         if (maxCount == -1) {
             // a{n,} - consume all matched
-            consumed = count32;
+            consumed = count;
         } else {
             // a{n,m} or a{n} - consume min(count, max)
             Value* maxVal = ConstantInt::get(intTy, maxCount);
-            Value* useMax = Builder.CreateICmpSGT(count32, maxVal);
-            consumed = Builder.CreateSelect(useMax, maxVal, count32);
+            Value* useMax = Builder.CreateICmpSGT(count, maxVal);
+            consumed = Builder.CreateSelect(useMax, maxVal, count);
         }
         
         Value* newIdx = Builder.CreateAdd(curIdx, consumed);
-        Builder.CreateStore(newIdx, Index);
+        Builder.CreateStore(newIdx, S.Index);
         Builder.CreateBr(GetSuccessBlock());
         return nullptr;
     }
+
+    // Greedy class repeats with bounds ([0-9]{3}, \w{2,8}, [a-f]{4,})
+    if (!nonGreedy && emitClassSpanRepeat(S, *Body, minCount, maxCount, GetSuccessBlock(), GetFailBlock())) {
+        return nullptr;
+    }
     
     // 允许范围（如 {2,5} 或 {3,} ）
     int minR = minCount < 0 ? 0 : minCount;
     int maxR = maxCount;
     // max = -1 视为无穷(贪婪型)
-    Value* counter = Builder.CreateAlloca(intTy);
-    Builder.CreateStore(ConstantInt::get(Context, APInt(32, 0)), counter);
-    BasicBlock* checkMin = BasicBlock::Create(Context, "repeat_min_chk", MatchF);
-    BasicBlock* incMin = BasicBlock::Create(Context, "repeat_min", MatchF);
-    BasicBlock* checkMax = BasicBlock::Create(Context, "repeat_max_chk", MatchF);
-    BasicBlock* incMax = BasicBlock::Create(Context, "repeat_max", MatchF);
-    BasicBlock* exit = BasicBlock::Create(Context, "repeat_exit_rng", MatchF);
+    Value* counter = createEntryAlloca(S, intTy, "repeat_counter");
+    Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), counter);
+    BasicBlock* checkMin = BasicBlock::Create(Context, "repeat_min_chk", S.MatchF);
+    BasicBlock* incMin = BasicBlock::Create(Context, "repeat_min", S.MatchF);
+    BasicBlock* checkMax = BasicBlock::Create(Context, "repeat_max_chk", S.MatchF);
+    BasicBlock* incMax = BasicBlock::Create(Context, "repeat_max", S.MatchF);
+    BasicBlock* exit = BasicBlock::Create(Context, "repeat_exit_rng", S.MatchF);
     // 首先循环min次
     Builder.CreateBr(checkMin);
     // check min loop
     Builder.SetInsertPoint(checkMin);
     Value* val = Builder.CreateLoad(intTy, counter);
-    Value* mincheck = Builder.CreateICmpSLT(val, ConstantInt::get(Context, APInt(32, minR)));
+    Value* mincheck = Builder.CreateICmpSLT(val, ConstantInt::get(Context, APInt(64, minR)));
     Builder.CreateCondBr(mincheck, incMin, checkMax);
     // min loop体: incMin is the block where we attempt one repetition.
     // Create a dedicated post-success increment block so we always update
     // the counter when the Body succeeds (Body may emit a terminator that
     // jumps elsewhere, so we cannot rely on emitting increments after
     // Body->CodeGen in the same block).
-    BasicBlock* incMinSuccess = BasicBlock::Create(Context, "repeat_min_inc_success", MatchF);
+    BasicBlock* incMinSuccess = BasicBlock::Create(Context, "repeat_min_inc_success", S.MatchF);
     Builder.SetInsertPoint(incMin);
     Body->SetSuccessBlock(incMinSuccess);
     Body->SetFailBlock(GetFailBlock());
-    Body->CodeGen();
+    Body->CodeGen(S);
     // If Body fell through without emitting a terminator, ensure we branch
     // to the success-increment block so behavior is consistent.
     if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
@@ -1467,22 +2469,22 @@ Value* Repeat::CodeGen() {
     }
     // Emit the increment and loop-back in the dedicated inc-success block
     Builder.SetInsertPoint(incMinSuccess);
-    Value* stepmin = Builder.CreateAdd(val, ConstantInt::get(Context, APInt(32,1)));
+    Value* stepmin = Builder.CreateAdd(val, ConstantInt::get(Context, APInt(64,1)));
     Builder.CreateStore(stepmin, counter);
-    // Index advancement is done by the consuming node; do not modify Index here.
+    // S.Index advancement is done by the consuming node; do not modify S.Index here.
     Builder.CreateBr(checkMin);
     // min循环完后可进入max部分
     Builder.SetInsertPoint(checkMax);
     Value* val2 = Builder.CreateLoad(intTy, counter);
-    Value* finished = maxR == -1 ? Builder.getFalse() : Builder.CreateICmpSGE(val2, ConstantInt::get(Context, APInt(32, maxR)));
+    Value* finished = maxR == -1 ? Builder.getFalse() : Builder.CreateICmpSGE(val2, ConstantInt::get(Context, APInt(64, maxR)));
     Builder.CreateCondBr(finished, exit, incMax);
     // max阶段：贪婪与非贪婪切分分支
     Builder.SetInsertPoint(incMax);
     // Create an explicit attempt block so we don't emit instructions after
     // a terminating branch in the current block which would produce
     // invalid IR and crash optimizer passes.
-    BasicBlock* attemptBlock = BasicBlock::Create(Context, "repeat_attempt", MatchF);
-    BasicBlock* attemptSuccessInc = BasicBlock::Create(Context, "repeat_attempt_inc", MatchF);
+    BasicBlock* attemptBlock = BasicBlock::Create(Context, "repeat_attempt", S.MatchF);
+    BasicBlock* attemptSuccessInc = BasicBlock::Create(Context, "repeat_attempt_inc", S.MatchF);
     // Branch to attemptBlock (or to success immediately for non-greedy path)
     if (nonGreedy) {
         // Non-greedy: first try to succeed without consuming; if that fails,
@@ -1492,16 +2494,16 @@ Value* Repeat::CodeGen() {
         Builder.SetInsertPoint(attemptBlock);
         Body->SetSuccessBlock(attemptSuccessInc);
         Body->SetFailBlock(exit);
-        Body->CodeGen();
+        Body->CodeGen(S);
         if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
             Builder.CreateBr(attemptSuccessInc);
         }
         // attemptSuccessInc: increment and go back to checkMax
         Builder.SetInsertPoint(attemptSuccessInc);
         Value* afterVal = Builder.CreateLoad(intTy, counter);
-        Value* stepAfter = Builder.CreateAdd(afterVal, ConstantInt::get(Context, APInt(32,1)));
+        Value* stepAfter = Builder.CreateAdd(afterVal, ConstantInt::get(Context, APInt(64,1)));
         Builder.CreateStore(stepAfter, counter);
-        // Index advancement is done by the consuming node; do not modify Index here.
+        // S.Index advancement is done by the consuming node; do not modify S.Index here.
         Builder.CreateBr(checkMax);
     } else {
         // Greedy: attempt to consume first, then on fail try overall success
@@ -1509,16 +2511,16 @@ Value* Repeat::CodeGen() {
         Builder.SetInsertPoint(attemptBlock);
         Body->SetSuccessBlock(attemptSuccessInc);
         Body->SetFailBlock(exit);
-        Body->CodeGen();
+        Body->CodeGen(S);
         if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
             Builder.CreateBr(GetSuccessBlock());
         }
         // After attempting to consume, increment and loop back
         Builder.SetInsertPoint(attemptSuccessInc);
         Value* afterVal2 = Builder.CreateLoad(intTy, counter);
-        Value* stepAfter2 = Builder.CreateAdd(afterVal2, ConstantInt::get(Context, APInt(32,1)));
+        Value* stepAfter2 = Builder.CreateAdd(afterVal2, ConstantInt::get(Context, APInt(64,1)));
         Builder.CreateStore(stepAfter2, counter);
-        // Index advancement is done by the consuming node; do not modify Index here.
+        // S.Index advancement is done by the consuming node; do not modify S.Index here.
         Builder.CreateBr(checkMax);
     }
     // 量词退出
@@ -1963,6 +2965,7 @@ class RegexParser {
         // The first branch may be empty when the expression starts
         // with '|' (e.g. "|a") or the group is "(|)".
         std::unique_ptr<Root> left;
+        bool flatAlt = false; // left is the Alternative built by this call
         if (at_empty_branch()) {
             left = std::make_unique<Concat>();  // empty branch
         } else {
@@ -1976,10 +2979,15 @@ class RegexParser {
             } else {
                 right = parse_concat();
             }
-            auto alt = std::make_unique<Alternative>();
-            alt->Append(std::move(left));
-            alt->Append(std::move(right));
-            left = std::move(alt);
+            // a|b|c is one Alternative with three branches, so even a
+            // list of thousands of words stays one level deep
+            if (!flatAlt) {
+                auto alt = std::make_unique<Alternative>();
+                alt->Append(std::move(left));
+                left = std::move(alt);
+                flatAlt = true;
+            }
+            static_cast<Alternative*>(left.get())->Append(std::move(right));
         }
         return left;
     }
@@ -2001,26 +3009,223 @@ public:
     }
 };
 
+std::unique_ptr<Root> parseRegex(const std::string& pattern) {
+    RegexLexer lexer(pattern);
+    RegexParser parser(lexer);
+    return parser.parse();
+}
+
+// --- Alternation optimizer ---
+// The parser builds a|b|c as one Alternative(a, b, c) and abc as
+// Concat(Concat(a, b), c), so a list of N literals is tried one branch after
+// another, re-reading the same bytes. optimizeAlternations() flattens the
+// Concat chains, and alternations nested through a group, a|(b|c), into
+// their parent, then rewrites every alternation:
+//   - branches that start with the same literal byte are factored into a
+//     trie: GET|POST|PUT|PATCH -> GET|P(OST|UT|ATCH);
+//   - runs of adjacent branches that consume exactly one byte become one
+//     CharClass: a|b|[0-9] -> [ab0-9].
+// Alternative::CodeGen then dispatches on the first byte. The rewrite keeps
+// leftmost-first semantics: a branch only moves up past branches that cannot
+// match where it can (they start with other bytes and cannot match empty),
+// and a shared literal prefix matches the same way in every branch.
+namespace {
+
+using NodeList = std::vector<std::unique_ptr<Root>>;
+
+std::unique_ptr<Root> optimizeNode(std::unique_ptr<Root> node);
+
+void flattenConcat(std::unique_ptr<Root> node, NodeList &out) {
+    if (auto* c = dynamic_cast<Concat*>(node.get())) {
+        for (auto& child : c->BodyVec) flattenConcat(std::move(child), out);
+        return;
+    }
+    out.push_back(std::move(node));
+}
+
+void flattenAlternative(std::unique_ptr<Root> node, NodeList &out) {
+    if (auto* a = dynamic_cast<Alternative*>(node.get())) {
+        for (auto& child : a->BodyVec) flattenAlternative(std::move(child), out);
+        return;
+    }
+    out.push_back(std::move(node));
+}
+
+std::unique_ptr<Root> makeConcat(NodeList items) {
+    if (items.size() == 1) return std::move(items[0]);
+    auto c = std::make_unique<Concat>();
+    for (auto& item : items) c->Append(std::move(item));
+    return c;
+}
+
+int leadingLiteral(const NodeList &items) {
+    if (items.empty()) return -1;
+    if (auto* m = dynamic_cast<const Match*>(items[0].get())) return static_cast<unsigned char>(m->getChar());
+    return -1;
+}
+
+// Branches that consume exactly one byte and can be merged into a CharClass.
+// Bytes >= 0x80 are left alone: CharClass stores its ranges as plain char.
+bool isSingleByte(const Root &node) {
+    if (auto* m = dynamic_cast<const Match*>(&node)) return static_cast<unsigned char>(m->getChar()) < 0x80;
+    if (auto* cc = dynamic_cast<const CharClass*>(&node)) return !cc->isNegated() && !cc->isDotClass();
+    return false;
+}
+
+// Union of two single-byte branches (both non-negated, so their ranges can
+// simply be concatenated).
+std::unique_ptr<Root> mergeSingleBytes(std::unique_ptr<Root> a, const Root &b) {
+    auto cc = std::make_unique<CharClass>(false, false);
+    for (const Root* n : {static_cast<const Root*>(a.get()), &b}) {
+        if (auto* m = dynamic_cast<const Match*>(n)) {
+            cc->addChar(m->getChar());
+        } else {
+            for (const auto& r : static_cast<const CharClass*>(n)->getRanges()) cc->addRange(r.start, r.end, r.included);
+        }
+    }
+    return cc;
+}
+
+struct BranchGroup {
+    int lead;                   // shared leading literal, or -1
+    std::vector<NodeList> members;
+    std::bitset<256> first;     // bytes a member can start with
+    bool nullable;
+};
+
+// Build the alternation of `branches` (each a flattened, optimized Concat).
+std::unique_ptr<Root> buildAlternation(std::vector<NodeList> branches) {
+    std::vector<BranchGroup> groups;
+    for (auto& branch : branches) {
+        int lead = leadingLiteral(branch);
+        bool joined = false;
+        if (lead >= 0) {
+            // Join the last group with the same leading byte, unless a group
+            // after it could also match here and would lose its priority.
+            for (size_t g = groups.size(); g-- > 0;) {
+                if (groups[g].lead == lead) {
+                    groups[g].members.push_back(std::move(branch));
+                    joined = true;
+                    break;
+                }
+                if (groups[g].nullable || groups[g].first[lead]) break;
+            }
+        }
+        if (joined) continue;
+        BranchGroup group{lead, {}, {}, true};
+        for (const auto& item : branch) {
+            if (!firstByteSet(*item, group.first)) { group.nullable = false; break; }
+        }
+        group.members.push_back(std::move(branch));
+        groups.push_back(std::move(group));
+    }
+
+    NodeList out;
+    for (auto& group : groups) {
+        if (group.members.size() == 1) {
+            out.push_back(makeConcat(std::move(group.members[0])));
+            continue;
+        }
+        // Match the shared byte once, then the alternation of the rests
+        NodeList seq;
+        seq.push_back(std::move(group.members[0][0]));
+        std::vector<NodeList> rests;
+        for (auto& m : group.members) {
+            rests.emplace_back(std::make_move_iterator(m.begin() + 1), std::make_move_iterator(m.end()));
+        }
+        flattenConcat(buildAlternation(std::move(rests)), seq);
+        out.push_back(makeConcat(std::move(seq)));
+    }
+
+    NodeList merged;
+    for (auto& node : out) {
+        if (!merged.empty() && isSingleByte(*node) && isSingleByte(*merged.back())) {
+            merged.back() = mergeSingleBytes(std::move(merged.back()), *node);
+        } else {
+            merged.push_back(std::move(node));
+        }
+    }
+    if (merged.size() == 1) return std::move(merged[0]);
+    auto alt = std::make_unique<Alternative>();
+    for (auto& node : merged) alt->Append(std::move(node));
+    return alt;
+}
+
+std::unique_ptr<Root> optimizeNode(std::unique_ptr<Root> node) {
+    if (dynamic_cast<Alternative*>(node.get())) {
+        NodeList flat;
+        flattenAlternative(std::move(node), flat);
+        std::vector<NodeList> branches;
+        for (auto& branch : flat) {
+            NodeList items;
+            flattenConcat(optimizeNode(std::move(branch)), items);
+            branches.push_back(std::move(items));
+        }
+        return buildAlternation(std::move(branches));
+    }
+    if (dynamic_cast<Concat*>(node.get())) {
+        NodeList flat, items;
+        flattenConcat(std::move(node), flat);
+        for (auto& item : flat) flattenConcat(optimizeNode(std::move(item)), items);
+        return makeConcat(std::move(items));
+    }
+    if (auto* rep = dynamic_cast<Repeat*>(node.get())) {
+        rep->Body = optimizeNode(std::move(rep->Body));
+    } else if (auto* f = dynamic_cast<Func*>(node.get())) {
+        f->Body = optimizeNode(std::move(f->Body));
+    }
+    return node;
+}
+
+} // namespace
+
+std::unique_ptr<Root> optimizeAlternations(std::unique_ptr<Root> ast) {
+    return optimizeNode(std::move(ast));
+}
+
 // CharClass implementation
-Value* CharClass::CodeGen() {
+// Classes with at least this many ranges are tested against a bitmap
+// instead of a compare chain (\w has four).
+static constexpr size_t kCharClassBitmapMinRanges = 3;
+
+// Returns an i1 that is true when the byte `ch` (zero-extended to i32) is in
+// `cc`: one load from a 256-bit membership bitmap and a bit test. The bits
+// come from matchesByte(), so negation is already folded in.
+static Value* emitClassBitmapTest(CodeGenSession &S, const CharClass &cc, Value* ch) {
+    std::string bits(32, '\0');
+    for (int c = 0; c < 256; ++c) {
+        if (cc.matchesByte(static_cast<unsigned char>(c))) bits[c >> 3] |= static_cast<char>(1 << (c & 7));
+    }
+    Value*& bitmap = S.ClassBitmaps[bits];
+    if (!bitmap) bitmap = Builder.CreateGlobalStringPtr(bits, "charclass_bitmap");
+    Value* byteIdx = Builder.CreateLShr(ch, ConstantInt::get(Builder.getInt32Ty(), 3));
+    Value* byte = Builder.CreateLoad(Builder.getInt8Ty(),
+        Builder.CreateGEP(Builder.getInt8Ty(), bitmap, byteIdx));
+    Value* bitIdx = Builder.CreateTrunc(
+        Builder.CreateAnd(ch, ConstantInt::get(Builder.getInt32Ty(), 7)), Builder.getInt8Ty());
+    Value* bit = Builder.CreateAnd(Builder.CreateLShr(byte, bitIdx), Builder.getInt8(1));
+    return Builder.CreateICmpNE(bit, Builder.getInt8(0));
+}
+
+Value* CharClass::CodeGen(CodeGenSession &S) {
     // Load current index
-    Value* curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
+    Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
     
     // CRITICAL: Boundary check - must have at least one character remaining
     // Without this, negated classes like \D would match '\0' at string end
-    Value* strLen = Builder.CreateLoad(Builder.getInt32Ty(), StrLenAlloca);
+    Value* strLen = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
     Value* inBounds = Builder.CreateICmpSLT(curIdx, strLen);
     
-    BasicBlock* checkCharBlock = BasicBlock::Create(Context, "charclass_check", MatchF);
-    BasicBlock* matchBlock = BasicBlock::Create(Context, "charclass_match", MatchF);
-    BasicBlock* nomatchBlock = BasicBlock::Create(Context, "charclass_nomatch", MatchF);
+    BasicBlock* checkCharBlock = BasicBlock::Create(Context, "charclass_check", S.MatchF);
+    BasicBlock* matchBlock = BasicBlock::Create(Context, "charclass_match", S.MatchF);
+    BasicBlock* nomatchBlock = BasicBlock::Create(Context, "charclass_nomatch", S.MatchF);
     
     // If out of bounds, go directly to fail block
     Builder.CreateCondBr(inBounds, checkCharBlock, nomatchBlock);
     
     // Now we're in bounds, load and check the character
     Builder.SetInsertPoint(checkCharBlock);
-    Value* charPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, curIdx);
+    Value* charPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, curIdx);
     Value* currentChar = Builder.CreateLoad(Builder.getInt8Ty(), charPtr);
     currentChar = Builder.CreateIntCast(currentChar, Builder.getInt32Ty(), false);
     
@@ -2032,13 +3237,16 @@ Value* CharClass::CodeGen() {
         Value* isNewline = Builder.CreateICmpEQ(currentChar, 
             ConstantInt::get(Context, APInt(32, '\n')));
         finalMatch = Builder.CreateNot(isNewline);
+    } else if (ranges.size() >= kCharClassBitmapMinRanges) {
+        finalMatch = emitClassBitmapTest(S, *this, currentChar);
     } else {
-        // For regular character classes, check each range
+        // For regular character classes, check each range. Bounds are
+        // bytes: compare them unsigned like matchesByte().
         for (const auto& range : ranges) {
             Value* geStart = Builder.CreateICmpUGE(currentChar, 
-                ConstantInt::get(Context, APInt(32, range.start)));
+                ConstantInt::get(Context, APInt(32, static_cast<unsigned char>(range.start))));
             Value* leEnd = Builder.CreateICmpULE(currentChar, 
-                ConstantInt::get(Context, APInt(32, range.end)));
+                ConstantInt::get(Context, APInt(32, static_cast<unsigned char>(range.end))));
             Value* rangeMatch = Builder.CreateAnd(geStart, leEnd);
             
             if (!range.included) {
@@ -2061,17 +3269,17 @@ Value* CharClass::CodeGen() {
     Builder.CreateCondBr(finalMatch, matchBlock, nomatchBlock);
 
     Builder.SetInsertPoint(matchBlock);
-    // On match, increment Index (consuming node) then go to success
+    // On match, increment S.Index (consuming node) then go to success
     if (!dotClass) {
         // For normal char classes we consume one char
-        Value* curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-        Value* nextIdx = Builder.CreateAdd(curIdx, ConstantInt::get(Context, APInt(32, 1)));
-        Builder.CreateStore(nextIdx, Index);
+        Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+        Value* nextIdx = Builder.CreateAdd(curIdx, ConstantInt::get(Context, APInt(64, 1)));
+        Builder.CreateStore(nextIdx, S.Index);
     } else {
         // dotClass also consumes one character
-        Value* curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
-        Value* nextIdx = Builder.CreateAdd(curIdx, ConstantInt::get(Context, APInt(32, 1)));
-        Builder.CreateStore(nextIdx, Index);
+        Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
+        Value* nextIdx = Builder.CreateAdd(curIdx, ConstantInt::get(Context, APInt(64, 1)));
+        Builder.CreateStore(nextIdx, S.Index);
     }
     Builder.CreateBr(GetSuccessBlock());
     
@@ -2082,226 +3290,92 @@ Value* CharClass::CodeGen() {
 }
 
 // Anchor implementation
-Value* Anchor::CodeGen() {
-    Value* curIdx = Builder.CreateLoad(Builder.getInt32Ty(), Index);
+
+// Returns an i1 that is true when the byte `ch` (zero-extended to i32) is a
+// word character [a-zA-Z0-9_].
+static Value* emitIsWordChar(CodeGenSession &S, Value* ch) {
+    Value* isLower = Builder.CreateAnd(
+        Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'a'))),
+        Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'z')))
+    );
+    Value* isUpper = Builder.CreateAnd(
+        Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'A'))),
+        Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'Z')))
+    );
+    Value* isDigit = Builder.CreateAnd(
+        Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, '0'))),
+        Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, '9')))
+    );
+    Value* isUnderscore = Builder.CreateICmpEQ(ch, 
+        ConstantInt::get(Context, APInt(32, '_')));
+    
+    return Builder.CreateOr(Builder.CreateOr(Builder.CreateOr(isLower, isUpper), isDigit), isUnderscore);
+}
+
+// Returns an i1 that is true when `valid` holds and str[pos] is a word
+// character. The byte is only loaded when `valid` is true, so callers can
+// pass positions outside the input guarded by a bounds check.
+static Value* emitWordCharAt(CodeGenSession &S, Value* pos, Value* valid, const std::string& prefix) {
+    BasicBlock* fromBlock = Builder.GetInsertBlock();
+    BasicBlock* loadBlock = BasicBlock::Create(Context, prefix + "_load", S.MatchF);
+    BasicBlock* joinBlock = BasicBlock::Create(Context, prefix + "_join", S.MatchF);
+    Builder.CreateCondBr(valid, loadBlock, joinBlock);
+    
+    Builder.SetInsertPoint(loadBlock);
+    Value* charPtr = Builder.CreateGEP(Builder.getInt8Ty(), S.Arg0, pos);
+    Value* ch = Builder.CreateLoad(Builder.getInt8Ty(), charPtr);
+    ch = Builder.CreateIntCast(ch, Builder.getInt32Ty(), false);
+    Value* isWord = emitIsWordChar(S, ch);
+    BasicBlock* loadEnd = Builder.GetInsertBlock();
+    Builder.CreateBr(joinBlock);
+    
+    Builder.SetInsertPoint(joinBlock);
+    PHINode* result = Builder.CreatePHI(Builder.getInt1Ty(), 2);
+    result->addIncoming(Builder.getFalse(), fromBlock);
+    result->addIncoming(isWord, loadEnd);
+    return result;
+}
+
+Value* Anchor::CodeGen(CodeGenSession &S) {
+    Value* curIdx = Builder.CreateLoad(Builder.getInt64Ty(), S.Index);
     Value* match = nullptr;
     
     switch (anchorType) {
         case Start: {
             // ^ matches at the beginning of the string (index == 0)
             match = Builder.CreateICmpEQ(curIdx, 
-                ConstantInt::get(Context, APInt(32, 0)));
+                ConstantInt::get(Context, APInt(64, 0)));
             break;
         }
         case End: {
             // $ matches at the end of the string (index == strlen)
-            // Use the precomputed inline strlen value stored in StrLenAlloca
-            Value* strLen = Builder.CreateLoad(Builder.getInt32Ty(), StrLenAlloca);
+            // Use the caller-supplied length stored in S.StrLenAlloca
+            Value* strLen = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
             match = Builder.CreateICmpEQ(curIdx, strLen);
             break;
         }
-        case WordBoundary: {
-            // \b matches at word boundaries (transition between \w and \W)
-            // Correct semantics:
-            // - At position 0: TRUE if str[0] is a word char (non-word -> word transition)
-            // - At position strlen: TRUE if str[strlen-1] is a word char (word -> non-word transition)
-            // - Middle positions: TRUE if isWordChar(str[i-1]) XOR isWordChar(str[i])
-            
-            Value* strLen = Builder.CreateLoad(Builder.getInt32Ty(), StrLenAlloca);
-            
-            Value* atStart = Builder.CreateICmpEQ(curIdx, 
-                ConstantInt::get(Context, APInt(32, 0)));
-            Value* atEnd = Builder.CreateICmpEQ(curIdx, strLen);
-            
-            // Helper lambda to check if a character is a word character
-            auto isWordChar = [&](Value* ch) -> Value* {
-                Value* isLower = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'a'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'z')))
-                );
-                Value* isUpper = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'A'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'Z')))
-                );
-                Value* isDigit = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, '0'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, '9')))
-                );
-                Value* isUnderscore = Builder.CreateICmpEQ(ch, 
-                    ConstantInt::get(Context, APInt(32, '_')));
-                
-                return Builder.CreateOr(Builder.CreateOr(Builder.CreateOr(isLower, isUpper), isDigit), isUnderscore);
-            };
-            
-            // Create basic blocks for different cases
-            BasicBlock* checkStartBlock = BasicBlock::Create(Context, "wb_check_start", MatchF);
-            BasicBlock* checkEndBlock = BasicBlock::Create(Context, "wb_check_end", MatchF);
-            BasicBlock* checkMiddleBlock = BasicBlock::Create(Context, "wb_check_middle", MatchF);
-            BasicBlock* endCheck = BasicBlock::Create(Context, "wb_end_check", MatchF);
-            
-            // Branch: if at start, check first char; else check if at end
-            Builder.CreateCondBr(atStart, checkStartBlock, checkEndBlock);
-            
-            // At string start (position 0): boundary if first char is a word char
-            Builder.SetInsertPoint(checkStartBlock);
-            Value* isEmpty = Builder.CreateICmpEQ(strLen, ConstantInt::get(Context, APInt(32, 0)));
-            // If string is empty, no boundary at position 0
-            Value* firstCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, 
-                ConstantInt::get(Context, APInt(32, 0)));
-            Value* firstChar = Builder.CreateLoad(Builder.getInt8Ty(), firstCharPtr);
-            firstChar = Builder.CreateIntCast(firstChar, Builder.getInt32Ty(), false);
-            Value* firstIsWord = isWordChar(firstChar);
-            // Boundary at start = first char is word AND string is not empty
-            Value* boundaryAtStart = Builder.CreateAnd(firstIsWord, Builder.CreateNot(isEmpty));
-            Builder.CreateBr(endCheck);
-            
-            // Check if at end
-            Builder.SetInsertPoint(checkEndBlock);
-            Builder.CreateCondBr(atEnd, checkMiddleBlock, checkMiddleBlock);
-            // Note: We handle atEnd inside checkMiddleBlock to avoid code duplication
-            
-            // Handle both middle positions and end position
-            Builder.SetInsertPoint(checkMiddleBlock);
-            // At string end (position strlen): boundary if last char is a word char
-            // At middle positions: boundary if prev XOR cur
-            
-            // For end position: check str[strlen-1]
-            Value* lastIdx = Builder.CreateSub(strLen, ConstantInt::get(Context, APInt(32, 1)));
-            Value* lastCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, lastIdx);
-            Value* lastChar = Builder.CreateLoad(Builder.getInt8Ty(), lastCharPtr);
-            lastChar = Builder.CreateIntCast(lastChar, Builder.getInt32Ty(), false);
-            Value* lastIsWord = isWordChar(lastChar);
-            
-            // For middle positions: check transition
-            Value* prevIdx = Builder.CreateSub(curIdx, ConstantInt::get(Context, APInt(32, 1)));
-            Value* prevCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, prevIdx);
-            Value* prevChar = Builder.CreateLoad(Builder.getInt8Ty(), prevCharPtr);
-            prevChar = Builder.CreateIntCast(prevChar, Builder.getInt32Ty(), false);
-            
-            Value* curCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, curIdx);
-            Value* curChar = Builder.CreateLoad(Builder.getInt8Ty(), curCharPtr);
-            curChar = Builder.CreateIntCast(curChar, Builder.getInt32Ty(), false);
-            
-            Value* curIsWord = isWordChar(curChar);
-            Value* prevIsWord = isWordChar(prevChar);
-            Value* middleBoundary = Builder.CreateXor(curIsWord, prevIsWord);
-            
-            // Select result based on whether we're at end or middle
-            // atEnd (in this block) means curIdx == strLen
-            Value* atEndHere = Builder.CreateICmpEQ(curIdx, strLen);
-            Value* boundaryAtMiddleOrEnd = Builder.CreateSelect(atEndHere, lastIsWord, middleBoundary);
-            Builder.CreateBr(endCheck);
-            
-            // Combine results with PHI
-            Builder.SetInsertPoint(endCheck);
-            PHINode* result = Builder.CreatePHI(Builder.getInt1Ty(), 2);
-            result->addIncoming(boundaryAtStart, checkStartBlock);
-            result->addIncoming(boundaryAtMiddleOrEnd, checkMiddleBlock);
-            
-            match = result;
-            break;
-        }
+        case WordBoundary:
         case NonWordBoundary: {
-            // \B matches at non-word boundaries (NO transition between \w and \W)
-            // Correct semantics (inverse of \b):
-            // - At position 0: TRUE if str[0] is NOT a word char (non-word -> non-word)
-            // - At position strlen: TRUE if str[strlen-1] is NOT a word char (non-word -> non-word)
-            // - Middle positions: TRUE if isWordChar(str[i-1]) == isWordChar(str[i]) (no transition)
-            // - Special case: empty string at position 0 is \B (both sides are non-word)
-            
-            Value* strLen = Builder.CreateLoad(Builder.getInt32Ty(), StrLenAlloca);
-            
-            Value* atStart = Builder.CreateICmpEQ(curIdx, 
-                ConstantInt::get(Context, APInt(32, 0)));
-            Value* atEnd = Builder.CreateICmpEQ(curIdx, strLen);
-            Value* isEmpty = Builder.CreateICmpEQ(strLen, ConstantInt::get(Context, APInt(32, 0)));
-            
-            // Helper lambda to check if a character is a word character
-            auto isWordChar = [&](Value* ch) -> Value* {
-                Value* isLower = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'a'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'z')))
-                );
-                Value* isUpper = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, 'A'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, 'Z')))
-                );
-                Value* isDigit = Builder.CreateAnd(
-                    Builder.CreateICmpUGE(ch, ConstantInt::get(Context, APInt(32, '0'))),
-                    Builder.CreateICmpULE(ch, ConstantInt::get(Context, APInt(32, '9')))
-                );
-                Value* isUnderscore = Builder.CreateICmpEQ(ch, 
-                    ConstantInt::get(Context, APInt(32, '_')));
-                
-                return Builder.CreateOr(Builder.CreateOr(Builder.CreateOr(isLower, isUpper), isDigit), isUnderscore);
-            };
-            
-            // Create basic blocks for different cases
-            BasicBlock* checkStartBlock = BasicBlock::Create(Context, "nwb_check_start", MatchF);
-            BasicBlock* checkEndBlock = BasicBlock::Create(Context, "nwb_check_end", MatchF);
-            BasicBlock* checkMiddleBlock = BasicBlock::Create(Context, "nwb_check_middle", MatchF);
-            BasicBlock* endCheck = BasicBlock::Create(Context, "nwb_end_check", MatchF);
-            
-            // Branch: if at start, check first char; else check if at end
-            Builder.CreateCondBr(atStart, checkStartBlock, checkEndBlock);
-            
-            // At string start (position 0): non-boundary if first char is NOT a word char OR string is empty
-            Builder.SetInsertPoint(checkStartBlock);
-            Value* firstCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, 
-                ConstantInt::get(Context, APInt(32, 0)));
-            Value* firstChar = Builder.CreateLoad(Builder.getInt8Ty(), firstCharPtr);
-            firstChar = Builder.CreateIntCast(firstChar, Builder.getInt32Ty(), false);
-            Value* firstIsWord = isWordChar(firstChar);
-            // Non-boundary at start = first char is NOT word OR string is empty
-            Value* nonBoundaryAtStart = Builder.CreateOr(Builder.CreateNot(firstIsWord), isEmpty);
-            Builder.CreateBr(endCheck);
-            
-            // Check if at end
-            Builder.SetInsertPoint(checkEndBlock);
-            Builder.CreateCondBr(atEnd, checkMiddleBlock, checkMiddleBlock);
-            // Note: We handle atEnd inside checkMiddleBlock to avoid code duplication
-            
-            // Handle both middle positions and end position
-            Builder.SetInsertPoint(checkMiddleBlock);
-            
-            // For end position: check str[strlen-1] - non-boundary if last char is NOT word
-            Value* lastIdx = Builder.CreateSub(strLen, ConstantInt::get(Context, APInt(32, 1)));
-            Value* lastCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, lastIdx);
-            Value* lastChar = Builder.CreateLoad(Builder.getInt8Ty(), lastCharPtr);
-            lastChar = Builder.CreateIntCast(lastChar, Builder.getInt32Ty(), false);
-            Value* lastIsWord = isWordChar(lastChar);
-            Value* nonBoundaryAtEnd = Builder.CreateNot(lastIsWord);
-            
-            // For middle positions: check NO transition (both word or both non-word)
-            Value* prevIdx = Builder.CreateSub(curIdx, ConstantInt::get(Context, APInt(32, 1)));
-            Value* prevCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, prevIdx);
-            Value* prevChar = Builder.CreateLoad(Builder.getInt8Ty(), prevCharPtr);
-            prevChar = Builder.CreateIntCast(prevChar, Builder.getInt32Ty(), false);
-            
-            Value* curCharPtr = Builder.CreateGEP(Builder.getInt8Ty(), Arg0, curIdx);
-            Value* curChar = Builder.CreateLoad(Builder.getInt8Ty(), curCharPtr);
-            curChar = Builder.CreateIntCast(curChar, Builder.getInt32Ty(), false);
-            
-            Value* curIsWord = isWordChar(curChar);
-            Value* prevIsWord = isWordChar(prevChar);
-            
-            // Non-boundary: both are word chars OR both are non-word chars (no XOR)
-            Value* bothWord = Builder.CreateAnd(curIsWord, prevIsWord);
-            Value* bothNonWord = Builder.CreateAnd(Builder.CreateNot(curIsWord), Builder.CreateNot(prevIsWord));
-            Value* middleNonBoundary = Builder.CreateOr(bothWord, bothNonWord);
-            
-            // Select result based on whether we're at end or middle
-            Value* atEndHere = Builder.CreateICmpEQ(curIdx, strLen);
-            Value* nonBoundaryAtMiddleOrEnd = Builder.CreateSelect(atEndHere, nonBoundaryAtEnd, middleNonBoundary);
-            Builder.CreateBr(endCheck);
-            
-            // Combine results with PHI
-            Builder.SetInsertPoint(endCheck);
-            PHINode* result = Builder.CreatePHI(Builder.getInt1Ty(), 2);
-            result->addIncoming(nonBoundaryAtStart, checkStartBlock);
-            result->addIncoming(nonBoundaryAtMiddleOrEnd, checkMiddleBlock);
-            
-            match = result;
+            // \b matches at word boundaries (transition between \w and \W),
+            // \B is its inverse. Positions outside the input count as non-word:
+            // - At position 0: \b iff str[0] is a word char
+            // - At position strlen: \b iff str[strlen-1] is a word char
+            // - Middle positions: \b iff isWordChar(str[i-1]) XOR isWordChar(str[i])
+            // - Empty string: \B matches at position 0 (both sides are non-word)
+            // The input is length-delimited, so str[-1] and str[strlen] are
+            // never loaded.
+            Value* strLen = Builder.CreateLoad(Builder.getInt64Ty(), S.StrLenAlloca);
+            Value* hasPrev = Builder.CreateICmpSGT(curIdx,
+                ConstantInt::get(Context, APInt(64, 0)));
+            Value* hasCur = Builder.CreateICmpSLT(curIdx, strLen);
+            
+            Value* prevIdx = Builder.CreateSub(curIdx, ConstantInt::get(Context, APInt(64, 1)));
+            const char* prefix = anchorType == WordBoundary ? "wb" : "nwb";
+            Value* prevIsWord = emitWordCharAt(S, prevIdx, hasPrev, std::string(prefix) + "_prev");
+            Value* curIsWord = emitWordCharAt(S, curIdx, hasCur, std::string(prefix) + "_cur");
+            
+            Value* boundary = Builder.CreateXor(prevIsWord, curIsWord);
+            match = anchorType == WordBoundary ? boundary : Builder.CreateNot(boundary);
             break;
         }
     }
@@ -2316,11 +3390,11 @@ Value* Anchor::CodeGen() {
 // Note: This is a placeholder - the Not class is declared but not currently
 // used by the parser. If you need negative lookahead or similar features,
 // implement the actual logic here.
-Value* Not::CodeGen() {
+Value* Not::CodeGen(CodeGenSession &S) {
     // For now, just generate the body and invert the result
     // This is a stub implementation to satisfy the linker
     if (Body) {
-        Body->CodeGen();
+        Body->CodeGen(S);
     }
     return nullptr;
 }
@@ -2336,6 +3410,11 @@ bool Repeat::containsZeroWidthRepeat() const {
     return Body->containsZeroWidthRepeat();
 }
 
+bool Repeat::containsLazyRepeat() const {
+    if (nonGreedy) return true;
+    return Body && Body->containsLazyRepeat();
+}
+
 bool Concat::isAnchoredAtStart() const {
     if (BodyVec.empty()) return false;
     return BodyVec.front()->isAnchoredAtStart();
@@ -2366,117 +3445,252 @@ bool Alternative::containsZeroWidthRepeat() const {
     return false;
 }
 
-// New JIT compilation interface
-bool CompileRegex(const std::string& pattern) {
-    // Debug: show tokenization to help locate parser errors (only when debugging)
-    RJDBG({
-        RegexLexer tmp(pattern);
-        errs() << "Lexer tokens for pattern: '" << pattern << "'\n";
-        while (true) {
-            auto t = tmp.get_next_token();
-            if (t.type == RegexLexer::EOS) { errs() << "  <EOS>\n"; break; }
-            errs() << "  token: " << t.type << " value:'" << t.value << "'\n";
-        }
-    });
-    // If there is no per-compile context currently, this is a direct
-    // invocation path (not via getOrCompile). In that case, clear
-    // FunctionName so we always generate a fresh, unique name for the
-    // function we will emit into the new module. This prevents duplicate
-    // symbol errors when compiling multiple patterns in the same process.
-    bool createdContext = false;
-    bool directInvocation = (OwnedCompileContext == nullptr);
-    if (directInvocation) FunctionName.clear();
-    try {
-        // If a per-compile context already exists (e.g. when called via
-        // getOrCompile), reuse it. Otherwise create a fresh per-compile
-        // context/module here for direct CompileRegex invocations.
-        if (!OwnedCompileContext) {
-            ThisModule.reset();
-            OwnedCompileContext = std::make_unique<LLVMContext>();
-            OwnedCompileBuilder = std::make_unique<IRBuilder<>>(*OwnedCompileContext);
-            ContextPtr = OwnedCompileContext.get();
-            BuilderPtr = OwnedCompileBuilder.get();
-            RJDBG(errs() << "CompileRegex: created OwnedCompileContext=" << (void*)OwnedCompileContext.get() << "\n");
-            ThisModule = std::make_unique<Module>("my_module", Context);
-            if (JIT) ThisModule->setDataLayout(JIT->getDataLayout());
-            createdContext = true;
-        } else {
-            RJDBG(errs() << "CompileRegex: reusing existing OwnedCompileContext=" << (void*)OwnedCompileContext.get() << " ThisModule=" << (void*)ThisModule.get() << "\n");
+bool Concat::containsLazyRepeat() const {
+    for (const auto &b : BodyVec) {
+        if (b->containsLazyRepeat()) return true;
+    }
+    return false;
+}
+
+bool Alternative::containsLazyRepeat() const {
+    for (const auto &b : BodyVec) {
+        if (b->containsLazyRepeat()) return true;
+    }
+    return false;
+}
+
+// Adjacent literal children form one longer literal; anchors between them
+// take no input. Any other child ends the run but may require a literal of
+// its own.
+std::string Concat::getRequiredLiteral() const {
+    std::string best, run;
+    for (const auto &b : BodyVec) {
+        if (b->isZeroWidth()) continue;
+        if (b->isPureLiteral()) {
+            run += b->getLiteralPrefix();
+            continue;
         }
+        if (run.size() > best.size()) best = run;
+        run.clear();
+        std::string inner = b->getRequiredLiteral();
+        if (inner.size() > best.size()) best = std::move(inner);
+    }
+    return run.size() > best.size() ? run : best;
+}
 
-        // Always generate a unique function name for this compile. This
-        // prevents duplicate-symbol errors when compiling multiple modules
-        // in the same process. The name includes a hash of the pattern and
-        // a monotonically increasing id to avoid collisions.
-        {
-            uint64_t id = GlobalFnId.fetch_add(1);
-            std::hash<std::string> hasher;
-            auto h = hasher(pattern);
-            FunctionName = "regjit_match_" + std::to_string(h) + "_" + std::to_string(id);
+// Only what every branch contains: the longest common substring of the
+// branches' required literals.
+std::string Alternative::getRequiredLiteral() const {
+    if (BodyVec.empty()) return "";
+    std::string common = BodyVec[0]->getRequiredLiteral();
+    for (size_t i = 1; i < BodyVec.size() && !common.empty(); ++i) {
+        std::string lit = BodyVec[i]->getRequiredLiteral();
+        size_t bestLen = 0, bestPos = 0;
+        std::vector<size_t> prev(lit.size() + 1, 0), cur(lit.size() + 1, 0);
+        for (size_t a = 1; a <= common.size(); ++a) {
+            for (size_t b = 1; b <= lit.size(); ++b) {
+                cur[b] = common[a - 1] == lit[b - 1] ? prev[b - 1] + 1 : 0;
+                if (cur[b] > bestLen) { bestLen = cur[b]; bestPos = a - bestLen; }
+            }
+            std::swap(prev, cur);
         }
-        RJDBG(errs() << "CompileRegex: ThisModule=" << (void*)ThisModule.get() << " ContextPtr=" << (void*)ContextPtr << " FunctionName=" << FunctionName << "\n");
-        RegexLexer lexer(pattern);
-        RegexParser parser(lexer);
-        auto ast = parser.parse();
-        // Debug: dump AST structure
-        RJDBG({
-            std::function<void(Root*, int)> dump = [&](Root* r, int depth) -> void {
-                std::string indent(depth*2, ' ');
-                if (dynamic_cast<Func*>(r)) {
-                    errs() << indent << "Func\n";
-                } else if (dynamic_cast<Concat*>(r)) {
-                    errs() << indent << "Concat\n";
-                    Concat* c = static_cast<Concat*>(r);
-                    for (auto &ch : c->BodyVec) dump(ch.get(), depth+1);
-                    return;
-                } else if (dynamic_cast<Match*>(r)) {
-                    errs() << indent << "Match\n";
-                } else if (dynamic_cast<Repeat*>(r)) {
-                    errs() << indent << "Repeat\n";
-                    Repeat* rep = static_cast<Repeat*>(r);
-                    dump(rep->Body.get(), depth+1);
-                    return;
-                } else if (dynamic_cast<Anchor*>(r)) {
-                    errs() << indent << "Anchor\n";
-                } else if (dynamic_cast<CharClass*>(r)) {
-                    errs() << indent << "CharClass\n";
-                } else if (dynamic_cast<Alternative*>(r)) {
-                    errs() << indent << "Alternative\n";
-                    Alternative* a = static_cast<Alternative*>(r);
-                    for (auto &ch : a->BodyVec) dump(ch.get(), depth+1);
-                    return;
-                } else if (dynamic_cast<Not*>(r)) {
-                    errs() << indent << "Not\n";
-                } else {
-                    errs() << indent << "UnknownNode\n";
-                }
-            };
-            errs() << "AST dump for pattern: '" << pattern << "'\n";
-            // ast is a unique_ptr<Root>
-            dump(ast.get(), 0);
-        });
-        auto func = std::make_unique<Func>(std::move(ast));
-        func->CodeGen();
-        Compile();
-
-        // If we created a temporary per-compile context for this direct
-        // invocation (not via getOrCompile), ownership will have been
-        // transferred into the JIT by Compile(), so clear our local
-        // pointers and defaults.
-        if (createdContext) {
-            // OwnedCompileContext has been moved into ThreadSafeContext by
-            // Compile(); ensure the local unique_ptr is null and restore
-            // global pointers.
-            OwnedCompileContext.reset();
-            OwnedCompileBuilder.reset();
-            ContextPtr = &GlobalContext;
-            BuilderPtr = &GlobalBuilder;
+        common = common.substr(bestPos, bestLen);
+    }
+    return common;
+}
+
+std::string Repeat::getRequiredLiteral() const {
+    if (minCount == 0) return "";
+    if (!Body->isPureLiteral()) return Body->getRequiredLiteral();
+    // (ab){3} contains ababab; longer runs are capped, a prefix still counts
+    std::string unit = Body->getLiteralPrefix(), result;
+    for (int i = 0; i < minCount && result.size() + unit.size() <= 255; ++i) result += unit;
+    return result.empty() ? Body->getRequiredLiteral() : result;
+}
+
+// Lengths past this are treated as unbounded (max) or clamped (min), so
+// the arithmetic below cannot overflow; either keeps the bounds valid.
+static constexpr int64_t kLengthCap = int64_t(1) << 40;
+
+static int64_t addLength(int64_t a, int64_t b) {
+    if (a < 0 || b < 0) return -1;
+    return a + b > kLengthCap ? -1 : a + b;
+}
+
+static int64_t mulLength(int64_t count, int64_t each) {
+    if (count == 0 || each == 0) return 0;
+    if (count < 0 || each < 0 || count > kLengthCap / each) return -1;
+    return count * each;
+}
+
+int64_t Concat::getMinLength() const {
+    int64_t total = 0;
+    for (const auto &b : BodyVec) total = std::min(total + b->getMinLength(), kLengthCap);
+    return total;
+}
+
+int64_t Concat::getMaxLength() const {
+    int64_t total = 0;
+    for (const auto &b : BodyVec) total = addLength(total, b->getMaxLength());
+    return total;
+}
+
+int64_t Alternative::getMinLength() const {
+    if (BodyVec.empty()) return 0;
+    int64_t least = kLengthCap;
+    for (const auto &b : BodyVec) least = std::min(least, b->getMinLength());
+    return least;
+}
+
+int64_t Alternative::getMaxLength() const {
+    int64_t most = 0;
+    for (const auto &b : BodyVec) {
+        int64_t m = b->getMaxLength();
+        if (m < 0) return -1;
+        most = std::max(most, m);
+    }
+    return most;
+}
+
+int64_t Repeat::getMinLength() const {
+    int64_t m = mulLength(minCount, Body->getMinLength());
+    return m < 0 ? kLengthCap : m;
+}
+
+// maxCount -1 is unbounded, which only matters if the body takes input
+int64_t Repeat::getMaxLength() const {
+    return mulLength(maxCount, Body->getMaxLength());
+}
+
+// New JIT compilation interface
+// Parse, generate and JIT one pattern in a fresh CodeGenSession. Touches no
+// shared codegen state, so it may run on several threads at once. Throws on
+// parse or codegen errors.
+static CompiledEntry compilePattern(const std::string &pattern, uint64_t stepBudget, regjit_opt_level optLevel,
+                                    size_t dfaMaxStates) {
+  ensureJITInitialized();
+
+  // Unique function name: hash of the pattern plus a monotonically
+  // increasing id, so recompiling a pattern never redefines a symbol.
+  uint64_t id = GlobalFnId.fetch_add(1);
+  std::hash<std::string> hasher;
+  CodeGenSession S("regjit_match_" + std::to_string(hasher(pattern)) + "_" + std::to_string(id));
+  S.M = std::make_unique<Module>("module_" + std::to_string(id), *S.Ctx);
+  S.M->setDataLayout(JIT->getDataLayout());
+  S.StepBudget = stepBudget;
+  S.OptLevel = optLevel;
+  S.DFAMaxStates = dfaMaxStates;
+  S.ByteFreq = currentByteFrequencies();
+  RJDBG(fprintf(stderr, "compilePattern: pattern='%s' -> FunctionName='%s'\n", pattern.c_str(), S.FunctionName.c_str()));
+
+  // Debug: show tokenization to help locate parser errors (only when debugging)
+  RJDBG({
+      RegexLexer tmp(pattern);
+      errs() << "Lexer tokens for pattern: '" << pattern << "'\n";
+      while (true) {
+          auto t = tmp.get_next_token();
+          if (t.type == RegexLexer::EOS) { errs() << "  <EOS>\n"; break; }
+          errs() << "  token: " << t.type << " value:'" << t.value << "'\n";
+      }
+  });
+  auto ast = parseRegex(pattern);
+  std::vector<std::string> keywords;
+  if (collectLiteralAlternation(*ast, kAhoCorasickMinKeywords, keywords)) {
+    S.Keywords = std::make_shared<const AhoCorasick>(keywords);
+  } else {
+    ast = optimizeAlternations(std::move(ast));
+  }
+  // Debug: dump AST structure
+  RJDBG({
+    std::function<void(Root*, int)> dump = [&](Root* r, int depth) -> void {
+        std::string indent(depth*2, ' ');
+        if (dynamic_cast<Func*>(r)) {
+            errs() << indent << "Func\n";
+        } else if (dynamic_cast<Concat*>(r)) {
+            errs() << indent << "Concat\n";
+            Concat* c = static_cast<Concat*>(r);
+            for (auto &ch : c->BodyVec) dump(ch.get(), depth+1);
+            return;
+        } else if (dynamic_cast<Match*>(r)) {
+            errs() << indent << "Match\n";
+        } else if (dynamic_cast<Repeat*>(r)) {
+            errs() << indent << "Repeat\n";
+            Repeat* rep = static_cast<Repeat*>(r);
+            dump(rep->Body.get(), depth+1);
+            return;
+        } else if (dynamic_cast<Anchor*>(r)) {
+            errs() << indent << "Anchor\n";
+        } else if (dynamic_cast<CharClass*>(r)) {
+            errs() << indent << "CharClass\n";
+        } else if (dynamic_cast<Alternative*>(r)) {
+            errs() << indent << "Alternative\n";
+            Alternative* a = static_cast<Alternative*>(r);
+            for (auto &ch : a->BodyVec) dump(ch.get(), depth+1);
+            return;
+        } else if (dynamic_cast<Not*>(r)) {
+            errs() << indent << "Not\n";
+        } else {
+            errs() << indent << "UnknownNode\n";
         }
+    };
+    errs() << "AST dump for pattern: '" << pattern << "'\n";
+    dump(ast.get(), 0);
+  });
+  // Look in the object cache first. An object already loaded in this
+  // process cannot be added twice; that case compiles a fresh copy.
+  if (!S.Keywords && objectCacheEnabled()) {
+    std::string key = objectCacheKey(pattern + '\0' + "budget=" + std::to_string(stepBudget) +
+                                     ",opt=" + std::to_string(optLevel) +
+                                     ",dfa=" + std::to_string(dfaMaxStates) + ",freq=" +
+                                     std::string(reinterpret_cast<const char*>(S.ByteFreq.rank), 256));
+    CachedObject cached;
+    if (loadCachedObject(key, cached)) {
+      CompiledEntry e;
+      e.FnName = cached.FnName;
+      e.PrefilterByte = cached.PrefilterByte;
+      e.RT = JIT->getMainJITDylib().createResourceTracker();
+      auto buf = MemoryBuffer::getMemBufferCopy(cached.Object, e.FnName);
+      if (Error err = JIT->addObjectFile(e.RT, std::move(buf))) {
+        consumeError(std::move(err));
+        ExitOnErr(e.RT->remove());
+      } else if (auto Sym = JIT->lookup(e.FnName)) {
+        e.Addr = Sym->getValue();
+        RJDBG(fprintf(stderr, "compilePattern: loaded '%s' from the object cache\n", e.FnName.c_str()));
+        return e;
+      } else {
+        consumeError(Sym.takeError());
+        ExitOnErr(e.RT->remove());
+      }
+    } else {
+      S.ObjectCacheKey = key;
+      S.FunctionName = objectCacheSymbol(id);
+    }
+  }
+
+  auto func = std::make_unique<Func>(std::move(ast));
+  func->CodeGen(S);
+
+  CompiledEntry e;
+  e.FnName = S.FunctionName;
+  e.Keywords = S.Keywords;
+  e.PrefilterByte = S.PrefilterByte;
+  e.RT = Compile(S);
+  auto Sym = ExitOnErr(JIT->lookup(e.FnName));
+  e.Addr = Sym.getValue();
+  return e;
+}
+
+// Legacy single-pattern API: compile `pattern` outside the cache and make it
+// the target of Execute()/CleanUp().
+bool CompileRegex(const std::string& pattern) {
+    try {
+        CompiledEntry e = compilePattern(pattern);
+        FunctionName = e.FnName;
+        RT = e.RT;
+        RTKeywords = e.Keywords;
         return true;
     } catch (const std::exception &e) {
         std::cerr << "CompileRegex failed for pattern '" << pattern << "': " << e.what() << "\n";
-        // restore globals and drop any partially built module
-        resetCompileState();
         return false;
     }
 }
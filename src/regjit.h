@@ -27,19 +27,31 @@
 #include <mutex>
 #include <atomic>
 #include <string>
+#include <vector>
 #include <future>
+#include "regjit_capi.h"
+#include "regjit_freq.h"
+#include "regjit_runtime.h"
 
 using namespace llvm;
 using namespace llvm::orc;
 
 
-  extern llvm::LLVMContext* ContextPtr;
-  extern llvm::IRBuilder<>* BuilderPtr;
   extern   ExitOnError ExitOnErr;
   extern std::unique_ptr<llvm::orc::LLJIT> JIT;
   
+  // Signature of every generated matcher:
+  // int fn(const char* data, size_t len, int64_t* start_out, int64_t* end_out)
+  typedef int (*RegjitMatchFn)(const char*, size_t, int64_t*, int64_t*);
+
+  class ProgMatcher;
+  class AhoCorasick;
+
   struct CompiledEntry {
-    uint64_t Addr; // JIT absolute address
+    uint64_t Addr = 0; // JIT absolute address (0 when Matcher is used)
+    std::shared_ptr<ProgMatcher> Matcher; // non-JIT engine (e.g. lazy DFA), or null
+    std::shared_ptr<const AhoCorasick> Keywords; // automaton the generated code calls, or null
+    int PrefilterByte = -1; // byte the generated code scans for with memchr, or -1
     llvm::orc::ResourceTrackerSP RT; // tracker to allow unloading
     std::string FnName; // generated function name
     size_t refCount = 0; // number of active users
@@ -55,21 +67,74 @@ using namespace llvm::orc;
   };
   extern std::unordered_map<std::string, InflightCompile> CompileInflight;
   extern std::atomic<uint64_t> GlobalFnId;
-  extern std::string FunctionName; // current/last generated function name
+  extern std::string FunctionName; // function generated by the last CompileRegex()
   #include <list>
   extern size_t CacheMaxSize;
   extern std::list<std::string> CacheLRUList;
+  extern std::atomic<size_t> DirectDFAMaxStates; // regjit_set_dfa_codegen_limit()
+
+  // State of one pattern compilation. Every CodeGen() call for a pattern
+  // receives the same session and sessions share nothing, so different
+  // patterns can be compiled on different threads at the same time.
+  struct CodeGenSession {
+    std::unique_ptr<llvm::LLVMContext> Ctx; // owns the IR until Compile() hands it to the JIT
+    std::unique_ptr<llvm::Module> M;
+    std::unique_ptr<llvm::IRBuilder<>> B;
+    std::string FunctionName;               // symbol of the generated matcher
+    llvm::Function* MatchF = nullptr;
+    llvm::Value* Arg0 = nullptr;            // input pointer
+    llvm::Value* Index = nullptr;           // i64 alloca: current position
+    llvm::Value* StrLenAlloca = nullptr;    // i64 alloca: input length
+    // Match position tracking for Python re compatibility
+    llvm::Value* MatchStartAlloca = nullptr; // start position of current match attempt
+    llvm::Value* StartOutArg = nullptr;      // output parameter for match start
+    llvm::Value* EndOutArg = nullptr;        // output parameter for match end
+    // Backtracking step budget (0 = unlimited). When set, Func::CodeGen
+    // creates the per-call counter and the block that returns
+    // REGJIT_BUDGET_EXCEEDED; see emitBacktrackStep().
+    uint64_t StepBudget = 0;
+    llvm::Value* StepsLeft = nullptr;         // i64 alloca: steps remaining in this call
+    llvm::BasicBlock* BudgetExceededBB = nullptr;
+    // Set by compilePattern() for large literal alternations: Func::CodeGen
+    // then emits a call into this automaton instead of a matcher.
+    std::shared_ptr<const AhoCorasick> Keywords;
+    // Membership bitmaps already emitted for character classes, keyed by
+    // their 32 bytes, so a class used several times shares one constant.
+    std::unordered_map<std::string, llvm::Value*> ClassBitmaps;
+    // Ranks required bytes when picking the memchr prefilter byte; a copy
+    // of the model current when compilation started.
+    ByteFrequencies ByteFreq = ByteFrequencies::builtin();
+    int PrefilterByte = -1; // the byte Func::CodeGen picked, or -1
+    // When set, Compile() lowers the module to an object itself and stores
+    // it in the object cache under this key (see regjit_objcache.h).
+    std::string ObjectCacheKey;
+    regjit_opt_level OptLevel = REGJIT_OPT_REGEX; // pipeline Compile() runs
+    size_t DFAMaxStates = 0; // direct-coded DFA limit for this compile (0 = never)
+
+    explicit CodeGenSession(std::string fnName)
+      : Ctx(std::make_unique<llvm::LLVMContext>()),
+        B(std::make_unique<llvm::IRBuilder<>>(*Ctx)),
+        FunctionName(std::move(fnName)) {}
+  };
 
   // cache management
-  CompiledEntry getOrCompile(const std::string &pattern);
-  void releasePattern(const std::string &pattern);
+  // Entries are keyed by pattern for the default options and by
+  // cacheKey(pattern, opts) otherwise.
+  std::string cacheKey(const std::string &pattern, const regjit_options &opts);
+  CompiledEntry getOrCompile(const std::string &pattern); // pins the entry; pair with releasePattern()
+  CompiledEntry getOrCompile(const std::string &pattern, const regjit_options &opts);
+  // getOrCompile() on the compile pool (regjit_pool.h). The entry is pinned
+  // as with getOrCompile(); a compile error is rethrown by get().
+  std::future<CompiledEntry> getOrCompileAsync(const std::string &pattern);
+  std::future<CompiledEntry> getOrCompileAsync(const std::string &pattern, const regjit_options &opts);
+  void releasePattern(const std::string &key);
   void evictIfNeeded();
   class Root {
     BasicBlock* failBlock = nullptr;
     BasicBlock* nextBlock = nullptr;
 public:
     virtual ~Root() = default;
-    virtual Value *CodeGen() = 0;
+    virtual Value *CodeGen(CodeGenSession &S) = 0;
     // Returns true if this node is zero-width (e.g. anchor, lookaround, etc)
     virtual bool isZeroWidth() const { return false; }
     // Returns true if the subtree is guaranteed to only match at string start
@@ -79,6 +144,8 @@ public:
     // Returns true if the subtree contains a Repeat whose body is zero-width
     // (e.g. repeating an anchor). Conservative default: false.
     virtual bool containsZeroWidthRepeat() const { return false; }
+    // Returns true if the subtree contains a non-greedy (lazy) Repeat.
+    virtual bool containsLazyRepeat() const { return false; }
     // Returns the first literal character if the pattern starts with a literal
     // Returns -1 if not applicable (e.g., starts with anchor, char class, etc.)
     virtual int getFirstLiteralChar() const { return -1; }
@@ -93,6 +160,13 @@ public:
     // Returns characters that MUST appear in any successful match
     // Used for pre-filtering optimization - quickly reject strings missing required chars
     virtual std::set<char> getRequiredChars() const { return {}; }
+    // Returns the longest string found to appear in every successful match
+    // (a substring search for it can reject inputs or anchor the search)
+    virtual std::string getRequiredLiteral() const { return ""; }
+    // Fewest and most input bytes a successful match can consume; -1 for no
+    // upper bound. The search loop skips starts that cannot fit a match.
+    virtual int64_t getMinLength() const { return 0; }
+    virtual int64_t getMaxLength() const { return -1; }
     void SetFailBlock(BasicBlock *b) {
       failBlock = b;
     }
@@ -111,7 +185,7 @@ public:
     public:
       std::unique_ptr<Root> Body;
       explicit Func(std::unique_ptr<Root> b):Body(std::move(b)){}
-      Value *CodeGen() override;
+      Value *CodeGen(CodeGenSession &S) override;
        ~Func() override = default; // 显式声明析构函数
   };
 
@@ -121,12 +195,15 @@ public:
     public:
      explicit Match(char x) :choice(x){}
      char getChar() const { return choice; }
-     Value* CodeGen() override;
+     Value* CodeGen(CodeGenSession &S) override;
      int getFirstLiteralChar() const override { return static_cast<unsigned char>(choice); }
      std::string getLiteralPrefix() const override { return std::string(1, choice); }
      bool isPureLiteral() const override { return true; }
      int getSingleChar() const override { return static_cast<unsigned char>(choice); }
      std::set<char> getRequiredChars() const override { return {choice}; }
+     std::string getRequiredLiteral() const override { return std::string(1, choice); }
+     int64_t getMinLength() const override { return 1; }
+     int64_t getMaxLength() const override { return 1; }
       ~Match() override = default; 
   };
   class Concat: public Root{
@@ -134,9 +211,12 @@ public:
     std::vector<std::unique_ptr<Root>> BodyVec;
     Concat(){}
     void Append(std::unique_ptr<Root> Body);
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
+    // Emit only BodyVec[first..], for callers that already matched the rest
+    Value* CodeGenFrom(CodeGenSession &S, size_t first);
     bool isAnchoredAtStart() const override;
     bool containsZeroWidthRepeat() const override;
+    bool containsLazyRepeat() const override;
     int getFirstLiteralChar() const override {
       // Skip zero-width elements (anchors) and return first literal
       for (const auto& child : BodyVec) {
@@ -171,6 +251,9 @@ public:
       }
       return result;
     }
+    std::string getRequiredLiteral() const override;
+    int64_t getMinLength() const override;
+    int64_t getMaxLength() const override;
   };
   
   class Alternative: public Root{
@@ -178,9 +261,10 @@ public:
     std::vector<std::unique_ptr<Root>> BodyVec;
     Alternative(){}
     void Append(std::unique_ptr<Root> Body);
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
     bool isAnchoredAtStart() const override;
     bool containsZeroWidthRepeat() const override;
+    bool containsLazyRepeat() const override;
     std::set<char> getRequiredChars() const override {
       // For alternatives, only chars required by ALL branches are truly required
       if (BodyVec.empty()) return {};
@@ -195,13 +279,16 @@ public:
       }
       return result;
     }
+    std::string getRequiredLiteral() const override;
+    int64_t getMinLength() const override;
+    int64_t getMaxLength() const override;
   };
   // not operator
   class Not: public Root {
     public:
     std::unique_ptr<Root> Body;
     explicit Not(std::unique_ptr<Root> b):Body(std::move(b)){}
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
     ~Not()override = default; 
   };
   // Repeat
@@ -228,9 +315,10 @@ public:
     static std::unique_ptr<Repeat> makeRange(std::unique_ptr<Root> b, int min, int max, bool nongreedy=false) {
       return std::make_unique<Repeat>(std::move(b), min, max, nongreedy);
     }
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
     ~Repeat() override = default;
     bool containsZeroWidthRepeat() const override;
+    bool containsLazyRepeat() const override;
     // Repeats are not considered anchored at start conservatively because
     // a repeat may wrap a zero-width anchor and change search semantics.
     bool isAnchoredAtStart() const override { return false; }
@@ -240,6 +328,9 @@ public:
       // If min > 0, the body's required chars are also required
       return Body->getRequiredChars();
     }
+    std::string getRequiredLiteral() const override;
+    int64_t getMinLength() const override;
+    int64_t getMaxLength() const override;
   };
 
 
@@ -273,8 +364,21 @@ public:
     bool isNegated() const { return negated; }
     bool isDotClass() const { return dotClass; }
     const std::vector<CharRange>& getRanges() const { return ranges; }
+    // Byte-level membership test with the same rules as CodeGen(); used by
+    // the engines that do not generate code.
+    bool matchesByte(unsigned char c) const {
+        if (dotClass) return c != '\n';
+        bool match = false;
+        for (const auto& r : ranges) {
+            bool in = c >= static_cast<unsigned char>(r.start) && c <= static_cast<unsigned char>(r.end);
+            if (in == r.included) { match = true; break; }
+        }
+        return negated ? !match : match;
+    }
     
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
+    int64_t getMinLength() const override { return 1; }
+    int64_t getMaxLength() const override { return 1; }
     ~CharClass() override = default;
   };
 
@@ -292,17 +396,28 @@ private:
 public:
     explicit Anchor(AnchorType type) : anchorType(type) {}
     AnchorType getType() const { return anchorType; }
-    Value* CodeGen() override;
+    Value* CodeGen(CodeGenSession &S) override;
     bool isZeroWidth() const override { return true; }
     bool isAnchoredAtStart() const override;
     bool containsZeroWidthRepeat() const override { return false; }
+    int64_t getMinLength() const override { return 0; }
+    int64_t getMaxLength() const override { return 0; }
     ~Anchor() override = default;
   };
+std::unique_ptr<Root> parseRegex(const std::string& pattern); // throws std::runtime_error on syntax errors
+// Flatten and factor alternations for the backtracking codegen (shared
+// literal prefixes into a trie, single-byte branches into a CharClass).
+// Matches the same strings with the same leftmost-first preference.
+std::unique_ptr<Root> optimizeAlternations(std::unique_ptr<Root> ast);
 void Initialize();
-void Compile();
+// Run the IR pipeline for `level` over M; throws std::runtime_error for an
+// unknown level.
+void OptimizeModule(Module& M, regjit_opt_level level = REGJIT_OPT_REGEX);
+llvm::orc::ResourceTrackerSP Compile(CodeGenSession &S); // optimize S.M and add it to the JIT
 bool CompileRegex(const std::string& pattern);
 void ensureJITInitialized();
-int Execute(const char* input); // execute last compiled function
+int Execute(const char* input); // execute last compiled function on a NUL-terminated string
+int Execute(const char* input, size_t len); // execute last compiled function on input[0, len)
 int ExecutePattern(const std::string& pattern, const char* input); // compile-or-get then execute
 void unloadPattern(const std::string& pattern);
 void CleanUp();
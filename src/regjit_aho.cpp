@@ -0,0 +1,161 @@
+#include "regjit_aho.h"
+#include "regjit.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+AhoCorasick::AhoCorasick(const std::vector<std::string>& keywords) {
+  // Bytes used by some keyword get classes 1..k in byte order; the rest
+  // share class 0, which no state has a child for.
+  bool used[256] = {};
+  std::fill(std::begin(startsKeyword), std::end(startsKeyword), false);
+  for (const auto& k : keywords) {
+    for (unsigned char c : k) used[c] = true;
+    if (!k.empty()) startsKeyword[static_cast<unsigned char>(k[0])] = true;
+  }
+  int numClasses = 1;
+  for (int b = 0; b < 256; ++b) byteClass[b] = used[b] ? static_cast<uint8_t>(numClasses++) : 0;
+  if (numClasses > 256) { // every byte occurs: classes are the bytes
+    for (int b = 0; b < 256; ++b) byteClass[b] = static_cast<uint8_t>(b);
+    numClasses = 256;
+  }
+
+  // Trie with sparse children while building
+  std::vector<std::vector<std::pair<uint8_t, uint32_t>>> kids(1);
+  keyword.assign(1, -1);
+  keywordLen.reserve(keywords.size());
+  for (size_t i = 0; i < keywords.size(); ++i) {
+    const std::string& k = keywords[i];
+    uint32_t s = 0;
+    for (unsigned char c : k) {
+      uint8_t cls = byteClass[c];
+      auto& ks = kids[s];
+      auto it = std::find_if(ks.begin(), ks.end(), [cls](const auto& e) { return e.first == cls; });
+      if (it != ks.end()) {
+        s = it->second;
+        continue;
+      }
+      uint32_t id = static_cast<uint32_t>(kids.size());
+      ks.emplace_back(cls, id);
+      kids.emplace_back();
+      keyword.push_back(-1);
+      s = id;
+    }
+    if (keyword[s] < 0) keyword[s] = static_cast<int32_t>(i);
+    keywordLen.push_back(static_cast<uint32_t>(k.size()));
+    maxLen = std::max(maxLen, k.size());
+  }
+
+  // Banded layout: the root gets a full row, other states the span of
+  // classes between their smallest and largest child.
+  const size_t n = kids.size();
+  bandStart.resize(n);
+  bandLo.resize(n);
+  bandHi.resize(n);
+  for (size_t s = 0; s < n; ++s) {
+    auto& ks = kids[s];
+    uint8_t lo = 1, hi = 0; // empty band
+    if (s == 0) {
+      lo = 0;
+      hi = static_cast<uint8_t>(numClasses - 1);
+    } else if (!ks.empty()) {
+      lo = hi = ks[0].first;
+      for (const auto& e : ks) {
+        lo = std::min(lo, e.first);
+        hi = std::max(hi, e.first);
+      }
+    }
+    bandStart[s] = static_cast<uint32_t>(next.size());
+    bandLo[s] = lo;
+    bandHi[s] = hi;
+    if (lo <= hi) next.resize(next.size() + (hi - lo + 1), kNone);
+    for (const auto& e : ks) next[bandStart[s] + e.first - lo] = e.second;
+  }
+
+  // Failure links, breadth first
+  fail.assign(n, 0);
+  endsMatch.assign(n, 0);
+  std::vector<uint32_t> queue;
+  queue.reserve(n);
+  for (const auto& e : kids[0]) {
+    queue.push_back(e.second);
+    endsMatch[e.second] = keyword[e.second] >= 0;
+  }
+  for (size_t qi = 0; qi < queue.size(); ++qi) {
+    uint32_t u = queue[qi];
+    for (const auto& [cls, v] : kids[u]) {
+      uint32_t f = fail[u];
+      while (f != 0 && child(f, cls) == kNone) f = fail[f];
+      uint32_t t = child(f, cls);
+      fail[v] = t != kNone ? t : 0;
+      endsMatch[v] = keyword[v] >= 0 || endsMatch[fail[v]];
+      queue.push_back(v);
+    }
+  }
+}
+
+int32_t AhoCorasick::keywordAt(const uint8_t* p, size_t len, size_t pos) const {
+  int32_t best = -1;
+  uint32_t s = 0;
+  for (size_t j = pos; j < len; ++j) {
+    s = child(s, byteClass[p[j]]);
+    if (s == kNone) break;
+    int32_t k = keyword[s];
+    if (k >= 0 && (best < 0 || k < best)) best = k;
+  }
+  return best;
+}
+
+int AhoCorasick::search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) const {
+  *start_out = -1;
+  *end_out = -1;
+  if (!data && len != 0) return -1;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  uint32_t s = 0;
+  for (size_t i = 0; i < len; ++i) {
+    // At the root only a keyword's first byte leads anywhere
+    if (s == 0) {
+      while (i < len && !startsKeyword[p[i]]) ++i;
+      if (i == len) break;
+    }
+    uint8_t cls = byteClass[p[i]];
+    for (;;) {
+      uint32_t t = child(s, cls);
+      if (t != kNone) { s = t; break; }
+      if (s == 0) break;
+      s = fail[s];
+    }
+    if (!endsMatch[s]) continue;
+    // The first match to end here. A match that starts further left must
+    // end later but start at most maxLen bytes back, so the leftmost start
+    // is the first of those positions where some keyword matches.
+    size_t end = i + 1;
+    for (size_t st = end > maxLen ? end - maxLen : 0; st < end; ++st) {
+      int32_t k = keywordAt(p, len, st);
+      if (k >= 0) {
+        *start_out = static_cast<int64_t>(st);
+        *end_out = static_cast<int64_t>(st + keywordLen[k]);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+bool collectLiteralAlternation(const Root& ast, size_t minKeywords, std::vector<std::string>& keywords) {
+  auto* alt = dynamic_cast<const Alternative*>(&ast);
+  if (!alt || alt->BodyVec.size() < minKeywords) return false;
+  keywords.clear();
+  keywords.reserve(alt->BodyVec.size());
+  for (const auto& branch : alt->BodyVec) {
+    if (!branch->isPureLiteral()) return false;
+    keywords.push_back(branch->getLiteralPrefix());
+    if (keywords.back().empty()) return false;
+  }
+  return true;
+}
+
+extern "C" int regjit_ac_search(const void* ac, const char* data, size_t len,
+                                int64_t* start_out, int64_t* end_out) {
+  return static_cast<const AhoCorasick*>(ac)->search(data, len, start_out, end_out);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Root;
+
+// Aho-Corasick automaton for a set of literal keywords, used instead of
+// generated code when a pattern is nothing but a long alternation of
+// literals (deny-lists such as foo|bar|baz|... with thousands of words).
+//
+// The keyword trie is stored with a banded layout: each state keeps only
+// the span [lo, hi] of byte classes its children use, in one shared array,
+// so the states of 50,000 keywords stay compact while the hot root state is
+// a full row. Missing transitions follow failure links as usual. Building is
+// linear in the total keyword length and a search is one pass over the
+// input.
+//
+// Matching is leftmost-first like an alternation: of the keywords that occur
+// at the leftmost position, the one listed first wins.
+class AhoCorasick {
+public:
+  // Keywords must be non-empty.
+  explicit AhoCorasick(const std::vector<std::string>& keywords);
+
+  // Same contract as RegjitMatchFn. Safe to call from several threads.
+  int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) const;
+
+  size_t numStates() const { return fail.size(); }
+
+private:
+  static constexpr uint32_t kNone = 0; // no child (the root is never a child)
+
+  uint8_t byteClass[256];                 // 0: byte in no keyword
+  bool startsKeyword[256];                // first byte of some keyword
+  std::vector<uint32_t> bandStart;        // per state, offset into `next`
+  std::vector<uint8_t> bandLo, bandHi;    // class span; lo > hi when no children
+  std::vector<uint32_t> next;             // child per class in the band, or kNone
+  std::vector<uint32_t> fail;             // failure link
+  std::vector<uint8_t> endsMatch;         // some keyword ends at this state or a suffix of it
+  std::vector<int32_t> keyword;           // first keyword ending exactly here, or -1
+  std::vector<uint32_t> keywordLen;
+  size_t maxLen = 0;
+
+  uint32_t child(uint32_t state, uint8_t cls) const {
+    if (cls < bandLo[state] || cls > bandHi[state]) return kNone;
+    return next[bandStart[state] + cls - bandLo[state]];
+  }
+  // Earliest-listed keyword that matches at `pos`, or -1.
+  int32_t keywordAt(const uint8_t* p, size_t len, size_t pos) const;
+};
+
+// If `ast` is an alternation of at least `minKeywords` non-empty literals,
+// store them in branch order in `keywords` and return true.
+bool collectLiteralAlternation(const Root& ast, size_t minKeywords, std::vector<std::string>& keywords);
+
+// Fewest branches for which the JIT hands a literal alternation to
+// AhoCorasick; smaller sets go through the alternation trie codegen.
+constexpr size_t kAhoCorasickMinKeywords = 256;
+
+// Called from generated code; `ac` is an AhoCorasick.
+extern "C" int regjit_ac_search(const void* ac, const char* data, size_t len,
+                                int64_t* start_out, int64_t* end_out);
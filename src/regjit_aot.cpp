@@ -0,0 +1,137 @@
+#include "regjit_aot.h"
+#include "regjit.h"
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <cctype>
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+bool isIdentifier(const std::string& s) {
+  if (s.empty() || std::isdigit(static_cast<unsigned char>(s[0]))) return false;
+  for (char c : s) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+  }
+  return true;
+}
+
+std::string errorText(Error err) {
+  std::string msg;
+  handleAllErrors(std::move(err), [&](const ErrorInfoBase& e) { msg = e.message(); });
+  return msg;
+}
+
+std::unique_ptr<TargetMachine> createAotTargetMachine(const AotTarget& target) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  auto JTMB = JITTargetMachineBuilder::detectHost();
+  if (!JTMB) throw std::runtime_error("cannot detect the host target: " + errorText(JTMB.takeError()));
+  if (target.CPU != "native") {
+    // Baseline (or the named) CPU of the host architecture, not its features
+    JTMB->setCPU(target.CPU);
+    JTMB->getFeatures() = SubtargetFeatures();
+  }
+  if (!target.Features.empty()) {
+    SubtargetFeatures extra(target.Features);
+    JTMB->addFeatures(extra.getFeatures());
+  }
+  // Position independent, so the object links into executables and shared
+  // libraries alike
+  JTMB->setRelocationModel(Reloc::PIC_);
+  auto TM = JTMB->createTargetMachine();
+  if (!TM) throw std::runtime_error("cannot create the target machine: " + errorText(TM.takeError()));
+  return std::move(*TM);
+}
+
+// Pattern text for a C comment: printable ASCII, no "*/"
+std::string commentText(const std::string& pattern) {
+  std::string out;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(pattern[i]);
+    if (c == '*' && i + 1 < pattern.size() && pattern[i + 1] == '/') {
+      out += "*\\/";
+      ++i;
+    } else if (c < 0x20 || c >= 0x7f) {
+      char buf[5];
+      snprintf(buf, sizeof(buf), "\\x%02x", c);
+      out += buf;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+std::vector<AotPattern> parseAotManifest(std::istream& in) {
+  std::vector<AotPattern> patterns;
+  std::set<std::string> names;
+  std::string line;
+  for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    size_t nameStart = line.find_first_not_of(" \t");
+    if (nameStart == std::string::npos || line[nameStart] == '#') continue;
+    size_t nameEnd = line.find_first_of(" \t", nameStart);
+    std::string where = "manifest line " + std::to_string(lineNo);
+    std::string name = line.substr(nameStart, nameEnd - nameStart);
+    if (!isIdentifier(name)) throw std::runtime_error(where + ": '" + name + "' is not a C identifier");
+    if (!names.insert(name).second) throw std::runtime_error(where + ": '" + name + "' is defined twice");
+    size_t patStart = nameEnd == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", nameEnd);
+    if (patStart == std::string::npos) throw std::runtime_error(where + ": no pattern for '" + name + "'");
+    patterns.push_back({name, line.substr(patStart), lineNo});
+  }
+  return patterns;
+}
+
+std::string compileAotObject(const std::vector<AotPattern>& patterns, const AotTarget& target) {
+  auto TM = createAotTargetMachine(target);
+
+  // One session and module for all matchers; only the per-function state
+  // is reset between them, so constants such as class bitmaps are shared.
+  CodeGenSession S("");
+  S.M = std::make_unique<Module>("regjit_aot", *S.Ctx);
+  S.M->setDataLayout(TM->createDataLayout());
+  S.M->setTargetTriple(TM->getTargetTriple().str());
+  S.DFAMaxStates = DirectDFAMaxStates.load(std::memory_order_relaxed);
+  for (const auto& p : patterns) {
+    try {
+      auto ast = optimizeAlternations(parseRegex(p.Pattern));
+      S.FunctionName = p.Name;
+      S.MatchF = nullptr;
+      S.StepsLeft = nullptr;
+      S.BudgetExceededBB = nullptr;
+      S.PrefilterByte = -1;
+      Func(std::move(ast)).CodeGen(S);
+    } catch (const std::exception& e) {
+      throw std::runtime_error("'" + p.Name + "' (line " + std::to_string(p.Line) + "): " + e.what());
+    }
+  }
+
+  if (verifyModule(*S.M, &errs())) throw std::runtime_error("module verification failed");
+  // Build time can afford LLVM's full pipeline
+  OptimizeModule(*S.M, REGJIT_OPT_O2);
+  auto Obj = SimpleCompiler(*TM)(*S.M);
+  if (!Obj) throw std::runtime_error("code generation failed: " + errorText(Obj.takeError()));
+  return (*Obj)->getBuffer().str();
+}
+
+std::string aotHeader(const std::vector<AotPattern>& patterns, const std::string& guard) {
+  std::string h;
+  h += "/* Generated by regjitc; do not edit. */\n";
+  h += "#ifndef " + guard + "\n#define " + guard + "\n\n";
+  h += "#include <stddef.h>\n#include <stdint.h>\n\n";
+  h += "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n";
+  h += "/* Each searches data[0, len) for the leftmost match of its pattern.\n"
+       "   Returns 1 and sets *start_out and *end_out to the match's bounds,\n"
+       "   or 0 if there is none. They call the runtime in libregjit_rt.a,\n"
+       "   which `make NAME.a` archives with them. */\n\n";
+  for (const auto& p : patterns) {
+    h += "/* " + commentText(p.Pattern) + " */\n";
+    h += "int " + p.Name + "(const char* data, size_t len, int64_t* start_out, int64_t* end_out);\n";
+  }
+  h += "\n#ifdef __cplusplus\n}\n#endif\n\n#endif /* " + guard + " */\n";
+  return h;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <istream>
+#include <string>
+#include <vector>
+
+// Ahead-of-time compilation (regjitc).
+//
+// Patterns known at build time can be compiled into an ordinary object
+// file instead of at startup: each becomes a C function with the signature
+// of every generated matcher (RegjitMatchFn),
+//
+//   int name(const char* data, size_t len, int64_t* start_out, int64_t* end_out);
+//
+// generated by the same parser, AST CodeGen and OptimizeModule() the JIT
+// uses. The object only calls libc and the runtime helpers in
+// regjit_runtime.cpp and regjit_teddy.cpp, so a program links it with
+// libregjit_rt.a and needs neither LLVM nor a JIT at run time.
+//
+// Differences from the JIT: large literal alternations get the trie-shaped
+// backtracking code instead of an Aho-Corasick automaton (which lives in
+// the compiling process), and there is no step budget.
+
+struct AotPattern {
+  std::string Name;    // C symbol of the matcher
+  std::string Pattern;
+  int Line = 0;        // manifest line, for messages
+};
+
+struct AotTarget {
+  // CPU to tune and select instructions for: empty for the baseline of the
+  // host architecture (runs on any CPU of it), "native" for this machine
+  std::string CPU;
+  std::string Features; // extra subtarget features, e.g. "+avx2,+bmi2"
+};
+
+// Read a manifest: one "name pattern" per line, the pattern being the rest
+// of the line after the blanks that follow the name. Blank lines and lines
+// starting with '#' are skipped. Throws std::runtime_error naming the line
+// for a bad or repeated name or a missing pattern.
+std::vector<AotPattern> parseAotManifest(std::istream& in);
+
+// Generate every pattern into one module, optimize it and return the
+// relocatable object file. Throws std::runtime_error naming the pattern
+// that fails to parse or compile.
+std::string compileAotObject(const std::vector<AotPattern>& patterns, const AotTarget& target);
+
+// C/C++ header declaring the matchers in the object.
+std::string aotHeader(const std::vector<AotPattern>& patterns, const std::string& guard);
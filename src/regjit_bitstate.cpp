@@ -0,0 +1,121 @@
+#include "regjit_bitstate.h"
+#include <algorithm>
+
+struct BitState::Scratch {
+  std::vector<uint64_t> visited; // bit id * (len + 1) + offset
+  std::vector<std::pair<uint32_t, size_t>> stack;
+};
+
+namespace {
+
+bool assertHolds(uint32_t kind, const uint8_t* p, size_t len, size_t i) {
+  switch (kind) {
+    case AssertBeginText: return i == 0;
+    case AssertEndText: return i == len;
+    case AssertWordBoundary:
+    case AssertNonWordBoundary: {
+      bool prevWord = i > 0 && isWordByte(p[i - 1]);
+      bool nextWord = i < len && isWordByte(p[i]);
+      return (prevWord != nextWord) == (kind == AssertWordBoundary);
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+BitState::BitState(const Root& ast, size_t maxVisitedBits)
+    : prog(compileProg(ast, false)), maxVisitedBits(maxVisitedBits), fallback(ast) {}
+
+BitState::~BitState() = default;
+
+size_t BitState::maxInputLength() const {
+  size_t positions = maxVisitedBits / prog->size();
+  return positions == 0 ? 0 : positions - 1;
+}
+
+BitState::Scratch* BitState::acquireScratch() {
+  {
+    std::lock_guard<std::mutex> lk(poolMutex);
+    if (!freeList.empty()) {
+      Scratch* s = freeList.back();
+      freeList.pop_back();
+      return s;
+    }
+  }
+  auto s = std::make_unique<Scratch>();
+  std::lock_guard<std::mutex> lk(poolMutex);
+  pool.push_back(std::move(s));
+  return pool.back().get();
+}
+
+void BitState::releaseScratch(Scratch* s) {
+  std::lock_guard<std::mutex> lk(poolMutex);
+  freeList.push_back(s);
+}
+
+// Depth-first search for a match starting at `start`. Jobs on the stack are
+// the lower-priority branches of the Splits passed so far. Visited bits are
+// kept across start positions: a pair that failed for an earlier start
+// fails for this one too.
+bool BitState::tryMatch(Scratch& s, const uint8_t* p, size_t len, size_t start, int64_t* end_out) {
+  const Prog& P = *prog;
+  const size_t stride = len + 1;
+  s.stack.clear();
+  s.stack.emplace_back(P.start, start);
+  while (!s.stack.empty()) {
+    auto [id, i] = s.stack.back();
+    s.stack.pop_back();
+    // Follow the preferred branch until it dies, pushing the alternatives
+    for (;;) {
+      size_t bit = static_cast<size_t>(id) * stride + i;
+      uint64_t mask = uint64_t(1) << (bit & 63);
+      if (s.visited[bit >> 6] & mask) break;
+      s.visited[bit >> 6] |= mask;
+
+      const ProgInst& inst = P.insts[id];
+      if (inst.op == ProgInst::ByteSet) {
+        if (i == len || !P.sets[inst.arg][p[i]]) break;
+        id = inst.out;
+        ++i;
+      } else if (inst.op == ProgInst::Split) {
+        s.stack.emplace_back(inst.out1, i);
+        id = inst.out;
+      } else if (inst.op == ProgInst::Jmp) {
+        id = inst.out;
+      } else if (inst.op == ProgInst::Assert) {
+        if (!assertHolds(inst.arg, p, len, i)) break;
+        id = inst.out;
+      } else { // Match: the first one reached is the preferred one
+        *end_out = static_cast<int64_t>(i);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int BitState::search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) {
+  *start_out = -1;
+  *end_out = -1;
+  if (!data && len != 0) return -1;
+  if (len > maxInputLength()) return fallback.search(data, len, start_out, end_out);
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  Scratch* s = acquireScratch();
+  size_t words = (prog->size() * (len + 1) + 63) / 64;
+  if (s->visited.size() < words) s->visited.resize(words);
+  std::fill(s->visited.begin(), s->visited.begin() + words, 0);
+
+  int found = 0;
+  size_t lastStart = prog->anchoredStart ? 0 : len;
+  for (size_t i = 0; i <= lastStart; ++i) {
+    if (tryMatch(*s, p, len, i, end_out)) {
+      *start_out = static_cast<int64_t>(i);
+      found = 1;
+      break;
+    }
+  }
+  releaseScratch(s);
+  return found;
+}
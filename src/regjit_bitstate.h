@@ -0,0 +1,52 @@
+#pragma once
+#include "regjit_pike.h"
+#include <mutex>
+
+// BitState: a backtracking matcher over a Prog that memoizes what it has
+// already explored.
+//
+// It walks the program depth-first in priority order, like the JIT's
+// backtracking codegen would, but marks every (instruction, input offset)
+// pair it visits in a bitmap and never expands a pair twice. A pair that was
+// expanded once and did not lead to a match cannot lead to one later (the
+// outcome only depends on the instruction and the offset), so a search
+// costs at most O(prog size * len) steps even on (a|aa)*b or (ba+)+c, with
+// the constant factor of a plain backtracker: no thread lists to copy and
+// no work for threads that a higher-priority one already beat.
+//
+// The bitmap has prog size * (len + 1) bits, so this only pays off for
+// short inputs. Inputs whose bitmap would exceed `maxVisitedBits` are
+// handed to a Pike VM built from the same pattern instead.
+//
+// Matching is leftmost-first with Python re preferences, same as the Pike VM.
+class BitState : public ProgMatcher {
+public:
+  // 256 Kbit (32 KiB): a 60-instruction program covers ~4 KB of input.
+  static constexpr size_t kDefaultMaxVisitedBits = 256 * 1024;
+
+  // Throws std::runtime_error if the pattern cannot be compiled to a Prog.
+  explicit BitState(const Root& ast, size_t maxVisitedBits = kDefaultMaxVisitedBits);
+  ~BitState() override;
+
+  int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) override;
+
+  // Longest input searched with the bitmap; longer ones go to the Pike VM.
+  size_t maxInputLength() const;
+
+  struct Scratch;
+
+private:
+  std::unique_ptr<Prog> prog;
+  size_t maxVisitedBits;
+  PikeVM fallback;
+
+  // Bitmaps and job stacks are reused across searches; concurrent searches
+  // each take their own from this pool.
+  std::mutex poolMutex;
+  std::vector<std::unique_ptr<Scratch>> pool;
+  std::vector<Scratch*> freeList;
+
+  Scratch* acquireScratch();
+  void releaseScratch(Scratch* s);
+  bool tryMatch(Scratch& s, const uint8_t* p, size_t len, size_t start, int64_t* end_out);
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -7,12 +8,65 @@ extern "C" {
 
 // Match result structure - compatible with Python re.Match
 typedef struct {
-    int matched;    // 1 if matched, 0 if not matched, -1 on error
-    int start;      // start position of match (-1 if no match)
-    int end;        // end position of match (-1 if no match)
+    int matched;    // 1 if matched, 0 if not matched, -1 on error,
+                    // REGJIT_BUDGET_EXCEEDED if the step budget ran out
+    int64_t start;  // start position of match (-1 if no match)
+    int64_t end;    // end position of match (-1 if no match)
 } regjit_match_result;
 
+// regjit_match_result.matched (and the generated function's return value)
+// when a pattern compiled with a step budget gave up; no match is reported.
+#define REGJIT_BUDGET_EXCEEDED (-2)
+
+// Matching engines
+typedef enum {
+    REGJIT_ENGINE_BACKTRACK = 0, // JIT-compiled matcher: direct-coded DFA or backtracking (default)
+    REGJIT_ENGINE_LAZY_DFA  = 1, // lazily built DFA: linear-time scan, no JIT compile
+    REGJIT_ENGINE_PIKE_VM   = 2, // NFA simulation: O(len * pattern size), no state cache
+    REGJIT_ENGINE_AUTO      = 3, // JIT, or BitState for patterns with nested quantifiers
+                                 // that the JIT would have to backtrack through
+    REGJIT_ENGINE_BITSTATE  = 4, // memoized backtracking: O(len * pattern size) on inputs up
+                                 // to a few KB, the Pike VM on longer ones
+    REGJIT_ENGINE_TIERED    = 5  // BitState from the first call, the JIT compiled in the
+                                 // background once the pattern is hot (tier_up_*) if it
+                                 // gets a direct-coded DFA or literal search
+} regjit_engine;
+
+// Optimization applied to the LLVM IR of JIT-compiled matchers. O1-O3 are
+// LLVM's standard pipelines; REGEX is a short one for the single-function
+// IR the code generator emits (promote locals to registers, combine and
+// simplify, GVN, and LICM only for functions with loops).
+typedef enum {
+    REGJIT_OPT_O0    = 0, // no IR optimization
+    REGJIT_OPT_O1    = 1,
+    REGJIT_OPT_O2    = 2,
+    REGJIT_OPT_O3    = 3,
+    REGJIT_OPT_REGEX = 4  // default
+} regjit_opt_level;
+
+// Per-pattern compile options; initialize with regjit_options_init().
+typedef struct {
+    regjit_engine engine;
+    size_t dfa_cache_bytes; // LAZY_DFA: state cache budget per concurrent search (0 = 1 MiB)
+    // Backtracking matcher: maximum number of backtracking steps (an
+    // alternative or repeat restoring the position, or the search loop
+    // moving to the next start) per call before it returns
+    // REGJIT_BUDGET_EXCEEDED. 0 = unlimited, and no counting code is
+    // generated. Linear-time matchers (direct-coded DFA, LAZY_DFA, PIKE_VM,
+    // BITSTATE) never need it and ignore it.
+    uint64_t step_budget;
+    // TIERED: queue the JIT compile after this many searches or this many
+    // input bytes, whichever comes first; 0 disables that trigger, both 0
+    // keep the pattern interpreted. Defaults 1000 searches, 1 MiB.
+    uint64_t tier_up_calls;
+    uint64_t tier_up_bytes;
+    // JIT-compiled matchers (BACKTRACK, AUTO, TIERED): see regjit_opt_level
+    regjit_opt_level opt_level;
+} regjit_options;
+
 // Minimal C API for RegJIT
+// Match functions take the input as (buf, len). The buffer is matched in
+// place: it need not be NUL-terminated and may contain embedded NUL bytes.
 // Returns 1 on success, 0 on failure. On failure err_msg may be allocated with strdup.
 int regjit_compile(const char* pattern, char** err_msg);
 
@@ -34,14 +88,93 @@ regjit_match_result regjit_match_at_start(const char* pattern, const char* buf,
 // Returns match result with start/end positions
 regjit_match_result regjit_search(const char* pattern, const char* buf, size_t len);
 
-// Unload compiled pattern (free resources)
+// Handle API: compile (or look up) a pattern once and keep it pinned in the
+// cache, so regjit_exec() is a direct call into the JIT code with no cache
+// lookup, locking or refcounting on the match path.
+typedef struct regjit_handle regjit_handle;
+
+// Returns a new handle, or NULL on failure (err_msg may be set, strdup).
+regjit_handle* regjit_open(const char* pattern, char** err_msg);
+
+// Fill opts with the defaults used by regjit_open().
+void regjit_options_init(regjit_options* opts);
+
+// Like regjit_open() with explicit options (NULL = defaults). The same
+// pattern opened with different options is cached as separate entries.
+regjit_handle* regjit_open_ex(const char* pattern, const regjit_options* opts, char** err_msg);
+
+// Search for the pattern in buf[0, len). Thread-safe: one handle may be used
+// from several threads at once.
+regjit_match_result regjit_exec(const regjit_handle* h, const char* buf, size_t len);
+
+// 1 if h's searches run JIT code, 0 if they are interpreted: always for
+// the LAZY_DFA, PIKE_VM and BITSTATE engines, and for TIERED until its
+// background compile is done or, for patterns it never promotes, for good.
+int regjit_tier(const regjit_handle* h);
+
+// Drop the handle's reference; the compiled code becomes evictable again.
+void regjit_close(regjit_handle* h);
+
+// Asynchronous open, for compiling patterns ahead of use without blocking
+// the caller. The pattern is compiled (or found in the cache) on a compile
+// pool thread, which then calls callback(h, NULL, userdata) with a new
+// handle for the callback's owner to regjit_close(), or on failure
+// callback(NULL, err_msg, userdata); err_msg is valid during the call only.
+// Returns 1 when queued, 0 if pattern or callback is NULL.
+typedef void (*regjit_compile_callback)(regjit_handle* h, const char* err_msg, void* userdata);
+int regjit_compile_async(const char* pattern, regjit_compile_callback callback, void* userdata);
+int regjit_compile_async_ex(const char* pattern, const regjit_options* opts, regjit_compile_callback callback,
+                            void* userdata);
+
+// Run at most n compiles at once on the pool shared by regjit_compile_async()
+// and TIERED tier-up (0 = one per hardware thread, the default).
+void regjit_set_compile_threads(size_t n);
+
+// Unload compiled pattern (free resources). Patterns that are still acquired
+// or held by an open handle are left loaded. Like regjit_acquire/release,
+// this addresses the entry compiled with default options.
 void regjit_unload(const char* pattern);
 
 // Cache helpers
 size_t regjit_cache_size();
 void regjit_set_cache_maxsize(size_t n);
 
+// Patterns without lazy quantifiers are compiled to a direct-coded DFA (one
+// block of machine code per state) when the minimized DFA has at most
+// max_states states; larger ones, and all patterns when max_states is 0, use
+// the backtracking code generator. Default 256. Applies to patterns compiled
+// after the call; already cached ones keep their code.
+void regjit_set_dfa_codegen_limit(size_t max_states);
+
+// Before running the pattern, generated code scans with memchr for a byte
+// every match must contain; when there are several, the one ranked rarest
+// by a byte frequency model. The built-in model was measured on prose,
+// source code, JSON and logs. Training replaces it with byte counts from a
+// sample of your own data; reset restores the built-in one. Both apply to
+// patterns compiled after the call.
+void regjit_train_byte_frequencies(const char* sample, size_t len);
+void regjit_reset_byte_frequencies(void);
+
+// The byte h's matcher scans for with memchr, or -1 when it uses no
+// single-byte prefilter (pure literals, Teddy, Aho-Corasick, non-JIT
+// engines, or no byte is required).
+int regjit_prefilter_byte(const regjit_handle* h);
+
+// Persistent object cache: compiled matchers are stored as object files in
+// dir (created if missing), and later processes load them from there
+// instead of compiling the pattern again. Entries are keyed by pattern,
+// options, RegJIT and LLVM version and host CPU. When the files exceed
+// max_bytes (0 = 256 MiB) the least recently used ones are deleted. dir
+// NULL or "" turns the cache off, the default. Applies to patterns compiled
+// after the call. Returns 1 on success, 0 if dir cannot be created.
+int regjit_set_object_cache(const char* dir, uint64_t max_bytes);
+
+// Since the last regjit_set_object_cache(): matchers loaded from the cache
+// and matchers compiled and stored into it.
+void regjit_object_cache_stats(uint64_t* loaded, uint64_t* stored);
+
 // Get raw JIT function pointer for fast matching (caller must ensure pattern stays compiled)
+// Signature: int fn(const char* buf, size_t len, int64_t* start_out, int64_t* end_out)
 // Returns function pointer address, or 0 on error
 uintptr_t regjit_get_func_ptr(const char* pattern);
 
@@ -0,0 +1,403 @@
+#include "regjit_dfa.h"
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+enum : uint8_t {
+  FlagBegin = 1,    // no byte precedes this position in scan direction
+  FlagPrevWord = 2, // the byte preceding this position is a word character
+  FlagMatch = 4     // the transition into this state passed a Match: a match
+                    // ends just before the byte that was consumed
+};
+
+struct DState {
+  std::vector<uint32_t> insts;     // NFA threads, highest priority first
+  uint8_t flags = 0;
+  std::unique_ptr<DState*[]> next; // per byte class, plus end of text; null = not built yet
+};
+
+struct KeyHash {
+  size_t operator()(const std::vector<uint32_t>& k) const {
+    uint64_t h = 1469598103934665603ULL;
+    for (uint32_t v : k) h = (h ^ v) * 1099511628211ULL;
+    return static_cast<size_t>(h);
+  }
+};
+
+// States of one DFA (one direction) plus scratch space for building them.
+struct DFAStates {
+  const Prog* prog = nullptr;
+  bool longest = false;         // keep going after a Match instead of cutting lower priorities
+  std::vector<uint8_t> classRep; // one byte of each class
+  std::unordered_map<std::vector<uint32_t>, DState*, KeyHash> map;
+  std::vector<std::unique_ptr<DState>> states;
+  DState* starts[4] = {};
+  DState dead;                  // no threads, no match
+  size_t bytes = 0;
+
+  std::vector<uint32_t> stack;
+  std::vector<uint32_t> mark;   // closure visited marks (== gen)
+  std::vector<uint32_t> queued; // next-kernel dedup marks (== gen)
+  std::vector<uint32_t> kernel;
+  std::vector<uint32_t> key;
+  uint32_t gen = 0;
+
+  void init(const Prog* p, bool longestMatch) {
+    prog = p;
+    longest = longestMatch;
+    classRep.assign(p->numClasses, 0);
+    for (int b = 255; b >= 0; --b) classRep[p->byteClass[b]] = static_cast<uint8_t>(b);
+    mark.assign(p->size(), 0);
+    queued.assign(p->size(), 0);
+    dead.next.reset(new DState*[p->numClasses + 1]);
+    for (int i = 0; i <= p->numClasses; ++i) dead.next[i] = &dead;
+  }
+
+  void flush() {
+    map.clear();
+    states.clear();
+    for (auto& s : starts) s = nullptr;
+    bytes = 0;
+  }
+
+  size_t stateCost(size_t ninsts) const {
+    // state + transition table + map node with its key
+    return sizeof(DState) + (prog->numClasses + 1) * sizeof(DState*) +
+           2 * (ninsts + 1) * sizeof(uint32_t) + 64;
+  }
+
+  // Keep only the flags the program can observe, so states that differ in
+  // irrelevant context are shared.
+  uint8_t normalize(uint8_t flags) const {
+    if (!prog->usesBeginText) flags &= ~FlagBegin;
+    if (!prog->usesWordAssert) flags &= ~FlagPrevWord;
+    return flags;
+  }
+
+  DState* find(const std::vector<uint32_t>& insts, uint8_t flags) {
+    if (insts.empty() && !(flags & FlagMatch)) return &dead;
+    key.assign(insts.begin(), insts.end());
+    key.push_back(flags);
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : it->second;
+  }
+
+  DState* create(const std::vector<uint32_t>& insts, uint8_t flags) {
+    auto s = std::make_unique<DState>();
+    s->insts = insts;
+    s->flags = flags;
+    s->next.reset(new DState*[prog->numClasses + 1]());
+    bytes += stateCost(insts.size());
+    key.assign(insts.begin(), insts.end());
+    key.push_back(flags);
+    DState* raw = s.get();
+    map.emplace(key, raw);
+    states.push_back(std::move(s));
+    return raw;
+  }
+
+  bool assertHolds(uint32_t kind, uint8_t flags, bool atEnd, bool nextWord) const {
+    bool prevWord = flags & FlagPrevWord;
+    switch (kind) {
+      case AssertBeginText: return flags & FlagBegin;
+      case AssertEndText: return atEnd;
+      case AssertWordBoundary: return prevWord != nextWord;
+      case AssertNonWordBoundary: return prevWord == nextWord;
+    }
+    return false;
+  }
+
+  // Follow the empty-width closure of `s` given the upcoming byte class
+  // (numClasses = end of text), then step every thread over that byte.
+  // Leaves the successor threads in `kernel` and returns its flags.
+  uint8_t successor(const DState* s, int cls) {
+    const Prog& P = *prog;
+    const bool atEnd = cls == P.numClasses;
+    const unsigned char rep = atEnd ? 0 : classRep[cls];
+    const bool nextWord = !atEnd && isWordByte(rep);
+    bool matched = false;
+
+    if (++gen == 0) {
+      std::fill(mark.begin(), mark.end(), 0);
+      std::fill(queued.begin(), queued.end(), 0);
+      gen = 1;
+    }
+    kernel.clear();
+    for (uint32_t root : s->insts) {
+      stack.push_back(root);
+      while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        if (mark[id] == gen) continue;
+        mark[id] = gen;
+        const ProgInst& inst = P.insts[id];
+        switch (inst.op) {
+          case ProgInst::ByteSet:
+            if (!atEnd && P.sets[inst.arg][rep] && queued[inst.out] != gen) {
+              queued[inst.out] = gen;
+              kernel.push_back(inst.out);
+            }
+            break;
+          case ProgInst::Split:
+            stack.push_back(inst.out1);
+            stack.push_back(inst.out);
+            break;
+          case ProgInst::Jmp:
+            stack.push_back(inst.out);
+            break;
+          case ProgInst::Assert:
+            if (assertHolds(inst.arg, s->flags, atEnd, nextWord)) stack.push_back(inst.out);
+            break;
+          case ProgInst::Match:
+            matched = true;
+            if (!longest) {
+              // Leftmost-first: every thread not yet explored has lower
+              // priority than this match, so drop them all.
+              stack.clear();
+              goto done;
+            }
+            break;
+        }
+      }
+    }
+  done:
+    uint8_t flags = matched ? FlagMatch : 0;
+    if (nextWord) flags |= FlagPrevWord;
+    if (atEnd) kernel.clear();
+    return normalize(flags);
+  }
+
+  DState* start(bool atBegin, bool prevWord, uint32_t entry, size_t budget, size_t& resets) {
+    uint8_t flags = normalize((atBegin ? FlagBegin : 0) | (prevWord ? FlagPrevWord : 0));
+    int slot = flags & 3;
+    if (starts[slot]) return starts[slot];
+    kernel.assign(1, entry);
+    DState* s = find(kernel, flags);
+    if (!s) {
+      if (bytes + stateCost(kernel.size()) > budget && !states.empty()) {
+        flush();
+        ++resets;
+      }
+      s = create(kernel, flags);
+    }
+    starts[slot] = s;
+    return s;
+  }
+
+  // Build (or find) the transition of `s` on byte class `cls`. May flush
+  // the cache, in which case `s` is rebuilt first; callers must only use the
+  // returned state afterwards.
+  DState* transition(DState* s, int cls, size_t budget, size_t& resets) {
+    uint8_t flags = successor(s, cls);
+    DState* t = find(kernel, flags);
+    if (!t) {
+      if (bytes + stateCost(kernel.size()) > budget && !states.empty()) {
+        std::vector<uint32_t> keepInsts = s->insts;
+        uint8_t keepFlags = s->flags;
+        std::vector<uint32_t> nextInsts = kernel;
+        flush();
+        ++resets;
+        s = create(keepInsts, keepFlags);
+        kernel.swap(nextInsts);
+      }
+      t = create(kernel, flags);
+    }
+    s->next[cls] = t;
+    return t;
+  }
+};
+
+} // namespace
+
+struct LazyDFA::Cache {
+  DFAStates fwd;
+  DFAStates rev;
+  size_t resets = 0;
+};
+
+LazyDFA::LazyDFA(const Root& ast, size_t budget)
+  : fwd(compileProg(ast, false)), rev(compileProg(ast, true)),
+    cacheBytes(budget ? budget : kDefaultCacheBytes) {}
+
+LazyDFA::~LazyDFA() = default;
+
+LazyDFA::Cache* LazyDFA::acquireCache() {
+  {
+    std::lock_guard<std::mutex> lk(poolMutex);
+    if (!freeList.empty()) {
+      Cache* c = freeList.back();
+      freeList.pop_back();
+      return c;
+    }
+  }
+  auto c = std::make_unique<Cache>();
+  c->fwd.init(fwd.get(), false);
+  c->rev.init(rev.get(), true);
+  std::lock_guard<std::mutex> lk(poolMutex);
+  pool.push_back(std::move(c));
+  return pool.back().get();
+}
+
+void LazyDFA::releaseCache(Cache* c) {
+  std::lock_guard<std::mutex> lk(poolMutex);
+  freeList.push_back(c);
+}
+
+size_t LazyDFA::cacheResets() const {
+  std::lock_guard<std::mutex> lk(poolMutex);
+  size_t n = 0;
+  for (const auto& c : pool) n += c->resets;
+  return n;
+}
+
+int LazyDFA::search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) {
+  *start_out = -1;
+  *end_out = -1;
+  if (!data && len != 0) return -1;
+
+  Cache* c = acquireCache();
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const size_t budget = cacheBytes / 2; // split between the two directions
+
+  // Forward: find where the leftmost-first match ends.
+  DFAStates& f = c->fwd;
+  const int fEnd = fwd->numClasses;
+  DState* s = f.start(true, false, fwd->anchoredStart ? fwd->start : fwd->startUnanchored,
+                      budget, c->resets);
+  int64_t matchEnd = -1;
+  bool stopped = false;
+  for (size_t i = 0; i < len; ++i) {
+    int cls = fwd->byteClass[p[i]];
+    DState* t = s->next[cls];
+    s = t ? t : f.transition(s, cls, budget, c->resets);
+    if (s->flags & FlagMatch) matchEnd = static_cast<int64_t>(i);
+    if (s->insts.empty()) { stopped = true; break; }
+  }
+  if (!stopped) {
+    DState* t = s->next[fEnd];
+    s = t ? t : f.transition(s, fEnd, budget, c->resets);
+    if (s->flags & FlagMatch) matchEnd = static_cast<int64_t>(len);
+  }
+  if (matchEnd < 0) {
+    releaseCache(c);
+    return 0;
+  }
+
+  // Backward from the end: the longest match of the reversed pattern gives
+  // the leftmost start.
+  DFAStates& r = c->rev;
+  const int rEnd = rev->numClasses;
+  size_t e = static_cast<size_t>(matchEnd);
+  s = r.start(e == len, e < len && isWordByte(p[e]), rev->start, budget, c->resets);
+  int64_t matchStart = -1;
+  stopped = false;
+  for (size_t i = e; i > 0; --i) {
+    int cls = rev->byteClass[p[i - 1]];
+    DState* t = s->next[cls];
+    s = t ? t : r.transition(s, cls, budget, c->resets);
+    if (s->flags & FlagMatch) matchStart = static_cast<int64_t>(i);
+    if (s->insts.empty()) { stopped = true; break; }
+  }
+  if (!stopped) {
+    DState* t = s->next[rEnd];
+    s = t ? t : r.transition(s, rEnd, budget, c->resets);
+    if (s->flags & FlagMatch) matchStart = 0;
+  }
+  releaseCache(c);
+
+  if (matchStart < 0) return -1; // cannot happen: the forward scan saw a match
+  *start_out = matchStart;
+  *end_out = matchEnd;
+  return 1;
+}
+
+bool buildDenseDFA(const Prog& prog, uint32_t entry, bool longest, size_t maxStates,
+                   DenseDFA& out) {
+  const int C = prog.numClasses;
+  const size_t buildLimit = maxStates * 4;
+  const size_t unlimited = SIZE_MAX;
+  size_t resets = 0;
+  DFAStates d;
+  d.init(&prog, longest);
+
+  // Raw states in discovery order, the dead state first.
+  std::vector<DState*> order{&d.dead};
+  std::unordered_map<DState*, uint32_t> index{{&d.dead, 0}};
+  auto idOf = [&](DState* s) -> int64_t {
+    auto it = index.find(s);
+    if (it != index.end()) return it->second;
+    if (order.size() >= buildLimit) return -1;
+    index.emplace(s, static_cast<uint32_t>(order.size()));
+    order.push_back(s);
+    return static_cast<int64_t>(order.size() - 1);
+  };
+
+  uint32_t starts[4];
+  for (int slot = 0; slot < 4; ++slot) {
+    int64_t id = idOf(d.start(slot & 1, slot & 2, entry, unlimited, resets));
+    if (id < 0) return false;
+    starts[slot] = static_cast<uint32_t>(id);
+  }
+
+  std::vector<uint32_t> next;
+  std::vector<uint8_t> matchOnEntry, matchAtEnd, finished;
+  for (size_t i = 0; i < order.size(); ++i) {
+    DState* s = order[i];
+    matchOnEntry.push_back((s->flags & FlagMatch) ? 1 : 0);
+    finished.push_back(s->insts.empty() ? 1 : 0);
+    if (s->insts.empty()) {
+      next.insert(next.end(), C, 0);
+      matchAtEnd.push_back(0);
+      continue;
+    }
+    for (int cls = 0; cls < C; ++cls) {
+      int64_t id = idOf(d.transition(s, cls, unlimited, resets));
+      if (id < 0) return false;
+      next.push_back(static_cast<uint32_t>(id));
+    }
+    matchAtEnd.push_back((d.transition(s, C, unlimited, resets)->flags & FlagMatch) ? 1 : 0);
+  }
+
+  // Moore's partition refinement: start from what a state reports, split
+  // blocks whose members move to different blocks on some class, stop when
+  // no block splits. Numbering blocks by first member keeps dead at 0.
+  const size_t n = order.size();
+  std::vector<uint32_t> block(n), refined(n);
+  std::map<std::vector<uint32_t>, uint32_t> ids;
+  std::vector<uint32_t> key;
+  for (size_t s = 0; s < n; ++s) {
+    key = {matchOnEntry[s], matchAtEnd[s], finished[s]};
+    block[s] = ids.emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+  }
+  size_t count = ids.size();
+  for (;;) {
+    ids.clear();
+    for (size_t s = 0; s < n; ++s) {
+      key.assign(1, block[s]);
+      for (int cls = 0; cls < C; ++cls) key.push_back(block[next[s * C + cls]]);
+      refined[s] = ids.emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+    }
+    if (ids.size() == count) break;
+    count = ids.size();
+    block.swap(refined);
+  }
+  if (count > maxStates) return false;
+
+  out.numClasses = C;
+  std::memcpy(out.byteClass, prog.byteClass, sizeof(out.byteClass));
+  out.next.assign(count * C, 0);
+  out.matchOnEntry.assign(count, 0);
+  out.matchAtEnd.assign(count, 0);
+  out.finished.assign(count, 0);
+  for (size_t s = 0; s < n; ++s) {
+    uint32_t b = block[s];
+    out.matchOnEntry[b] = matchOnEntry[s];
+    out.matchAtEnd[b] = matchAtEnd[s];
+    out.finished[b] = finished[s];
+    for (int cls = 0; cls < C; ++cls) out.next[b * C + cls] = block[next[s * C + cls]];
+  }
+  for (int slot = 0; slot < 4; ++slot) out.start[slot] = block[starts[slot]];
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "regjit_prog.h"
+#include <mutex>
+
+// Lazily built DFA over a Prog.
+//
+// DFA states are sets of NFA instructions, built by subset construction the
+// first time a (state, byte class) transition is taken and memoized after
+// that, so each input byte costs one table lookup once the working set of
+// states is warm. Matching is leftmost-first like the JIT matchers:
+//   1. a forward scan over the unanchored program finds where the
+//      leftmost-first match ends, stopping as soon as no thread can improve
+//      on it;
+//   2. a backward scan from that end over the reversed program, anchored and
+//      longest-match, finds where it starts.
+// Both scans are linear in the input no matter how the pattern nests.
+//
+// Unlike the JIT's backtracking codegen, which does not backtrack into a
+// repeat or an alternative once it has moved past it, this engine explores
+// every alternative: (a|ab)c matches "abc" and a*a matches "aaa".
+class LazyDFA : public ProgMatcher {
+public:
+  // Default budget for the states of one cache, see cacheBytes below.
+  static constexpr size_t kDefaultCacheBytes = 1 << 20;
+
+  // Throws std::runtime_error if the pattern cannot be compiled to a Prog.
+  LazyDFA(const Root& ast, size_t cacheBytes = 0);
+  ~LazyDFA() override;
+
+  int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) override;
+
+  // Number of times a state cache hit its budget and was flushed, summed
+  // over all caches (for tests and tuning).
+  size_t cacheResets() const;
+
+  struct Cache;
+
+private:
+  std::unique_ptr<Prog> fwd; // unanchored, finds the match end
+  std::unique_ptr<Prog> rev; // reversed, finds the match start
+  // Each cache holds the states of one forward and one reverse DFA and may
+  // use at most this many bytes. When a new state would not fit, the cache
+  // is flushed and rebuilt from the state the scan is in, so memory stays
+  // bounded and a scan never has to give up.
+  size_t cacheBytes;
+
+  // Caches are mutable, so concurrent searches each take their own from
+  // this pool and put it back afterwards.
+  mutable std::mutex poolMutex;
+  std::vector<std::unique_ptr<Cache>> pool;
+  std::vector<Cache*> freeList;
+
+  Cache* acquireCache();
+  void releaseCache(Cache* c);
+};
+
+// Complete, minimized DFA over one Prog, built ahead of time so the JIT can
+// emit it as straight-line code (one basic block per state, see
+// Func::CodeGen). Same state semantics as the lazy DFA above; state 0 is the
+// dead state.
+struct DenseDFA {
+  int numClasses = 0;
+  uint8_t byteClass[256] = {};
+  std::vector<uint32_t> next;        // next[state * numClasses + byte class]
+  std::vector<uint8_t> matchOnEntry; // entering the state passed a Match: a
+                                     // match ends just before the consumed byte
+  std::vector<uint8_t> matchAtEnd;   // reaching the end of text here completes a match
+  std::vector<uint8_t> finished;     // no threads left, scanning on changes nothing
+  uint32_t start[4] = {};            // by (atBegin ? 1 : 0) | (prevWord ? 2 : 0)
+
+  size_t size() const { return matchOnEntry.size(); }
+};
+
+// Run subset construction over `prog` from `entry` to completion
+// (leftmost-first, or longest-match with `longest`), then merge equivalent
+// states. Returns false when the minimized DFA would have more than
+// `maxStates` states, or construction exceeds a small multiple of that.
+bool buildDenseDFA(const Prog& prog, uint32_t entry, bool longest, size_t maxStates,
+                   DenseDFA& out);
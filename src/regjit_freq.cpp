@@ -0,0 +1,66 @@
+#include "regjit_freq.h"
+#include <algorithm>
+#include <mutex>
+
+namespace {
+// Rank of each byte value, 0 = rarest. Control bytes other than \t \n \r
+// come first and most bytes >= 0x80 (UTF-8 sequences) next; letters,
+// digits and common punctuation are at the top, and space is the most
+// common byte.
+const ByteFrequencies kBuiltinFrequencies = {{
+      0,   1,   2,   3,   4,   5,   6,   7,   8, 183, 246,   9,  96, 187,  10,  11,  // 0x00
+     12,  13,  14,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  // 0x10
+    255, 158, 251, 189, 160, 162, 168, 172, 220, 218, 212, 196, 231, 241, 236, 208,  // 0x20
+    232, 234, 233, 222, 224, 217, 216, 203, 195, 191, 238, 186, 184, 197, 185, 148,  // 0x30
+    166, 205, 190, 210, 198, 219, 192, 194, 181, 215, 169, 182, 214, 199, 209, 206,  // 0x40
+    207, 164, 204, 226, 213, 193, 179, 173, 188, 177, 170, 176, 171, 175, 150, 239,  // 0x50
+    167, 252, 229, 242, 243, 254, 227, 228, 230, 249, 178, 223, 244, 235, 250, 247,  // 0x60
+    240, 174, 245, 248, 253, 237, 221, 211, 202, 225, 180, 201, 161, 200, 165,  28,  // 0x70
+    149, 147, 113, 107,  76,  89, 124, 156,  87,  88,  29,  93,  92, 137,  73,  81,  // 0x80
+     97,  94, 125, 105, 145,  75,  85, 106, 127, 143,  82, 110,  95,  91, 100, 157,  // 0x90
+    129, 153, 111, 131, 134,  98, 122, 130, 136, 152, 115, 144, 128, 146, 108, 109,  // 0xa0
+    135, 140, 120, 142, 119, 116, 126, 104, 138, 117, 139, 121, 132, 118, 133, 101,  // 0xb0
+     30,  31, 114, 163, 159, 151,  86, 102, 112, 123,  83,  32,  99,  33,  34,  74,  // 0xc0
+    103,  77,  35,  36,  37,  38,  39,  84,  40,  41,  42,  43,  44,  45,  46,  47,  // 0xd0
+     48, 141, 154,  70,  78,  90,  71,  79,  49,  80,  50,  51,  52,  53,  54,  72,  // 0xe0
+    155,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  // 0xf0
+}};
+
+std::mutex FreqMutex;
+ByteFrequencies CurrentFreq = kBuiltinFrequencies;
+}
+
+const ByteFrequencies& ByteFrequencies::builtin() { return kBuiltinFrequencies; }
+
+ByteFrequencies ByteFrequencies::train(const char* data, size_t len) {
+  size_t count[256] = {};
+  for (size_t i = 0; i < len; ++i) ++count[static_cast<unsigned char>(data[i])];
+  int order[256];
+  for (int b = 0; b < 256; ++b) order[b] = b;
+  std::sort(order, order + 256, [&](int a, int b) {
+    if (count[a] != count[b]) return count[a] < count[b];
+    return kBuiltinFrequencies.rank[a] < kBuiltinFrequencies.rank[b];
+  });
+  ByteFrequencies freq;
+  for (int r = 0; r < 256; ++r) freq.rank[order[r]] = static_cast<uint8_t>(r);
+  return freq;
+}
+
+ByteFrequencies currentByteFrequencies() {
+  std::lock_guard<std::mutex> lk(FreqMutex);
+  return CurrentFreq;
+}
+
+void setByteFrequencies(const ByteFrequencies& freq) {
+  std::lock_guard<std::mutex> lk(FreqMutex);
+  CurrentFreq = freq;
+}
+
+int rarestByte(const std::set<char>& bytes, const ByteFrequencies& freq) {
+  int best = -1;
+  for (char c : bytes) {
+    int b = static_cast<unsigned char>(c);
+    if (best < 0 || freq.rank[b] < freq.rank[best]) best = b;
+  }
+  return best;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <set>
+
+// Byte frequency model for choosing prefilter bytes.
+//
+// The search loop (and the direct-coded DFA) first scans with memchr for a
+// byte every match must contain. The rarer that byte is in the input, the
+// less often the scan stops, so among several required bytes the one with
+// the lowest rank wins. Ranks run from 0 (rarest) to 255 (most common).
+// The built-in table was measured on a mix of English prose, C source, JSON
+// and system logs, each weighted equally; train() builds one from a sample
+// of the caller's own data.
+
+struct ByteFrequencies {
+  uint8_t rank[256];
+
+  static const ByteFrequencies& builtin();
+  // Ranks by byte count in data[0, len). Bytes with equal counts (including
+  // the ones the sample never contains) keep their built-in order.
+  static ByteFrequencies train(const char* data, size_t len);
+};
+
+// The model used for patterns compiled from now on; builtin() until
+// setByteFrequencies() replaces it.
+ByteFrequencies currentByteFrequencies();
+void setByteFrequencies(const ByteFrequencies& freq);
+
+// Rarest byte of `bytes` under `freq`, or -1 when the set is empty.
+int rarestByte(const std::set<char>& bytes, const ByteFrequencies& freq);
@@ -0,0 +1,74 @@
+#include "regjit_inner.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Whether some live state of `d` can consume byte `b` and stay alive. A
+// move into a finished state only reports the match that ended before `b`.
+bool consumesByte(const DenseDFA& d, unsigned char b) {
+  const uint32_t cls = d.byteClass[b];
+  for (size_t k = 1; k < d.size(); ++k) {
+    if (d.finished[k]) continue;
+    uint32_t t = d.next[k * d.numClasses + cls];
+    if (t != 0 && !d.finished[t]) return true;
+  }
+  return false;
+}
+
+int rarestRank(const std::string& lit, const ByteFrequencies& freq) {
+  int best = 256;
+  for (unsigned char c : lit) best = std::min(best, int(freq.rank[c]));
+  return best;
+}
+
+struct Run {
+  size_t begin;
+  std::string literal;
+};
+
+} // namespace
+
+bool findInnerLiteral(const Root& ast, bool allowLeading, const ByteFrequencies& freq,
+                      InnerLiteral& out) {
+  auto* c = dynamic_cast<const Concat*>(&ast);
+  if (!c || ast.isAnchoredAtStart()) return false;
+
+  // Runs of consecutive literal elements; an anchor inside ends the run
+  std::vector<Run> runs;
+  const auto& v = c->BodyVec;
+  for (size_t i = 0; i < v.size();) {
+    if (v[i]->isZeroWidth() || !v[i]->isPureLiteral()) {
+      ++i;
+      continue;
+    }
+    Run r{i, ""};
+    for (; i < v.size() && !v[i]->isZeroWidth() && v[i]->isPureLiteral(); ++i) {
+      r.literal += v[i]->getLiteralPrefix();
+    }
+    if (!r.literal.empty() && (r.begin > 0 || allowLeading)) runs.push_back(std::move(r));
+  }
+  std::stable_sort(runs.begin(), runs.end(), [&](const Run& a, const Run& b) {
+    if (a.literal.size() != b.literal.size()) return a.literal.size() > b.literal.size();
+    return rarestRank(a.literal, freq) < rarestRank(b.literal, freq);
+  });
+
+  for (const Run& r : runs) {
+    InnerLiteral cand;
+    cand.literal = r.literal;
+    cand.prefixLen = r.begin;
+    if (r.begin > 0) {
+      try {
+        auto rev = compileProgPrefix(*c, r.begin, true);
+        if (!buildDenseDFA(*rev, rev->start, true, kInnerPrefixMaxStates, cand.prefixRev)) continue;
+      } catch (const std::runtime_error&) {
+        return false;
+      }
+      if (consumesByte(cand.prefixRev, static_cast<unsigned char>(r.literal[0]))) continue;
+    }
+    out = std::move(cand);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "regjit_dfa.h"
+#include "regjit_freq.h"
+#include <string>
+
+// Inner literal prefilter.
+//
+// Many patterns have no useful leading literal but a selective one inside:
+// \d+\.\d+, \w+@\w+\.com, [A-Z]+: error. When the top-level concatenation
+// is P L S with L a literal, the matcher can search for L with the
+// substring searcher and, at each occurrence i, run a reverse DFA of P back
+// from i to find where a match could start.
+//
+// That only finds the leftmost match if the occurrences partition the
+// candidate starts, so L's first byte must be one that P can never
+// consume. Then no match of P reaches across an occurrence of L: every
+// match that starts after the previous occurrence and at or before i uses
+// the occurrence at i, starts no earlier than the reverse scan says, and
+// the reverse scans together read each input byte at most once.
+
+// Largest reverse DFA built for a prefix, independent of
+// regjit_set_dfa_codegen_limit() since the backtracking codegen uses it too.
+constexpr size_t kInnerPrefixMaxStates = 256;
+
+struct InnerLiteral {
+  std::string literal;
+  size_t prefixLen = 0;  // top-level Concat elements before the literal
+  DenseDFA prefixRev;    // reverse DFA of those elements, anchored at the literal
+};
+
+// Pick the longest literal run among the top-level elements of `ast` that
+// satisfies the condition above, the one whose rarest byte is rarest under
+// `freq` among equally long runs. Runs at the very start (empty prefix)
+// count only with `allowLeading`. Returns false when there is none.
+bool findInnerLiteral(const Root& ast, bool allowLeading, const ByteFrequencies& freq,
+                      InnerLiteral& out);
@@ -0,0 +1,298 @@
+#include "regjit_objcache.h"
+#if __has_include("regjit_build_id.h")
+#include "regjit_build_id.h"
+#else
+// Built without the Makefile: tell builds apart by when this file was compiled
+#define REGJIT_BUILD_ID "unknown " __DATE__ " " __TIME__
+#endif
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Target/TargetMachine.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'J', 'O', 'B', 'J', '\0', '\0', '\1'};
+constexpr const char* kSuffix = ".rjo";
+
+struct CacheState {
+  std::mutex mu;
+  fs::path dir;          // empty when the cache is off
+  uint64_t maxBytes = 0;
+  uint64_t bytes = 0;    // size of the entries, as of the last scan plus stores since
+  uint64_t tmpId = 0;    // numbers this process's temporary files
+  ObjectCacheStats stats;
+};
+
+CacheState& state() {
+  static CacheState s;
+  return s;
+}
+
+uint64_t fnv1a(const char* p, size_t n) {
+  uint64_t h = 1469598103934665603ull;
+  for (size_t i = 0; i < n; ++i) {
+    h ^= static_cast<unsigned char>(p[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::string hex(uint64_t v) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+  return buf;
+}
+
+uint64_t processTag() {
+  static const uint64_t tag = [] {
+    std::random_device rd;
+    uint64_t t = (uint64_t(rd()) << 32) ^ rd();
+    return t ^ uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+  }();
+  return tag;
+}
+
+// Triple, CPU and features the JIT compiles for on this host
+// Null if the host cannot be detected
+const llvm::orc::JITTargetMachineBuilder* hostMachineBuilder() {
+  static const std::unique_ptr<llvm::orc::JITTargetMachineBuilder> builder = [] {
+    auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB) {
+      llvm::consumeError(JTMB.takeError());
+      return std::unique_ptr<llvm::orc::JITTargetMachineBuilder>();
+    }
+    return std::make_unique<llvm::orc::JITTargetMachineBuilder>(std::move(*JTMB));
+  }();
+  return builder.get();
+}
+
+const std::string& hostDescription() {
+  static const std::string desc = [] {
+    const auto* JTMB = hostMachineBuilder();
+    if (!JTMB) return std::string("unknown-host");
+    return JTMB->getTargetTriple().str() + "|" + JTMB->getCPU() + "|" + JTMB->getFeatures().getString();
+  }();
+  return desc;
+}
+
+fs::path entryPath(const fs::path& dir, const std::string& key) {
+  return dir / (hex(fnv1a(key.data(), key.size())) + kSuffix);
+}
+
+struct EntryInfo {
+  fs::path path;
+  uint64_t size;
+  fs::file_time_type used;
+};
+
+std::vector<EntryInfo> listEntries(const fs::path& dir) {
+  std::vector<EntryInfo> entries;
+  std::error_code ec;
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+    if (it->path().extension() != kSuffix) continue;
+    std::error_code e1, e2;
+    uint64_t size = it->file_size(e1);
+    fs::file_time_type used = it->last_write_time(e2);
+    if (!e1 && !e2) entries.push_back({it->path(), size, used});
+  }
+  return entries;
+}
+
+// Delete the least recently used entries until at most `target` bytes
+// remain; returns what remains.
+uint64_t prune(const fs::path& dir, uint64_t target) {
+  auto entries = listEntries(dir);
+  uint64_t total = 0;
+  for (const auto& e : entries) total += e.size;
+  std::sort(entries.begin(), entries.end(),
+            [](const EntryInfo& a, const EntryInfo& b) { return a.used < b.used; });
+  for (const auto& e : entries) {
+    if (total <= target) break;
+    std::error_code ec;
+    if (fs::remove(e.path, ec)) total -= e.size;
+  }
+  return total;
+}
+
+void putU32(std::string& s, uint32_t v) { s.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+void putU64(std::string& s, uint64_t v) { s.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+
+// Bounds-checked reader over a file's bytes
+struct Reader {
+  const std::string& data;
+  size_t pos = 0;
+  bool ok = true;
+
+  template <typename T> T get() {
+    T v{};
+    if (!ok || data.size() - pos < sizeof(T)) {
+      ok = false;
+      return v;
+    }
+    memcpy(&v, data.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+  std::string bytes(uint64_t n) {
+    if (!ok || data.size() - pos < n) {
+      ok = false;
+      return "";
+    }
+    std::string s = data.substr(pos, n);
+    pos += n;
+    return s;
+  }
+};
+
+} // namespace
+
+bool setObjectCacheDir(const std::string& dir, uint64_t maxBytes) {
+  CacheState& st = state();
+  fs::path path(dir);
+  uint64_t bytes = 0;
+  if (!dir.empty()) {
+    std::error_code ec;
+    fs::create_directories(path, ec);
+    if (!fs::is_directory(path, ec)) return false;
+    for (const auto& e : listEntries(path)) bytes += e.size;
+  }
+  std::lock_guard<std::mutex> lk(st.mu);
+  st.dir = path;
+  st.maxBytes = maxBytes ? maxBytes : kObjectCacheDefaultMaxBytes;
+  st.bytes = bytes;
+  st.stats = ObjectCacheStats();
+  if (!dir.empty() && st.bytes > st.maxBytes) st.bytes = prune(st.dir, st.maxBytes - st.maxBytes / 4);
+  return true;
+}
+
+bool objectCacheEnabled() {
+  CacheState& st = state();
+  std::lock_guard<std::mutex> lk(st.mu);
+  return !st.dir.empty();
+}
+
+std::string objectCacheKey(const std::string& settings) {
+  return "regjit-objcache " REGJIT_BUILD_ID "|llvm " LLVM_VERSION_STRING "|" +
+         hostDescription() + "|" + settings;
+}
+
+llvm::TargetMachine& hostTargetMachine() {
+  static thread_local std::unique_ptr<llvm::TargetMachine> TM;
+  if (!TM) {
+    const auto* host = hostMachineBuilder();
+    if (!host) throw std::runtime_error("cannot detect the host target");
+    llvm::orc::JITTargetMachineBuilder JTMB = *host;
+    auto created = JTMB.createTargetMachine();
+    if (!created) throw std::runtime_error("cannot create a target machine: " + llvm::toString(created.takeError()));
+    TM = std::move(*created);
+  }
+  return *TM;
+}
+
+std::string objectCacheSymbol(uint64_t id) {
+  return "regjit_cached_" + hex(processTag()) + "_" + std::to_string(id);
+}
+
+bool loadCachedObject(const std::string& key, CachedObject& out) {
+  CacheState& st = state();
+  fs::path dir;
+  {
+    std::lock_guard<std::mutex> lk(st.mu);
+    dir = st.dir;
+  }
+  if (dir.empty()) return false;
+  fs::path path = entryPath(dir, key);
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  Reader r{data};
+  if (r.bytes(sizeof(kMagic)) != std::string(kMagic, sizeof(kMagic))) return false;
+  if (r.bytes(r.get<uint32_t>()) != key) return false;  // a hash collision or another format
+  CachedObject obj;
+  obj.FnName = r.bytes(r.get<uint32_t>());
+  obj.PrefilterByte = r.get<int32_t>();
+  uint64_t size = r.get<uint64_t>();
+  uint64_t sum = r.get<uint64_t>();
+  obj.Object = r.bytes(size);
+  if (!r.ok || r.pos != data.size() || obj.FnName.empty()) return false;
+  if (fnv1a(obj.Object.data(), obj.Object.size()) != sum) return false;
+  out = std::move(obj);
+
+  // Mark it recently used for pruning
+  std::error_code ec;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  std::lock_guard<std::mutex> lk(st.mu);
+  st.stats.loaded++;
+  return true;
+}
+
+void storeCachedObject(const std::string& key, const CachedObject& obj) {
+  CacheState& st = state();
+  fs::path dir;
+  uint64_t tmpId;
+  {
+    std::lock_guard<std::mutex> lk(st.mu);
+    dir = st.dir;
+    tmpId = st.tmpId++;
+  }
+  if (dir.empty()) return;
+
+  std::string data(kMagic, sizeof(kMagic));
+  putU32(data, static_cast<uint32_t>(key.size()));
+  data += key;
+  putU32(data, static_cast<uint32_t>(obj.FnName.size()));
+  data += obj.FnName;
+  putU32(data, static_cast<uint32_t>(obj.PrefilterByte));
+  putU64(data, obj.Object.size());
+  putU64(data, fnv1a(obj.Object.data(), obj.Object.size()));
+  data += obj.Object;
+
+  // Write aside, then rename over the entry: readers see the old file or
+  // the whole new one
+  fs::path path = entryPath(dir, key);
+  fs::path tmp = path;
+  tmp += ".tmp." + hex(processTag()) + "." + std::to_string(tmpId);
+  std::error_code ec;
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    out.close();
+    if (!out) {
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(st.mu);
+  if (st.dir != dir) return;
+  st.stats.stored++;
+  st.bytes += data.size();
+  if (st.bytes > st.maxBytes) st.bytes = prune(dir, st.maxBytes - st.maxBytes / 4);
+}
+
+ObjectCacheStats objectCacheStats() {
+  CacheState& st = state();
+  std::lock_guard<std::mutex> lk(st.mu);
+  return st.stats;
+}
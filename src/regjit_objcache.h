@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+class TargetMachine;
+}
+
+// Persistent object cache.
+//
+// Most of a pattern's compile time goes to the O2 pipeline and instruction
+// selection, so a process that compiles thousands of patterns at startup
+// spends seconds on work an earlier run already did. With a cache
+// directory set (regjit_set_object_cache), compilePattern() writes each
+// matcher's object file there, and later processes load the object instead
+// of generating and optimizing IR again.
+//
+// An entry is keyed by everything the machine code depends on: the pattern
+// and its options, the codegen settings in effect, the RegJIT build (a
+// checksum of the library sources, regjit_build_id.h, generated by the
+// Makefile), the LLVM version and the host target and CPU features (see
+// objectCacheKey()).
+// Generated code reaches the runtime helpers through named symbols the JIT
+// defines at startup, never through embedded addresses, so an object stays
+// valid in another process. Aho-Corasick matchers, which embed the address
+// of their automaton, are not cached.
+//
+// A file holds a header (magic, the full key, the matcher's symbol, its
+// prefilter byte, object size and checksum) followed by the object. Files
+// are written under a temporary name and renamed into place, so a reader
+// never sees a partial one; a file that fails any check is ignored and
+// overwritten by the next store. Once the directory grows past its byte
+// limit, the least recently used files are deleted.
+
+// Default byte limit when regjit_set_object_cache() is passed 0.
+constexpr uint64_t kObjectCacheDefaultMaxBytes = uint64_t(256) << 20;
+
+struct CachedObject {
+  std::string FnName;     // symbol of the matcher in Object
+  int PrefilterByte = -1; // CompiledEntry::PrefilterByte
+  std::string Object;     // object file bytes
+};
+
+// Use `dir` (created if missing) with at most `maxBytes` of files; an empty
+// dir turns the cache off. Returns false if the directory is unusable.
+bool setObjectCacheDir(const std::string& dir, uint64_t maxBytes);
+bool objectCacheEnabled();
+
+// Key for a matcher compiled from `settings` (the pattern and every option
+// that changes its code) on this host with this build.
+std::string objectCacheKey(const std::string& settings);
+
+// Target machine for lowering modules to host objects, created on first
+// use in each thread: one TargetMachine must not run two compiles at once.
+// Throws std::runtime_error if the host target is unavailable.
+llvm::TargetMachine& hostTargetMachine();
+
+// Symbol for the matcher of a module that will be stored. Unique in this
+// process and, through a random per-process tag, unlikely to collide with
+// one loaded from an object another process stored.
+std::string objectCacheSymbol(uint64_t id);
+
+bool loadCachedObject(const std::string& key, CachedObject& out); // false if absent or invalid
+void storeCachedObject(const std::string& key, const CachedObject& obj);
+
+struct ObjectCacheStats {
+  uint64_t loaded = 0; // objects used instead of compiling
+  uint64_t stored = 0; // objects written after compiling
+};
+ObjectCacheStats objectCacheStats(); // since the last setObjectCacheDir()
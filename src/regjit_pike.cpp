@@ -0,0 +1,213 @@
+#include "regjit_pike.h"
+
+namespace {
+
+// Sparse set of instruction ids in insertion (= priority) order, with the
+// start position of the thread at each. Clearing is O(1).
+struct ThreadList {
+  std::vector<uint32_t> dense;
+  std::vector<uint32_t> sparse;
+  std::vector<int64_t> startPos; // indexed by instruction id
+  size_t n = 0;
+
+  void init(size_t size) {
+    dense.assign(size, 0);
+    sparse.assign(size, 0);
+    startPos.assign(size, -1);
+    n = 0;
+  }
+  bool contains(uint32_t id) const { return sparse[id] < n && dense[sparse[id]] == id; }
+  void insert(uint32_t id) {
+    sparse[id] = static_cast<uint32_t>(n);
+    dense[n++] = id;
+  }
+  void clear() { n = 0; }
+};
+
+} // namespace
+
+struct PikeVM::Scratch {
+  ThreadList clist;
+  ThreadList nlist;
+  // Instructions visited by the current closure (marked in `seen`), which
+  // also covers Split/Jmp/Assert, so empty loops terminate.
+  ThreadList seen;
+  std::vector<std::pair<uint32_t, int64_t>> stack;
+};
+
+namespace {
+
+// Context of one input position for evaluating assertions.
+struct Position {
+  bool atBegin;
+  bool atEnd;
+  bool prevWord;
+  bool nextWord;
+};
+
+Position positionAt(const uint8_t* p, size_t len, size_t i) {
+  return {i == 0, i == len, i > 0 && isWordByte(p[i - 1]), i < len && isWordByte(p[i])};
+}
+
+bool assertHolds(uint32_t kind, const Position& at) {
+  switch (kind) {
+    case AssertBeginText: return at.atBegin;
+    case AssertEndText: return at.atEnd;
+    case AssertWordBoundary: return at.prevWord != at.nextWord;
+    case AssertNonWordBoundary: return at.prevWord == at.nextWord;
+  }
+  return false;
+}
+
+// Add `pc` and everything reachable from it through empty-width
+// instructions to `list`, in priority order. Only ByteSet and Match
+// instructions end up in the list; they are where threads wait.
+void addThread(const Prog& P, PikeVM::Scratch& s, ThreadList& list, uint32_t pc, int64_t start,
+               const Position& at) {
+  s.stack.emplace_back(pc, start);
+  while (!s.stack.empty()) {
+    auto [id, st] = s.stack.back();
+    s.stack.pop_back();
+    if (s.seen.contains(id)) continue;
+    s.seen.insert(id);
+    const ProgInst& inst = P.insts[id];
+    switch (inst.op) {
+      case ProgInst::ByteSet:
+      case ProgInst::Match:
+        list.insert(id);
+        list.startPos[id] = st;
+        break;
+      case ProgInst::Split:
+        s.stack.emplace_back(inst.out1, st);
+        s.stack.emplace_back(inst.out, st);
+        break;
+      case ProgInst::Jmp:
+        s.stack.emplace_back(inst.out, st);
+        break;
+      case ProgInst::Assert:
+        if (assertHolds(inst.arg, at)) s.stack.emplace_back(inst.out, st);
+        break;
+    }
+  }
+}
+
+bool repeatsMoreThanOnce(const Repeat& rep) {
+  return rep.maxCount < 0 || rep.maxCount > 1;
+}
+
+// True if `node` contains a quantifier or an alternation, i.e. can match
+// the same text in more than one way once it is itself repeated.
+bool isAmbiguous(const Root& node) {
+  if (dynamic_cast<const Repeat*>(&node) || dynamic_cast<const Alternative*>(&node)) return true;
+  if (auto* c = dynamic_cast<const Concat*>(&node)) {
+    for (const auto& child : c->BodyVec) {
+      if (isAmbiguous(*child)) return true;
+    }
+  }
+  if (auto* f = dynamic_cast<const Func*>(&node)) return isAmbiguous(*f->Body);
+  return false;
+}
+
+} // namespace
+
+PikeVM::PikeVM(const Root& ast) : prog(compileProg(ast, false)) {}
+
+PikeVM::~PikeVM() = default;
+
+PikeVM::Scratch* PikeVM::acquireScratch() {
+  {
+    std::lock_guard<std::mutex> lk(poolMutex);
+    if (!freeList.empty()) {
+      Scratch* s = freeList.back();
+      freeList.pop_back();
+      return s;
+    }
+  }
+  auto s = std::make_unique<Scratch>();
+  s->clist.init(prog->size());
+  s->nlist.init(prog->size());
+  s->seen.init(prog->size());
+  std::lock_guard<std::mutex> lk(poolMutex);
+  pool.push_back(std::move(s));
+  return pool.back().get();
+}
+
+void PikeVM::releaseScratch(Scratch* s) {
+  std::lock_guard<std::mutex> lk(poolMutex);
+  freeList.push_back(s);
+}
+
+int PikeVM::search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) {
+  *start_out = -1;
+  *end_out = -1;
+  if (!data && len != 0) return -1;
+
+  const Prog& P = *prog;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  Scratch* s = acquireScratch();
+  ThreadList* clist = &s->clist;
+  ThreadList* nlist = &s->nlist;
+  clist->clear();
+  nlist->clear();
+
+  int64_t matchStart = -1, matchEnd = -1;
+  Position at = positionAt(p, len, 0);
+  s->seen.clear();
+  for (size_t i = 0;; ++i) {
+    // A new attempt starting here has lower priority than every thread
+    // already running, which all started further left.
+    if (matchEnd < 0 && (i == 0 || !P.anchoredStart)) {
+      addThread(P, *s, *clist, P.start, static_cast<int64_t>(i), at);
+    }
+    // No thread left and no new attempt to come: nothing can change.
+    if (clist->n == 0 && (matchEnd >= 0 || P.anchoredStart)) break;
+
+    const Position next = i < len ? positionAt(p, len, i + 1) : at;
+    s->seen.clear();
+    for (size_t t = 0; t < clist->n; ++t) {
+      uint32_t id = clist->dense[t];
+      const ProgInst& inst = P.insts[id];
+      if (inst.op == ProgInst::Match) {
+        // Every thread after this one has lower priority: drop them.
+        matchStart = clist->startPos[id];
+        matchEnd = static_cast<int64_t>(i);
+        break;
+      }
+      if (i < len && P.sets[inst.arg][p[i]]) {
+        addThread(P, *s, *nlist, inst.out, clist->startPos[id], next);
+      }
+    }
+    if (i == len) break;
+    std::swap(clist, nlist);
+    nlist->clear();
+    at = next;
+  }
+  releaseScratch(s);
+
+  if (matchEnd < 0) return 0;
+  *start_out = matchStart;
+  *end_out = matchEnd;
+  return 1;
+}
+
+bool hasNestedQuantifier(const Root& ast) {
+  if (auto* rep = dynamic_cast<const Repeat*>(&ast)) {
+    if (repeatsMoreThanOnce(*rep) && isAmbiguous(*rep->Body)) return true;
+    return hasNestedQuantifier(*rep->Body);
+  }
+  if (auto* c = dynamic_cast<const Concat*>(&ast)) {
+    for (const auto& child : c->BodyVec) {
+      if (hasNestedQuantifier(*child)) return true;
+    }
+    return false;
+  }
+  if (auto* alt = dynamic_cast<const Alternative*>(&ast)) {
+    for (const auto& child : alt->BodyVec) {
+      if (hasNestedQuantifier(*child)) return true;
+    }
+    return false;
+  }
+  if (auto* n = dynamic_cast<const Not*>(&ast)) return hasNestedQuantifier(*n->Body);
+  if (auto* f = dynamic_cast<const Func*>(&ast)) return hasNestedQuantifier(*f->Body);
+  return false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "regjit_prog.h"
+#include <mutex>
+
+// Pike VM: simulates the Thompson NFA of a Prog directly, advancing every
+// live thread in lockstep over the input.
+//
+// A thread is an instruction plus the position where its match attempt
+// started. Threads are kept in priority order and at most one thread per
+// instruction survives a step, so a search costs O(len * prog size) no
+// matter how the pattern nests, and memory is O(prog size). Slower per byte
+// than the DFA engines, but nothing to build or flush: the choice for
+// hostile patterns where even a DFA could blow up.
+//
+// Matching is leftmost-first with Python re preferences: a thread that
+// reaches Match drops every lower-priority thread, and new attempts stop
+// being started once a match is known.
+class PikeVM : public ProgMatcher {
+public:
+  // Throws std::runtime_error if the pattern cannot be compiled to a Prog.
+  explicit PikeVM(const Root& ast);
+  ~PikeVM() override;
+
+  int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) override;
+
+  struct Scratch;
+
+private:
+  std::unique_ptr<Prog> prog;
+
+  // Thread lists are reused across searches; concurrent searches each take
+  // their own from this pool.
+  std::mutex poolMutex;
+  std::vector<std::unique_ptr<Scratch>> pool;
+  std::vector<Scratch*> freeList;
+
+  Scratch* acquireScratch();
+  void releaseScratch(Scratch* s);
+};
+
+// True when `ast` repeats something that can match the same text in more
+// than one way: a quantifier over another quantifier or over an alternation,
+// e.g. (ba+)+, (a(b(c)+)+)+ or (a|aa)*. These are the shapes that make the
+// backtracking matcher take exponential time; REGJIT_ENGINE_AUTO sends them
+// to BitState unless they fit the direct-coded DFA.
+bool hasNestedQuantifier(const Root& ast);
@@ -0,0 +1,88 @@
+#include "regjit_pool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+size_t defaultThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct CompilePool {
+  std::mutex mu;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> queue;
+  std::vector<std::thread> threads;
+  size_t limit = defaultThreads();
+  size_t running = 0; // threads that have not exited
+  size_t idle = 0;    // of those, waiting for a job
+  bool stopping = false;
+
+  static CompilePool& get() {
+    static CompilePool p;
+    return p;
+  }
+
+  void submit(std::function<void()> job) {
+    std::lock_guard<std::mutex> lk(mu);
+    if (stopping) return;
+    queue.push_back(std::move(job));
+    if (idle == 0 && running < limit) {
+      running++;
+      threads.emplace_back([this] { run(); });
+    } else {
+      cv.notify_one();
+    }
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lk(mu);
+    while (true) {
+      idle++;
+      cv.wait(lk, [this] { return stopping || !queue.empty() || running > limit; });
+      idle--;
+      if (stopping || running > limit) break;
+      std::function<void()> job = std::move(queue.front());
+      queue.pop_front();
+      lk.unlock();
+      job();
+      lk.lock();
+    }
+    running--;
+  }
+
+  void setLimit(size_t n) {
+    std::lock_guard<std::mutex> lk(mu);
+    limit = n ? n : defaultThreads();
+    cv.notify_all();
+  }
+
+  ~CompilePool() {
+    {
+      std::lock_guard<std::mutex> lk(mu);
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) t.join();
+  }
+};
+
+} // namespace
+
+void submitCompileJob(std::function<void()> job) {
+  CompilePool::get().submit(std::move(job));
+}
+
+void setCompileThreads(size_t n) {
+  CompilePool::get().setLimit(n);
+}
+
+size_t compileThreads() {
+  CompilePool& p = CompilePool::get();
+  std::lock_guard<std::mutex> lk(p.mu);
+  return p.limit;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Compile thread pool.
+//
+// Compiles nobody waits on run here: regjit_compile_async() and
+// getOrCompileAsync(), and tier-up of REGJIT_ENGINE_TIERED patterns. At
+// most compileThreads() jobs run at once, in submission order; threads are
+// started as jobs arrive and stay for later ones. At exit the jobs in
+// progress finish and queued ones are dropped.
+
+// Queue `job`; returns at once.
+void submitCompileJob(std::function<void()> job);
+
+// Run at most n jobs at once (0 = one per hardware thread, the default).
+// Lowering the limit lets running jobs finish.
+void setCompileThreads(size_t n);
+size_t compileThreads();
@@ -0,0 +1,195 @@
+#include "regjit_prog.h"
+#include <stdexcept>
+
+namespace {
+
+// Builds a program back to front: emit(node, next) appends the instructions
+// for `node`, wires their exit to `next` and returns the entry instruction.
+// Loops are closed by creating the Split first and patching it afterwards.
+class ProgCompiler {
+  Prog& P;
+
+  uint32_t add(const ProgInst& inst) {
+    if (P.insts.size() >= kMaxProgInsts) {
+      throw std::runtime_error("pattern too large for the NFA engines");
+    }
+    P.insts.push_back(inst);
+    return static_cast<uint32_t>(P.insts.size() - 1);
+  }
+
+  uint32_t addByteSet(const std::bitset<256>& set, uint32_t next) {
+    P.sets.push_back(set);
+    ProgInst inst{ProgInst::ByteSet};
+    inst.out = next;
+    inst.arg = static_cast<uint32_t>(P.sets.size() - 1);
+    return add(inst);
+  }
+
+  uint32_t addSplit(uint32_t preferred, uint32_t other) {
+    ProgInst inst{ProgInst::Split};
+    inst.out = preferred;
+    inst.out1 = other;
+    return add(inst);
+  }
+
+  uint32_t addAssert(AssertKind kind, uint32_t next) {
+    if (kind == AssertBeginText) P.usesBeginText = true;
+    if (kind == AssertEndText) P.usesEndText = true;
+    if (kind == AssertWordBoundary || kind == AssertNonWordBoundary) P.usesWordAssert = true;
+    ProgInst inst{ProgInst::Assert};
+    inst.out = next;
+    inst.arg = kind;
+    return add(inst);
+  }
+
+  // x* (or x*? when nonGreedy): L: split(body -> L, next)
+  uint32_t emitStar(const Root& body, bool nonGreedy, uint32_t next) {
+    uint32_t loop = addSplit(0, 0);
+    uint32_t bodyEntry = emit(body, loop);
+    P.insts[loop].out = nonGreedy ? next : bodyEntry;
+    P.insts[loop].out1 = nonGreedy ? bodyEntry : next;
+    return loop;
+  }
+
+  uint32_t emitRepeat(const Repeat& rep, uint32_t next) {
+    uint32_t entry = next;
+    if (rep.maxCount < 0) {
+      entry = emitStar(*rep.Body, rep.nonGreedy, next);
+    } else {
+      // x{0,k} as nested optionals: (x(x(x)?)?)?
+      for (int i = rep.minCount; i < rep.maxCount; ++i) {
+        uint32_t bodyEntry = emit(*rep.Body, entry);
+        entry = rep.nonGreedy ? addSplit(next, bodyEntry) : addSplit(bodyEntry, next);
+      }
+    }
+    for (int i = 0; i < rep.minCount; ++i) {
+      entry = emit(*rep.Body, entry);
+    }
+    return entry;
+  }
+
+  uint32_t emit(const Root& node, uint32_t next) {
+    if (auto* m = dynamic_cast<const Match*>(&node)) {
+      std::bitset<256> set;
+      set.set(static_cast<unsigned char>(m->getChar()));
+      return addByteSet(set, next);
+    }
+    if (auto* cc = dynamic_cast<const CharClass*>(&node)) {
+      std::bitset<256> set;
+      for (int c = 0; c < 256; ++c) {
+        if (cc->matchesByte(static_cast<unsigned char>(c))) set.set(c);
+      }
+      return addByteSet(set, next);
+    }
+    if (auto* c = dynamic_cast<const Concat*>(&node)) {
+      uint32_t entry = next;
+      if (P.reversed) {
+        for (auto it = c->BodyVec.begin(); it != c->BodyVec.end(); ++it) entry = emit(**it, entry);
+      } else {
+        for (auto it = c->BodyVec.rbegin(); it != c->BodyVec.rend(); ++it) entry = emit(**it, entry);
+      }
+      return entry;
+    }
+    if (auto* alt = dynamic_cast<const Alternative*>(&node)) {
+      if (alt->BodyVec.empty()) return next;
+      // Chain of splits keeps the left-to-right preference between branches
+      uint32_t entry = emit(*alt->BodyVec.back(), next);
+      for (size_t i = alt->BodyVec.size() - 1; i-- > 0;) {
+        entry = addSplit(emit(*alt->BodyVec[i], next), entry);
+      }
+      return entry;
+    }
+    if (auto* rep = dynamic_cast<const Repeat*>(&node)) {
+      return emitRepeat(*rep, next);
+    }
+    if (auto* a = dynamic_cast<const Anchor*>(&node)) {
+      switch (a->getType()) {
+        case Anchor::Start:
+          return addAssert(P.reversed ? AssertEndText : AssertBeginText, next);
+        case Anchor::End:
+          return addAssert(P.reversed ? AssertBeginText : AssertEndText, next);
+        case Anchor::WordBoundary:
+          return addAssert(AssertWordBoundary, next);
+        case Anchor::NonWordBoundary:
+          return addAssert(AssertNonWordBoundary, next);
+      }
+    }
+    if (auto* f = dynamic_cast<const Func*>(&node)) {
+      return emit(*f->Body, next);
+    }
+    throw std::runtime_error("construct not supported by the NFA engines");
+  }
+
+  // Partition bytes into classes that every ByteSet (and the word test of
+  // \b/\B) treats alike.
+  void computeByteClasses() {
+    std::bitset<257> boundary; // boundary[b]: a new class starts at byte b
+    boundary.set(0);
+    for (const auto& set : P.sets) {
+      for (int b = 1; b < 256; ++b) {
+        if (set[b] != set[b - 1]) boundary.set(b);
+      }
+    }
+    if (P.usesWordAssert) {
+      for (int b = 1; b < 256; ++b) {
+        if (isWordByte(b) != isWordByte(b - 1)) boundary.set(b);
+      }
+    }
+    int cls = -1;
+    for (int b = 0; b < 256; ++b) {
+      if (boundary[b]) ++cls;
+      P.byteClass[b] = static_cast<uint8_t>(cls);
+    }
+    P.numClasses = cls + 1;
+  }
+
+  // Add the unanchored entry loop and byte classes once P.start is set
+  void finish() {
+    // Unanchored entry: L: split(start, any -> L). Preferring `start` makes
+    // earlier starting positions win, i.e. leftmost matches.
+    std::bitset<256> any;
+    any.set();
+    uint32_t loop = addSplit(P.start, 0);
+    P.insts[loop].out1 = addByteSet(any, loop);
+    P.startUnanchored = loop;
+    computeByteClasses();
+  }
+
+public:
+  explicit ProgCompiler(Prog& p) : P(p) {}
+
+  void compile(const Root& ast) {
+    uint32_t match = add(ProgInst{ProgInst::Match});
+    P.start = emit(ast, match);
+    finish();
+    P.anchoredStart = !P.reversed && ast.isAnchoredAtStart() && !ast.containsZeroWidthRepeat();
+  }
+
+  // The first n elements of a Concat, as if they were a pattern of their own
+  void compilePrefix(const Concat& c, size_t n) {
+    uint32_t entry = add(ProgInst{ProgInst::Match});
+    if (P.reversed) {
+      for (size_t i = 0; i < n; ++i) entry = emit(*c.BodyVec[i], entry);
+    } else {
+      for (size_t i = n; i-- > 0;) entry = emit(*c.BodyVec[i], entry);
+    }
+    P.start = entry;
+    finish();
+  }
+};
+
+} // namespace
+
+std::unique_ptr<Prog> compileProg(const Root& ast, bool reversed) {
+  auto prog = std::make_unique<Prog>();
+  prog->reversed = reversed;
+  ProgCompiler(*prog).compile(ast);
+  return prog;
+}
+
+std::unique_ptr<Prog> compileProgPrefix(const Concat& c, size_t n, bool reversed) {
+  auto prog = std::make_unique<Prog>();
+  prog->reversed = reversed;
+  ProgCompiler(*prog).compilePrefix(c, n);
+  return prog;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "regjit.h"
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+// Thompson NFA ("program") compiled from the RegJIT AST. The JIT backend
+// either generates a backtracking matcher straight from the AST or emits a
+// DFA built from this program; the engines that guarantee linear time
+// (lazy DFA, ...) interpret it instead.
+//
+// Instructions are listed in priority order: a Split prefers `out` over
+// `out1`, so exploring threads depth-first in that order yields the same
+// leftmost-first preference as Python's re (greedy repeats prefer another
+// iteration, lazy ones prefer to stop, alternatives prefer the left branch).
+
+struct ProgInst {
+  enum Op : uint8_t {
+    ByteSet, // consume one byte in sets[arg], continue at out
+    Split,   // try out, then out1
+    Jmp,     // continue at out
+    Assert,  // zero-width test arg (an AssertKind), continue at out
+    Match    // accept
+  };
+  Op op;
+  uint32_t out = 0;
+  uint32_t out1 = 0;
+  uint32_t arg = 0;
+};
+
+// Zero-width assertions, expressed in scan direction so a reversed program
+// can reuse them: BeginText holds when no byte precedes the position in the
+// direction of the scan, EndText when no byte follows it.
+enum AssertKind : uint32_t {
+  AssertBeginText,
+  AssertEndText,
+  AssertWordBoundary,
+  AssertNonWordBoundary
+};
+
+class Prog {
+public:
+  std::vector<ProgInst> insts;
+  std::vector<std::bitset<256>> sets; // byte sets referenced by ByteSet insts
+  uint32_t start = 0;           // anchored entry point
+  uint32_t startUnanchored = 0; // `.*?` loop in front of start
+  bool reversed = false;        // compiled right-to-left (for finding match starts)
+  bool anchoredStart = false;   // every match starts at BeginText
+  bool usesBeginText = false;
+  bool usesEndText = false;
+  bool usesWordAssert = false;
+
+  // Bytes that no ByteSet (nor the word-character test of \b and \B) can
+  // tell apart share a class, so DFA transition tables are indexed by class
+  // instead of by byte.
+  uint8_t byteClass[256];
+  int numClasses = 0;
+
+  size_t size() const { return insts.size(); }
+};
+
+// Largest program compileProg() will build; counted repeats such as
+// (x{100}){100} are expanded, so this bounds the memory of huge quantifiers.
+constexpr size_t kMaxProgInsts = 100000;
+
+// Compile `ast` into a program. With `reversed` the program matches the
+// reversed language (concatenations run right to left and ^/$ swap roles).
+// Throws std::runtime_error for nodes the engines do not support or when the
+// program would exceed kMaxProgInsts.
+std::unique_ptr<Prog> compileProg(const Root& ast, bool reversed = false);
+
+// Like compileProg() for the pattern made of the first `n` elements of `c`.
+std::unique_ptr<Prog> compileProgPrefix(const Concat& c, size_t n, bool reversed = false);
+
+// Word characters as used by \b, \B and \w: [a-zA-Z0-9_].
+inline bool isWordByte(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// Engines that run a Prog instead of JIT code implement this. search() has
+// the same contract as the generated matchers (RegjitMatchFn) and must be
+// safe to call from several threads at once.
+class ProgMatcher {
+public:
+  virtual ~ProgMatcher() = default;
+  virtual int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) = 0;
+};
@@ -0,0 +1,325 @@
+#include "regjit_runtime.h"
+#include <cstdio>
+#include <cstring>
+
+// ARM NEON SIMD support
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define HAS_NEON 1
+#else
+#define HAS_NEON 0
+#endif
+
+// x86 SIMD support: SSE2/AVX2/AVX-512BW variants of the runtime helpers are
+// compiled with target attributes and picked at startup (see runtimeHelpers)
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_SIMD 1
+#else
+#define HAS_X86_SIMD 0
+#endif
+
+#ifdef REGJIT_DEBUG
+#define RJDBG(x) x
+#else
+#define RJDBG(x) do {} while(0)
+#endif
+
+// Runtime trace helper called from generated code.
+extern "C" void regjit_trace(const char* tag, int idx, int cnt) {
+    RJDBG(fprintf(stderr, "regjit_trace: %s idx=%d cnt=%d\n", tag, idx, cnt));
+}
+
+// Boyer-Moore-Horspool bad-character table: shift[b] is how far the window
+// may move when its last byte is b. Entries are capped at 255 (a shorter
+// shift is always safe), so the table is 256 bytes and can be built once
+// when the pattern is compiled and embedded in the module.
+void buildBmhShiftTable(const char* needle, size_t needleLen, uint8_t shift[256]) {
+    const uint8_t full = static_cast<uint8_t>(needleLen < 255 ? needleLen : 255);
+    memset(shift, full, 256);
+    for (size_t i = 0; i + 1 < needleLen; i++) {
+        size_t d = needleLen - 1 - i;
+        shift[(unsigned char)needle[i]] = static_cast<uint8_t>(d < 255 ? d : 255);
+    }
+}
+
+// Boyer-Moore-Horspool string search implementation with memchr optimization.
+// Returns pointer to first occurrence of needle in haystack, or nullptr if not found.
+// This combines BMH bad-character shifts with memchr SIMD acceleration.
+// shift comes from buildBmhShiftTable; it is only read for needles longer
+// than 3 bytes.
+static const char* bmhSearchPortable(const char* haystack, size_t haystackLen,
+                                     const char* needle, size_t needleLen,
+                                     const uint8_t* shift) {
+    if (needleLen == 0) return haystack;
+    if (needleLen > haystackLen) return nullptr;
+    
+    // For single character, just use memchr (SIMD optimized)
+    if (needleLen == 1) {
+        return (const char*)memchr(haystack, needle[0], haystackLen);
+    }
+    
+    // For short needles (2-3 chars), use memchr + verify approach
+    // This is typically faster than shifting by the table
+    if (needleLen <= 3) {
+        const char* p = haystack;
+        const char* end = haystack + haystackLen - needleLen + 1;
+        const char firstChar = needle[0];
+        
+        while (p < end) {
+            p = (const char*)memchr(p, firstChar, end - p);
+            if (!p) return nullptr;
+            if (memcmp(p, needle, needleLen) == 0) return p;
+            p++;
+        }
+        return nullptr;
+    }
+    
+    // For longer needles, use full BMH with memchr for initial search
+    const char firstChar = needle[0];
+    const char lastChar = needle[needleLen - 1];
+    const size_t lastIdx = needleLen - 1;
+    
+    // Use memchr to find first char, then verify with BMH-style shifts
+    const char* p = haystack;
+    const char* end = haystack + haystackLen;
+    
+    while (p <= end - needleLen) {
+        // Use memchr to find first character (SIMD accelerated)
+        p = (const char*)memchr(p, firstChar, end - p - lastIdx);
+        if (!p) return nullptr;
+        
+        // Check last char quickly
+        if (p[lastIdx] == lastChar) {
+            // Full comparison (skip first and last which we already checked)
+            if (needleLen == 2 || memcmp(p + 1, needle + 1, needleLen - 2) == 0) {
+                return p;  // Found!
+            }
+        }
+        
+        // Move forward - use BMH shift if beneficial, otherwise just +1
+        size_t bmhShift = shift[(unsigned char)p[lastIdx]];
+        p += (bmhShift > 1) ? bmhShift : 1;
+    }
+    
+    return nullptr;  // Not found
+}
+
+// Count consecutive occurrences of a character starting from pos.
+// Uses SIMD when available for faster scanning.
+// Returns the count of consecutive matching characters.
+static size_t countCharPortable(const char* str, size_t len, char target) {
+    if (len == 0) return 0;
+    
+#if HAS_NEON
+    // ARM NEON optimized path (Apple Silicon, ARM64)
+    size_t count = 0;
+    uint8x16_t vtarget = vdupq_n_u8((uint8_t)target);
+    
+    // Process 16 bytes at a time with NEON
+    while (count + 16 <= len) {
+        uint8x16_t vdata = vld1q_u8((const uint8_t*)(str + count));
+        uint8x16_t vcmp = vceqq_u8(vdata, vtarget);
+        
+        // Check if all 16 bytes match using 64-bit lane comparison
+        uint64x2_t vcmp64 = vreinterpretq_u64_u8(vcmp);
+        uint64_t low = vgetq_lane_u64(vcmp64, 0);
+        uint64_t high = vgetq_lane_u64(vcmp64, 1);
+        
+        if (low == 0xFFFFFFFFFFFFFFFFULL && high == 0xFFFFFFFFFFFFFFFFULL) {
+            count += 16;
+        } else {
+            // Some bytes don't match - find the first non-match
+            for (int i = 0; i < 16 && count + i < len; i++) {
+                if (str[count + i] != target) return count + i;
+            }
+            count += 16;
+        }
+    }
+    
+    // Handle remaining bytes
+    while (count < len && str[count] == target) {
+        count++;
+    }
+    return count;
+    
+#else
+    // Generic optimized path - unroll loop for better pipelining
+    size_t count = 0;
+    
+    // Process 8 bytes at a time
+    while (count + 8 <= len) {
+        if (str[count] != target) return count;
+        if (str[count + 1] != target) return count + 1;
+        if (str[count + 2] != target) return count + 2;
+        if (str[count + 3] != target) return count + 3;
+        if (str[count + 4] != target) return count + 4;
+        if (str[count + 5] != target) return count + 5;
+        if (str[count + 6] != target) return count + 6;
+        if (str[count + 7] != target) return count + 7;
+        count += 8;
+    }
+    
+    // Handle remaining bytes
+    while (count < len && str[count] == target) {
+        count++;
+    }
+    
+    return count;
+#endif
+}
+
+#if HAS_X86_SIMD
+// Length of the run of `target` at str: compare a vector of bytes, and the
+// first zero bit of the movemask is the first mismatch.
+__attribute__((target("sse2")))
+static size_t countCharSSE2(const char* str, size_t len, char target) {
+    const __m128i t = _mm_set1_epi8(target);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        unsigned eq = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, t)));
+        if (eq != 0xffffu) return i + __builtin_ctz(~eq);
+    }
+    while (i < len && str[i] == target) i++;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t countCharAVX2(const char* str, size_t len, char target) {
+    const __m256i t = _mm256_set1_epi8(target);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+        uint32_t eq = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, t)));
+        if (eq != 0xffffffffu) return i + __builtin_ctz(~eq);
+    }
+    return i + countCharSSE2(str + i, len - i, target);
+}
+
+__attribute__((target("avx512bw")))
+static size_t countCharAVX512(const char* str, size_t len, char target) {
+    const __m512i t = _mm512_set1_epi8(target);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(str + i);
+        uint64_t eq = _mm512_cmpeq_epi8_mask(v, t);
+        if (eq != ~0ULL) return i + __builtin_ctzll(~eq);
+    }
+    return i + countCharAVX2(str + i, len - i, target);
+}
+
+// Substring search: compare the needle's first and last bytes at a whole
+// vector of candidate starts at once and memcmp only where both match.
+// Short inputs, 1-byte needles and the tail go to the next narrower variant.
+__attribute__((target("sse2")))
+static const char* bmhSearchSSE2(const char* haystack, size_t haystackLen,
+                                 const char* needle, size_t needleLen,
+                                 const uint8_t* shift) {
+    if (needleLen < 2 || needleLen > haystackLen)
+        return bmhSearchPortable(haystack, haystackLen, needle, needleLen, shift);
+    const size_t lastIdx = needleLen - 1;
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[lastIdx]);
+    size_t i = 0;
+    for (; i + lastIdx + 16 <= haystackLen; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + lastIdx));
+        unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        for (; hits; hits &= hits - 1) {
+            size_t k = i + __builtin_ctz(hits);
+            if (memcmp(haystack + k + 1, needle + 1, needleLen - 2) == 0) return haystack + k;
+        }
+    }
+    return bmhSearchPortable(haystack + i, haystackLen - i, needle, needleLen, shift);
+}
+
+__attribute__((target("avx2")))
+static const char* bmhSearchAVX2(const char* haystack, size_t haystackLen,
+                                 const char* needle, size_t needleLen,
+                                 const uint8_t* shift) {
+    if (needleLen < 2 || needleLen > haystackLen)
+        return bmhSearchPortable(haystack, haystackLen, needle, needleLen, shift);
+    const size_t lastIdx = needleLen - 1;
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[lastIdx]);
+    size_t i = 0;
+    for (; i + lastIdx + 32 <= haystackLen; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + lastIdx));
+        uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        for (; hits; hits &= hits - 1) {
+            size_t k = i + __builtin_ctz(hits);
+            if (memcmp(haystack + k + 1, needle + 1, needleLen - 2) == 0) return haystack + k;
+        }
+    }
+    return bmhSearchSSE2(haystack + i, haystackLen - i, needle, needleLen, shift);
+}
+
+__attribute__((target("avx512bw")))
+static const char* bmhSearchAVX512(const char* haystack, size_t haystackLen,
+                                   const char* needle, size_t needleLen,
+                                   const uint8_t* shift) {
+    if (needleLen < 2 || needleLen > haystackLen)
+        return bmhSearchPortable(haystack, haystackLen, needle, needleLen, shift);
+    const size_t lastIdx = needleLen - 1;
+    const __m512i first = _mm512_set1_epi8(needle[0]);
+    const __m512i last = _mm512_set1_epi8(needle[lastIdx]);
+    size_t i = 0;
+    for (; i + lastIdx + 64 <= haystackLen; i += 64) {
+        __m512i a = _mm512_loadu_si512(haystack + i);
+        __m512i b = _mm512_loadu_si512(haystack + i + lastIdx);
+        uint64_t hits = _mm512_cmpeq_epi8_mask(a, first) & _mm512_cmpeq_epi8_mask(b, last);
+        for (; hits; hits &= hits - 1) {
+            size_t k = i + __builtin_ctzll(hits);
+            if (memcmp(haystack + k + 1, needle + 1, needleLen - 2) == 0) return haystack + k;
+        }
+    }
+    return bmhSearchAVX2(haystack + i, haystackLen - i, needle, needleLen, shift);
+}
+#endif
+
+// Every variant of the helpers this CPU can run, best first.
+std::vector<RuntimeHelpers> availableRuntimeHelpers() {
+    std::vector<RuntimeHelpers> v;
+#if HAS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) v.push_back({"avx512bw", countCharAVX512, bmhSearchAVX512});
+    if (__builtin_cpu_supports("avx2")) v.push_back({"avx2", countCharAVX2, bmhSearchAVX2});
+    if (__builtin_cpu_supports("sse2")) v.push_back({"sse2", countCharSSE2, bmhSearchSSE2});
+#endif
+    v.push_back({HAS_NEON ? "neon" : "portable", countCharPortable, bmhSearchPortable});
+    return v;
+}
+
+// Chosen once per process; generated code calls these pointers directly.
+const RuntimeHelpers& runtimeHelpers() {
+    static const RuntimeHelpers best = availableRuntimeHelpers().front();
+    return best;
+}
+
+// Generated code passes the table built at compile time; this entry point is
+// for callers that only have the needle.
+extern "C" const char* regjit_bmh_search(const char* haystack, size_t haystackLen,
+                                          const char* needle, size_t needleLen) {
+    uint8_t shift[256];
+    if (needleLen > 3 && needleLen <= haystackLen) buildBmhShiftTable(needle, needleLen, shift);
+    return runtimeHelpers().bmhSearch(haystack, haystackLen, needle, needleLen, shift);
+}
+
+extern "C" size_t regjit_count_char(const char* str, size_t len, char target) {
+    return runtimeHelpers().countChar(str, len, target);
+}
+
+// The entry points generated code calls. The JIT binds these names to the
+// chosen variants directly; ahead-of-time objects link against these.
+extern "C" const char* regjit_rt_bmh_search(const char* haystack, size_t haystackLen,
+                                             const char* needle, size_t needleLen, const uint8_t* shift) {
+    return runtimeHelpers().bmhSearch(haystack, haystackLen, needle, needleLen, shift);
+}
+
+extern "C" size_t regjit_rt_count_char(const char* str, size_t len, char target) {
+    return runtimeHelpers().countChar(str, len, target);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Runtime helpers called from generated code: CPU-dispatched substring
+// search and run counting, and the trace hook. Nothing here depends on
+// LLVM, so this file (with regjit_teddy.cpp) is also the runtime library
+// that objects from the ahead-of-time compiler (regjitc) link against.
+
+// One implementation of the runtime helpers called from generated code
+// (regjit_count_char, regjit_bmh_search) for a given instruction set.
+struct RuntimeHelpers {
+  const char* isa; // "avx512bw", "avx2", "sse2", "neon" or "portable"
+  size_t (*countChar)(const char* str, size_t len, char target);
+  // shift is the needle's table from buildBmhShiftTable
+  const char* (*bmhSearch)(const char* haystack, size_t haystackLen, const char* needle, size_t needleLen,
+                           const uint8_t* shift);
+};
+void buildBmhShiftTable(const char* needle, size_t needleLen, uint8_t shift[256]);
+std::vector<RuntimeHelpers> availableRuntimeHelpers(); // every variant this CPU runs, best first
+const RuntimeHelpers& runtimeHelpers(); // the best one, chosen once via CPUID
+
+// Symbols generated code calls; regjit_rt_* go through runtimeHelpers().
+extern "C" {
+const char* regjit_rt_bmh_search(const char* haystack, size_t haystackLen, const char* needle, size_t needleLen,
+                                 const uint8_t* shift);
+size_t regjit_rt_count_char(const char* str, size_t len, char target);
+const char* regjit_bmh_search(const char* haystack, size_t haystackLen, const char* needle, size_t needleLen);
+size_t regjit_count_char(const char* str, size_t len, char target);
+void regjit_trace(const char* tag, int idx, int cnt);
+}
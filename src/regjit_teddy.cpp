@@ -0,0 +1,177 @@
+#include "regjit_teddy.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEDDY_X86 1
+#else
+#define TEDDY_X86 0
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define TEDDY_NEON 1
+#else
+#define TEDDY_NEON 0
+#endif
+
+TeddyMasks::TeddyMasks(const std::vector<std::string>& prefixes) {
+  std::memset(table, 0, sizeof(table));
+  len = kTeddyMaxLen;
+  for (const auto& p : prefixes) len = std::min(len, p.size());
+  std::vector<std::string> fingerprints;
+  for (const auto& p : prefixes) fingerprints.push_back(p.substr(0, len));
+  std::sort(fingerprints.begin(), fingerprints.end());
+  fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+  // Neighbours in sorted order share a bucket: they tend to differ in few
+  // nibbles, so sharing adds few false positives.
+  const size_t n = fingerprints.size();
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t bit = static_cast<uint8_t>(1u << (i * 8 / n));
+    for (size_t j = 0; j < len; ++j) {
+      uint8_t c = static_cast<uint8_t>(fingerprints[i][j]);
+      table[j][0][c & 15] |= bit;
+      table[j][1][c >> 4] |= bit;
+    }
+  }
+}
+
+namespace {
+
+// Does some bucket accept p[0..m)?
+inline bool candidateAt(const uint8_t* t, size_t m, const uint8_t* p) {
+  uint8_t bits = 0xff;
+  for (size_t j = 0; j < m; ++j) bits &= t[j * 32 + (p[j] & 15)] & t[j * 32 + 16 + (p[j] >> 4)];
+  return bits != 0;
+}
+
+int64_t findScalar(const uint8_t* t, size_t m, const uint8_t* p, size_t len, size_t from) {
+  for (size_t i = from; i + m <= len; ++i) {
+    if (candidateAt(t, m, p + i)) return static_cast<int64_t>(i);
+  }
+  return -1;
+}
+
+#if TEDDY_X86
+template <size_t M>
+__attribute__((target("ssse3")))
+int64_t findSSSE3(const uint8_t* t, const uint8_t* p, size_t len, size_t from) {
+  const __m128i nib = _mm_set1_epi8(0x0f);
+  __m128i lo[M], hi[M];
+  for (size_t j = 0; j < M; ++j) {
+    lo[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + j * 32));
+    hi[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + j * 32 + 16));
+  }
+  size_t i = from;
+  for (; i + 16 + M - 1 <= len; i += 16) {
+    __m128i acc = _mm_set1_epi8(-1);
+    for (size_t j = 0; j < M; ++j) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + j));
+      __m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(v, nib));
+      __m128i h = _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(v, 4), nib));
+      acc = _mm_and_si128(acc, _mm_and_si128(l, h));
+    }
+    unsigned miss = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())));
+    unsigned hit = ~miss & 0xffffu;
+    if (hit) return static_cast<int64_t>(i + __builtin_ctz(hit));
+  }
+  return findScalar(t, M, p, len, i);
+}
+
+template <size_t M>
+__attribute__((target("avx2")))
+int64_t findAVX2(const uint8_t* t, const uint8_t* p, size_t len, size_t from) {
+  const __m256i nib = _mm256_set1_epi8(0x0f);
+  __m256i lo[M], hi[M];
+  for (size_t j = 0; j < M; ++j) {
+    lo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t + j * 32)));
+    hi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t + j * 32 + 16)));
+  }
+  size_t i = from;
+  for (; i + 32 + M - 1 <= len; i += 32) {
+    __m256i acc = _mm256_set1_epi8(-1);
+    for (size_t j = 0; j < M; ++j) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + j));
+      __m256i l = _mm256_shuffle_epi8(lo[j], _mm256_and_si256(v, nib));
+      __m256i h = _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(v, 4), nib));
+      acc = _mm256_and_si256(acc, _mm256_and_si256(l, h));
+    }
+    uint32_t miss = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(acc, _mm256_setzero_si256())));
+    uint32_t hit = ~miss;
+    if (hit) return static_cast<int64_t>(i + __builtin_ctz(hit));
+  }
+  return findSSSE3<M>(t, p, len, i);
+}
+#endif
+
+#if TEDDY_NEON
+template <size_t M>
+int64_t findNEON(const uint8_t* t, const uint8_t* p, size_t len, size_t from) {
+  const uint8x16_t nib = vdupq_n_u8(0x0f);
+  uint8x16_t lo[M], hi[M];
+  for (size_t j = 0; j < M; ++j) {
+    lo[j] = vld1q_u8(t + j * 32);
+    hi[j] = vld1q_u8(t + j * 32 + 16);
+  }
+  size_t i = from;
+  for (; i + 16 + M - 1 <= len; i += 16) {
+    uint8x16_t acc = vdupq_n_u8(0xff);
+    for (size_t j = 0; j < M; ++j) {
+      uint8x16_t v = vld1q_u8(p + i + j);
+      uint8x16_t l = vqtbl1q_u8(lo[j], vandq_u8(v, nib));
+      uint8x16_t h = vqtbl1q_u8(hi[j], vshrq_n_u8(v, 4));
+      acc = vandq_u8(acc, vandq_u8(l, h));
+    }
+    if (vmaxvq_u8(acc) == 0) continue;
+    uint8_t lanes[16];
+    vst1q_u8(lanes, acc);
+    for (size_t k = 0; k < 16; ++k) {
+      if (lanes[k]) return static_cast<int64_t>(i + k);
+    }
+  }
+  return findScalar(t, M, p, len, i);
+}
+#endif
+
+using FindFn = int64_t (*)(const uint8_t*, const uint8_t*, size_t, size_t);
+
+template <size_t M>
+int64_t findPortable(const uint8_t* t, const uint8_t* p, size_t len, size_t from) {
+#if TEDDY_NEON
+  return findNEON<M>(t, p, len, from);
+#else
+  return findScalar(t, M, p, len, from);
+#endif
+}
+
+struct FindTable {
+  FindFn fn[kTeddyMaxLen + 1] = {};
+  FindTable() {
+    fn[1] = findPortable<1>;
+    fn[2] = findPortable<2>;
+    fn[3] = findPortable<3>;
+#if TEDDY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      fn[1] = findAVX2<1>;
+      fn[2] = findAVX2<2>;
+      fn[3] = findAVX2<3>;
+    } else if (__builtin_cpu_supports("ssse3")) {
+      fn[1] = findSSSE3<1>;
+      fn[2] = findSSSE3<2>;
+      fn[3] = findSSSE3<3>;
+    }
+#endif
+  }
+};
+
+const FindTable Finders; // CPU features are probed once at load time
+
+} // namespace
+
+extern "C" int64_t regjit_teddy_find(const uint8_t* masks, size_t m, const char* data,
+                                     size_t len, size_t from) {
+  if (from >= len || m == 0 || m > kTeddyMaxLen) return -1;
+  return Finders.fn[m](masks, reinterpret_cast<const uint8_t*>(data), len, from);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Root;
+
+// Teddy-style multi-literal prefilter for the search loop.
+//
+// When every match of a pattern starts with one of a few short strings
+// (foo|bar|baz, (GET|PUT) /, [A-Z]x...), the search loop only needs to try
+// the positions where one of those strings occurs. Up to 64 fingerprints
+// (the first 1-3 bytes of each string) are spread over 8 buckets; for each
+// fingerprint byte there is a 16-entry table per nibble whose bits say which
+// buckets allow that nibble there. A position is a candidate when, for
+// every fingerprint byte, the low- and high-nibble tables share a bucket
+// bit. With byte shuffles (pshufb / tbl) that is a handful of vector ops per
+// 16 or 32 input bytes. Candidates may be false positives; the caller
+// verifies them by running the full pattern there.
+
+constexpr size_t kTeddyMaxPrefixes = 64;
+constexpr size_t kTeddyMaxLen = 3;
+
+struct TeddyMasks {
+  size_t len = 0;                       // fingerprint length, 1..kTeddyMaxLen
+  uint8_t table[kTeddyMaxLen][2][16];   // [byte][low nibble, high nibble] -> bucket bits
+
+  TeddyMasks() = default;
+  // Prefixes must be non-empty; at most kTeddyMaxPrefixes of them.
+  explicit TeddyMasks(const std::vector<std::string>& prefixes);
+};
+
+// If every match of `ast` starts with one of at most kTeddyMaxPrefixes
+// non-empty strings, store them (cut to kTeddyMaxLen bytes) in `prefixes`
+// and return true.
+bool collectPrefixSet(const Root& ast, std::vector<std::string>& prefixes);
+
+// First candidate position in [from, len), or -1. `masks` is the `table` of
+// a TeddyMasks with fingerprint length `m`. Called from generated code.
+extern "C" int64_t regjit_teddy_find(const uint8_t* masks, size_t m, const char* data,
+                                     size_t len, size_t from);
@@ -0,0 +1,115 @@
+#include "regjit_teddy.h"
+#include "regjit.h"
+#include <algorithm>
+
+// Prefix sets for the Teddy prefilter, read off the AST. Kept apart from
+// the scanner in regjit_teddy.cpp, which generated code links against.
+
+namespace {
+
+struct Prefix {
+  std::string s;
+  bool whole; // s is an entire match of the node, so what follows may extend it
+};
+using PrefixList = std::vector<Prefix>;
+
+void addPrefix(PrefixList& out, Prefix p) {
+  for (auto& q : out) {
+    if (q.s == p.s) {
+      q.whole = q.whole && p.whole;
+      return;
+    }
+  }
+  out.push_back(std::move(p));
+}
+
+bool prefixesOf(const Root& node, PrefixList& out) {
+  out.clear();
+  if (auto* m = dynamic_cast<const Match*>(&node)) {
+    out.push_back({std::string(1, m->getChar()), true});
+    return true;
+  }
+  if (auto* cc = dynamic_cast<const CharClass*>(&node)) {
+    for (int c = 0; c < 256; ++c) {
+      if (!cc->matchesByte(static_cast<unsigned char>(c))) continue;
+      if (out.size() == kTeddyMaxPrefixes) return false;
+      out.push_back({std::string(1, static_cast<char>(c)), true});
+    }
+    return true;
+  }
+  if (dynamic_cast<const Anchor*>(&node)) {
+    out.push_back({"", true});
+    return true;
+  }
+  if (auto* f = dynamic_cast<const Func*>(&node)) return prefixesOf(*f->Body, out);
+  if (auto* alt = dynamic_cast<const Alternative*>(&node)) {
+    PrefixList sub;
+    for (const auto& child : alt->BodyVec) {
+      if (!prefixesOf(*child, sub)) return false;
+      for (auto& p : sub) addPrefix(out, std::move(p));
+      if (out.size() > kTeddyMaxPrefixes) return false;
+    }
+    return true;
+  }
+  if (auto* c = dynamic_cast<const Concat*>(&node)) {
+    out.push_back({"", true});
+    PrefixList sub, next;
+    for (const auto& child : c->BodyVec) {
+      bool extendable = std::any_of(out.begin(), out.end(), [](const Prefix& p) {
+        return p.whole && p.s.size() < kTeddyMaxLen;
+      });
+      if (!extendable) break;
+      bool known = prefixesOf(*child, sub);
+      next.clear();
+      for (const auto& p : out) {
+        if (!known || !p.whole || p.s.size() >= kTeddyMaxLen) {
+          addPrefix(next, {p.s, false});
+          continue;
+        }
+        for (const auto& q : sub) {
+          Prefix e{p.s + q.s, q.whole};
+          if (e.s.size() > kTeddyMaxLen) {
+            e.s.resize(kTeddyMaxLen);
+            e.whole = false;
+          }
+          addPrefix(next, std::move(e));
+        }
+      }
+      if (!known || next.size() > kTeddyMaxPrefixes) {
+        // Stop at what is known so far
+        for (auto& p : out) p.whole = false;
+        break;
+      }
+      out.swap(next);
+    }
+    return true;
+  }
+  if (auto* rep = dynamic_cast<const Repeat*>(&node)) {
+    if (rep->maxCount == 0) {
+      out.push_back({"", true});
+      return true;
+    }
+    if (!prefixesOf(*rep->Body, out)) return false;
+    // After more than one iteration the body's whole matches are only
+    // prefixes of the repeat's.
+    if (rep->maxCount != 1) {
+      for (auto& p : out) p.whole = false;
+    }
+    if (rep->minCount == 0) addPrefix(out, {"", true});
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+bool collectPrefixSet(const Root& ast, std::vector<std::string>& prefixes) {
+  PrefixList list;
+  if (!prefixesOf(ast, list) || list.empty()) return false;
+  prefixes.clear();
+  for (auto& p : list) {
+    if (p.s.empty()) return false; // some match may start anywhere
+    prefixes.push_back(std::move(p.s));
+  }
+  return true;
+}
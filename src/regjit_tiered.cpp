@@ -0,0 +1,41 @@
+#include "regjit_tiered.h"
+#include "regjit_pool.h"
+
+TieredMatcher::TieredMatcher(std::unique_ptr<ProgMatcher> interpreter, CompileFn compile, uint64_t callThreshold,
+                             uint64_t byteThreshold)
+    : interpreter(std::move(interpreter)), compile(std::move(compile)), callThreshold(callThreshold),
+      byteThreshold(byteThreshold) {}
+
+TieredMatcher::~TieredMatcher() {
+  if (jit.RT) ExitOnErr(jit.RT->remove());
+}
+
+int TieredMatcher::search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) {
+  if (RegjitMatchFn f = fn.load(std::memory_order_acquire)) {
+    int rc = f(data, len, start_out, end_out);
+    if (rc != REGJIT_BUDGET_EXCEEDED) return rc;
+  } else if (!requested.load(std::memory_order_relaxed)) {
+    uint64_t c = calls.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t b = bytes.fetch_add(len, std::memory_order_relaxed) + len;
+    if ((callThreshold && c >= callThreshold) || (byteThreshold && b >= byteThreshold)) requestPromotion();
+  }
+  return interpreter->search(data, len, start_out, end_out);
+}
+
+void TieredMatcher::requestPromotion() {
+  if (requested.exchange(true)) return;
+  submitCompileJob([self = weak_from_this()] {
+    // A matcher dropped from the cache meanwhile needs no code
+    if (auto m = self.lock()) m->promote();
+  });
+}
+
+void TieredMatcher::promote() {
+  try {
+    jit = compile();
+  } catch (const std::exception&) {
+    // Stay on the interpreter; its answers are the same
+    return;
+  }
+  fn.store((RegjitMatchFn)(uintptr_t)jit.Addr, std::memory_order_release);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "regjit_prog.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Tiered execution (REGJIT_ENGINE_TIERED).
+//
+// A cold JIT compile costs milliseconds, far more than a one-off search. A
+// TieredMatcher answers from an interpreter over the pattern's Prog (the
+// same bytecode the linear-time engines run, built in microseconds) from
+// the first call, and counts calls and input bytes. Once either count
+// reaches its threshold the pattern is queued for the JIT on the compile
+// pool (regjit_pool.h); when the code is ready its entry point is published
+// with one atomic store and every later search, through any handle, calls
+// it directly. Searches never wait for the compile.
+//
+// Both tiers report the same leftmost-first match: only patterns the JIT
+// emits as a direct-coded DFA or a literal search are promoted, and the
+// rest (lazy quantifiers, DFAs over the state limit) stay interpreted. If
+// JIT code ever gives up on its step budget the call is answered by the
+// interpreter instead, so a tiered search never returns
+// REGJIT_BUDGET_EXCEEDED.
+class TieredMatcher : public ProgMatcher, public std::enable_shared_from_this<TieredMatcher> {
+public:
+  // Compiles the JIT tier; runs on a compile pool thread, may throw.
+  using CompileFn = std::function<CompiledEntry()>;
+
+  // Promote after `callThreshold` searches or `byteThreshold` input bytes,
+  // whichever comes first; 0 disables that trigger.
+  TieredMatcher(std::unique_ptr<ProgMatcher> interpreter, CompileFn compile, uint64_t callThreshold,
+                uint64_t byteThreshold);
+  ~TieredMatcher() override; // unloads the JIT code
+
+  int search(const char* data, size_t len, int64_t* start_out, int64_t* end_out) override;
+
+  // The JIT entry point, or null while searches are interpreted.
+  RegjitMatchFn jitFunction() const { return fn.load(std::memory_order_acquire); }
+
+private:
+  void requestPromotion();
+  void promote(); // on a compile pool thread
+
+  std::unique_ptr<ProgMatcher> interpreter;
+  CompileFn compile;
+  const uint64_t callThreshold;
+  const uint64_t byteThreshold;
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<bool> requested{false};
+  std::atomic<RegjitMatchFn> fn{nullptr};
+  CompiledEntry jit; // written once, before fn is published; keeps the code loaded
+};
@@ -0,0 +1,61 @@
+#include "regjit_aot.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// regjitc: compile a pattern manifest ahead of time (see regjit_aot.h).
+//
+//   regjitc [--cpu NAME|native] [--features LIST] -o OUT MANIFEST
+//
+// writes OUT.o and OUT.h. `make OUT.a` builds both from OUT.regjit and
+// archives the object with the runtime helpers.
+
+static int usage() {
+  std::cerr << "usage: regjitc [--cpu NAME|native] [--features LIST] -o OUT MANIFEST\n"
+               "  writes the matchers to OUT.o and their declarations to OUT.h\n";
+  return 2;
+}
+
+static void writeFile(const std::string& path, const std::string& data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+  out.close();
+  if (!out) throw std::runtime_error("cannot write " + path);
+}
+
+int main(int argc, char** argv) {
+  AotTarget target;
+  std::string out, manifest;
+  for (int i = 1; i < argc; ++i) {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--cpu") && hasValue) target.CPU = argv[++i];
+    else if (!strcmp(argv[i], "--features") && hasValue) target.Features = argv[++i];
+    else if (!strcmp(argv[i], "-o") && hasValue) out = argv[++i];
+    else if (argv[i][0] != '-' && manifest.empty()) manifest = argv[i];
+    else return usage();
+  }
+  if (out.empty() || manifest.empty()) return usage();
+
+  try {
+    std::ifstream in(manifest);
+    if (!in) throw std::runtime_error("cannot read " + manifest);
+    std::vector<AotPattern> patterns = parseAotManifest(in);
+    if (patterns.empty()) throw std::runtime_error(manifest + " has no patterns");
+
+    // Include guard from the output's file name
+    std::string guard;
+    for (char c : out.substr(out.find_last_of('/') + 1)) {
+      guard += std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(c)) : '_';
+    }
+    guard = "REGJIT_AOT_" + guard + "_H";
+
+    writeFile(out + ".o", compileAotObject(patterns, target));
+    writeFile(out + ".h", aotHeader(patterns, guard));
+  } catch (const std::exception& e) {
+    std::cerr << "regjitc: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
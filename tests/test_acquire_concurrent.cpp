@@ -4,6 +4,7 @@
 #include <vector>
 #include <atomic>
 #include <cassert>
+#include <string>
 #include "../src/regjit_capi.h"
 
 int main() {
@@ -43,6 +44,35 @@ int main() {
         return 3;
     }
 
+    // Distinct cold patterns compiled concurrently: each thread compiles its
+    // own pattern and must get back code for that pattern, not a neighbour's.
+    regjit_set_cache_maxsize(64);
+    std::atomic<int> distinct_ok{0};
+    std::vector<std::thread> dths;
+    for (int i = 0; i < N; ++i) {
+        dths.emplace_back([&distinct_ok, i]() {
+            std::string pat = "k" + std::to_string(i) + "[a-z]+" + std::to_string(i) + "x";
+            std::string hit = "--k" + std::to_string(i) + "abc" + std::to_string(i) + "x--";
+            std::string miss = "--k" + std::to_string(i) + "abc" + std::to_string(i + 1) + "x--";
+            char* err = nullptr;
+            if (!regjit_acquire(pat.c_str(), &err)) {
+                if (err) { fprintf(stderr, "acquire error: %s\n", err); free(err); }
+                return;
+            }
+            regjit_match_result r = regjit_search(pat.c_str(), hit.data(), hit.size());
+            bool good = r.matched == 1 && r.start == 2 && r.end == (int64_t)hit.size() - 2;
+            good = good && regjit_search(pat.c_str(), miss.data(), miss.size()).matched == 0;
+            regjit_release(pat.c_str());
+            if (good) distinct_ok.fetch_add(1);
+        });
+    }
+    for (auto &t : dths) t.join();
+
+    if ((int)distinct_ok != N) {
+        fprintf(stderr, "concurrent distinct compile failed: %d/%d correct\n", (int)distinct_ok.load(), N);
+        return 4;
+    }
+
     printf("concurrent acquire test passed\n");
     return 0;
 }
@@ -0,0 +1,174 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_aho.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Aho-Corasick path for large literal alternations (regjit_aho.h).
+
+static void check_ac(const std::vector<std::string>& keywords, const std::string& input,
+                     int64_t start, int64_t end) {
+    AhoCorasick ac(keywords);
+    int64_t s, e;
+    int m = ac.search(input.data(), input.size(), &s, &e);
+    if (m != (start >= 0 ? 1 : 0) || s != start || e != end) {
+        std::cerr << "  FAIL on '" << input << "': got (" << s << ", " << e << "), expected ("
+                  << start << ", " << end << ")" << std::endl;
+        assert(false);
+    }
+}
+
+// Leftmost-first reference: first position, then first keyword in order
+static void reference(const std::vector<std::string>& keywords, const std::string& input,
+                      int64_t* start, int64_t* end) {
+    for (size_t s = 0; s < input.size(); ++s) {
+        for (const auto& k : keywords) {
+            if (input.compare(s, k.size(), k) == 0) {
+                *start = (int64_t)s;
+                *end = (int64_t)(s + k.size());
+                return;
+            }
+        }
+    }
+    *start = *end = -1;
+}
+
+static std::vector<std::string> random_words(size_t n, uint32_t seed) {
+    std::vector<std::string> words;
+    uint32_t x = seed;
+    for (size_t i = 0; i < n; ++i) {
+        x = x * 1103515245u + 12345u;
+        size_t len = 3 + (x >> 16) % 8;
+        std::string w;
+        for (size_t j = 0; j < len; ++j) {
+            x = x * 1103515245u + 12345u;
+            w += (char)('a' + (x >> 16) % 26);
+        }
+        words.push_back(w);
+    }
+    return words;
+}
+
+static std::string join(const std::vector<std::string>& words) {
+    std::string p;
+    for (const auto& w : words) p += (p.empty() ? "" : "|") + w;
+    return p;
+}
+
+void test_automaton() {
+    std::cout << "Testing the automaton..." << std::endl;
+    check_ac({"he", "she", "his", "hers"}, "ushers", 1, 4);
+    check_ac({"abcd", "bc"}, "abcd", 0, 4);
+    check_ac({"bc", "abcd"}, "abcd", 0, 4);
+    check_ac({"bc", "abcd"}, "abce", 1, 3);
+    check_ac({"ab", "abc"}, "abc", 0, 2);
+    check_ac({"abc", "ab"}, "abc", 0, 3);
+    check_ac({"abc", "ab", "abc"}, "xabc", 1, 4);
+    check_ac({"foo", "bar"}, "", -1, -1);
+    check_ac({"foo", "bar"}, "fobaz", -1, -1);
+    check_ac({"a\nb", std::string("\0z", 2)}, std::string("xx\0z a\nb", 8), 2, 4);
+    check_ac({"\xff\xfe", "q"}, "ab\xff\xfe", 2, 4);
+    // Every byte value in some keyword
+    std::vector<std::string> all;
+    for (int b = 0; b < 256; ++b) all.push_back(std::string(1, (char)b) + "!");
+    check_ac(all, "abc!", 2, 4);
+    std::cout << "  test_automaton passed" << std::endl;
+}
+
+void test_detection() {
+    std::cout << "Testing literal alternation detection..." << std::endl;
+    std::vector<std::string> kw;
+    assert(collectLiteralAlternation(*parseRegex("foo|bar|baz"), 3, kw));
+    assert(kw.size() == 3 && kw[0] == "foo" && kw[2] == "baz");
+    assert(!collectLiteralAlternation(*parseRegex("foo|bar|baz"), 4, kw));
+    assert(!collectLiteralAlternation(*parseRegex("foo|ba.|baz"), 2, kw));
+    assert(!collectLiteralAlternation(*parseRegex("foo||baz"), 2, kw));
+    assert(!collectLiteralAlternation(*parseRegex("^foo|bar"), 2, kw));
+    assert(!collectLiteralAlternation(*parseRegex("(foo|bar)x"), 2, kw));
+    // The parser keeps long alternations one level deep
+    auto ast = parseRegex("a|b|c|(d|e)|f");
+    auto* alt = dynamic_cast<Alternative*>(ast.get());
+    assert(alt && alt->BodyVec.size() == 5);
+    std::cout << "  test_detection passed" << std::endl;
+}
+
+static void check_jit(const std::vector<std::string>& words, const std::vector<std::string>& inputs) {
+    std::string pattern = join(words);
+    char* err = nullptr;
+    auto t0 = std::chrono::steady_clock::now();
+    regjit_handle* h = regjit_open(pattern.c_str(), &err);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    assert(h);
+    std::cout << "  " << words.size() << " keywords compiled in " << secs << "s" << std::endl;
+    for (const auto& in : inputs) {
+        int64_t s, e;
+        reference(words, in, &s, &e);
+        regjit_match_result r = regjit_exec(h, in.data(), in.size());
+        if (r.start != s || r.end != e || r.matched != (s >= 0 ? 1 : 0)) {
+            std::cerr << "  FAIL on '" << in.substr(0, 60) << "': got (" << r.start << ", " << r.end
+                      << "), expected (" << s << ", " << e << ")" << std::endl;
+            assert(false);
+        }
+    }
+    regjit_close(h);
+    regjit_unload(pattern.c_str());
+}
+
+void test_jit_keyword_sets() {
+    std::cout << "Testing keyword sets through the JIT..." << std::endl;
+    std::vector<std::string> words = random_words(5000, 7);
+    std::vector<std::string> inputs;
+    uint32_t x = 99;
+    for (int i = 0; i < 20; ++i) {
+        std::string in;
+        for (int j = 0; j < 200; ++j) {
+            x = x * 1103515245u + 12345u;
+            in += (char)('a' + (x >> 16) % 26);
+        }
+        inputs.push_back(in);
+    }
+    inputs.push_back("-- " + words[4321] + " --");
+    inputs.push_back(std::string(1000, '.'));
+    inputs.push_back("");
+    check_jit(words, inputs);
+    // Below the threshold the trie codegen handles it; same answers
+    std::vector<std::string> few(words.begin(), words.begin() + 40);
+    check_jit(few, inputs);
+    std::cout << "  test_jit_keyword_sets passed" << std::endl;
+}
+
+void test_large_set() {
+    std::cout << "Testing a 50,000-keyword deny-list..." << std::endl;
+    std::vector<std::string> words = random_words(50000, 12345);
+    std::string pattern = join(words);
+    char* err = nullptr;
+    auto t0 = std::chrono::steady_clock::now();
+    regjit_handle* h = regjit_open(pattern.c_str(), &err);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    assert(h);
+    std::cout << "  compiled in " << secs << "s" << std::endl;
+    assert(secs < 30.0);
+    // A megabyte with no keyword, then the last one listed (which may
+    // itself contain an earlier, shorter keyword)
+    std::string tail = words[49999] + " " + words[0];
+    std::string text = std::string(1 << 20, ' ') + tail;
+    int64_t s, e;
+    reference(words, tail, &s, &e);
+    regjit_match_result r = regjit_exec(h, text.data(), text.size());
+    assert(r.matched == 1 && r.start == (1 << 20) + s && r.end == (1 << 20) + e);
+    regjit_close(h);
+    regjit_unload(pattern.c_str());
+    std::cout << "  test_large_set passed" << std::endl;
+}
+
+int main() {
+    test_automaton();
+    test_detection();
+    test_jit_keyword_sets();
+    test_large_set();
+    std::cout << "[Aho-Corasick tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Alternation optimizer (optimizeAlternations) and first-byte dispatch in
+// the backtracking codegen. The direct-coded DFA is switched off so every
+// pattern here goes through Alternative::CodeGen.
+
+static regjit_match_result run(const std::string& pattern, const std::string& input) {
+    regjit_set_dfa_codegen_limit(0);
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(pattern.c_str(), &err);
+    if (!h) std::cerr << "regjit_open failed for " << pattern << ": " << (err ? err : "?") << std::endl;
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    regjit_close(h);
+    regjit_unload(pattern.c_str());
+    regjit_set_dfa_codegen_limit(256);
+    return r;
+}
+
+static void check(const std::string& pattern, const std::string& input, int64_t start, int64_t end) {
+    expect_span(pattern, input, run(pattern, input), start, end);
+}
+
+void test_rewrite_shape() {
+    std::cout << "Testing the rewritten AST..." << std::endl;
+    auto ast = optimizeAlternations(parseRegex("GET|POST|PUT|PATCH|DELETE"));
+    auto* alt = dynamic_cast<Alternative*>(ast.get());
+    assert(alt && alt->BodyVec.size() == 3);
+    // P(OST|UT|ATCH)
+    auto* p = dynamic_cast<Concat*>(alt->BodyVec[1].get());
+    assert(p && p->BodyVec.size() == 2 && p->BodyVec[0]->getSingleChar() == 'P');
+    auto* rest = dynamic_cast<Alternative*>(p->BodyVec[1].get());
+    assert(rest && rest->BodyVec.size() == 3);
+    // Factoring exposes the shared prefix to the search loop
+    assert(optimizeAlternations(parseRegex("abc|abd"))->getLiteralPrefix() == "ab");
+    // Single-byte branches become one class
+    assert(dynamic_cast<CharClass*>(optimizeAlternations(parseRegex("a|b|[0-9]|_")).get()));
+    // ...but only when adjacent
+    auto mixed = optimizeAlternations(parseRegex("a|bc|d"));
+    assert(dynamic_cast<Alternative*>(mixed.get())->BodyVec.size() == 3);
+    std::cout << "  test_rewrite_shape passed" << std::endl;
+}
+
+void test_leftmost_first() {
+    std::cout << "Testing leftmost-first preferences..." << std::endl;
+    check("GET|POST|PUT|PATCH|DELETE", "x PATCH /", 2, 7);
+    check("GET|POST|PUT|PATCH|DELETE", "PUSH", -1, -1);
+    check("ab|a|abc", "abc", 0, 2);
+    check("a|ab", "ab", 0, 1);
+    check("abc|ab", "abd", 0, 2);
+    check("b|ab|a", "xab", 1, 3);
+    check("ab|", "xab", 0, 0);
+    check("a(b|)c", "abc", 0, 3);
+    check("a(b|)c", "xac", 1, 3);
+    // 'ab' must not move ahead of '.', which also matches at 'a'
+    check("ax|.|ab", "ab", 0, 1);
+    check("ax|\\w+|ab", "ab", 0, 2);
+    // ...but may move ahead of branches that start differently
+    check("ax|bq|ab", "zab", 1, 3);
+    check("a|b|c", "xxc", 2, 3);
+    check("(a|b|c)+d", "zabcabd", 1, 7);
+    check("(x|yz|y)w", "yw", 0, 2);
+    check("\\b(cat|car|cart)s", "a cars", 2, 6);
+    std::cout << "  test_leftmost_first passed" << std::endl;
+}
+
+void test_failed_branch_restores_index() {
+    std::cout << "Testing a branch that fails partway through..." << std::endl;
+    // No later branch starts with 'a': the alternation still fails at the
+    // position it started from, not past the bytes the branch consumed
+    check("b(aa|c)?x*?", "ba", 0, 1);
+    check("b(aaa|c)?(x+?b)*", "baa", 0, 1);
+    check("b(axa|c)?(x+?c|c{1,3}b{2}b)*[^a]", "1xxba1", -1, -1);
+    check("(abc|d)x|ab", "abd", 0, 2);
+    std::cout << "  test_failed_branch_restores_index passed" << std::endl;
+}
+
+void test_agrees_with_pike_vm() {
+    std::cout << "Testing agreement with the Pike VM..." << std::endl;
+    const char* patterns[] = {"GET|POST|PUT|PATCH|DELETE", "ab|abc|abd|b", "(foo|bar|baz)[0-9]+",
+                              "x(a|b|c|d)y", "(aa|ab|ba|bb)+c", "[0-9]|a|b|\\s", "(com|org|net)\\b",
+                              "te(st|am|n)s?"};
+    const std::string inputs[] = {"PATCH", "xxabd", "baz42", "xcy", "aabbbac", "  ab", "site.org",
+                                  "teams", "tens", "", "DELETE GET"};
+    for (const char* p : patterns) {
+        PikeVM vm(*parseRegex(p));
+        for (const auto& in : inputs) {
+            int64_t s, e;
+            int m = vm.search(in.data(), in.size(), &s, &e);
+            regjit_match_result j = run(p, in);
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in << "': pike (" << s << ", " << e
+                          << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+    }
+    std::cout << "  test_agrees_with_pike_vm passed" << std::endl;
+}
+
+void test_routing_table() {
+    std::cout << "Testing a 200-branch routing pattern..." << std::endl;
+    const char* verbs[] = {"users", "orders", "items", "carts", "payments"};
+    std::string pattern;
+    std::vector<std::string> routes;
+    for (int i = 0; i < 40; ++i) {
+        for (const char* v : verbs) {
+            routes.push_back("/api/v" + std::to_string(i % 3) + "/" + v + "/" + std::to_string(i));
+            pattern += (pattern.empty() ? "" : "|") + routes.back();
+        }
+    }
+    PikeVM vm(*parseRegex(pattern));
+    for (size_t i = 0; i < routes.size(); i += 7) {
+        std::string in = "GET " + routes[i] + " HTTP/1.1";
+        int64_t s, e;
+        assert(vm.search(in.data(), in.size(), &s, &e) == 1);
+        check(pattern, in, s, e);
+    }
+    check(pattern, "GET /api/v1/users/x HTTP/1.1", -1, -1);
+    std::cout << "  test_routing_table passed" << std::endl;
+}
+
+int main() {
+    regjit_set_cache_maxsize(1024);
+    test_rewrite_shape();
+    test_leftmost_first();
+    test_failed_branch_restores_index();
+    test_agrees_with_pike_vm();
+    test_routing_table();
+    std::cout << "[alternation tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_aot.h"
+#include <llvm/Object/ObjectFile.h>
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Ahead-of-time compilation (regjit_aot.h). The objects are loaded into the
+// JIT to run them; what they may link against is read off their symbols.
+
+static std::vector<AotPattern> patternsFrom(const std::string& manifest) {
+    std::istringstream in(manifest);
+    return parseAotManifest(in);
+}
+
+static std::string manifestError(const std::string& manifest) {
+    try {
+        patternsFrom(manifest);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+void test_manifest() {
+    std::cout << "Testing manifest parsing..." << std::endl;
+    auto ps = patternsFrom("# comment\n\nnum  [0-9]+\r\n\tspaced a b \nlast (x|y)#");
+    assert(ps.size() == 3);
+    assert(ps[0].Name == "num" && ps[0].Pattern == "[0-9]+" && ps[0].Line == 3);
+    // The pattern keeps inner and trailing blanks
+    assert(ps[1].Name == "spaced" && ps[1].Pattern == "a b " && ps[1].Line == 4);
+    assert(ps[2].Name == "last" && ps[2].Pattern == "(x|y)#");
+    assert(manifestError("1abc x").find("line 1") != std::string::npos);
+    assert(manifestError("a-b x").find("not a C identifier") != std::string::npos);
+    assert(manifestError("a x\nb y\na z").find("line 3: 'a' is defined twice") != std::string::npos);
+    assert(manifestError("ok x\nlonely   ").find("no pattern for 'lonely'") != std::string::npos);
+    std::cout << "  test_manifest passed" << std::endl;
+}
+
+// Names of the undefined symbols in an object, without the platform's
+// global prefix
+static std::set<std::string> undefinedSymbols(const std::string& object) {
+    auto buf = MemoryBuffer::getMemBuffer(object, "aot", false);
+    auto obj = ExitOnErr(object::ObjectFile::createObjectFile(buf->getMemBufferRef()));
+    std::set<std::string> names;
+    for (const auto& sym : obj->symbols()) {
+        uint32_t flags = ExitOnErr(sym.getFlags());
+        if (!(flags & object::SymbolRef::SF_Undefined)) continue;
+        std::string name = ExitOnErr(sym.getName()).str();
+        if (!name.empty() && name[0] == JIT->getDataLayout().getGlobalPrefix()) name.erase(0, 1);
+        if (!name.empty()) names.insert(name);
+    }
+    return names;
+}
+
+static std::string keywordAlternation() {
+    std::string p;
+    for (int i = 0; i < 300; ++i) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "kw%03d", i);
+        p += (i ? "|" : "") + std::string(buf);
+    }
+    return p;
+}
+
+void test_matches_like_jit(const AotTarget& target, const std::string& prefix) {
+    std::cout << "Testing objects for cpu '" << target.CPU << "'..." << std::endl;
+    ensureJITInitialized();
+    // One pattern per code path: BMH literal, direct-coded DFA, Teddy,
+    // count_char, an anchored attempt (trace hook), the class span loop,
+    // inner literal, and a keyword alternation the JIT would hand to
+    // Aho-Corasick
+    std::vector<std::string> patterns = {"needle", "[0-9]+\\.[0-9]+", "(foo|bar)+?!", "x+y",
+                                         "^GET /", "[a-z]+?\\d{3}", "[a-z]+?error", keywordAlternation()};
+    std::string manifest;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        manifest += prefix + std::to_string(i) + " " + patterns[i] + "\n";
+    }
+    auto ps = patternsFrom(manifest);
+    std::string object = compileAotObject(ps, target);
+
+    // Only libc, the runtime helpers and what the linker defines, never the
+    // JIT-only automaton
+    for (const auto& name : undefinedSymbols(object)) {
+        bool allowed = name.rfind("regjit_rt_", 0) == 0 || name == "regjit_teddy_find" ||
+                       name == "regjit_trace" || name.rfind("mem", 0) == 0 || name == "bcmp" ||
+                       name == "_GLOBAL_OFFSET_TABLE_";
+        if (!allowed) std::cerr << "  unexpected undefined symbol " << name << std::endl;
+        assert(allowed);
+    }
+
+    ExitOnErr(JIT->addObjectFile(MemoryBuffer::getMemBufferCopy(object, "aot")));
+    const std::vector<std::string> inputs = {
+        "", "a needle here", "pi is 3.14", "barfoo! foo!", "xxxxxxxy", "GET /index", "a GET /",
+        "abc123", "an error", "xx kw123 kw007", "needle" + std::string(100, 'x') + "y", "kw29 kw299"};
+    for (size_t i = 0; i < ps.size(); ++i) {
+        auto fn = (RegjitMatchFn)ExitOnErr(JIT->lookup(ps[i].Name)).getValue();
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(ps[i].Pattern.c_str(), &err);
+        assert(h);
+        for (const auto& in : inputs) {
+            int64_t s = -1, e = -1;
+            int m = fn(in.data(), in.size(), &s, &e);
+            regjit_match_result j = regjit_exec(h, in.data(), in.size());
+            if (m != j.matched || (m && (s != j.start || e != j.end))) {
+                std::cerr << "  FAIL " << ps[i].Name << " on '" << in << "': aot " << m << " (" << s << ", "
+                          << e << ") jit " << j.matched << " (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+    }
+    std::cout << "  test_matches_like_jit passed" << std::endl;
+}
+
+void test_compile_errors() {
+    std::cout << "Testing compile errors..." << std::endl;
+    try {
+        compileAotObject(patternsFrom("good abc\nbad (abc\n"), AotTarget());
+        assert(false);
+    } catch (const std::runtime_error& e) {
+        assert(std::string(e.what()).find("'bad' (line 2)") != std::string::npos);
+    }
+    std::cout << "  test_compile_errors passed" << std::endl;
+}
+
+void test_header() {
+    std::cout << "Testing the header..." << std::endl;
+    std::string h = aotHeader(patternsFrom("digits [0-9]+/*x*/\nctl a\x01z\n"), "REGJIT_AOT_T_H");
+    assert(h.find("#ifndef REGJIT_AOT_T_H\n#define REGJIT_AOT_T_H") != std::string::npos);
+    assert(h.find("int digits(const char* data, size_t len, int64_t* start_out, int64_t* end_out);") !=
+           std::string::npos);
+    assert(h.find("int ctl(") != std::string::npos);
+    // Pattern text cannot end the comment early or carry control bytes
+    assert(h.find("/* [0-9]+/*x*\\/ */") != std::string::npos);
+    assert(h.find("/* a\\x01z */") != std::string::npos);
+    assert(h.find("extern \"C\"") != std::string::npos);
+    std::cout << "  test_header passed" << std::endl;
+}
+
+int main() {
+    test_manifest();
+    test_matches_like_jit(AotTarget(), "aot_base_");
+    AotTarget native;
+    native.CPU = "native";
+    test_matches_like_jit(native, "aot_native_");
+    test_compile_errors();
+    test_header();
+    std::cout << "[aot tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Asynchronous compiles on the compile pool (regjit_pool.h):
+// regjit_compile_async() and getOrCompileAsync().
+
+// Collects callback results; the callbacks run on pool threads
+struct Results {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::vector<regjit_handle*> handles;
+    std::vector<std::string> errors;
+    size_t done = 0;
+
+    void waitFor(size_t n) {
+        std::unique_lock<std::mutex> lk(mu);
+        bool ok = cv.wait_for(lk, std::chrono::seconds(30), [&] { return done >= n; });
+        assert(ok);
+    }
+};
+
+static void onCompiled(regjit_handle* h, const char* err_msg, void* userdata) {
+    Results* r = static_cast<Results*>(userdata);
+    std::lock_guard<std::mutex> lk(r->mu);
+    if (h) {
+        assert(!err_msg);
+        r->handles.push_back(h);
+    } else {
+        assert(err_msg);
+        r->errors.push_back(err_msg);
+    }
+    r->done++;
+    r->cv.notify_all();
+}
+
+void test_callback() {
+    std::cout << "Testing the completion callback..." << std::endl;
+    Results r;
+    assert(regjit_compile_async("ab+c", onCompiled, &r) == 1);
+    assert(regjit_compile_async("(ab", onCompiled, &r) == 1);
+    r.waitFor(2);
+    assert(r.handles.size() == 1 && r.errors.size() == 1);
+    regjit_match_result m = regjit_exec(r.handles[0], "xxabbbc", 7);
+    assert(m.matched == 1 && m.start == 2 && m.end == 7);
+    regjit_close(r.handles[0]);
+    // Nothing queued without a pattern or a callback
+    assert(regjit_compile_async(nullptr, onCompiled, &r) == 0);
+    assert(regjit_compile_async("abc", nullptr, &r) == 0);
+    std::cout << "  test_callback passed" << std::endl;
+}
+
+struct Gate {
+    std::mutex mu;
+    std::condition_variable cv;
+    bool open = false;
+    bool ran = false;
+};
+
+static void waitAtGate(regjit_handle* h, const char*, void* userdata) {
+    Gate* g = static_cast<Gate*>(userdata);
+    std::unique_lock<std::mutex> lk(g->mu);
+    g->cv.wait(lk, [&] { return g->open; });
+    g->ran = true;
+    g->cv.notify_all();
+    regjit_close(h);
+}
+
+void test_submit_does_not_block() {
+    std::cout << "Testing that submission returns before the compile..." << std::endl;
+    Gate g;
+    // The callback cannot finish until the gate opens below, so a
+    // submission that waited for it would never return
+    assert(regjit_compile_async("blocking[0-9]+", waitAtGate, &g) == 1);
+    {
+        std::unique_lock<std::mutex> lk(g.mu);
+        assert(!g.ran);
+        g.open = true;
+        g.cv.notify_all();
+        g.cv.wait(lk, [&] { return g.ran; });
+    }
+    std::cout << "  test_submit_does_not_block passed" << std::endl;
+}
+
+void test_future() {
+    std::cout << "Testing the future-returning API..." << std::endl;
+    std::future<CompiledEntry> ok = getOrCompileAsync("[0-9]{3}x[0-9]{4}");
+    std::future<CompiledEntry> bad = getOrCompileAsync("[abc");
+    CompiledEntry e = ok.get();
+    assert(e.Addr);
+    auto fn = (RegjitMatchFn)(uintptr_t)e.Addr;
+    int64_t s, en;
+    assert(fn("call 555x1234", 13, &s, &en) == 1 && s == 5 && en == 13);
+    releasePattern("[0-9]{3}x[0-9]{4}");
+    bool threw = false;
+    try {
+        bad.get();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  test_future passed" << std::endl;
+}
+
+void test_options() {
+    std::cout << "Testing async compiles with options..." << std::endl;
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_PIKE_VM;
+    Results r;
+    assert(regjit_compile_async_ex("(a|b)*abb", &opts, onCompiled, &r) == 1);
+    r.waitFor(1);
+    assert(r.handles.size() == 1);
+    assert(regjit_tier(r.handles[0]) == 0);
+    regjit_match_result m = regjit_exec(r.handles[0], "babaabb", 7);
+    assert(m.matched == 1 && m.start == 0 && m.end == 7);
+    regjit_close(r.handles[0]);
+
+    std::future<CompiledEntry> f = getOrCompileAsync("x+y", opts);
+    CompiledEntry e = f.get();
+    assert(e.Matcher && !e.Addr);
+    releasePattern(cacheKey("x+y", opts));
+    std::cout << "  test_options passed" << std::endl;
+}
+
+void test_prewarm() {
+    std::cout << "Testing a batch prewarm on a bounded pool..." << std::endl;
+    regjit_set_cache_maxsize(512);
+    regjit_set_compile_threads(2);
+    const size_t n = 200;
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < n; ++i) patterns.push_back("id" + std::to_string(i) + "=[a-f0-9]+");
+    Results r;
+    for (const auto& p : patterns) assert(regjit_compile_async(p.c_str(), onCompiled, &r) == 1);
+    r.waitFor(n);
+    assert(r.handles.size() == n && r.errors.empty());
+    assert(regjit_cache_size() >= n);
+    // Each handle answers for its own pattern
+    for (regjit_handle* h : r.handles) {
+        regjit_match_result m = regjit_exec(h, "id7=beef", 8);
+        assert(m.matched == 0 || (m.start == 0 && m.end == 8));
+    }
+    size_t hits = 0;
+    for (regjit_handle* h : r.handles) {
+        hits += regjit_exec(h, "id7=beef", 8).matched == 1;
+        regjit_close(h);
+    }
+    assert(hits == 1);
+    regjit_set_compile_threads(0);
+    std::cout << "  test_prewarm passed" << std::endl;
+}
+
+int main() {
+    test_callback();
+    test_submit_does_not_block();
+    test_future();
+    test_options();
+    test_prewarm();
+    std::cout << "[async compile tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+
+// Inputs are passed as (data, len): they need not be NUL-terminated and may
+// contain embedded NUL bytes.
+
+void test_embedded_nul() {
+    std::cout << "Testing embedded NUL bytes..." << std::endl;
+    std::string input("a\0b", 3);
+    Initialize();
+    bool ok = CompileRegex("b");
+    assert(ok && "CompileRegex failed for pattern b");
+    assert(Execute(input.data(), input.size()) == 1 && "b should be found after an embedded NUL");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("a\\0b");
+    assert(ok && "CompileRegex failed for pattern a\\0b");
+    assert(Execute(input.data(), input.size()) == 1 && "a\\0b should match a NUL in the input");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("^a.b$");
+    assert(ok && "CompileRegex failed for pattern ^a.b$");
+    assert(Execute(input.data(), input.size()) == 1 && "dot should match an embedded NUL");
+    CleanUp();
+    std::cout << "  test_embedded_nul passed" << std::endl;
+}
+
+void test_slice_bounds() {
+    std::cout << "Testing matching on a slice of a larger buffer..." << std::endl;
+    // Only the first 3 bytes ("abc") are part of the input.
+    const char* buf = "abcdef";
+    Initialize();
+    bool ok = CompileRegex("def");
+    assert(ok && "CompileRegex failed for pattern def");
+    assert(Execute(buf, 3) == 0 && "def lies outside the slice");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("cd");
+    assert(ok && "CompileRegex failed for pattern cd");
+    assert(Execute(buf, 3) == 0 && "cd straddles the end of the slice");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("c$");
+    assert(ok && "CompileRegex failed for pattern c$");
+    assert(Execute(buf, 3) == 1 && "$ should match at the end of the slice");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("c\\b");
+    assert(ok && "CompileRegex failed for pattern c\\b");
+    assert(Execute(buf, 3) == 1 && "\\b should see the slice end as non-word");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("[a-z]{4}");
+    assert(ok && "CompileRegex failed for pattern [a-z]{4}");
+    assert(Execute(buf, 3) == 0 && "char class must not read past the slice");
+    CleanUp();
+
+    Initialize();
+    ok = CompileRegex("\\B");
+    assert(ok && "CompileRegex failed for pattern \\B");
+    assert(Execute(buf, 0) == 1 && "\\B should match the empty slice");
+    CleanUp();
+    std::cout << "  test_slice_bounds passed" << std::endl;
+}
+
+void test_capi_positions() {
+    std::cout << "Testing C API with length-delimited buffers..." << std::endl;
+    std::string input("xx\0needle\0yy", 12);
+    regjit_match_result r = regjit_search("needle", input.data(), input.size());
+    assert(r.matched == 1 && r.start == 3 && r.end == 9);
+
+    r = regjit_search("e+d", input.data(), input.size());
+    assert(r.matched == 1 && r.start == 4 && r.end == 7);
+
+    r = regjit_search("yy$", input.data(), input.size());
+    assert(r.matched == 1 && r.start == 10 && r.end == 12);
+
+    r = regjit_match_at_start("xx", input.data(), 1);
+    assert(r.matched == 0 && r.start == -1 && r.end == -1);
+
+    assert(regjit_match("needle", input.data(), 8) == 0 && "needle is cut off by len");
+    std::cout << "  test_capi_positions passed" << std::endl;
+}
+
+void test_large_offsets() {
+    std::cout << "Testing offsets beyond 2 GiB..." << std::endl;
+    // Reserve a sparse, zero-filled mapping; only the page holding the
+    // needle is ever written.
+    const size_t len = (size_t(1) << 31) + 4096;
+    const int64_t pos = (int64_t(1) << 31) + 10;
+    void* mem = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        std::cout << "  test_large_offsets skipped (mmap failed)" << std::endl;
+        return;
+    }
+    char* buf = static_cast<char*>(mem);
+    memcpy(buf + pos, "needle", 6);
+    memcpy(buf + len - 4, "tail", 4);
+
+    regjit_match_result r = regjit_search("needle", buf, len);
+    assert(r.matched == 1 && r.start == pos && r.end == pos + 6);
+
+    r = regjit_search("ne+dle", buf, len);
+    assert(r.matched == 1 && r.start == pos && r.end == pos + 6);
+
+    r = regjit_search("ta[a-z]l$", buf, len);
+    assert(r.matched == 1 && r.start == (int64_t)len - 4 && r.end == (int64_t)len);
+
+    munmap(mem, len);
+    std::cout << "  test_large_offsets passed" << std::endl;
+}
+
+int main() {
+    test_embedded_nul();
+    test_slice_bounds();
+    test_capi_positions();
+    test_large_offsets();
+    std::cout << "[binary input tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_freq.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+
+// Byte frequency model (regjit_freq.h) and the memchr prefilter byte it
+// picks among a pattern's required bytes.
+
+static int prefilter(const char* pattern) {
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(pattern, &err);
+    assert(h);
+    int b = regjit_prefilter_byte(h);
+    regjit_close(h);
+    regjit_unload(pattern);
+    return b;
+}
+
+static void check(const char* pattern, const std::string& input, int64_t start, int64_t end) {
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(pattern, &err);
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    if (r.start != start || r.end != end) {
+        std::cerr << "  FAIL " << pattern << ": got (" << r.start << ", " << r.end
+                  << "), expected (" << start << ", " << end << ")" << std::endl;
+        assert(false);
+    }
+    regjit_close(h);
+    regjit_unload(pattern);
+}
+
+void test_builtin_model() {
+    std::cout << "Testing the built-in model..." << std::endl;
+    const ByteFrequencies& f = ByteFrequencies::builtin();
+    bool seen[256] = {};
+    for (int b = 0; b < 256; ++b) {
+        assert(!seen[f.rank[b]]);
+        seen[f.rank[b]] = true;
+    }
+    assert(f.rank[' '] == 255);
+    assert(f.rank['@'] < f.rank['.']);
+    assert(f.rank['z'] < f.rank['e'] && f.rank['q'] < f.rank['t']);
+    assert(f.rank[0x01] < f.rank['\n']);
+    assert(rarestByte({}, f) == -1);
+    assert(rarestByte({'.', '@'}, f) == '@');
+    assert(rarestByte({'e', 'x', 'a'}, f) == 'x');
+    std::cout << "  test_builtin_model passed" << std::endl;
+}
+
+void test_training() {
+    std::cout << "Testing a model trained on a sample..." << std::endl;
+    std::string sample = std::string(100, '@') + std::string(10, '.') + "ab";
+    ByteFrequencies f = ByteFrequencies::train(sample.data(), sample.size());
+    assert(f.rank['@'] == 255 && f.rank['.'] == 254);
+    assert(rarestByte({'.', '@'}, f) == '.');
+    // Bytes the sample lacks keep their built-in order below the seen ones
+    const ByteFrequencies& b = ByteFrequencies::builtin();
+    assert(f.rank['z'] < f.rank['a'] && (f.rank['q'] < f.rank['z']) == (b.rank['q'] < b.rank['z']));
+    std::cout << "  test_training passed" << std::endl;
+}
+
+void test_prefilter_choice() {
+    std::cout << "Testing the prefilter byte chosen for patterns..." << std::endl;
+    const char* email = "[a-z]+@[a-z]+\\.[a-z]+";
+    // Both the direct-coded DFA and the backtracking search loop
+    for (size_t limit : {size_t(256), size_t(0)}) {
+        regjit_set_dfa_codegen_limit(limit);
+        assert(prefilter(email) == '@');
+        check(email, "see x.y or bob@site.org.", 11, 23);
+        check(email, "no address. here.", -1, -1);
+        assert(prefilter("[0-9]+x[0-9]*e") == 'x');
+        assert(prefilter("\\w+") == -1);
+    }
+    // The first-literal-char path reports its byte too; pure literals do not
+    regjit_set_dfa_codegen_limit(0);
+    assert(prefilter("k[0-9]+") == 'k');
+    assert(prefilter("keyword") == -1);
+
+    std::string logs;
+    for (int i = 0; i < 50; ++i) logs += "user@host: login ok\n";
+    regjit_train_byte_frequencies(logs.data(), logs.size());
+    for (size_t limit : {size_t(256), size_t(0)}) {
+        regjit_set_dfa_codegen_limit(limit);
+        assert(prefilter(email) == '.');
+        check(email, "see x.y or bob@site.org.", 11, 23);
+    }
+    regjit_reset_byte_frequencies();
+    assert(prefilter(email) == '@');
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_prefilter_choice passed" << std::endl;
+}
+
+int main() {
+    test_builtin_model();
+    test_training();
+    test_prefilter_choice();
+    std::cout << "[byte frequency tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+
+// Character class codegen: compare chains for small classes, a membership
+// bitmap for larger ones. Every byte is checked against
+// CharClass::matchesByte, which the Prog/DFA engines use. The direct-coded
+// DFA is switched off so CharClass::CodeGen runs.
+
+static void check_class(const std::string& cls) {
+    auto ast = parseRegex(cls);
+    auto* cc = dynamic_cast<CharClass*>(ast.get());
+    assert(cc);
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(cls.c_str(), &err);
+    assert(h);
+    for (int b = 0; b < 256; ++b) {
+        char in = static_cast<char>(b);
+        regjit_match_result r = regjit_exec(h, &in, 1);
+        int expect = cc->matchesByte(static_cast<unsigned char>(b)) ? 1 : 0;
+        if (r.matched != expect) {
+            std::cerr << "  FAIL " << cls << " on byte " << b << ": got " << r.matched
+                      << ", expected " << expect << std::endl;
+            assert(false);
+        }
+    }
+    regjit_close(h);
+    regjit_unload(cls.c_str());
+}
+
+void test_every_byte() {
+    std::cout << "Testing every byte against matchesByte..." << std::endl;
+    const std::string classes[] = {
+        "[abc]", "[a-z]", "[^a]", "[a-zA-Z]",                 // compare chains
+        "\\w", "\\W", "\\d", "\\s", "\\S", "[a-zA-Z0-9_\\-\\.]",  // bitmaps
+        "[^a-zA-Z0-9]", "[!#%&\\*\\+/=\\?`\\{\\|\\}~]", "[ -~]",
+        "[\x80-\xff]", "[a\x80-\x9f\xc0-\xff]", "[^\x80-\xff\n]"};
+    for (const auto& c : classes) check_class(c);
+    std::cout << "  test_every_byte passed" << std::endl;
+}
+
+void test_in_patterns() {
+    std::cout << "Testing classes inside larger patterns..." << std::endl;
+    struct Case { const char* pattern; std::string input; int64_t start, end; };
+    const Case cases[] = {
+        {"[a-zA-Z_][a-zA-Z0-9_]*", "  foo_1 = 2", 2, 7},
+        {"\\w+@\\w+\\.com", "mail: bob@site.com!", 6, 18},
+        {"[^ \\t\\r\\n]+", " \t token\n", 3, 8},
+        {"\\d{3}\\-\\d{4}", "call 555-1234", 5, 13},
+        {"[\x80-\xff]+", "ab\xc3\xa9" "c", 2, 4},
+        {"[^a-z0-9 ]", "abc 12 x", -1, -1},
+    };
+    for (const auto& c : cases) {
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(c.pattern, &err);
+        assert(h);
+        regjit_match_result r = regjit_exec(h, c.input.data(), c.input.size());
+        if (r.start != c.start || r.end != c.end) {
+            std::cerr << "  FAIL " << c.pattern << ": got (" << r.start << ", " << r.end
+                      << "), expected (" << c.start << ", " << c.end << ")" << std::endl;
+            assert(false);
+        }
+        regjit_close(h);
+        regjit_unload(c.pattern);
+    }
+    std::cout << "  test_in_patterns passed" << std::endl;
+}
+
+int main() {
+    regjit_set_dfa_codegen_limit(0);
+    test_every_byte();
+    test_in_patterns();
+    std::cout << "[character class bitmap tests passed]" << std::endl;
+    return 0;
+}
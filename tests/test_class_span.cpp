@@ -0,0 +1,102 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Vectorized span scan for greedy character class repeats in
+// Repeat::CodeGen. The direct-coded DFA is switched off so the
+// backtracking codegen runs.
+
+static void check(const char* pattern, const std::string& input, int64_t start, int64_t end) {
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(pattern, &err);
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    if (r.start != start || r.end != end || r.matched != (start >= 0 ? 1 : 0)) {
+        std::cerr << "  FAIL " << pattern << " on '" << input.substr(0, 60) << "': got (" << r.start
+                  << ", " << r.end << "), expected (" << start << ", " << end << ")" << std::endl;
+        assert(false);
+    }
+    regjit_close(h);
+    regjit_unload(pattern);
+}
+
+void test_spans() {
+    std::cout << "Testing span lengths around the vector width..." << std::endl;
+    for (size_t n : {0, 1, 15, 16, 17, 31, 32, 33, 100}) {
+        std::string digits(n, '7');
+        check("\\d+", "ab" + digits + "x", n ? 2 : -1, n ? 2 + (int64_t)n : -1);
+        check("x\\d*", "x" + digits + "y", 0, 1 + (int64_t)n);
+        check("[^;]+;", std::string(n, 'q') + ";", n ? 0 : -1, n ? (int64_t)n + 1 : -1);
+        check("\\w+$", "-- " + std::string(n, 'w'), n ? 3 : -1, n ? 3 + (int64_t)n : -1);
+        // The span stops at the end of the input, not past it
+        check("[a-z]*", std::string(n, 'k'), 0, (int64_t)n);
+    }
+    check("\\s+", "a \t\r\n  b", 1, 7);
+    check("[\x80-\xff]+", "ab\xc3\xa9\xe2\x82\xac" "c", 2, 7);
+    check(".+", "line one\nline two", 0, 8);
+    std::cout << "  test_spans passed" << std::endl;
+}
+
+void test_bounds() {
+    std::cout << "Testing {n,m} bounds..." << std::endl;
+    std::string run(40, '5');
+    check("[0-9]{3}", run, 0, 3);
+    check("[0-9]{20,}", run, 0, 40);
+    check("[0-9]{41,}", run, -1, -1);
+    check("[0-9]{5,18}", run, 0, 18);
+    check("[0-9]{0,17}x", run + "x", 23, 41);
+    check("x[0-9]{2,3}", "x5 x55555", 3, 7);
+    check("[a-f0-9]{32}", "id=" + std::string(31, 'a') + "g" + std::string(32, 'b'), 35, 67);
+    std::cout << "  test_bounds passed" << std::endl;
+}
+
+void test_agrees_with_pike_vm() {
+    std::cout << "Testing agreement with the Pike VM..." << std::endl;
+    const char* patterns[] = {"[a-zA-Z_][a-zA-Z0-9_]*", "\\d+\\.\\d+", "[^ ]+ [^ ]+", "\\w+@\\w+",
+                              "[0-9a-f]{4,8}\\b", "\\S+", "[ -~]{10,}", "\\W+"};
+    std::vector<std::string> inputs = {"", " ", "x", "3.14159 and 2.71828", "bob@example x@y",
+                                       "deadbeef cafe 12345678901", std::string(50, ' ') + "tail"};
+    uint32_t x = 5;
+    for (int i = 0; i < 20; ++i) {
+        std::string in;
+        for (int j = 0; j < 90; ++j) {
+            x = x * 1103515245u + 12345u;
+            const char alphabet[] = "ab09_ .@-\t\x85Zz";
+            in += alphabet[(x >> 16) % (sizeof(alphabet) - 1)];
+        }
+        inputs.push_back(in);
+    }
+    for (const char* p : patterns) {
+        PikeVM vm(*parseRegex(p));
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(p, &err);
+        assert(h);
+        for (const auto& in : inputs) {
+            int64_t s, e;
+            int m = vm.search(in.data(), in.size(), &s, &e);
+            regjit_match_result j = regjit_exec(h, in.data(), in.size());
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in.substr(0, 40) << "': pike (" << s << ", " << e
+                          << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+        regjit_unload(p);
+    }
+    std::cout << "  test_agrees_with_pike_vm passed" << std::endl;
+}
+
+int main() {
+    regjit_set_dfa_codegen_limit(0);
+    test_spans();
+    test_bounds();
+    test_agrees_with_pike_vm();
+    std::cout << "[class span tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_dfa.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+
+// Direct-coded DFA codegen (regjit_set_dfa_codegen_limit).
+
+static const size_t kDefaultLimit = 256;
+
+// Compile `pattern` with the given DFA codegen limit, run it once and drop
+// it from the cache again so the next call recompiles.
+static regjit_match_result run(const char* pattern, const std::string& input, size_t limit) {
+    regjit_set_dfa_codegen_limit(limit);
+    char* err = nullptr;
+    regjit_handle* h = regjit_open(pattern, &err);
+    if (!h) std::cerr << "regjit_open failed for " << pattern << ": " << (err ? err : "?") << std::endl;
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    regjit_close(h);
+    regjit_unload(pattern);
+    regjit_set_dfa_codegen_limit(kDefaultLimit);
+    return r;
+}
+
+static void check(const char* pattern, const std::string& input, int64_t start, int64_t end) {
+    expect_span(pattern, input, run(pattern, input, kDefaultLimit), start, end);
+}
+
+void test_basic() {
+    std::cout << "Testing direct-coded DFA matches..." << std::endl;
+    check("[a-z]+@[a-z]+\\.com", "mail bob@example.com now", 5, 20);
+    check("x[0-9]+", "aaaa x x12y", 7, 10);
+    check("colou?r", "the color red", 4, 9);
+    check("[0-9]{2,3}", "a12345", 1, 4);
+    check("a+b", "caaab", 1, 5);
+    check("a|ab", "ab", 0, 1);
+    check("(a|ab)c", "abc", 0, 3);
+    check("a*a", "aaa", 0, 3);
+    check("a.*b", "axxbyyb", 0, 7);
+    check(".", "\n\nx", 2, 3);
+    check("\\d+", std::string("ab\0" "42", 5), 3, 5);
+    check("[^a-z]+", "ab\xc3\xa9z", 2, 4);
+    check("", "abc", 0, 0);
+    check("a*", "bbb", 0, 0);
+    check("x*", "", 0, 0);
+    check("[a-z]+", "", -1, -1);
+    std::cout << "  test_basic passed" << std::endl;
+}
+
+void test_anchors() {
+    std::cout << "Testing anchors and word boundaries..." << std::endl;
+    check("^ab+", "abbbc", 0, 4);
+    check("^ab+", "xabbb", -1, -1);
+    check("[a-z]+$", "abc def", 4, 7);
+    check("[a-z]+$", "abc def ", -1, -1);
+    check("^$", "", 0, 0);
+    check("\\bfo+\\b", "a foo b", 2, 5);
+    check("\\bfo+\\b", "afoo", -1, -1);
+    check("\\Bo+", "foo", 1, 3);
+    check("x\\b|y", "xa y", 3, 4);
+    check("\\w+\\b", "  ab", 2, 4);
+    std::cout << "  test_anchors passed" << std::endl;
+}
+
+void test_agrees_with_lazy_dfa() {
+    std::cout << "Testing agreement with the lazy DFA engine..." << std::endl;
+    const char* patterns[] = {"[a-z]+@[a-z]+\\.com", "\\d{3}\\-\\d{4}", "^\\w+", "(foo|bar)+",
+                              "\\s+$", "[A-Z][a-z]*", "(a|b)*abb", "\\b[0-9]+\\b"};
+    const std::string inputs[] = {"mail bob@example.com now", "call 555-1234", "Word up",
+                                  "xxbarfoo", "trail   ", "no Caps Here", "babaabbab", "v2 12 x9",
+                                  ""};
+    for (const char* p : patterns) {
+        LazyDFA dfa(*parseRegex(p));
+        for (const auto& in : inputs) {
+            regjit_match_result j = run(p, in, kDefaultLimit);
+            int64_t s, e;
+            int m = dfa.search(in.data(), in.size(), &s, &e);
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in << "': lazy (" << s << ", " << e
+                          << ") codegen (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+    }
+    std::cout << "  test_agrees_with_lazy_dfa passed" << std::endl;
+}
+
+void test_linear_time() {
+    std::cout << "Testing linear time on nested quantifiers..." << std::endl;
+    check("(x+x+)+y", std::string(100000, 'x'), -1, -1);
+    check("(a|aa)+$", std::string(100000, 'a'), 0, 100000);
+    std::string ab;
+    for (int i = 0; i < 50000; ++i) ab += "ab";
+    check("(a|b)*c", ab + "c", 0, (int64_t)ab.size() + 1);
+    std::cout << "  test_linear_time passed" << std::endl;
+}
+
+void test_fallback() {
+    std::cout << "Testing fallback to the backtracking codegen..." << std::endl;
+    std::string in("abc");
+    // DFA semantics up to the limit; the backtracking codegen does not
+    // retry the alternative once 'a' matched.
+    assert(run("(a|ab)c", in, kDefaultLimit).matched == 1);
+    assert(run("(a|ab)c", in, 2).matched == 0);
+    assert(run("(a|ab)c", in, 0).matched == 0);
+    // Lazy quantifiers always use the backtracking codegen
+    assert(run("(a|ab)c+?", in, kDefaultLimit).matched == 0);
+    // a[ab]{8}c needs hundreds of states unanchored
+    std::string big = std::string(64, 'b') + "aababababbc";
+    regjit_match_result r1 = run("a[ab]{8}c", big, 16);
+    regjit_match_result r2 = run("a[ab]{8}c", big, 4096);
+    assert(r1.matched == 1 && r2.matched == 1);
+    assert(r1.start == r2.start && r1.end == r2.end && r2.start == 65);
+    std::cout << "  test_fallback passed" << std::endl;
+}
+
+void test_dense_dfa_minimized() {
+    std::cout << "Testing DFA minimization..." << std::endl;
+    // (a|b)*abb: the 4 states of the textbook DFA, plus the two that the
+    // byte after "abb" leads to, which report the match on entry
+    auto prog = compileProg(*parseRegex("(a|b)*abb"));
+    DenseDFA d;
+    assert(buildDenseDFA(*prog, prog->start, false, 64, d));
+    size_t live = 0;
+    for (size_t s = 1; s < d.size(); ++s) live += d.finished[s] ? 0 : 1;
+    assert(live == 6);
+    assert(!buildDenseDFA(*prog, prog->start, false, 2, d));
+    std::cout << "  test_dense_dfa_minimized passed" << std::endl;
+}
+
+int main() {
+    test_basic();
+    test_anchors();
+    test_agrees_with_lazy_dfa();
+    test_linear_time();
+    test_fallback();
+    test_dense_dfa_minimized();
+    std::cout << "[DFA codegen tests passed]" << std::endl;
+    return 0;
+}
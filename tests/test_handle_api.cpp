@@ -0,0 +1,102 @@
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// regjit_open/regjit_exec/regjit_close: compile once, match many times
+// through a pinned handle.
+
+void test_open_exec_close() {
+    std::cout << "Testing open/exec/close..." << std::endl;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open("b+c", &err);
+    assert(h && "regjit_open failed for b+c");
+
+    std::string input("aabbbcd");
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    assert(r.matched == 1 && r.start == 2 && r.end == 6);
+
+    r = regjit_exec(h, input.data(), 4);
+    assert(r.matched == 0 && "bc is cut off by len");
+
+    r = regjit_exec(h, nullptr, 0);
+    assert(r.matched == 0 && "empty input has no match");
+
+    r = regjit_exec(nullptr, input.data(), input.size());
+    assert(r.matched == -1 && "null handle is an error");
+
+    regjit_close(h);
+    regjit_close(nullptr);
+    std::cout << "  test_open_exec_close passed" << std::endl;
+}
+
+void test_bad_pattern() {
+    std::cout << "Testing open with an invalid pattern..." << std::endl;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open("(abc", &err);
+    assert(!h && "unbalanced group must fail");
+    assert(err && "error message should be set");
+    free(err);
+    std::cout << "  test_bad_pattern passed" << std::endl;
+}
+
+void test_handle_pins_entry() {
+    std::cout << "Testing that an open handle survives eviction and unload..." << std::endl;
+    char* err = nullptr;
+    regjit_set_cache_maxsize(1);
+    regjit_handle* h = regjit_open("pinned", &err);
+    assert(h && "regjit_open failed for pinned");
+
+    // Push other patterns through the one-slot cache and try to unload ours
+    for (const char* p : {"x1", "x2", "x3"}) {
+        assert(regjit_acquire(p, &err));
+        regjit_release(p);
+    }
+    regjit_unload("pinned");
+
+    std::string input("still here: pinned");
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    assert(r.matched == 1 && r.start == 12 && r.end == 18);
+
+    regjit_close(h);
+    regjit_set_cache_maxsize(64);
+    std::cout << "  test_handle_pins_entry passed" << std::endl;
+}
+
+void test_shared_handle_threads() {
+    std::cout << "Testing one handle shared across threads..." << std::endl;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open("[0-9]+x", &err);
+    assert(h && "regjit_open failed for [0-9]+x");
+
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([h, t, &ok]() {
+            std::string input = "ab" + std::to_string(t * 1000 + 7) + "x";
+            int good = 1;
+            for (int i = 0; i < 1000; ++i) {
+                regjit_match_result r = regjit_exec(h, input.data(), input.size());
+                if (r.matched != 1 || r.start != 2 || r.end != (int64_t)input.size()) good = 0;
+            }
+            ok[t] = good;
+        });
+    }
+    for (auto &th : threads) th.join();
+    for (int v : ok) assert(v && "concurrent exec returned a wrong result");
+
+    regjit_close(h);
+    std::cout << "  test_shared_handle_threads passed" << std::endl;
+}
+
+int main() {
+    test_open_exec_close();
+    test_bad_pattern();
+    test_handle_pins_entry();
+    test_shared_handle_threads();
+    std::cout << "[handle API tests passed]" << std::endl;
+    return 0;
+}
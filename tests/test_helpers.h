@@ -0,0 +1,37 @@
+#pragma once
+#include "../src/regjit_capi.h"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Helpers shared by the engine tests. An expected start of -1 means no match.
+
+inline regjit_handle* open_engine(const char* pattern, regjit_engine engine, size_t dfa_cache_bytes = 0) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = engine;
+    opts.dfa_cache_bytes = dfa_cache_bytes;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    if (!h) std::cerr << "regjit_open_ex failed for " << pattern << ": " << (err ? err : "?") << std::endl;
+    assert(h);
+    return h;
+}
+
+inline void expect_span(const std::string& pattern, const std::string& input, const regjit_match_result& r,
+                        int64_t start, int64_t end) {
+    if (r.start != start || r.end != end || r.matched != (start >= 0 ? 1 : 0)) {
+        std::cerr << "  FAIL " << pattern << " on '" << input << "': got " << r.matched
+                  << " (" << r.start << ", " << r.end << "), expected (" << start << ", " << end << ")" << std::endl;
+        assert(false);
+    }
+}
+
+// Open `pattern` with `engine`, search `input` once and close it again
+inline void check_engine(regjit_engine engine, const char* pattern, const std::string& input, int64_t start,
+                         int64_t end) {
+    regjit_handle* h = open_engine(pattern, engine);
+    expect_span(pattern, input, regjit_exec(h, input.data(), input.size()), start, end);
+    regjit_close(h);
+}
@@ -0,0 +1,181 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_dfa.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lazy DFA engine (REGJIT_ENGINE_LAZY_DFA).
+
+static regjit_handle* open_dfa(const char* pattern, size_t cache_bytes = 0) {
+    return open_engine(pattern, REGJIT_ENGINE_LAZY_DFA, cache_bytes);
+}
+
+static void check(const char* pattern, const std::string& input, int64_t start, int64_t end) {
+    check_engine(REGJIT_ENGINE_LAZY_DFA, pattern, input, start, end);
+}
+
+void test_basic() {
+    std::cout << "Testing literals, classes and repeats..." << std::endl;
+    check("abc", "xxabcxx", 2, 5);
+    check("abc", "xxabxcx", -1, -1);
+    check("a+b", "caaab", 1, 5);
+    check("[0-9]{2,3}", "a12345", 1, 4);
+    check("x{2}", "axxx", 1, 3);
+    check("[^a]", "aab", 2, 3);
+    check(".", "\n\nx", 2, 3);
+    check("\\d+", std::string("ab\0" "42", 5), 3, 5);
+    check("colou?r", "the color red", 4, 9);
+    check("", "abc", 0, 0);
+    check("a*", "bbb", 0, 0);
+    check("x*", "", 0, 0);
+    std::cout << "  test_basic passed" << std::endl;
+}
+
+void test_leftmost_first() {
+    std::cout << "Testing leftmost-first preferences..." << std::endl;
+    check("a|ab", "ab", 0, 1);
+    check("ab|a", "ab", 0, 2);
+    check("a.*b", "axxbyyb", 0, 7);
+    check("a.*?b", "axxbyyb", 0, 4);
+    check("a+?", "aaa", 0, 1);
+    // The DFA explores every alternative, so these match even though the
+    // JIT's backtracking codegen does not backtrack into the repeat/alternative.
+    check("(a|ab)c", "abc", 0, 3);
+    check("a*a", "aaa", 0, 3);
+    check("a.*b", "axxbyy", 0, 4);
+    std::cout << "  test_leftmost_first passed" << std::endl;
+}
+
+void test_anchors() {
+    std::cout << "Testing anchors and word boundaries..." << std::endl;
+    check("^abc", "xabc", -1, -1);
+    check("^abc", "abcx", 0, 3);
+    check("c$", "abc", 2, 3);
+    check("c$", "abcd", -1, -1);
+    check("^$", "", 0, 0);
+    check("\\bfoo\\b", "a foo b", 2, 5);
+    check("\\bfoo\\b", "afoo", -1, -1);
+    check("\\Boo", "foo", 1, 3);
+    check("\\b", "  ab", 2, 2);
+    check("x\\b|y", "xa y", 3, 4);
+    std::cout << "  test_anchors passed" << std::endl;
+}
+
+void test_agrees_with_jit() {
+    std::cout << "Testing agreement with the JIT engine..." << std::endl;
+    const char* patterns[] = {"hello", "[a-z]+@[a-z]+\\.com", "\\d{3}\\-\\d{4}", "^\\w+",
+                              "foo|bar", "colou?r", "\\s+$", "[A-Z][a-z]*"};
+    const std::string inputs[] = {"say hello world", "mail bob@example.com now", "call 555-1234",
+                                  "Word up", "xxbarfoo", "colour", "trail   ", "no Caps Here"};
+    for (const char* p : patterns) {
+        regjit_handle* h = open_dfa(p);
+        for (const auto& in : inputs) {
+            regjit_match_result d = regjit_exec(h, in.data(), in.size());
+            regjit_match_result j = regjit_search(p, in.data(), in.size());
+            if (d.matched != j.matched || d.start != j.start || d.end != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in << "': dfa (" << d.start << ", " << d.end
+                          << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+    }
+    std::cout << "  test_agrees_with_jit passed" << std::endl;
+}
+
+void test_pathological() {
+    std::cout << "Testing linear time on nested quantifiers..." << std::endl;
+    std::string as(100000, 'a');
+    check("(a*c?)*b", as, -1, -1);
+    check("(x+x+)+y", std::string(100000, 'x'), -1, -1);
+    check("(a|aa)+$", as, 0, (int64_t)as.size());
+    std::string ab;
+    for (int i = 0; i < 50000; ++i) ab += "ab";
+    check("(a|b)*c", ab + "c", 0, (int64_t)ab.size() + 1);
+    std::cout << "  test_pathological passed" << std::endl;
+}
+
+void test_cache_reset() {
+    std::cout << "Testing state cache budget and reset..." << std::endl;
+    // Unanchored a[ab]{8}c needs ~2^9 DFA states; a 16 KiB budget forces resets.
+    std::string input;
+    uint32_t x = 12345;
+    for (int i = 0; i < 20000; ++i) {
+        x = x * 1103515245u + 12345u;
+        input += (x >> 16) & 1 ? 'a' : 'b';
+    }
+    input += "ac";
+    auto ast = parseRegex("a[ab]{8}c");
+    LazyDFA small(*ast, 16 << 10);
+    LazyDFA large(*ast);
+    int64_t s1, e1, s2, e2;
+    int m1 = small.search(input.data(), input.size(), &s1, &e1);
+    int m2 = large.search(input.data(), input.size(), &s2, &e2);
+    assert(m1 == m2 && s1 == s2 && e1 == e2);
+    assert(small.cacheResets() > 0 && "small budget should have flushed the cache");
+    assert(large.cacheResets() == 0);
+    std::cout << "  test_cache_reset passed" << std::endl;
+}
+
+void test_shared_handle_threads() {
+    std::cout << "Testing one DFA handle shared across threads..." << std::endl;
+    regjit_handle* h = open_dfa("k[0-9]+x");
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([h, t, &ok]() {
+            std::string input = "ab k" + std::to_string(t * 1000 + 7) + "x";
+            int good = 1;
+            for (int i = 0; i < 2000; ++i) {
+                regjit_match_result r = regjit_exec(h, input.data(), input.size());
+                if (r.matched != 1 || r.start != 3 || r.end != (int64_t)input.size()) good = 0;
+            }
+            ok[t] = good;
+        });
+    }
+    for (auto &th : threads) th.join();
+    for (int v : ok) assert(v && "concurrent exec returned a wrong result");
+    regjit_close(h);
+    std::cout << "  test_shared_handle_threads passed" << std::endl;
+}
+
+void test_separate_cache_entries() {
+    std::cout << "Testing that engines are cached separately..." << std::endl;
+    size_t before = regjit_cache_size();
+    char* err = nullptr;
+    // Lazy, so the JIT gets backtracking code, which never goes back into
+    // the alternation; the DFA tries both branches
+    regjit_handle* jit = regjit_open("(a|ab)c+?", &err);
+    regjit_handle* dfa = open_dfa("(a|ab)c+?");
+    assert(regjit_cache_size() == before + 2);
+    std::string in("abcc");
+    assert(regjit_exec(jit, in.data(), in.size()).matched == 0);
+    expect_span("(a|ab)c+?", in, regjit_exec(dfa, in.data(), in.size()), 0, 3);
+    regjit_close(jit);
+    regjit_close(dfa);
+
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_LAZY_DFA;
+    assert(regjit_open_ex("(abc", &opts, &err) == nullptr && err);
+    free(err);
+    std::cout << "  test_separate_cache_entries passed" << std::endl;
+}
+
+int main() {
+    regjit_set_cache_maxsize(1024);
+    test_basic();
+    test_leftmost_first();
+    test_anchors();
+    test_agrees_with_jit();
+    test_pathological();
+    test_cache_reset();
+    test_shared_handle_threads();
+    test_separate_cache_entries();
+    std::cout << "[lazy DFA tests passed]" << std::endl;
+    return 0;
+}
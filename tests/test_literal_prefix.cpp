@@ -0,0 +1,76 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <vector>
+
+// Literal prefix search in the backtracking search loop: patterns that
+// start with a literal run but are not pure literals.
+
+static regjit_match_result run(const char* pattern, const std::string& input, uint64_t budget) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_BACKTRACK;
+    opts.step_budget = budget;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    regjit_close(h);
+    return r;
+}
+
+void test_first_byte_hits_skipped() {
+    std::cout << "Testing that first-byte hits are skipped..." << std::endl;
+    regjit_set_dfa_codegen_limit(0);
+    // Every 'n' used to be a candidate start; only "needle" is now
+    std::string ns = std::string(10000, 'n') + "needle42";
+    regjit_match_result r = run("needle\\d+", ns, 100);
+    assert(r.matched == 1 && r.start == 10000 && r.end == 10008);
+    // Occurrences that fail the rest of the body are passed over one by one
+    std::string gets = "GET /api/ GET /api/9 GET /api/users";
+    r = run("GET /api/[a-z]+", gets, 100);
+    assert(r.matched == 1 && r.start == 21 && r.end == 35);
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_first_byte_hits_skipped passed" << std::endl;
+}
+
+void test_agrees_with_pike_vm() {
+    std::cout << "Testing agreement with the Pike VM..." << std::endl;
+    const char* patterns[] = {"needle\\d+", "GET /api/[a-z]+", "(ab)c[0-9]", "abc\\b", "ab\\bcd",
+                              "foo(bar|baz)+", "xy?z", "key=[^&]*", "aa[a-z]{2}"};
+    const std::vector<std::string> inputs = {
+        "", "needle", "needle7", "xneedleneedle12", "GET /api/x", "GET /api/", "abc1 abc",
+        "abcd abc", "ab cd", "foobarbaz foo", "xz xyz", "key= key=v&k", "aaa aaab aaaaa",
+        std::string(200, 'a') + "abc!"};
+    regjit_set_dfa_codegen_limit(0);
+    for (const char* p : patterns) {
+        PikeVM vm(*parseRegex(p));
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(p, &err);
+        assert(h);
+        for (const auto& in : inputs) {
+            int64_t s, e;
+            int m = vm.search(in.data(), in.size(), &s, &e);
+            regjit_match_result j = regjit_exec(h, in.data(), in.size());
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in.substr(0, 40) << "': pike (" << s << ", "
+                          << e << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+        regjit_unload(p);
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_agrees_with_pike_vm passed" << std::endl;
+}
+
+int main() {
+    test_first_byte_hits_skipped();
+    test_agrees_with_pike_vm();
+    std::cout << "[literal prefix tests passed]" << std::endl;
+    return 0;
+}
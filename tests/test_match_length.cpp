@@ -0,0 +1,103 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <vector>
+
+// Match length bounds (Root::getMinLength/getMaxLength) and how the
+// backtracking search loop uses them to skip start positions.
+
+static int64_t minLength(const char* pattern) {
+    return optimizeAlternations(parseRegex(pattern))->getMinLength();
+}
+
+static int64_t maxLength(const char* pattern) {
+    return optimizeAlternations(parseRegex(pattern))->getMaxLength();
+}
+
+static regjit_match_result run(const char* pattern, const std::string& input, uint64_t budget) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_BACKTRACK;
+    opts.step_budget = budget;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    assert(h);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    regjit_close(h);
+    return r;
+}
+
+void test_length_bounds() {
+    std::cout << "Testing length bounds..." << std::endl;
+    assert(minLength("abc") == 3 && maxLength("abc") == 3);
+    assert(minLength("a+") == 1 && maxLength("a+") == -1);
+    assert(minLength("a*") == 0 && maxLength("a*") == -1);
+    assert(minLength("a{2,5}") == 2 && maxLength("a{2,5}") == 5);
+    assert(minLength("(ab|c)d") == 2 && maxLength("(ab|c)d") == 3);
+    assert(minLength("(a|bc)?") == 0 && maxLength("(a|bc)?") == 2);
+    assert(minLength("[0-9]{3}:[0-9]{4}") == 8 && maxLength("[0-9]{3}:[0-9]{4}") == 8);
+    // Anchors take no input
+    assert(minLength("^a\\bb$") == 2 && maxLength("^a\\bb$") == 2);
+    // A zero count takes no input
+    assert(minLength("x(a|b{0})y") == 2 && maxLength("x(a|b{0})y") == 3);
+    // Nested counts multiply
+    assert(minLength("(ab{2,3}){2}") == 6 && maxLength("(ab{2,3}){2}") == 8);
+    std::cout << "  test_length_bounds passed" << std::endl;
+}
+
+void test_skipped_starts() {
+    std::cout << "Testing skipped start positions..." << std::endl;
+    regjit_set_dfa_codegen_limit(0);
+    // The required 'q' is at the end; only starts within maxLen of it are
+    // tried, not every one from 0
+    std::string as = std::string(10000, 'a');
+    regjit_match_result r = run("[a-z]{2}q", as + "q", 100);
+    assert(r.matched == 1 && r.start == 9998 && r.end == 10001);
+    // Shorter than the shortest match: no start is tried at all
+    assert(run("(a|b)[a-z]{600}", std::string(500, 'a'), 1).matched == 0);
+    // Only the starts that leave minLen bytes are tried
+    assert(run("[a-z]{999}[0-9]", std::string(1000, 'a'), 5).matched == 0);
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_skipped_starts passed" << std::endl;
+}
+
+void test_agrees_with_pike_vm() {
+    std::cout << "Testing agreement with the Pike VM..." << std::endl;
+    const char* patterns[] = {"[a-z]{2}q", "(ab|c)d", "[a-z]{2,4}[0-9]", "x?y{3}", "(a|bc)z",
+                              "\\b[a-z]{3}\\b", "k[0-9]{1,3}", "(foo|ba)r?!"};
+    const std::vector<std::string> inputs = {
+        "", "q", "aq", "abq", "xxxxq", "abd cd", "ab1 abcde9", "yyy", "xyyyy", "bcaz",
+        "ab abc abcd", "k k1 k1234", "bar! foo!", std::string(300, 'z') + "aq"};
+    regjit_set_dfa_codegen_limit(0);
+    for (const char* p : patterns) {
+        PikeVM vm(*parseRegex(p));
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(p, &err);
+        assert(h);
+        for (const auto& in : inputs) {
+            int64_t s, e;
+            int m = vm.search(in.data(), in.size(), &s, &e);
+            regjit_match_result j = regjit_exec(h, in.data(), in.size());
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in.substr(0, 40) << "': pike (" << s << ", "
+                          << e << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+        regjit_unload(p);
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_agrees_with_pike_vm passed" << std::endl;
+}
+
+int main() {
+    test_length_bounds();
+    test_skipped_starts();
+    test_agrees_with_pike_vm();
+    std::cout << "[match length tests passed]" << std::endl;
+    return 0;
+}
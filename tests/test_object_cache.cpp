@@ -0,0 +1,178 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Persistent object cache (regjit_set_object_cache, regjit_objcache.h).
+// The warm restart runs this binary again as a child process.
+
+namespace fs = std::filesystem;
+
+// One pattern per code path: pure literal (BMH), direct-coded DFA, inner
+// literal, literal prefix, required char memchr, Teddy, class span and
+// count_char helpers, lazy backtracking with a step budget
+static const char* kPatterns[] = {"needle", "[0-9]+\\.[0-9]+", "[a-z]+?error", "GET /[a-z]+?x",
+                                  "[a-z]+?@", "(foo|bar)+?!", "[a-z]+?\\d{3}", "a{20}?b"};
+
+static const char* kInput = "xx needle 3.14 ab_error GET /apix bob@ foobar! zz123 aaaaaaaaaaaaaaaaaaaaaab";
+
+static std::vector<regjit_match_result> runAll() {
+    std::vector<regjit_match_result> out;
+    for (const char* p : kPatterns) {
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(p, &err);
+        assert(h);
+        out.push_back(regjit_exec(h, kInput, strlen(kInput)));
+        regjit_close(h);
+    }
+    return out;
+}
+
+static void unloadAll() {
+    for (const char* p : kPatterns) regjit_unload(p);
+}
+
+static size_t countEntries(const fs::path& dir) {
+    size_t n = 0;
+    for (const auto& e : fs::directory_iterator(dir)) n += e.path().extension() == ".rjo";
+    return n;
+}
+
+static bool same(const std::vector<regjit_match_result>& a, const std::vector<regjit_match_result>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].matched != b[i].matched || a[i].start != b[i].start || a[i].end != b[i].end) return false;
+    }
+    return true;
+}
+
+const size_t kNumPatterns = sizeof(kPatterns) / sizeof(kPatterns[0]);
+
+void test_store_and_reload(const fs::path& dir, std::vector<regjit_match_result>& expected) {
+    std::cout << "Testing store and reload..." << std::endl;
+    assert(regjit_set_object_cache(dir.c_str(), 0) == 1);
+    uint64_t loaded = 0, stored = 0;
+    expected = runAll();
+    regjit_object_cache_stats(&loaded, &stored);
+    assert(loaded == 0 && stored == kNumPatterns);
+    assert(countEntries(dir) == kNumPatterns);
+
+    // Unloaded patterns come back from the files
+    unloadAll();
+    assert(same(runAll(), expected));
+    regjit_object_cache_stats(&loaded, &stored);
+    assert(loaded == kNumPatterns && stored == kNumPatterns);
+    std::cout << "  test_store_and_reload passed" << std::endl;
+}
+
+void test_loaded_twice() {
+    std::cout << "Testing a pattern loaded twice..." << std::endl;
+    // The cached entry is open; the legacy API compiles the same pattern
+    // and cannot add the same object again, so it compiles a copy
+    char* err = nullptr;
+    regjit_handle* h = regjit_open("needle", &err);
+    assert(h);
+    assert(CompileRegex("needle"));
+    assert(Execute("a needle") == 1);
+    CleanUp();
+    regjit_close(h);
+    std::cout << "  test_loaded_twice passed" << std::endl;
+}
+
+void test_corrupt_entries(const fs::path& dir, const std::vector<regjit_match_result>& expected) {
+    std::cout << "Testing corrupt entries..." << std::endl;
+    unloadAll();
+    // Truncate half of the files and flip the last object byte of the
+    // others: each fails a check and is compiled and stored again
+    std::vector<fs::path> files;
+    for (const auto& e : fs::directory_iterator(dir)) files.push_back(e.path());
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string data;
+        {
+            std::ifstream in(files[i], std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        if (i % 2) data.resize(data.size() / 2);
+        else data[data.size() - 1] ^= 0x5a;
+        std::ofstream(files[i], std::ios::binary | std::ios::trunc) << data;
+    }
+    assert(regjit_set_object_cache(dir.c_str(), 0) == 1);
+    assert(same(runAll(), expected));
+    uint64_t loaded = 0, stored = 0;
+    regjit_object_cache_stats(&loaded, &stored);
+    assert(loaded == 0 && stored == kNumPatterns);
+    std::cout << "  test_corrupt_entries passed" << std::endl;
+}
+
+void test_size_cap(const fs::path& dir) {
+    std::cout << "Testing the size cap..." << std::endl;
+    unloadAll();
+    // Each entry is larger than the limit, so none is kept
+    assert(regjit_set_object_cache(dir.c_str(), 1) == 1);
+    assert(countEntries(dir) == 0);
+    runAll();
+    assert(countEntries(dir) == 0);
+    assert(regjit_set_object_cache(dir.c_str(), 0) == 1);
+    std::cout << "  test_size_cap passed" << std::endl;
+}
+
+void test_disabled(const fs::path& dir) {
+    std::cout << "Testing the cache turned off..." << std::endl;
+    unloadAll();
+    assert(regjit_set_object_cache(nullptr, 0) == 1);
+    runAll();
+    assert(countEntries(dir) == 0);
+    std::cout << "  test_disabled passed" << std::endl;
+}
+
+// Child: a fresh process loads everything the parent stored
+static int childMain(const char* dir) {
+    assert(regjit_set_object_cache(dir, 0) == 1);
+    auto results = runAll();
+    uint64_t loaded = 0, stored = 0;
+    regjit_object_cache_stats(&loaded, &stored);
+    if (loaded != kNumPatterns || stored != 0) {
+        std::cerr << "  child: loaded " << loaded << " stored " << stored << std::endl;
+        return 1;
+    }
+    for (const auto& r : results) std::cout << r.matched << " " << r.start << " " << r.end << "\n";
+    return 0;
+}
+
+void test_warm_restart(const char* self, const fs::path& dir, const std::vector<regjit_match_result>& expected) {
+    std::cout << "Testing a warm restart..." << std::endl;
+    fs::path out = dir.parent_path() / (dir.filename().string() + ".out");
+    std::string cmd = std::string("\"") + self + "\" --child \"" + dir.string() + "\" > \"" + out.string() + "\"";
+    assert(std::system(cmd.c_str()) == 0);
+    std::ifstream in(out);
+    std::vector<regjit_match_result> results;
+    regjit_match_result r;
+    while (in >> r.matched >> r.start >> r.end) results.push_back(r);
+    assert(same(results, expected));
+    fs::remove(out);
+    std::cout << "  test_warm_restart passed" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::string(argv[1]) == "--child") return childMain(argv[2]);
+
+    fs::path dir = fs::temp_directory_path() / ("regjit_objcache_test_" + std::to_string(std::random_device()()));
+    fs::remove_all(dir);
+    std::vector<regjit_match_result> expected;
+    test_store_and_reload(dir, expected);
+    test_loaded_twice();
+    test_warm_restart(argv[0], dir, expected);
+    test_corrupt_entries(dir, expected);
+    test_size_cap(dir);
+    test_disabled(dir);
+    fs::remove_all(dir);
+    std::cout << "[object cache tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Optimization levels (regjit_options.opt_level): every pipeline, including
+// the REGEX one, must produce a matcher with the same answers.
+
+namespace fs = std::filesystem;
+
+static const regjit_opt_level kLevels[] = {REGJIT_OPT_O0, REGJIT_OPT_O1, REGJIT_OPT_O2, REGJIT_OPT_O3,
+                                           REGJIT_OPT_REGEX};
+
+// Loop-free (anchored literals) and looping code, DFA-shaped and
+// backtracking-shaped, with prefilters and runtime helper calls
+static const char* kPatterns[] = {"^hello",        "^ab$",          "needle",     "[a-z]+@[a-z]+\\.com",
+                                  "(a|ab)(c|bcd)", "[0-9]{3}x?",    "ab+?",       "(foo|bar)+!", 
+                                  "\\bword\\b",    "x[^y]{2,5}z",   "(a(b(c)+)+)+", "cat|dog|bird|fish|cow"};
+
+static const std::vector<std::string> kInputs = {
+    "", "hello world", "say hello", "ab", "abc", "a needle in hay", "mail bob@example.com now", "abcd acbcd",
+    "123x 45", "aaaab", "foobarfoo!", "a word here", "swordfish", "xaaz xyz xabcdez", "abcbcabcbcbc",
+    "hot dog and cow"};
+
+static regjit_handle* openAt(const char* pattern, regjit_opt_level level,
+                             regjit_engine engine = REGJIT_ENGINE_BACKTRACK) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = engine;
+    opts.opt_level = level;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    if (!h) {
+        std::cerr << "  open failed for " << pattern << ": " << (err ? err : "") << std::endl;
+        assert(false);
+    }
+    return h;
+}
+
+static void checkAgainstPike(const char* pattern, const regjit_handle* h, regjit_opt_level level) {
+    PikeVM vm(*parseRegex(pattern));
+    for (const auto& in : kInputs) {
+        int64_t s, e;
+        int m = vm.search(in.data(), in.size(), &s, &e);
+        regjit_match_result r = regjit_exec(h, in.data(), in.size());
+        if (m != r.matched || s != r.start || e != r.end) {
+            std::cerr << "  FAIL " << pattern << " on '" << in << "' at level " << level << ": pike (" << s << ", "
+                      << e << ") jit (" << r.start << ", " << r.end << ")" << std::endl;
+            assert(false);
+        }
+    }
+}
+
+void test_levels_agree() {
+    std::cout << "Testing that every level matches the same..." << std::endl;
+    // Both code generators
+    for (size_t limit : {size_t(256), size_t(0)}) {
+        regjit_set_dfa_codegen_limit(limit);
+        for (const char* p : kPatterns) {
+            for (regjit_opt_level level : kLevels) {
+                regjit_handle* h = openAt(p, level);
+                checkAgainstPike(p, h, level);
+                regjit_close(h);
+            }
+        }
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_levels_agree passed" << std::endl;
+}
+
+void test_large_input() {
+    std::cout << "Testing the backtracking code on a multi-MB input..." << std::endl;
+    // Every start position tried runs the repeat's code again; its locals
+    // must not take more stack each time, even unoptimized
+    regjit_set_dfa_codegen_limit(0);
+    std::string in;
+    while (in.size() < (8u << 20)) in += "a ";
+    for (const char* p : {"[a-z]+[0-9]", "[a-z]*[0-9]", "a*[0-9]", "a{2,3}[0-9]"}) {
+        for (regjit_opt_level level : {REGJIT_OPT_O0, REGJIT_OPT_O1}) {
+            regjit_handle* h = openAt(p, level);
+            assert(regjit_exec(h, in.data(), in.size()).matched == 0);
+            std::string hit = in + "aa7";
+            regjit_match_result r = regjit_exec(h, hit.data(), hit.size());
+            assert(r.matched == 1 && r.end == (int64_t)hit.size());
+            regjit_close(h);
+        }
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_large_input passed" << std::endl;
+}
+
+void test_separate_cache_entries() {
+    std::cout << "Testing cache entries per level..." << std::endl;
+    const char* p = "sep[0-9]+arate";
+    size_t before = regjit_cache_size();
+    std::vector<regjit_handle*> hs;
+    for (regjit_opt_level level : kLevels) hs.push_back(openAt(p, level));
+    assert(regjit_cache_size() == before + 5);
+    // The default level is the plain pattern's entry
+    char* err = nullptr;
+    regjit_handle* plain = regjit_open(p, &err);
+    assert(regjit_cache_size() == before + 5);
+    regjit_close(plain);
+    for (regjit_handle* h : hs) regjit_close(h);
+    std::cout << "  test_separate_cache_entries passed" << std::endl;
+}
+
+void test_other_engines() {
+    std::cout << "Testing opt_level with AUTO and TIERED..." << std::endl;
+    const char* p = "[a-z]+@[a-z]+\\.com";
+    regjit_handle* a = openAt(p, REGJIT_OPT_O1, REGJIT_ENGINE_AUTO);
+    checkAgainstPike(p, a, REGJIT_OPT_O1);
+    regjit_close(a);
+
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_TIERED;
+    opts.tier_up_calls = 1;
+    opts.opt_level = REGJIT_OPT_O0;
+    regjit_handle* t = regjit_open_ex(p, &opts, nullptr);
+    assert(t);
+    checkAgainstPike(p, t, REGJIT_OPT_O0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!regjit_tier(t)) {
+        assert(std::chrono::steady_clock::now() < deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    checkAgainstPike(p, t, REGJIT_OPT_O0);
+    regjit_close(t);
+    std::cout << "  test_other_engines passed" << std::endl;
+}
+
+void test_unknown_level() {
+    std::cout << "Testing an unknown level..." << std::endl;
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.opt_level = (regjit_opt_level)42;
+    char* err = nullptr;
+    assert(regjit_open_ex("abc", &opts, &err) == nullptr);
+    assert(err && strstr(err, "optimization level"));
+    free(err);
+    std::cout << "  test_unknown_level passed" << std::endl;
+}
+
+void test_object_cache_key() {
+    std::cout << "Testing object cache entries per level..." << std::endl;
+    fs::path dir = fs::temp_directory_path() / ("regjit_opt_level_" + std::to_string(std::random_device{}()));
+    assert(regjit_set_object_cache(dir.c_str(), 0) == 1);
+    const char* p = "cached[0-9]+key";
+    regjit_close(openAt(p, REGJIT_OPT_O2));
+    regjit_close(openAt(p, REGJIT_OPT_REGEX));
+    uint64_t loaded, stored;
+    regjit_object_cache_stats(&loaded, &stored);
+    // Different code, so neither is answered by the other's object
+    assert(loaded == 0 && stored == 2);
+    regjit_set_object_cache(nullptr, 0);
+    fs::remove_all(dir);
+    std::cout << "  test_object_cache_key passed" << std::endl;
+}
+
+int main() {
+    // Room for every level of every pattern
+    regjit_set_cache_maxsize(512);
+    test_levels_agree();
+    test_large_input();
+    test_separate_cache_entries();
+    test_other_engines();
+    test_unknown_level();
+    test_object_cache_key();
+    std::cout << "[opt level tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_dfa.h"
+#include "../src/regjit_pike.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pike VM engine (REGJIT_ENGINE_PIKE_VM) and REGJIT_ENGINE_AUTO.
+
+static void check(const char* pattern, const std::string& input, int64_t start, int64_t end,
+                  regjit_engine engine = REGJIT_ENGINE_PIKE_VM) {
+    check_engine(engine, pattern, input, start, end);
+}
+
+void test_basic() {
+    std::cout << "Testing literals, classes and repeats..." << std::endl;
+    check("abc", "xxabcxx", 2, 5);
+    check("abc", "xxabxcx", -1, -1);
+    check("a+b", "caaab", 1, 5);
+    check("[0-9]{2,3}", "a12345", 1, 4);
+    check("[^a]", "aab", 2, 3);
+    check(".", "\n\nx", 2, 3);
+    check("\\d+", std::string("ab\0" "42", 5), 3, 5);
+    check("", "abc", 0, 0);
+    check("a*", "bbb", 0, 0);
+    check("x*", "", 0, 0);
+    std::cout << "  test_basic passed" << std::endl;
+}
+
+void test_leftmost_first() {
+    std::cout << "Testing leftmost-first preferences..." << std::endl;
+    check("a|ab", "ab", 0, 1);
+    check("ab|a", "ab", 0, 2);
+    check("a.*b", "axxbyyb", 0, 7);
+    check("a.*?b", "axxbyyb", 0, 4);
+    check("a+?", "aaa", 0, 1);
+    check("a{2,}?", "aaaa", 0, 2);
+    check("(a|ab)c", "abc", 0, 3);
+    check("(a|ab)+?c", "ababc", 0, 5);
+    check("a*a", "aaa", 0, 3);
+    std::cout << "  test_leftmost_first passed" << std::endl;
+}
+
+void test_anchors() {
+    std::cout << "Testing anchors and word boundaries..." << std::endl;
+    check("^abc", "xabc", -1, -1);
+    check("^abc", "abcx", 0, 3);
+    check("c$", "abc", 2, 3);
+    check("c$", "abcd", -1, -1);
+    check("^$", "", 0, 0);
+    check("\\bfoo\\b", "a foo b", 2, 5);
+    check("\\bfoo\\b", "afoo", -1, -1);
+    check("\\Boo", "foo", 1, 3);
+    check("\\b", "  ab", 2, 2);
+    check("x\\b|y", "xa y", 3, 4);
+    std::cout << "  test_anchors passed" << std::endl;
+}
+
+void test_agrees_with_lazy_dfa() {
+    std::cout << "Testing agreement with the lazy DFA engine..." << std::endl;
+    const char* patterns[] = {"[a-z]+@[a-z]+\\.com", "\\d{3}\\-\\d{4}", "^\\w+", "(foo|bar)+?",
+                              "\\s+$", "[A-Z][a-z]*?", "(a|b)*abb", "\\b[0-9]+\\b", "(a|ab)(c|bcd)"};
+    const std::string inputs[] = {"mail bob@example.com now", "call 555-1234", "Word up",
+                                  "xxbarfoo", "trail   ", "no Caps Here", "babaabbab", "v2 12 x9",
+                                  "abcd", ""};
+    for (const char* p : patterns) {
+        LazyDFA dfa(*parseRegex(p));
+        PikeVM vm(*parseRegex(p));
+        for (const auto& in : inputs) {
+            int64_t s1, e1, s2, e2;
+            int m1 = dfa.search(in.data(), in.size(), &s1, &e1);
+            int m2 = vm.search(in.data(), in.size(), &s2, &e2);
+            if (m1 != m2 || s1 != s2 || e1 != e2) {
+                std::cerr << "  FAIL " << p << " on '" << in << "': dfa (" << s1 << ", " << e1
+                          << ") pike (" << s2 << ", " << e2 << ")" << std::endl;
+                assert(false);
+            }
+        }
+    }
+    std::cout << "  test_agrees_with_lazy_dfa passed" << std::endl;
+}
+
+void test_pathological() {
+    std::cout << "Testing linear time on nested quantifiers..." << std::endl;
+    std::string abc = "a";
+    for (int i = 0; i < 20000; ++i) abc += "bc";
+    check("(a(b(c)+)+)+d", abc, -1, -1);
+    check("(a(b(c)+)+)+", abc, 0, (int64_t)abc.size());
+    check("(x+x+)+y", std::string(50000, 'x'), -1, -1);
+    check("(a|aa)+$", std::string(50000, 'a'), 0, 50000);
+    check("(a|a)*?b", std::string(50000, 'a') + "b", 0, 50001);
+    std::cout << "  test_pathological passed" << std::endl;
+}
+
+void test_nested_quantifier_detection() {
+    std::cout << "Testing nested quantifier detection..." << std::endl;
+    assert(hasNestedQuantifier(*parseRegex("(ba+)+")));
+    assert(hasNestedQuantifier(*parseRegex("(a(b(c)+)+)+")));
+    assert(hasNestedQuantifier(*parseRegex("x(a|aa)*y")));
+    assert(hasNestedQuantifier(*parseRegex("((ab)+c)*")));
+    assert(!hasNestedQuantifier(*parseRegex("a+b*[0-9]{3}")));
+    assert(!hasNestedQuantifier(*parseRegex("(abc)+")));
+    assert(!hasNestedQuantifier(*parseRegex("(a|b)?c")));
+    assert(!hasNestedQuantifier(*parseRegex("foo|bar")));
+    std::cout << "  test_nested_quantifier_detection passed" << std::endl;
+}
+
+void test_auto_engine() {
+    std::cout << "Testing REGJIT_ENGINE_AUTO routing..." << std::endl;
+    // Lazy quantifier over an alternation: no direct-coded DFA, so AUTO
+    // picks BitState (see test_bitstate), which retries the alternative the
+    // backtracking codegen commits to.
+    check("(a|ab)+?c", "abc", 0, 3, REGJIT_ENGINE_AUTO);
+    check("(a|ab)+?c", "abc", -1, -1, REGJIT_ENGINE_BACKTRACK);
+    // Safe patterns stay on the JIT and match as usual
+    check("[a-z]+@[a-z]+\\.com", "mail bob@example.com now", 5, 20, REGJIT_ENGINE_AUTO);
+    check("colou?r", "the color red", 4, 9, REGJIT_ENGINE_AUTO);
+    // Engines are cached separately
+    size_t before = regjit_cache_size();
+    regjit_handle* a = open_engine("(q|qq)+?z", REGJIT_ENGINE_AUTO);
+    regjit_handle* p = open_engine("(q|qq)+?z", REGJIT_ENGINE_PIKE_VM);
+    assert(regjit_cache_size() == before + 2);
+    regjit_close(a);
+    regjit_close(p);
+    std::cout << "  test_auto_engine passed" << std::endl;
+}
+
+void test_shared_handle_threads() {
+    std::cout << "Testing one Pike VM handle shared across threads..." << std::endl;
+    regjit_handle* h = open_engine("k[0-9]+?x", REGJIT_ENGINE_PIKE_VM);
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([h, t, &ok]() {
+            std::string input = "ab k" + std::to_string(t * 1000 + 7) + "x";
+            int good = 1;
+            for (int i = 0; i < 2000; ++i) {
+                regjit_match_result r = regjit_exec(h, input.data(), input.size());
+                if (r.matched != 1 || r.start != 3 || r.end != (int64_t)input.size()) good = 0;
+            }
+            ok[t] = good;
+        });
+    }
+    for (auto &th : threads) th.join();
+    for (int v : ok) assert(v && "concurrent exec returned a wrong result");
+    regjit_close(h);
+    std::cout << "  test_shared_handle_threads passed" << std::endl;
+}
+
+int main() {
+    regjit_set_cache_maxsize(1024);
+    test_basic();
+    test_leftmost_first();
+    test_anchors();
+    test_agrees_with_lazy_dfa();
+    test_pathological();
+    test_nested_quantifier_detection();
+    test_auto_engine();
+    test_shared_handle_threads();
+    std::cout << "[Pike VM tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Runtime helpers called from JIT code (regjit_count_char, regjit_bmh_search).
+// Every variant this CPU supports is checked against a naive reference, not
+// just the one runtimeHelpers() picked.
+
+static size_t naive_count(const char* s, size_t len, char c) {
+    size_t n = 0;
+    while (n < len && s[n] == c) ++n;
+    return n;
+}
+
+static const char* naive_find(const char* h, size_t hl, const char* n, size_t nl) {
+    if (nl == 0) return h;
+    for (size_t i = 0; i + nl <= hl; ++i)
+        if (memcmp(h + i, n, nl) == 0) return h + i;
+    return nullptr;
+}
+
+void test_count_char() {
+    std::cout << "Testing countChar variants..." << std::endl;
+    for (const auto& rt : availableRuntimeHelpers()) {
+        for (size_t len = 0; len <= 200; ++len) {
+            for (size_t run : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(31), size_t(32),
+                               size_t(63), size_t(64), size_t(65), size_t(129), len}) {
+                if (run > len) continue;
+                std::string s(len, 'a');
+                if (run < len) s[run] = 'b';
+                // Offset the buffer so loads start at every alignment
+                for (size_t off = 0; off < 3; ++off) {
+                    std::string buf = std::string(off, 'z') + s;
+                    size_t got = rt.countChar(buf.data() + off, len, 'a');
+                    if (got != naive_count(buf.data() + off, len, 'a')) {
+                        std::cerr << "  FAIL " << rt.isa << " len " << len << " run " << run
+                                  << ": got " << got << std::endl;
+                        assert(false);
+                    }
+                }
+            }
+        }
+        // High bytes compare as bytes, not as signed values
+        std::string hi(70, '\xff');
+        hi[67] = '\x7f';
+        assert(rt.countChar(hi.data(), hi.size(), '\xff') == 67);
+        std::cout << "  " << rt.isa << " ok" << std::endl;
+    }
+    std::cout << "  test_count_char passed" << std::endl;
+}
+
+void test_bmh_search() {
+    std::cout << "Testing bmhSearch variants..." << std::endl;
+    uint32_t x = 7;
+    for (const auto& rt : availableRuntimeHelpers()) {
+        for (size_t nl = 1; nl <= 40; ++nl) {
+            std::string needle;
+            for (size_t i = 0; i < nl; ++i) needle += static_cast<char>('a' + (i * 7) % 5);
+            for (size_t hl : {size_t(0), nl - 1, nl, size_t(17), size_t(33), size_t(64), size_t(130), size_t(300)}) {
+                if (hl < nl && hl != 0 && hl != nl - 1) continue;
+                std::string hay;
+                for (size_t i = 0; i < hl; ++i) {
+                    x = x * 1103515245u + 12345u;
+                    // Near misses: the needle's own bytes, mostly
+                    hay += static_cast<char>('a' + (x >> 16) % 6);
+                }
+                std::vector<size_t> positions = {hl};  // hl means no planted match
+                for (size_t p : {size_t(0), size_t(15), size_t(16), size_t(31), size_t(32), size_t(63), size_t(64)})
+                    if (p + nl <= hl) positions.push_back(p);
+                if (hl >= nl) positions.push_back(hl - nl);
+                uint8_t shift[256];
+                buildBmhShiftTable(needle.data(), nl, shift);
+                for (size_t p : positions) {
+                    std::string h = hay;
+                    if (p < hl) h.replace(p, nl, needle);
+                    const char* got = rt.bmhSearch(h.data(), hl, needle.data(), nl, shift);
+                    const char* expect = naive_find(h.data(), hl, needle.data(), nl);
+                    if (got != expect) {
+                        std::cerr << "  FAIL " << rt.isa << " needle " << nl << " hay " << hl << " at " << p
+                                  << ": got " << (got ? got - h.data() : -1)
+                                  << ", expected " << (expect ? expect - h.data() : -1) << std::endl;
+                        assert(false);
+                    }
+                }
+            }
+        }
+        std::string hi = std::string(100, '\x80') + "\xff\xfe\x80";
+        assert(rt.bmhSearch(hi.data(), hi.size(), "\xff\xfe", 2, nullptr) == hi.data() + 100);
+        // Needles longer than 255 bytes use capped shifts
+        std::string longNeedle(300, 'q');
+        longNeedle[0] = 'x';
+        longNeedle[299] = 'y';
+        uint8_t shift[256];
+        buildBmhShiftTable(longNeedle.data(), longNeedle.size(), shift);
+        std::string hay = std::string(777, 'q') + longNeedle + "zz";
+        assert(rt.bmhSearch(hay.data(), hay.size(), longNeedle.data(), longNeedle.size(), shift) == hay.data() + 777);
+        std::cout << "  " << rt.isa << " ok" << std::endl;
+    }
+    std::cout << "  test_bmh_search passed" << std::endl;
+}
+
+void test_shift_table() {
+    std::cout << "Testing the BMH shift table..." << std::endl;
+    uint8_t shift[256];
+    buildBmhShiftTable("abcab", 5, shift);
+    assert(shift['a'] == 1 && shift['b'] == 3 && shift['c'] == 2 && shift['z'] == 5);
+    std::string longNeedle(400, 'n');
+    longNeedle[0] = 'a';
+    buildBmhShiftTable(longNeedle.data(), longNeedle.size(), shift);
+    assert(shift['a'] == 255 && shift['n'] == 1 && shift['z'] == 255);
+    std::cout << "  test_shift_table passed" << std::endl;
+}
+
+void test_jit_uses_selected_variant() {
+    std::cout << "Testing JIT code through the selected variant (" << runtimeHelpers().isa << ")..." << std::endl;
+    regjit_set_dfa_codegen_limit(0);
+    struct Case { const char* pattern; std::string input; int64_t start, end; };
+    const Case cases[] = {
+        {"needle", std::string(1000, 'n') + "needle", 1000, 1006},
+        {"needle", "a needle", 2, 8},
+        {"needle", "needl", -1, -1},
+        {"^a+$", std::string(999, 'a'), 0, 999},
+        {"^a+$", std::string(500, 'a') + "b", -1, -1},
+        {"^xa{3,70}", "x" + std::string(100, 'a'), 0, 71},
+    };
+    for (const auto& c : cases) {
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(c.pattern, &err);
+        assert(h);
+        regjit_match_result r = regjit_exec(h, c.input.data(), c.input.size());
+        if (r.start != c.start || r.end != c.end) {
+            std::cerr << "  FAIL " << c.pattern << ": got (" << r.start << ", " << r.end
+                      << "), expected (" << c.start << ", " << c.end << ")" << std::endl;
+            assert(false);
+        }
+        regjit_close(h);
+        regjit_unload(c.pattern);
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_jit_uses_selected_variant passed" << std::endl;
+}
+
+int main() {
+    assert(!availableRuntimeHelpers().empty());
+    assert(std::string(runtimeHelpers().isa) == availableRuntimeHelpers().front().isa);
+    test_shift_table();
+    test_count_char();
+    test_bmh_search();
+    test_jit_uses_selected_variant();
+    std::cout << "[runtime helper tests passed]" << std::endl;
+    return 0;
+}
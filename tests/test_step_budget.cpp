@@ -0,0 +1,119 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+
+// Per-call backtracking step budget (regjit_options.step_budget).
+
+static regjit_handle* open_budget(const char* pattern, uint64_t budget,
+                                  regjit_engine engine = REGJIT_ENGINE_BACKTRACK) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = engine;
+    opts.step_budget = budget;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    if (!h) std::cerr << "regjit_open_ex failed for " << pattern << ": " << (err ? err : "?") << std::endl;
+    assert(h);
+    return h;
+}
+
+static regjit_match_result run(const char* pattern, const std::string& input, uint64_t budget,
+                               regjit_engine engine = REGJIT_ENGINE_BACKTRACK) {
+    regjit_handle* h = open_budget(pattern, budget, engine);
+    regjit_match_result r = regjit_exec(h, input.data(), input.size());
+    regjit_close(h);
+    return r;
+}
+
+void test_budget_exceeded() {
+    std::cout << "Testing budget exhaustion..." << std::endl;
+    // Lazy repeats always use the backtracking codegen. The trailing "_q"
+    // gets past the required-byte prefilter; every start position then
+    // scans up to the '_' before failing.
+    std::string letters = std::string(20000, 'k') + "_q";
+    regjit_match_result r = run("[a-z]+?q", letters, 1000);
+    assert(r.matched == REGJIT_BUDGET_EXCEEDED);
+    assert(r.start == -1 && r.end == -1);
+    // The same handle runs out on every call, the counter is per call
+    regjit_handle* h = open_budget("[a-z]+?q", 1000);
+    for (int i = 0; i < 3; ++i)
+        assert(regjit_exec(h, letters.data(), letters.size()).matched == REGJIT_BUDGET_EXCEEDED);
+    // ...and short inputs stay within it, with the unlimited result
+    regjit_handle* unlimited = open_budget("[a-z]+?q", 0);
+    std::string small = "abcq";
+    r = regjit_exec(h, small.data(), small.size());
+    regjit_match_result u = regjit_exec(unlimited, small.data(), small.size());
+    assert(r.matched == 1 && r.start == u.start && r.end == u.end);
+    regjit_close(h);
+    regjit_close(unlimited);
+    std::cout << "  test_budget_exceeded passed" << std::endl;
+}
+
+void test_budget_large_enough() {
+    std::cout << "Testing results within the budget..." << std::endl;
+    std::string letters = std::string(2000, 'k') + "_q";
+    assert(run("[a-z]+?q", letters, 0).matched == 0);
+    assert(run("[a-z]+?q", letters, 1ull << 40).matched == 0);
+    std::string hit(20000, 'k');
+    regjit_match_result r = run("[a-z]+?q", hit + "q", 1ull << 40);
+    assert(r.matched == 1 && r.end == (int64_t)hit.size() + 1);
+    // A generous budget never changes the answer
+    const char* patterns[] = {"(a|ab)+?c", "a.*?b", "[0-9]+?x", "(foo|bar)+?z", "\\w+?\\b"};
+    const std::string inputs[] = {"xxabc", "axxbyyb", "12 345x", "foobarz", "ab cd", ""};
+    for (const char* p : patterns) {
+        for (const auto& in : inputs) {
+            regjit_match_result b = run(p, in, 1ull << 20);
+            regjit_match_result u = run(p, in, 0);
+            assert(b.matched == u.matched && b.start == u.start && b.end == u.end);
+        }
+    }
+    std::cout << "  test_budget_large_enough passed" << std::endl;
+}
+
+void test_dfa_ignores_budget() {
+    std::cout << "Testing that DFA-coded patterns ignore the budget..." << std::endl;
+    std::string letters = std::string(20000, 'k') + "_q_y_z";
+    // [a-z]+z compiles to a direct-coded DFA, which never backtracks
+    assert(run("[a-z]+z", letters, 10).matched == 0);
+    // ...unless DFA codegen is off
+    regjit_set_dfa_codegen_limit(0);
+    assert(run("[a-z]+y", letters, 10).matched == REGJIT_BUDGET_EXCEEDED);
+    regjit_set_dfa_codegen_limit(256);
+    // The Pike VM and lazy DFA engines are linear and ignore it too
+    assert(run("[a-z]+?q", letters, 10, REGJIT_ENGINE_PIKE_VM).matched == 0);
+    assert(run("[a-z]+?q", letters, 10, REGJIT_ENGINE_LAZY_DFA).matched == 0);
+    std::cout << "  test_dfa_ignores_budget passed" << std::endl;
+}
+
+void test_separate_cache_entries() {
+    std::cout << "Testing that budgets are cached separately..." << std::endl;
+    size_t before = regjit_cache_size();
+    // A class rather than a literal at the end, so no inner literal search
+    // skips the backtracking
+    regjit_handle* a = open_budget("[0-9]+?[wx]", 0);
+    regjit_handle* b = open_budget("[0-9]+?[wx]", 100);
+    regjit_handle* c = open_budget("[0-9]+?[wx]", 100000);
+    regjit_handle* d = open_budget("[0-9]+?[wx]", 100);
+    assert(regjit_cache_size() == before + 3);
+    std::string digits = std::string(5000, '7') + "_w";
+    assert(regjit_exec(a, digits.data(), digits.size()).matched == 0);
+    assert(regjit_exec(b, digits.data(), digits.size()).matched == REGJIT_BUDGET_EXCEEDED);
+    assert(regjit_exec(d, digits.data(), digits.size()).matched == REGJIT_BUDGET_EXCEEDED);
+    regjit_close(a);
+    regjit_close(b);
+    regjit_close(c);
+    regjit_close(d);
+    std::cout << "  test_separate_cache_entries passed" << std::endl;
+}
+
+int main() {
+    regjit_set_cache_maxsize(1024);
+    test_budget_exceeded();
+    test_budget_large_enough();
+    test_dfa_ignores_budget();
+    test_separate_cache_entries();
+    std::cout << "[step budget tests passed]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include "../src/regjit_teddy.h"
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Teddy multi-literal prefilter (regjit_teddy.h) in the backtracking search
+// loop. The direct-coded DFA is switched off so the search loop runs.
+
+static std::vector<std::string> prefixes(const char* pattern) {
+    std::vector<std::string> out;
+    if (!collectPrefixSet(*parseRegex(pattern), out)) return {};
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void test_prefix_sets() {
+    std::cout << "Testing prefix set extraction..." << std::endl;
+    assert((prefixes("foo|bar|baz") == std::vector<std::string>{"bar", "baz", "foo"}));
+    assert((prefixes("(GET|PUT) /") == std::vector<std::string>{"GET", "PUT"}));
+    assert((prefixes("[ab]x+") == std::vector<std::string>{"ax", "bx"}));
+    assert((prefixes("a?bc") == std::vector<std::string>{"abc", "bc"}));
+    assert((prefixes("x*y") == std::vector<std::string>{"x", "y"}));
+    assert((prefixes("\\b(cat|dog)s") == std::vector<std::string>{"cat", "dog"}));
+    assert((prefixes("(ab)+c") == std::vector<std::string>{"ab"}));
+    assert((prefixes("longer|words") == std::vector<std::string>{"lon", "wor"}));
+    // Too many first bytes, or a match that may start anywhere
+    assert(prefixes(".x").empty());
+    assert(prefixes("[^x]y").empty());
+    assert(prefixes("(a|b)*").empty());
+    assert(prefixes("a|").empty());
+    // Classes that would blow the limit stop the prefix early
+    assert(prefixes("[a-h][a-z]").size() == 8);
+    std::cout << "  test_prefix_sets passed" << std::endl;
+}
+
+void test_find_matches_brute_force() {
+    std::cout << "Testing regjit_teddy_find against brute force..." << std::endl;
+    const std::vector<std::vector<std::string>> sets = {
+        {"ab", "cd"}, {"q"}, {"xyz", "zyx", "aaa"}, {"\x80\x81", "\xff\x01"},
+        {"a", "b", "c", "d", "e", "f", "g", "h"}};
+    uint32_t x = 1;
+    for (const auto& set : sets) {
+        TeddyMasks masks(set);
+        std::string alphabet;
+        for (const auto& s : set) alphabet += s;
+        alphabet += "-.";
+        for (size_t len : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(17), size_t(31),
+                           size_t(33), size_t(64), size_t(100), size_t(257)}) {
+            std::string text;
+            for (size_t i = 0; i < len; ++i) {
+                x = x * 1103515245u + 12345u;
+                // Mostly filler so hits land all over the vector blocks
+                text += (x >> 16) % 7 == 0 ? alphabet[(x >> 20) % alphabet.size()] : '-';
+            }
+            for (size_t from = 0; from <= len; ++from) {
+                // Up to 8 fingerprints each get a bucket, so candidates are exact
+                int64_t expect = -1;
+                for (size_t i = from; i + masks.len <= len && expect < 0; ++i) {
+                    for (const auto& s : set) {
+                        if (text.compare(i, masks.len, s, 0, masks.len) == 0) { expect = (int64_t)i; break; }
+                    }
+                }
+                int64_t got = regjit_teddy_find(&masks.table[0][0][0], masks.len, text.data(), len, from);
+                if (got != expect) {
+                    std::cerr << "  FAIL set of " << set.size() << " len " << len << " from " << from
+                              << ": got " << got << ", expected " << expect << std::endl;
+                    assert(false);
+                }
+            }
+        }
+    }
+    std::cout << "  test_find_matches_brute_force passed" << std::endl;
+}
+
+void test_agrees_with_pike_vm() {
+    std::cout << "Testing agreement with the Pike VM..." << std::endl;
+    regjit_set_dfa_codegen_limit(0);
+    const char* patterns[] = {"(foo|bar)[0-9]+", "\\b(cat|dog)s?\\b", "(GET|PUT|POST) /[a-z]*",
+                              "x*yz", "[ab]x+c", "(ab)+c", "(error|warn|fatal):\\s+\\w+", "a?bc"};
+    std::string filler(200, '.');
+    const std::string inputs[] = {"", "foo", "xx bar42 foo7", "hotdogs and cats", "GET /index",
+                                  filler + "PUT /a" + filler, "xxxyz", "axxxc bxc", filler + "ababc",
+                                  "log: warn:  disk", filler + filler + "fatal: x", "abc bc"};
+    for (const char* p : patterns) {
+        PikeVM vm(*parseRegex(p));
+        char* err = nullptr;
+        regjit_handle* h = regjit_open(p, &err);
+        assert(h);
+        for (const auto& in : inputs) {
+            int64_t s, e;
+            int m = vm.search(in.data(), in.size(), &s, &e);
+            regjit_match_result j = regjit_exec(h, in.data(), in.size());
+            if (m != j.matched || s != j.start || e != j.end) {
+                std::cerr << "  FAIL " << p << " on '" << in.substr(0, 40) << "': pike (" << s << ", " << e
+                          << ") jit (" << j.start << ", " << j.end << ")" << std::endl;
+                assert(false);
+            }
+        }
+        regjit_close(h);
+        regjit_unload(p);
+    }
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_agrees_with_pike_vm passed" << std::endl;
+}
+
+int main() {
+    test_prefix_sets();
+    test_find_matches_brute_force();
+    test_agrees_with_pike_vm();
+    std::cout << "[Teddy tests passed]" << std::endl;
+    return 0;
+}
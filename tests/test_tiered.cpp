@@ -0,0 +1,202 @@
+#include "../src/regjit.h"
+#include "../src/regjit_capi.h"
+#include "../src/regjit_pike.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tiered execution (REGJIT_ENGINE_TIERED, regjit_tiered.h): interpreted
+// from the first call, JIT code once the pattern is hot.
+
+static regjit_handle* open_tiered(const char* pattern, uint64_t calls, uint64_t bytes, uint64_t budget = 0) {
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_TIERED;
+    opts.tier_up_calls = calls;
+    opts.tier_up_bytes = bytes;
+    opts.step_budget = budget;
+    char* err = nullptr;
+    regjit_handle* h = regjit_open_ex(pattern, &opts, &err);
+    assert(h);
+    return h;
+}
+
+// The compile runs in the background; give it a generous deadline
+static bool waitForJit(const regjit_handle* h) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!regjit_tier(h)) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static void checkAgainstPike(const char* pattern, const regjit_handle* h, const std::vector<std::string>& inputs) {
+    PikeVM vm(*parseRegex(pattern));
+    for (const auto& in : inputs) {
+        int64_t s, e;
+        int m = vm.search(in.data(), in.size(), &s, &e);
+        regjit_match_result r = regjit_exec(h, in.data(), in.size());
+        if (m != r.matched || s != r.start || e != r.end) {
+            std::cerr << "  FAIL " << pattern << " on '" << in.substr(0, 40) << "' (tier " << regjit_tier(h)
+                      << "): pike (" << s << ", " << e << ") tiered (" << r.start << ", " << r.end << ")"
+                      << std::endl;
+            assert(false);
+        }
+    }
+}
+
+void test_call_threshold() {
+    std::cout << "Testing promotion after a number of calls..." << std::endl;
+    const char* p = "[a-z]+@[a-z]+\\.com";
+    const std::vector<std::string> inputs = {"", "mail bob@example.com now", "@.com", "a@b.co x@y.com"};
+    regjit_handle* h = open_tiered(p, 10, 0);
+    assert(regjit_tier(h) == 0);
+    // Interpreted below the threshold, and nothing is compiled
+    for (int i = 0; i < 2; ++i) checkAgainstPike(p, h, inputs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(regjit_tier(h) == 0);
+    // The 10th call queues the compile; the same answers come from either tier
+    checkAgainstPike(p, h, inputs);
+    assert(waitForJit(h));
+    checkAgainstPike(p, h, inputs);
+    regjit_close(h);
+    std::cout << "  test_call_threshold passed" << std::endl;
+}
+
+void test_byte_threshold() {
+    std::cout << "Testing promotion after a number of bytes..." << std::endl;
+    regjit_handle* h = open_tiered("needle[0-9]", 0, 4096);
+    std::string small(1000, 'x');
+    for (int i = 0; i < 3; ++i) assert(regjit_exec(h, small.data(), small.size()).matched == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(regjit_tier(h) == 0);
+    std::string big = std::string(2000, 'x') + "needle7";
+    regjit_match_result r = regjit_exec(h, big.data(), big.size());
+    assert(r.matched == 1 && r.start == 2000 && r.end == 2007);
+    assert(waitForJit(h));
+    r = regjit_exec(h, big.data(), big.size());
+    assert(r.matched == 1 && r.start == 2000 && r.end == 2007);
+    regjit_close(h);
+    std::cout << "  test_byte_threshold passed" << std::endl;
+}
+
+void test_never_promoted() {
+    std::cout << "Testing patterns that stay interpreted..." << std::endl;
+    // Both triggers off
+    regjit_handle* off = open_tiered("abc", 0, 0);
+    // Nested lazy quantifiers: the JIT would backtrack through them
+    regjit_handle* risky = open_tiered("(ba+?)+?c", 1, 1);
+    std::string in = std::string(3000, 'b') + "bac";
+    for (int i = 0; i < 100; ++i) {
+        assert(regjit_exec(off, in.data(), in.size()).matched == 0);
+        regjit_match_result r = regjit_exec(risky, in.data(), in.size());
+        assert(r.matched == 1 && r.start == 3000 && r.end == 3003);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(regjit_tier(off) == 0 && regjit_tier(risky) == 0);
+    regjit_close(off);
+    regjit_close(risky);
+    std::cout << "  test_never_promoted passed" << std::endl;
+}
+
+void test_budget_falls_back() {
+    std::cout << "Testing a tiny step budget..." << std::endl;
+    regjit_set_dfa_codegen_limit(0);
+    regjit_handle* h = open_tiered("[a-z]+?q", 1, 0, 10);
+    std::string in(500, 'a');
+    std::string hit = in + "q";
+    // Hot, but the backtracking code it would get stays out; the budget
+    // never turns into REGJIT_BUDGET_EXCEEDED
+    for (int i = 0; i < 20; ++i) {
+        assert(regjit_exec(h, in.data(), in.size()).matched == 0);
+        regjit_match_result r = regjit_exec(h, hit.data(), hit.size());
+        assert(r.matched == 1 && r.start == 0 && r.end == 501);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(regjit_tier(h) == 0);
+    regjit_close(h);
+    regjit_set_dfa_codegen_limit(256);
+    std::cout << "  test_budget_falls_back passed" << std::endl;
+}
+
+void test_lazy_patterns_stay_interpreted() {
+    std::cout << "Testing lazy patterns the JIT would match differently..." << std::endl;
+    // The backtracking code would keep "a" and never retry "ab" for these
+    const std::vector<std::string> inputs = {"abcd", "xabcccd", "acd", "abd", ""};
+    for (const char* p : {"(a|ab)c.*?d", "(a|ab)c+?"}) {
+        regjit_handle* h = open_tiered(p, 3, 0);
+        for (int i = 0; i < 20; ++i) checkAgainstPike(p, h, inputs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        assert(regjit_tier(h) == 0);
+        checkAgainstPike(p, h, inputs);
+        regjit_close(h);
+    }
+    std::cout << "  test_lazy_patterns_stay_interpreted passed" << std::endl;
+}
+
+void test_limit_change_after_open() {
+    std::cout << "Testing a DFA limit change before promotion..." << std::endl;
+    const char* p = "(a|ab)c";
+    const std::vector<std::string> inputs = {"abc", "xac", "ab", "zabcabc"};
+    regjit_handle* h = open_tiered(p, 5, 0);
+    // Judged exact under the limit it was opened with; the compile keeps
+    // that limit, so the code is still the DFA and still matches "abc"
+    regjit_set_dfa_codegen_limit(0);
+    for (int i = 0; i < 5; ++i) checkAgainstPike(p, h, inputs);
+    assert(waitForJit(h));
+    checkAgainstPike(p, h, inputs);
+    regjit_set_dfa_codegen_limit(256);
+    regjit_close(h);
+    std::cout << "  test_limit_change_after_open passed" << std::endl;
+}
+
+void test_shared_entry_and_threads() {
+    std::cout << "Testing handles and threads sharing a promoted entry..." << std::endl;
+    const char* p = "(GET|POST) /[a-z]+";
+    const std::vector<std::string> inputs = {"GET /index", "x POST /api y", "PUT /x", "GET /", "POST /a GET /b"};
+    regjit_handle* a = open_tiered(p, 200, 0);
+    regjit_handle* b = open_tiered(p, 200, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            // Searches keep going while the compile happens
+            for (int i = 0; i < 300; ++i) checkAgainstPike(p, t % 2 ? a : b, inputs);
+        });
+    }
+    for (auto& th : threads) th.join();
+    // Either handle's calls counted; both see the code
+    assert(waitForJit(a) && regjit_tier(b) == 1);
+    checkAgainstPike(p, b, inputs);
+    regjit_close(a);
+    regjit_close(b);
+    std::cout << "  test_shared_entry_and_threads passed" << std::endl;
+}
+
+void test_syntax_error() {
+    std::cout << "Testing syntax errors on open..." << std::endl;
+    regjit_options opts;
+    regjit_options_init(&opts);
+    opts.engine = REGJIT_ENGINE_TIERED;
+    char* err = nullptr;
+    assert(regjit_open_ex("(abc", &opts, &err) == nullptr);
+    assert(err);
+    free(err);
+    std::cout << "  test_syntax_error passed" << std::endl;
+}
+
+int main() {
+    test_call_threshold();
+    test_byte_threshold();
+    test_never_promoted();
+    test_budget_falls_back();
+    test_lazy_patterns_stay_interpreted();
+    test_limit_change_after_open();
+    test_shared_entry_and_threads();
+    test_syntax_error();
+    std::cout << "[tiered tests passed]" << std::endl;
+    return 0;
+}